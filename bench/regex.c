@@ -0,0 +1,316 @@
+/***************************************************************************//**
+
+  @file         regex.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Benchmarks for regex execution.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on the benchmarks:
+
+  Each corpus is a pattern and a set of lines, generated from a fixed seed so
+  that every run measures the same work.  Each line is matched with reexec()
+  (with and without captures) and reexecw(), over and over for a fixed amount
+  of time, and the throughput is the number of characters matched per second.
+  Wide input is measured in characters too, so that its numbers compare
+  directly with narrow ones.
+
+  Allocations are counted by replacing malloc(), calloc() and realloc() with
+  versions that count calls before passing them on to the C library.  That
+  only works with glibc, which makes its own versions available under other
+  names, and not under AddressSanitizer, which replaces them itself.
+  Otherwise, the allocation column is left out.
+
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+#include "libstephen/re.h"
+
+#define BENCH_SECONDS 0.25
+#define BENCH_LINES 16384
+
+static size_t nallocs = 0;
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+  nallocs++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+  nallocs++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  nallocs++;
+  return __libc_realloc(ptr, size);
+}
+#else
+#define COUNT_ALLOCS 0
+#endif
+
+typedef struct corpus corpus;
+struct corpus {
+  const char *name;
+  char *pattern;
+  char **lines;
+  wchar_t **wlines;
+  size_t nlines;
+  size_t chars;
+};
+
+/*
+  Line generation.
+ */
+
+static unsigned long seed = 1;
+
+static unsigned long next_random(void)
+{
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return seed >> 33;
+}
+
+static const char *words[] = {
+  "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "request",
+  "served", "from", "cache", "user", "login", "session", "closed", "ok",
+};
+
+static const char *alerts[] = {
+  "error", "warning", "fatal", "panic", "abort", "timeout", "refused", "denied",
+};
+
+static void addline(corpus *c, const char *line)
+{
+  size_t len = strlen(line);
+  c->lines[c->nlines] = calloc(len + 1, sizeof(char));
+  c->wlines[c->nlines] = calloc(len + 1, sizeof(wchar_t));
+  for (size_t i = 0; i <= len; i++) {
+    c->lines[c->nlines][i] = line[i];
+    c->wlines[c->nlines][i] = (wchar_t)line[i];
+  }
+  c->chars += len;
+  c->nlines++;
+}
+
+static corpus newcorpus(const char *name, const char *pattern)
+{
+  corpus c;
+  c.name = name;
+  c.pattern = calloc(strlen(pattern) + 1, sizeof(char));
+  strcpy(c.pattern, pattern);
+  c.lines = calloc(BENCH_LINES, sizeof(char *));
+  c.wlines = calloc(BENCH_LINES, sizeof(wchar_t *));
+  c.nlines = 0;
+  c.chars = 0;
+  return c;
+}
+
+static void freecorpus(corpus c)
+{
+  for (size_t i = 0; i < c.nlines; i++) {
+    free(c.lines[i]);
+    free(c.wlines[i]);
+  }
+  free(c.lines);
+  free(c.wlines);
+  free(c.pattern);
+}
+
+/**
+   @brief Lines of words, where one in eight contains a literal.
+ */
+static corpus literal(void)
+{
+  corpus c = newcorpus("literal", ".*needle");
+  char line[128];
+  for (size_t i = 0; i < BENCH_LINES; i++) {
+    line[0] = '\0';
+    for (int w = 0; w < 8; w++) {
+      if (w == 5 && next_random() % 8 == 0) {
+        strcat(line, "needle ");
+      } else {
+        strcat(line, words[next_random() % nelem(words)]);
+        strcat(line, " ");
+      }
+    }
+    addline(&c, line);
+  }
+  return c;
+}
+
+/**
+   @brief Log lines, some of which contain one of many alternatives.
+ */
+static corpus alternation(void)
+{
+  corpus c = newcorpus(
+    "alternation",
+    ".*(error|warning|fatal|panic|abort|timeout|refused|denied): (\\w+)"
+  );
+  char line[128];
+  for (size_t i = 0; i < BENCH_LINES; i++) {
+    line[0] = '\0';
+    for (int w = 0; w < 6; w++) {
+      strcat(line, words[next_random() % nelem(words)]);
+      strcat(line, " ");
+    }
+    if (next_random() % 4 == 0) {
+      strcat(line, alerts[next_random() % nelem(alerts)]);
+      strcat(line, ": ");
+      strcat(line, words[next_random() % nelem(words)]);
+    }
+    addline(&c, line);
+  }
+  return c;
+}
+
+/**
+   @brief Key-value pairs, matched with character classes.
+ */
+static corpus classes(void)
+{
+  corpus c = newcorpus("classes", "([A-Za-z_][A-Za-z0-9_]*)=([0-9a-f]+)");
+  char line[128];
+  for (size_t i = 0; i < BENCH_LINES; i++) {
+    snprintf(line, sizeof(line), "%s_%lu=%lx",
+             words[next_random() % nelem(words)], next_random() % 1000,
+             next_random());
+    if (next_random() % 3 == 0) {
+      // Break the pair, so that not every line matches.
+      *strchr(line, '=') = ':';
+    }
+    addline(&c, line);
+  }
+  return c;
+}
+
+/**
+   @brief (a?){n}a{n} on a string of n a's, which needs every thread.
+ */
+static corpus pathological(size_t n, const char *name)
+{
+  char *pattern = calloc(3 * n + 1, sizeof(char));
+  char *line = calloc(n + 1, sizeof(char));
+  for (size_t i = 0; i < n; i++) {
+    strcat(pattern, "a?");
+    line[i] = 'a';
+  }
+  for (size_t i = 0; i < n; i++) {
+    strcat(pattern, "a");
+  }
+
+  corpus c = newcorpus(name, pattern);
+  for (size_t i = 0; i < BENCH_LINES / 16; i++) {
+    addline(&c, line);
+  }
+  free(pattern);
+  free(line);
+  return c;
+}
+
+/*
+  Measurement.
+ */
+
+enum mode { Plain, WithCaptures, Wide };
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t pass(Regex r, const corpus *c, enum mode m)
+{
+  size_t matches = 0, *saved;
+  for (size_t i = 0; i < c->nlines; i++) {
+    ssize_t match;
+    if (m == Plain) {
+      match = reexec(r, c->lines[i], NULL);
+    } else if (m == WithCaptures) {
+      match = reexec(r, c->lines[i], &saved);
+      free(saved);
+    } else {
+      match = reexecw(r, c->wlines[i], &saved);
+      free(saved);
+    }
+    if (match != -1) {
+      matches++;
+    }
+  }
+  return matches;
+}
+
+static void bench(const corpus *c, enum mode m)
+{
+  const char *modes[] = {"reexec", "reexec+caps", "reexecw"};
+  Regex r = recomp(c->pattern);
+  size_t passes = 0, matches = pass(r, c, m); // warm up the DFA
+  size_t before = nallocs;
+
+  double start = now(), elapsed;
+  do {
+    pass(r, c, m);
+    passes++;
+    elapsed = now() - start;
+  } while (elapsed < BENCH_SECONDS);
+
+  double execs = (double)passes * c->nlines;
+  printf("%-14s %-12s %10.2f MB/s", c->name, modes[m],
+         passes * c->chars / elapsed / 1e6);
+  if (COUNT_ALLOCS) {
+    printf(" %8.2f allocs/exec", (nallocs - before) / execs);
+  }
+  printf(" %7.1f%% matched\n", 100.0 * matches / c->nlines);
+  refree(r);
+}
+
+int main(int argc, char **argv)
+{
+  corpus corpora[] = {
+    literal(),
+    alternation(),
+    classes(),
+    pathological(8, "(a?){8}a{8}"),
+    pathological(16, "(a?){16}a{16}"),
+    pathological(32, "(a?){32}a{32}"),
+  };
+
+  for (size_t i = 0; i < nelem(corpora); i++) {
+    // An argument picks out the corpora whose names contain it.
+    if (argc > 1 && !strstr(corpora[i].name, argv[1])) {
+      continue;
+    }
+    bench(&corpora[i], Plain);
+    bench(&corpora[i], WithCaptures);
+    bench(&corpora[i], Wide);
+  }
+
+  for (size_t i = 0; i < nelem(corpora); i++) {
+    freecorpus(corpora[i]);
+  }
+  return EXIT_SUCCESS;
+}
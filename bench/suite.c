@@ -0,0 +1,280 @@
+/***************************************************************************//**
+
+  @file         suite.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Benchmarks of the core data structures, regex and lisp, using
+                the smbunit benchmark runner.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on the benchmarks:
+
+  Each benchmark times one small operation on a structure which was built
+  before the group ran, so the numbers are per operation and comparable
+  between releases.  Structures which grow are cut back once they're large,
+  keeping their memory, so that a run measures steady state rather than the
+  first allocations.
+
+*******************************************************************************/
+
+#include <stdio.h>
+
+#include "libstephen/al.h"
+#include "libstephen/cb.h"
+#include "libstephen/ht.h"
+#include "libstephen/hta.h"
+#include "libstephen/lisp.h"
+#include "libstephen/ll.h"
+#include "libstephen/rb.h"
+#include "libstephen/re.h"
+#include "libstephen/ut.h"
+
+#define BENCH_KEYS 4096
+
+static unsigned int int_hash(DATA d)
+{
+  return (unsigned int) d.data_llint;
+}
+
+static unsigned int hta_hash(void *key)
+{
+  return *(unsigned int*) key;
+}
+
+/*
+  Containers.
+ */
+
+static void bench_al_append(void *arg, long n)
+{
+  smb_al *list = arg;
+  DATA d = {.data_llint = 1};
+  for (long i = 0; i < n; i++) {
+    al_append(list, d);
+    if (list->length == 65536) {
+      list->length = 0;
+    }
+  }
+}
+
+static void bench_al_get(void *arg, long n)
+{
+  smb_al *list = arg;
+  smb_status status = SMB_SUCCESS;
+  long long sum = 0;
+  for (long i = 0; i < n; i++) {
+    sum += al_get(list, i & (BENCH_KEYS - 1), &status).data_llint;
+  }
+  su_bench_keep(&sum);
+}
+
+static void bench_ll_queue(void *arg, long n)
+{
+  smb_ll *list = arg;
+  smb_status status = SMB_SUCCESS;
+  DATA d = {.data_llint = 1};
+  for (long i = 0; i < n; i++) {
+    ll_append(list, d);
+    d = ll_pop_front(list, &status);
+  }
+  su_bench_keep(&d);
+}
+
+static void bench_ht_get(void *arg, long n)
+{
+  smb_ht *table = arg;
+  smb_status status = SMB_SUCCESS;
+  long long sum = 0;
+  for (long i = 0; i < n; i++) {
+    DATA key = {.data_llint = i & (BENCH_KEYS - 1)};
+    sum += ht_get(table, key, &status).data_llint;
+  }
+  su_bench_keep(&sum);
+}
+
+static void bench_ht_miss(void *arg, long n)
+{
+  smb_ht *table = arg;
+  int found = 0;
+  for (long i = 0; i < n; i++) {
+    DATA key = {.data_llint = BENCH_KEYS + (i & (BENCH_KEYS - 1))};
+    found += ht_contains(table, key);
+  }
+  su_bench_keep(&found);
+}
+
+static void bench_hta_get(void *arg, long n)
+{
+  smb_hta *table = arg;
+  smb_status status = SMB_SUCCESS;
+  long long sum = 0;
+  for (long i = 0; i < n; i++) {
+    unsigned int key = i & (BENCH_KEYS - 1);
+    sum += *(int*) hta_get(table, &key, &status);
+  }
+  su_bench_keep(&sum);
+}
+
+static void bench_rb_queue(void *arg, long n)
+{
+  smb_rb *rb = arg;
+  int value = 0;
+  for (long i = 0; i < n; i++) {
+    rb_push_back(rb, &value);
+    rb_pop_front(rb, &value);
+  }
+  su_bench_keep(&value);
+}
+
+static void bench_cb_printf(void *arg, long n)
+{
+  cbuf *cb = arg;
+  for (long i = 0; i < n; i++) {
+    cb_clear(cb);
+    cb_printf(cb, "%s:%d: %s", "src/file.c", (int) i, "a message");
+  }
+  su_bench_keep(cb->buf);
+}
+
+static void bench_cb_append(void *arg, long n)
+{
+  cbuf *cb = arg;
+  for (long i = 0; i < n; i++) {
+    cb_clear(cb);
+    cb_concat(cb, "src/file.c:");
+    cb_append_int(cb, i);
+    cb_concat(cb, ": a message");
+  }
+  su_bench_keep(cb->buf);
+}
+
+/*
+  Regex.
+ */
+
+static const char *email = "([a-z]+)@([a-z]+)\\.com";
+static const char *email_line = "mail from someone@example.com was received";
+
+static void bench_re_compile(void *arg, long n)
+{
+  (void) arg; // unused
+  for (long i = 0; i < n; i++) {
+    refree(recomp(email));
+  }
+}
+
+static void bench_re_match(void *arg, long n)
+{
+  Regex *r = arg;
+  ssize_t total = 0;
+  for (long i = 0; i < n; i++) {
+    total += reexec(*r, email_line, NULL);
+  }
+  su_bench_keep(&total);
+}
+
+static void bench_re_captures(void *arg, long n)
+{
+  Regex *r = arg;
+  size_t *saved = NULL;
+  ssize_t total = 0;
+  for (long i = 0; i < n; i++) {
+    total += reexec(*r, email_line, &saved);
+    free(saved);
+  }
+  su_bench_keep(&total);
+}
+
+/*
+  Lisp.
+ */
+
+typedef struct {
+  lisp_runtime rt;
+  lisp_scope *scope;
+  lisp_value *call;
+} lisp_bench;
+
+static void bench_lisp_call(void *arg, long n)
+{
+  lisp_bench *lb = arg;
+  lisp_value *result = NULL;
+  for (long i = 0; i < n; i++) {
+    result = lisp_eval(&lb->rt, lb->scope, lb->call);
+    if ((i & 1023) == 1023) {
+      lisp_collect(&lb->rt, (lisp_value*) lb->scope);
+    }
+  }
+  su_bench_keep(result);
+}
+
+int main(void)
+{
+  smb_ut_group *group = su_create_test_group("bench/suite.c");
+  smb_al list, lookup;
+  smb_ll queue;
+  smb_ht table;
+  smb_hta atable;
+  smb_rb rb;
+  cbuf cb;
+  lisp_bench lb;
+  Regex r = recomp(email);
+  DATA d;
+  unsigned int i;
+  int value;
+
+  al_init(&list);
+  al_init(&lookup);
+  ll_init(&queue);
+  ht_init(&table, int_hash, data_compare_int);
+  hta_init(&atable, hta_hash, hta_int_comp, sizeof(unsigned int), sizeof(int));
+  rb_init(&rb, sizeof(int), 16);
+  cb_init(&cb, 256);
+  for (i = 0; i < BENCH_KEYS; i++) {
+    d.data_llint = i;
+    value = i;
+    al_append(&lookup, d);
+    ht_insert(&table, d, d);
+    hta_insert(&atable, &i, &value);
+  }
+
+  lisp_init(&lb.rt);
+  lb.scope = (lisp_scope*) lisp_new(&lb.rt, type_scope);
+  lisp_scope_populate_builtins(&lb.rt, lb.scope);
+  lisp_eval(&lb.rt, lb.scope,
+            lisp_parse(&lb.rt, "(define f (lambda (x y) (- (* x 3) y)))"));
+  lb.call = lisp_parse(&lb.rt, "(f 5 4)");
+  lisp_push_root(&lb.rt, lb.call);
+
+  su_add_bench(group, su_create_bench("al_append", bench_al_append, &list));
+  su_add_bench(group, su_create_bench("al_get", bench_al_get, &lookup));
+  su_add_bench(group, su_create_bench("ll_append_pop", bench_ll_queue, &queue));
+  su_add_bench(group, su_create_bench("ht_get", bench_ht_get, &table));
+  su_add_bench(group, su_create_bench("ht_miss", bench_ht_miss, &table));
+  su_add_bench(group, su_create_bench("hta_get", bench_hta_get, &atable));
+  su_add_bench(group, su_create_bench("rb_push_pop", bench_rb_queue, &rb));
+  su_add_bench(group, su_create_bench("cb_printf", bench_cb_printf, &cb));
+  su_add_bench(group, su_create_bench("cb_append", bench_cb_append, &cb));
+  su_add_bench(group, su_create_bench("re_compile", bench_re_compile, NULL));
+  su_add_bench(group, su_create_bench("re_match", bench_re_match, &r));
+  su_add_bench(group, su_create_bench("re_captures", bench_re_captures, &r));
+  su_add_bench(group, su_create_bench("lisp_call", bench_lisp_call, &lb));
+  su_run_benches(group);
+  su_delete_group(group);
+
+  lisp_destroy(&lb.rt);
+  refree(r);
+  cb_destroy(&cb);
+  rb_destroy(&rb);
+  hta_destroy(&atable);
+  ht_destroy(&table);
+  ll_destroy(&queue);
+  al_destroy(&lookup);
+  al_destroy(&list);
+  return 0;
+}
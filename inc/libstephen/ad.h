@@ -19,6 +19,12 @@
   Finally are bare strings, which are things that aren't passed as parameters or
   as flags.
 
+  When the response_files field is set, an argument "@file" is replaced by the
+  lines of the file, one argument per line (empty lines are skipped), as if
+  they'd been on the command line there.  Response files can name other
+  response files.  If the file can't be read, "@file" is kept as it is.  It is
+  off by default, so that "@" arguments are plain strings.
+
   @copyright    Copyright (c) 2013-2016, Stephen Brennan.  Released under the
                 Revised BSD License.  See the LICENSE.txt file for details.
 
@@ -35,6 +41,12 @@
  */
 #define MAX_FLAGS 52
 
+/**
+   @brief How deeply response files can name other response files.  It stops a
+   file which names itself.
+ */
+#define AD_MAX_RESPONSE_DEPTH 16
+
 /**
    @brief Data structure to store information on arguments passed to the program.
  */
@@ -65,6 +77,33 @@ typedef struct smb_ad
    */
   struct smb_ll *bare_strings;
 
+  /**
+     @brief Maps each long flag to the index of its first occurrence.
+   */
+  struct smb_ht *long_flag_index;
+
+  /**
+     @brief Maps each long flag to the parameter of its first occurrence.
+   */
+  struct smb_ht *long_flag_params;
+
+  /**
+     @brief Maps each bare string to the index of its first occurrence.
+   */
+  struct smb_ht *bare_string_index;
+
+  /**
+     @brief Holds the arguments read from response files, or NULL if there
+     were none.
+   */
+  struct smb_arena *response_strings;
+
+  /**
+     @brief Whether "@file" arguments are read as response files.  It is false
+     after arg_data_init(), so set it before process_args() to opt in.
+   */
+  bool response_files;
+
 } smb_ad;
 
 /**
@@ -97,7 +136,8 @@ void arg_data_delete(smb_ad *data);
    respective variable so they do not include the name of the program.  Unless,
    of course, you want the program name to be processed as an argument.  Once
    you have called this function, you can use the querying functions to find all
-   the arguments.
+   the arguments.  They look flags and strings up in hash tables, so each check
+   takes constant time however many arguments there are.
 
    @param data A pointer to an smb_ad object.
    @param argc The number of arguments (not including program name).
@@ -24,6 +24,12 @@
 #include "base.h"  /* DATA     */
 #include "list.h"  /* smb_list */
 
+/**
+   @brief The default factor an array list's capacity is multiplied by when it
+   is full.
+ */
+#define SMB_AL_GROWTH 2.0
+
 /**
    @brief The actual array list data type.
 
@@ -47,6 +53,16 @@ typedef struct smb_al
    */
   int allocated;
 
+  /**
+     @brief The factor the space is multiplied by when the list is full.
+   */
+  double growth;
+
+  /**
+     @brief The allocator the data comes from, or NULL for the default.
+   */
+  const smb_allocator *alloc;
+
 } smb_al;
 
 /**
@@ -56,6 +72,12 @@ typedef struct smb_al
    stack and initialize it, rather than allocating space on the heap.
  */
 void al_init(smb_al *list);
+/**
+   @brief Initialize an empty array list whose data comes from an allocator.
+   @param list The list to initialize.
+   @param allocator The allocator, or NULL for the default.
+ */
+void al_init_alloc(smb_al *list, const smb_allocator *allocator);
 /**
    @brief Allocate and initialize an empty array list.
    @returns A pointer to the new array list.
@@ -93,6 +115,45 @@ smb_list al_cast_to_list(smb_al *list);
    @param newData The data to append
  */
 void al_append(smb_al *list, DATA newData);
+/**
+   @brief Append n items to the end of a list, in one copy.
+   @param list A pointer to the list to append to.
+   @param items The items to append.
+   @param n The number of items.
+ */
+void al_append_many(smb_al *list, const DATA *items, int n);
+/**
+   @brief Insert n items at the specified location in the list.
+
+   The items after the location are moved up once, for the whole batch.  Out
+   of range locations are treated as they are by al_insert().
+   @param list A pointer to the list to insert into.
+   @param index The index to insert at.
+   @param items The items to insert.
+   @param n The number of items.
+ */
+void al_insert_many(smb_al *list, int index, const DATA *items, int n);
+/**
+   @brief Make sure the list can hold n items without expanding.
+   @param list A pointer to the list.
+   @param n The number of items.
+ */
+void al_reserve(smb_al *list, int n);
+/**
+   @brief Free the space allocated beyond the items in the list.
+   @param list A pointer to the list.
+ */
+void al_shrink_to_fit(smb_al *list);
+/**
+   @brief Set the factor the list's space is multiplied by when it is full.
+
+   Factors closer to 1 waste less space, and larger ones copy less.  It always
+   grows by at least a small block, so a factor of 1 (or less) grows the list by
+   a constant amount each time.
+   @param list A pointer to the list.
+   @param growth The growth factor.  The default is SMB_AL_GROWTH.
+ */
+void al_set_growth(smb_al *list, double growth);
 /**
    @brief Prepend an item to the beginning of the list.
    @param list A pointer to the list to prepend to.
@@ -205,6 +266,50 @@ int al_length(const smb_al *list);
    @returns Index of the item, or -1 if it's not in the list.
  */
 int al_index_of(const smb_al *list, DATA d, DATA_COMPARE comp);
+/**
+   @brief Stable sort of the list.  See data_sort().
+   @param list A pointer to the list.
+   @param cmp Comparator for ordering.
+ */
+void al_sort(smb_al *list, DATA_COMPARE cmp);
+/**
+   @brief Stable sort of the list, on up to nthreads threads.  See
+   data_sort_parallel().
+   @param list A pointer to the list.
+   @param cmp Comparator for ordering, safe to call from many threads.
+   @param nthreads The most threads to use, including the calling one.
+ */
+void al_sort_parallel(smb_al *list, DATA_COMPARE cmp, int nthreads);
+/**
+   @brief Sort a list of data_llint with a radix sort.  See data_sort_llint().
+   @param list A pointer to the list.
+ */
+void al_sort_llint(smb_al *list);
+/**
+   @brief Sort a list of data_dbl with a radix sort.  See data_sort_dbl().
+   @param list A pointer to the list.
+ */
+void al_sort_dbl(smb_al *list);
+
+/**
+   @brief Loop over every item of an array list, without any function calls.
+
+   The list must not be changed in the loop.  For example:
+
+       int i;
+       DATA d;
+       AL_FOR_EACH(list, i, d) {
+         printf("%d: %lld\n", i, d.data_llint);
+       }
+
+   @param list A pointer to the list.
+   @param index An int variable, set to each index in turn.
+   @param item A DATA variable, set to each item in turn.
+ */
+#define AL_FOR_EACH(list, index, item)                                  \
+  for ((index) = 0;                                                     \
+       (index) < (list)->length && ((item) = (list)->data[(index)], 1); \
+       (index)++)
 
 /**
    @brief Return an iterator on the array list.
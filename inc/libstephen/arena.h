@@ -0,0 +1,238 @@
+/***************************************************************************//**
+
+  @file         libstephen/arena.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        An arena (or region) allocator.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  An arena hands out memory by bumping a pointer through a block, and frees it
+  all at once.  When a block runs out, the next one is twice as large (up to
+  SMB_ARENA_MAX_BLOCK), so a long run of allocations needs few blocks.
+
+  Memory isn't freed piece by piece.  Instead, arena_save() marks a point, and
+  arena_restore() frees everything allocated since.  arena_reset() frees
+  everything.  Blocks that are freed this way are kept and reused, so an arena
+  that is reset between requests stops allocating once it's warmed up.
+
+  arena_allocator() returns the arena as an smb_allocator (see
+  "libstephen/base.h").  A container initialized with it keeps its storage in
+  the arena, and then it doesn't have to be destroyed.  Its memory goes when
+  the arena is reset.  (It can't be given to smb_set_allocator(), since
+  smb_renew() doesn't know the size of what it's copying.)
+
+  An arena isn't locked, so it must be used by one thread at a time.
+
+*******************************************************************************/
+
+#ifndef LIBSTEPHEN_ARENA_H
+#define LIBSTEPHEN_ARENA_H
+
+#include <stddef.h>
+
+#include "base.h"
+
+/**
+   @brief The alignment of memory from arena_alloc().
+ */
+#define SMB_ARENA_ALIGN _Alignof(max_align_t)
+
+/**
+   @brief The size of an arena's first block.
+ */
+#define SMB_ARENA_FIRST_BLOCK 4096
+
+/**
+   @brief The largest block an arena grows to, except to fit one allocation
+   which is larger.
+ */
+#define SMB_ARENA_MAX_BLOCK (1024 * 1024)
+
+struct smb_arena_block;
+
+/**
+   @brief An arena allocator.
+ */
+typedef struct smb_arena {
+
+  /**
+     @brief The next free byte of the current block.
+   */
+  char *next;
+  /**
+     @brief The end of the current block.
+   */
+  char *end;
+  /**
+     @brief The blocks in use, newest (the current one) first.
+   */
+  struct smb_arena_block *blocks;
+  /**
+     @brief Blocks freed by arena_restore() or arena_reset(), to be reused.
+   */
+  struct smb_arena_block *spare;
+  /**
+     @brief The size of the next new block.
+   */
+  size_t blocksize;
+  /**
+     @brief The bytes in use blocks before the current one.
+   */
+  size_t closed;
+  /**
+     @brief The most bytes that have been in use at once, as of the last
+     restore, reset or new block.
+   */
+  size_t peak;
+  /**
+     @brief Where blocks come from, or NULL for the default allocator.
+   */
+  const smb_allocator *parent;
+  /**
+     @brief This arena as an allocator.
+   */
+  smb_allocator allocator;
+
+} smb_arena;
+
+/**
+   @brief A point in an arena to go back to.
+ */
+typedef struct {
+
+  struct smb_arena_block *block;
+  char *next;
+  size_t closed;
+
+} smb_arena_mark;
+
+/**
+   @brief Statistics about an arena, from arena_stats().
+ */
+typedef struct {
+
+  /**
+     @brief Bytes in use, counting padding and the unused ends of full blocks.
+   */
+  size_t used;
+  /**
+     @brief The most bytes that have been in use at once.
+   */
+  size_t peak;
+  /**
+     @brief Bytes in all blocks held, in use or spare.
+   */
+  size_t reserved;
+  /**
+     @brief The number of blocks held.
+   */
+  int blocks;
+
+} smb_arena_stats;
+
+/**
+   @brief Initialize an empty arena.  No block is allocated until it's needed.
+   @param a The arena to initialize.
+ */
+void arena_init(smb_arena *a);
+/**
+   @brief Initialize an empty arena whose blocks come from another allocator.
+   @param a The arena to initialize.
+   @param parent The allocator for blocks, or NULL for the default.
+ */
+void arena_init_alloc(smb_arena *a, const smb_allocator *parent);
+/**
+   @brief Allocate and initialize an empty arena.
+   @returns The new arena.
+ */
+smb_arena *arena_create(void);
+/**
+   @brief Free every block of the arena, but not the arena.
+   @param a The arena to destroy.
+ */
+void arena_destroy(smb_arena *a);
+/**
+   @brief Free the arena and its blocks.
+   @param a The arena to delete.
+ */
+void arena_delete(smb_arena *a);
+
+/**
+   @brief Allocate from a new or spare block.  Used by arena_alloc() when the
+   current block is full.
+ */
+void *arena_alloc_block(smb_arena *a, size_t size, size_t align);
+
+/**
+   @brief Allocate memory aligned to SMB_ARENA_ALIGN.  It isn't zeroed.  While
+   the current block has room, this is a pointer increment.
+   @param a The arena.
+   @param size The number of bytes.
+   @returns The memory.
+ */
+static inline void *arena_alloc(smb_arena *a, size_t size)
+{
+  size = (size + SMB_ARENA_ALIGN - 1) & ~(size_t)(SMB_ARENA_ALIGN - 1);
+  if ((size_t)(a->end - a->next) >= size) {
+    void *p = a->next;
+    a->next += size;
+    return p;
+  }
+  return arena_alloc_block(a, size, SMB_ARENA_ALIGN);
+}
+
+/**
+   @brief Allocate memory with a larger alignment than arena_alloc() gives.
+   @param a The arena.
+   @param size The number of bytes.
+   @param align The alignment, a power of two.
+   @returns The memory.
+ */
+void *arena_alloc_aligned(smb_arena *a, size_t size, size_t align);
+
+/**
+   @brief Allocate memory for n of a type from an arena.
+ */
+#define arena_new(a, type, n) ((type*) arena_alloc(a, (n) * sizeof(type)))
+
+/**
+   @brief Return a mark of everything allocated so far.
+   @param a The arena.
+   @returns The mark.
+ */
+smb_arena_mark arena_save(const smb_arena *a);
+/**
+   @brief Free everything allocated since a mark was saved.  Marks saved after
+   it are no longer valid.
+   @param a The arena.
+   @param mark The mark.
+ */
+void arena_restore(smb_arena *a, smb_arena_mark mark);
+/**
+   @brief Free everything allocated, keeping the blocks for reuse.
+   @param a The arena.
+ */
+void arena_reset(smb_arena *a);
+/**
+   @brief Measure the arena's memory.
+   @param a The arena.
+   @param[out] stats Where to put the statistics.
+ */
+void arena_stats(smb_arena *a, smb_arena_stats *stats);
+
+/**
+   @brief Return the arena as an allocator.
+
+   Freeing or resizing the most recent allocation is done in place.  Freeing
+   anything else does nothing until the arena is restored or reset.
+   @param a The arena.
+   @returns The allocator, which is valid as long as the arena is.
+ */
+const smb_allocator *arena_allocator(smb_arena *a);
+
+#endif // LIBSTEPHEN_ARENA_H
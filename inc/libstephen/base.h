@@ -72,6 +72,40 @@ int data_compare_int(DATA d1, DATA d2);
 int data_compare_float(DATA d1, DATA d2);
 int data_compare_pointer(DATA d1, DATA d2);
 
+/**
+   @brief Stable sort of an array of DATA.  This is a merge sort, and it
+   allocates a buffer as large as the array.
+   @param items The array to sort.
+   @param n The number of items.
+   @param cmp Comparator for ordering.
+ */
+void data_sort(DATA *items, int n, DATA_COMPARE cmp);
+/**
+   @brief Stable sort of an array of DATA, on up to nthreads threads.  Each
+   thread is given at least a few thousand items, so small arrays are sorted on
+   the calling thread.  The comparator must be safe to call from many threads.
+   @param items The array to sort.
+   @param n The number of items.
+   @param cmp Comparator for ordering.
+   @param nthreads The most threads to use, including the calling one.
+ */
+void data_sort_parallel(DATA *items, int n, DATA_COMPARE cmp, int nthreads);
+/**
+   @brief Stable sort of an array of DATA by data_llint.  This is a radix sort,
+   so it's linear in n and takes no comparator.
+   @param items The array to sort.
+   @param n The number of items.
+ */
+void data_sort_llint(DATA *items, int n);
+/**
+   @brief Stable sort of an array of DATA by data_dbl, with -0.0 before 0.0.
+   Like data_sort_llint(), it's a radix sort.  NaNs with the sign bit clear sort
+   after infinity, and ones with it set before negative infinity.
+   @param items The array to sort.
+   @param n The number of items.
+ */
+void data_sort_dbl(DATA *items, int n);
+
 /**
    @brief A function pointer that takes a DATA and prints it.
 
@@ -92,9 +126,68 @@ void data_printer_pointer(FILE *f, DATA d);
 
 *******************************************************************************/
 
+/**
+   @brief An allocator, as a table of functions and a context they're given.
+
+   Containers initialized with an allocator (al_init_alloc() and friends) take
+   all of their storage from it, and pass the size of each block back when it's
+   reallocated or freed, so an allocator needn't keep track of sizes itself.
+   An arena's free can do nothing, and then everything a container allocated
+   goes at once when the arena does.
+
+   An allocator returning NULL is treated like malloc() failing: the program
+   exits with an error message.
+ */
+typedef struct smb_allocator {
+
+  /**
+     @brief Allocate size bytes.
+   */
+  void *(*alloc)(void *ctx, size_t size);
+  /**
+     @brief Resize a block of old_size bytes to new_size bytes, keeping its
+     contents.
+   */
+  void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+  /**
+     @brief Free a block of size bytes.
+   */
+  void (*free)(void *ctx, void *ptr, size_t size);
+  /**
+     @brief Passed to each function.
+   */
+  void *ctx;
+
+} smb_allocator;
+
+/**
+   @brief The allocator wrapping malloc(), realloc() and free().
+ */
+extern const smb_allocator smb_malloc_allocator;
+
+/**
+   @brief Set the allocator behind smb_new(), smb_renew() and smb_free(), and
+   behind containers initialized without one.
+
+   Set it before anything is allocated, and don't change it while memory from
+   the old one is still in use.  smb_renew() and smb_free() don't know the size
+   of the block they're given, so they pass a size of 0, and this allocator
+   must know sizes on its own, the way malloc() does.
+   @param allocator The allocator, or NULL for smb_malloc_allocator.
+ */
+void smb_set_allocator(const smb_allocator *allocator);
+/**
+   @brief Return the allocator set by smb_set_allocator().
+ */
+const smb_allocator *smb_get_allocator(void);
+
 void *smb___new(size_t amt);
 void *smb___renew(void *ptr, size_t newsize);
 void smb___free(void *ptr);
+void *smb___alloc(const smb_allocator *allocator, size_t amt);
+void *smb___realloc(const smb_allocator *allocator, void *ptr,
+                    size_t oldsize, size_t newsize);
+void smb___dealloc(const smb_allocator *allocator, void *ptr, size_t size);
 
 /**
    @brief A nicer allocation function.
@@ -133,6 +226,39 @@ void smb___free(void *ptr);
  */
 #define smb_free(ptr) smb___free(ptr)
 
+/**
+   @brief Allocate from an allocator, like smb_new().
+   @param allocator The allocator, or NULL for the one smb_new() uses.
+   @param type The type of the memory to allocate.
+   @param n The number of instances to allocate.
+   @returns A pointer to the allocated memory.
+ */
+#define smb_alloc(allocator, type, n) \
+  ((type*) smb___alloc(allocator, (n) * sizeof(type)))
+
+/**
+   @brief Reallocate memory from an allocator, like smb_renew().
+   @param allocator The allocator the memory came from.
+   @param type The type of the memory.
+   @param ptr The memory to reallocate.
+   @param oldamt The number of instances it holds now.
+   @param newamt The number of instances to hold.
+   @returns A pointer to the reallocated memory.
+ */
+#define smb_realloc(allocator, type, ptr, oldamt, newamt)               \
+  ((type*) smb___realloc(allocator, ptr, (oldamt) * sizeof(type),        \
+                         (newamt) * sizeof(type)))
+
+/**
+   @brief Free memory from an allocator, like smb_free().
+   @param allocator The allocator the memory came from.
+   @param type The type of the memory.
+   @param ptr The memory to free.
+   @param n The number of instances it holds.
+ */
+#define smb_dealloc(allocator, type, ptr, n) \
+  smb___dealloc(allocator, ptr, (n) * sizeof(type))
+
 /*******************************************************************************
 
                                  Error Handling
@@ -148,6 +274,7 @@ typedef int smb_status;
 #define SMB_INDEX_ERROR 1
 #define SMB_NOT_FOUND_ERROR 2
 #define SMB_STOP_ITERATION 3
+#define SMB_IO_ERROR 4
 #define SMB_EXTERNAL_EXCEPTION_START 100
 
 char *smb_status_string(smb_status status);
@@ -91,4 +91,69 @@ void bf_clear(unsigned char *data, int index);
  */
 void bf_flip(unsigned char *data, int index);
 
+/**
+   @brief Set dst to the intersection of two bitfields.
+
+   These set operations work a vector (or 64 bit word) at a time.  The
+   bitfields must all be the same size, and dst may be the same as either
+   operand.  Bits past num_bools in the last byte are combined too.
+   @param dst The bitfield to store the result in.
+   @param a The first operand.
+   @param b The second operand.
+   @param num_bools The size of the bitfields, in bools.
+ */
+void bf_and(unsigned char *dst, const unsigned char *a, const unsigned char *b,
+            int num_bools);
+/**
+   @brief Set dst to the union of two bitfields.  See bf_and().
+   @param dst The bitfield to store the result in.
+   @param a The first operand.
+   @param b The second operand.
+   @param num_bools The size of the bitfields, in bools.
+ */
+void bf_or(unsigned char *dst, const unsigned char *a, const unsigned char *b,
+           int num_bools);
+/**
+   @brief Set dst to the bits set in exactly one of two bitfields.  See
+   bf_and().
+   @param dst The bitfield to store the result in.
+   @param a The first operand.
+   @param b The second operand.
+   @param num_bools The size of the bitfields, in bools.
+ */
+void bf_xor(unsigned char *dst, const unsigned char *a, const unsigned char *b,
+            int num_bools);
+/**
+   @brief Set dst to the bits set in a and not in b.  See bf_and().
+   @param dst The bitfield to store the result in.
+   @param a The first operand.
+   @param b The second operand.
+   @param num_bools The size of the bitfields, in bools.
+ */
+void bf_andnot(unsigned char *dst, const unsigned char *a,
+               const unsigned char *b, int num_bools);
+/**
+   @brief Return the number of bits set among the first num_bools.
+   @param data A pointer to the bitfield.
+   @param num_bools The size of the bitfield, in bools.
+   @returns The number of set bits.
+ */
+int bf_count(const unsigned char *data, int num_bools);
+/**
+   @brief Find the first set bit at or after an index.
+   @param data A pointer to the bitfield.
+   @param num_bools The size of the bitfield, in bools.
+   @param start The index to start looking from.
+   @returns The index of the bit, or -1 if there isn't one before num_bools.
+ */
+int bf_next_set(const unsigned char *data, int num_bools, int start);
+/**
+   @brief Find the first clear bit at or after an index.
+   @param data A pointer to the bitfield.
+   @param num_bools The size of the bitfield, in bools.
+   @param start The index to start looking from.
+   @returns The index of the bit, or -1 if there isn't one before num_bools.
+ */
+int bf_next_clear(const unsigned char *data, int num_bools, int start);
+
 #endif // LIBSTEPHEN_BF_H
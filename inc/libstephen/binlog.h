@@ -0,0 +1,173 @@
+/***************************************************************************//**
+
+  @file         libstephen/binlog.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Binary logging, with formatting deferred to a decoder.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  BLOG() doesn't format its message.  It writes a compact record holding the
+  call site's id, the level, a timestamp, and the raw arguments, which costs a
+  walk over the format string to find their types and a few copies.  The first
+  message from each call site is preceded by a record defining the site: its
+  format string, file, line, and function.  bl_decode() (or the binlog tool)
+  turns the stream back into text later.
+
+  A stream is made of native-endian values:
+
+      header:   "SMBL"  u32 version  u32 0x01020304
+      define:   u8 1  u32 id  i32 line  str format  str file  str function
+      message:  u8 2  u32 id  i32 level  u64 nanoseconds  u32 size  arguments
+
+  where a str is a u32 length followed by that many bytes.  Arguments follow
+  the format string's conversions: each '*' width or precision and each
+  integer, character or pointer is an i64 or u64, each floating point number
+  is a double, and each string is a str.
+
+*******************************************************************************/
+
+#ifndef LIBSTEPHEN_BINLOG_H
+#define LIBSTEPHEN_BINLOG_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "base.h"
+#include "log.h" /* LEVEL_*, SMB_LOG_MIN_LEVEL */
+
+/**
+   @brief The version of the stream format written.
+ */
+#define BL_VERSION 1
+
+/**
+   @brief A place in the code which logs with BLOG().  Each is given an id
+   (which is never 0) the first time it logs.
+ */
+typedef struct {
+
+  /**
+     @brief The file containing the call.
+   */
+  const char *file;
+  /**
+     @brief The function containing the call.
+   */
+  const char *function;
+  /**
+     @brief The line of the call.
+   */
+  int line;
+  /**
+     @brief The site's id, or 0 before it first logs.
+   */
+  atomic_uint id;
+
+} smb_binlog_site;
+
+/**
+   @brief A binary log stream.  Any number of threads may log to it at once.
+ */
+typedef struct {
+
+  /**
+     @brief The file records are written to.
+   */
+  FILE *dst;
+  /**
+     @brief The lowest level written.
+   */
+  int level;
+  /**
+     @brief Held while writing records, so that they don't interleave.
+   */
+  pthread_mutex_t lock;
+  /**
+     @brief Which site ids have been defined in this stream, indexed by id.
+   */
+  bool *defined;
+  /**
+     @brief The length of the defined array.
+   */
+  unsigned int ndefined;
+
+} smb_binlog;
+
+/**
+   @brief Initialize a binary log, and write the stream header.
+   @param obj The binary log to initialize.
+   @param dst The file to write to.
+   @param level The lowest level to write.
+ */
+void bl_init(smb_binlog *obj, FILE *dst, int level);
+/**
+   @brief Allocate and initialize a binary log.
+   @param dst The file to write to.
+   @param level The lowest level to write.
+   @returns The new binary log.
+ */
+smb_binlog *bl_create(FILE *dst, int level);
+/**
+   @brief Flush the stream, and free the binary log's resources.  The file
+   isn't closed.
+   @param obj The binary log to destroy.
+ */
+void bl_destroy(smb_binlog *obj);
+/**
+   @brief Destroy and free a binary log.
+   @param obj The binary log to delete.
+ */
+void bl_delete(smb_binlog *obj);
+
+/**
+   @brief Write a message record.  Use BLOG() instead, which provides the site.
+
+   A site must always be given the same format string.  Long doubles are
+   written as doubles, wide strings and characters are converted to multibyte
+   ones, and %n writes nothing.  Arguments after a conversion which isn't
+   understood are dropped, and the decoder prints the rest of the format
+   string as it is.  The decoder rejects widths and precisions over 4096, from
+   the format or from '*' arguments, as it can't tell them from corruption.
+   @param obj The binary log.
+   @param site The call site.
+   @param level The level of the message.
+   @param format The format string.
+   @param ... The format arguments.
+ */
+void bl_log(smb_binlog *obj, smb_binlog_site *site, int level,
+            const char *format, ...);
+
+/**
+   @brief Decode a binary log stream into text, one line per message, like a
+   text logger with a timestamp in front.
+   @param in The stream to read.
+   @param out Where to write the text.
+   @param[out] status For error reporting.
+   @exception SMB_IO_ERROR If the stream is malformed or cut short.  Messages
+   before the problem are still written.
+ */
+void bl_decode(FILE *in, FILE *out, smb_status *status);
+
+/**
+   @brief Log a message to a binary log.  Like LOG(), messages below
+   SMB_LOG_MIN_LEVEL compile to nothing, and the log and level may be evaluated
+   more than once.
+   @param bl The binary log.
+   @param lvl The level of the message.
+   @param ... A string literal format, and format arguments.
+ */
+#define BLOG(bl, lvl, ...)                                              \
+  do {                                                                  \
+    static smb_binlog_site bl_site_ = {__FILE__, __func__, __LINE__, 0}; \
+    if ((lvl) >= SMB_LOG_MIN_LEVEL && (lvl) >= (bl)->level) {           \
+      bl_log(bl, &bl_site_, lvl, __VA_ARGS__);                          \
+    }                                                                   \
+  } while (0)
+
+#endif // LIBSTEPHEN_BINLOG_H
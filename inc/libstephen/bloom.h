@@ -0,0 +1,152 @@
+/***************************************************************************//**
+
+  @file         libstephen/bloom.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        A Bloom filter, stored in a bitfield (see "libstephen/bf.h").
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  A Bloom filter answers "is this key in the set?" with either "no" or
+  "maybe", in a few bits per key.  Put one in front of a hash table where most
+  lookups miss, and most of them never probe the table:
+
+      bloom_init(&filter, 100000, 0.01, ht_string_hash, false);
+      ...
+      if (bloom_check(&filter, key)) {
+        value = ht_get(&table, key, &status);
+      }
+
+  Each key is hashed once.  The filter's hash function has the same type as a
+  table's, so the two can share one, and its result is mixed out to 64 bits.
+  The k bits for a key are then made from the two halves of that by double
+  hashing, h1 + i * h2.  A caller with a 64 bit hash of its own can use
+  bloom_add_hash() and bloom_check_hash() directly.
+
+  In the blocked layout, the first half of the hash chooses a 64 byte block (a
+  cache line), and every bit for the key is set within it.  That makes a check
+  touch one cache line instead of k of them, at the cost of a somewhat higher
+  false positive rate than the one asked for, since keys don't spread as
+  evenly.
+
+*******************************************************************************/
+
+#ifndef LIBSTEPHEN_BLOOM_H
+#define LIBSTEPHEN_BLOOM_H
+
+#include <stdint.h>
+
+#include "base.h"
+#include "ht.h" /* HASH_FUNCTION */
+
+/**
+   @brief The size of a block in the blocked layout, in bytes.
+ */
+#define BLOOM_BLOCK 64
+
+/**
+   @brief The most hash functions a filter uses.
+ */
+#define BLOOM_MAX_K 16
+
+/**
+   @brief A Bloom filter.
+ */
+typedef struct {
+
+  /**
+     @brief The bitfield.  In the blocked layout, it's aligned to BLOOM_BLOCK.
+   */
+  unsigned char *bits;
+  /**
+     @brief The allocation holding the bitfield.
+   */
+  unsigned char *alloc;
+  /**
+     @brief The number of bits.
+   */
+  int num_bits;
+  /**
+     @brief The number of bits set for each key.
+   */
+  int k;
+  /**
+     @brief Whether the blocked layout is used.
+   */
+  bool blocked;
+  /**
+     @brief The hash function for keys.
+   */
+  HASH_FUNCTION hash;
+
+} smb_bloom;
+
+/**
+   @brief Initialize a Bloom filter sized for a number of keys.
+
+   The filter gets about -log2(fp_rate) / ln 2 bits per key, and -log2(fp_rate)
+   hash functions (at most BLOOM_MAX_K).
+   @param obj The filter to initialize.
+   @param capacity The number of keys expected.
+   @param fp_rate The false positive rate wanted once capacity keys are added,
+   between 0 and 1.
+   @param hash The hash function for keys.  It may be NULL, if only
+   bloom_add_hash() and bloom_check_hash() are used.
+   @param blocked Whether to use the blocked layout.
+ */
+void bloom_init(smb_bloom *obj, int capacity, double fp_rate,
+                HASH_FUNCTION hash, bool blocked);
+/**
+   @brief Allocate and initialize a Bloom filter.  See bloom_init().
+   @returns The new filter.
+ */
+smb_bloom *bloom_create(int capacity, double fp_rate, HASH_FUNCTION hash,
+                        bool blocked);
+/**
+   @brief Free the filter's resources, but not the filter.
+   @param obj The filter to destroy.
+ */
+void bloom_destroy(smb_bloom *obj);
+/**
+   @brief Free the filter and its resources.
+   @param obj The filter to delete.
+ */
+void bloom_delete(smb_bloom *obj);
+
+/**
+   @brief Add a key to the filter.
+   @param obj The filter.
+   @param key The key.
+ */
+void bloom_add(smb_bloom *obj, DATA key);
+/**
+   @brief Return whether a key may have been added to the filter.
+   @param obj The filter.
+   @param key The key.
+   @returns False if the key was never added, and true if it probably was.
+ */
+bool bloom_check(const smb_bloom *obj, DATA key);
+/**
+   @brief Add a key to the filter, by a 64 bit hash of it.
+   @param obj The filter.
+   @param hash The key's hash.
+ */
+void bloom_add_hash(smb_bloom *obj, uint64_t hash);
+/**
+   @brief Return whether a key may have been added, by a 64 bit hash of it.
+   @param obj The filter.
+   @param hash The key's hash.
+   @returns False if the key was never added, and true if it probably was.
+ */
+bool bloom_check_hash(const smb_bloom *obj, uint64_t hash);
+/**
+   @brief Remove every key from the filter.
+   @param obj The filter.
+ */
+void bloom_clear(smb_bloom *obj);
+
+#endif // LIBSTEPHEN_BLOOM_H
@@ -19,6 +19,18 @@
 #include <stdarg.h>
 #include <wchar.h>
 
+/**
+   @brief The most digits cb_append_uint() can write.
+ */
+#define CB_UINT_DIGITS 20
+
+/**
+   @brief The most decimal places cb_append_dbl() formats itself.
+ */
+#define CB_DBL_PRECISION 9
+
+struct smb_allocator; /* "libstephen/base.h" */
+
 /**
    @brief A character buffer utility that is easier to handle than a char*.
 
@@ -39,6 +51,15 @@ typedef struct {
      @brief Length of the string in the buffer.
    */
   int length;
+  /**
+     @brief The caller's buffer given to cb_init_local(), or NULL.  While buf
+     points here, it isn't freed or reallocated.
+   */
+  char *local;
+  /**
+     @brief The allocator the buffer comes from, or NULL for the default.
+   */
+  const struct smb_allocator *alloc;
 } cbuf;
 
 /**
@@ -50,6 +71,27 @@ typedef struct {
    @param capacity Initial capacity of the buffer.
  */
 void cb_init(cbuf *obj, int capacity);
+/**
+   @brief Initialize a character buffer which starts out using memory the
+   caller provides (such as an array on the stack).
+
+   Nothing is allocated until the string outgrows that memory, when it's moved
+   to the heap.  So short-lived strings which are usually small cost no
+   allocation at all.  The memory must outlive the cbuf, and cb_destroy() must
+   still be called, in case it was moved.
+   @param obj The cbuf to initialize.
+   @param local The memory to start with.
+   @param capacity The size of that memory.
+ */
+void cb_init_local(cbuf *obj, char *local, int capacity);
+/**
+   @brief Initialize a character buffer whose memory comes from an allocator.
+   @param obj The cbuf to initialize.
+   @param capacity Initial capacity of the buffer.
+   @param allocator The allocator, or NULL for the default.
+ */
+void cb_init_alloc(cbuf *obj, int capacity,
+                   const struct smb_allocator *allocator);
 /**
    @brief Allocate and initialize a brand-new character buffer.
 
@@ -75,6 +117,32 @@ void cb_delete(cbuf *obj);
    @param str The string to concat.
  */
 void cb_concat(cbuf *obj, char *str);
+/**
+   @brief Append n characters onto the end of the character buffer.  Unlike
+   cb_concat(), the length is already known, so the string isn't scanned.
+   @param obj The buffer to append onto.
+   @param str The characters to append (which needn't be NUL terminated).
+   @param n The number of characters.
+ */
+void cb_append_n(cbuf *obj, const char *str, int n);
+/**
+   @brief Make sure n more characters can be added without reallocating.
+   @param obj The buffer.
+   @param n The number of characters (not counting the NUL).
+ */
+void cb_reserve(cbuf *obj, int n);
+/**
+   @brief Take the string out of the buffer, without copying it if it's on the
+   heap.
+
+   The caller must smb_free() the returned string, since it comes from the
+   default allocator.  A string in local memory, or from a cbuf's own
+   allocator, is copied there first.  The buffer is left destroyed, and must be
+   initialized again to be reused.
+   @param obj The buffer.
+   @returns The string.
+ */
+char *cb_steal(cbuf *obj);
 /**
    @brief Append a character onto the end of the character buffer.
    @param obj The buffer to append onto.
@@ -92,14 +160,41 @@ void cb_trim(cbuf *obj);
  */
 void cb_clear(cbuf *obj);
 /**
-   @brief Format and print a string onto the end of a character buffer.
+   @brief Format and print a string onto the end of a character buffer.  See
+   cb_vprintf().
    @param obj The object to print onto.
    @param format The format string to print.
    @param ... The arguments to the format string.
  */
 void cb_printf(cbuf *obj, char *format, ...);
+/**
+   @brief Append an integer in decimal, without going through printf.
+   @param obj The buffer.
+   @param value The integer.
+ */
+void cb_append_int(cbuf *obj, long long value);
+/**
+   @brief Append an unsigned integer in decimal, without going through printf.
+   @param obj The buffer.
+   @param value The integer.
+ */
+void cb_append_uint(cbuf *obj, unsigned long long value);
+/**
+   @brief Append a number with a fixed number of decimal places, like "%.*f".
+
+   Up to CB_DBL_PRECISION places are rounded here, without going through
+   printf, and the output is the same as printf's.  Numbers so near a halfway
+   point that scaling them could round the wrong way, more places, huge
+   numbers, NaN and infinity are handed to cb_printf().
+   @param obj The buffer.
+   @param value The number.
+   @param precision The number of decimal places.
+ */
+void cb_append_dbl(cbuf *obj, double value, int precision);
 /**
    @brief Format and print a string onto the cbuf using a va_list.
+
+   If the buffer would grow past INT_MAX characters, nothing is appended.
    @param obj The cbuf to print into.
    @param format The format string to print.
    @param va The vararg list.
@@ -127,6 +222,10 @@ typedef struct {
      @brief Length of the string in the buffer.
    */
   int length;
+  /**
+     @brief The caller's buffer given to wcb_init_local(), or NULL.
+   */
+  wchar_t *local;
 } wcbuf;
 
 /**
@@ -141,6 +240,14 @@ void wcb_init(wcbuf *obj, int capacity);
    @return A pointer to the buffer.
  */
 wcbuf *wcb_create(int capacity);
+/**
+   @brief Initialize a wide buffer which starts out using memory the caller
+   provides.  See cb_init_local().
+   @param obj The wide buffer to initialize.
+   @param local The memory to start with.
+   @param capacity The number of wide characters that memory holds.
+ */
+void wcb_init_local(wcbuf *obj, wchar_t *local, int capacity);
 /**
    @brief Destroy the wide buffer contained in the wcbuf struct.
    @param obj The wide buffer to destroy.
@@ -158,6 +265,25 @@ void wcb_delete(wcbuf *obj);
    @param str The wide string to concat on.
  */
 void wcb_concat(wcbuf *obj, wchar_t *str);
+/**
+   @brief Append n wide characters onto the end of the wide buffer.
+   @param obj The wide buffer to append onto.
+   @param str The characters to append (which needn't be NUL terminated).
+   @param n The number of characters.
+ */
+void wcb_append_n(wcbuf *obj, const wchar_t *str, int n);
+/**
+   @brief Make sure n more wide characters can be added without reallocating.
+   @param obj The wide buffer.
+   @param n The number of characters (not counting the NUL).
+ */
+void wcb_reserve(wcbuf *obj, int n);
+/**
+   @brief Take the string out of the wide buffer.  See cb_steal().
+   @param obj The wide buffer.
+   @returns The string, which the caller must smb_free().
+ */
+wchar_t *wcb_steal(wcbuf *obj);
 /**
    @brief Append a single character onto the buffer.
    @param obj The wide buffer to append onto.
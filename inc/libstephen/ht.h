@@ -20,16 +20,21 @@
 #include "list.h"  /* DATA, DATA_ACTION */
 
 /**
-   @brief An initial amount of rows in the hash table.  Something just off of a
-   power of 2.
+   @brief An initial amount of rows in the hash table.  Tables are always a power
+   of 2 in size.
  */
-#define HASH_TABLE_INITIAL_SIZE 31
+#define HASH_TABLE_INITIAL_SIZE 32
 
 /**
    @brief The maximum load factor that can be allowed in the hash table.
  */
 #define HASH_TABLE_MAX_LOAD_FACTOR 0.5
 
+/**
+   @brief How many keys ht_insert_many() hashes ahead of inserting them.
+ */
+#define HT_INSERT_BATCH 16
+
 /**
    @brief A hash function declaration.
 
@@ -67,6 +72,12 @@ typedef struct smb_ht_bckt
    */
   DATA value;
 
+  /**
+     @brief The mixed hash of the key, so that most keys which don't match can
+     be skipped without comparing them, and resizing doesn't hash again.
+   */
+  unsigned int hash;
+
   /**
      @brief Marker for whether or not the table is full or empty.
    */
@@ -89,6 +100,12 @@ typedef struct smb_ht
    */
   unsigned int allocated;
 
+  /**
+     @brief The number of slots marked with a gravestone.  They count towards
+     the load factor, since probes continue past them.
+   */
+  unsigned int graves;
+
   /**
      @brief The hash function for this hash table.
    */
@@ -104,8 +121,51 @@ typedef struct smb_ht
    */
   struct smb_ht_bckt *table;
 
+  /**
+     @brief The allocator the table comes from, or NULL for the default.
+   */
+  const smb_allocator *alloc;
+
 } smb_ht;
 
+/**
+   @brief Statistics about a hash table, from ht_stats() or hta_stats().
+ */
+typedef struct smb_ht_stats
+{
+  /**
+     @brief The number of items in the table.
+   */
+  unsigned int length;
+
+  /**
+     @brief The number of slots allocated.
+   */
+  unsigned int allocated;
+
+  /**
+     @brief The number of slots marked with a gravestone.
+   */
+  unsigned int graves;
+
+  /**
+     @brief The average number of slots looked at to find an item in the table.
+     An item in the first slot it could go in has a probe length of 1.
+   */
+  double mean_probe;
+
+  /**
+     @brief The longest probe length of any item in the table.
+   */
+  unsigned int max_probe;
+
+  /**
+     @brief Bytes allocated for the slots.
+   */
+  size_t bytes;
+
+} smb_ht_stats;
+
 /**
    @brief Initialize a hash table in memory already allocated.
    @param table A pointer to the table to initialize.
@@ -113,6 +173,15 @@ typedef struct smb_ht
    @param equal A comparison function for DATA.
  */
 void ht_init(smb_ht *table, HASH_FUNCTION hash_func, DATA_COMPARE equal);
+/**
+   @brief Initialize a hash table whose slots come from an allocator.
+   @param table A pointer to the table to initialize.
+   @param hash_func A hash function for the table.
+   @param equal A comparison function for DATA.
+   @param allocator The allocator, or NULL for the default.
+ */
+void ht_init_alloc(smb_ht *table, HASH_FUNCTION hash_func, DATA_COMPARE equal,
+                   const smb_allocator *allocator);
 /**
    @brief Allocate and initialize a hash table.
    @param hash_func A function that takes one DATA and returns a hash value
@@ -158,14 +227,38 @@ void ht_delete(smb_ht *table);
 /**
    @brief Insert data into the hash table.
 
-   Expands the hash table if the load factor is below a threshold.  If the key
-   already exists in the table, then the function will overwrite it with the new
-   data provided.
+   Expands the hash table if the load factor is above a threshold, or rebuilds
+   it at the same size if that's because of removed items.  If the key already
+   exists in the table, then the function will overwrite it with the new data
+   provided.
    @param table A pointer to the hash table.
    @param key The key to insert.
    @param value The value to insert at the key.
  */
 void ht_insert(smb_ht *table, DATA key, DATA value);
+/**
+   @brief Make room for n items, so that inserting up to n doesn't resize the
+   table.
+
+   Useful before loading many items, since the table grows once instead of
+   doubling over and over.
+   @param table A pointer to the hash table.
+   @param n The number of items (including those already in the table).
+ */
+void ht_reserve(smb_ht *table, unsigned int n);
+/**
+   @brief Insert many keys and values.
+
+   The table is sized for them once, and then they are inserted a batch at a
+   time, prefetching each batch's buckets.  Like ht_insert(), a key which is
+   already in the table gets the new value.
+   @param table A pointer to the hash table.
+   @param keys The keys to insert.
+   @param values The values to insert, one per key.
+   @param n The number of keys.
+ */
+void ht_insert_many(smb_ht *table, const DATA *keys, const DATA *values,
+                    unsigned int n);
 /**
    @brief Remove the key, value pair stored in the hash table.
    @param table A pointer to the hash table.
@@ -208,12 +301,61 @@ bool ht_contains(smb_ht const *table, DATA key);
    @returns An iterator struct.
  */
 smb_iter ht_get_iter(const smb_ht *ht);
+/**
+   @brief Loop over every key and value of a hash table, without any function
+   calls.
+
+   The table must not be changed in the loop, though values may be changed in
+   their buckets.  For example:
+
+       unsigned int i;
+       DATA k, v;
+       HT_FOR_EACH(table, i, k, v) {
+         printf("%s: %lld\n", (char*)k.data_ptr, v.data_llint);
+       }
+
+   This is a loop around an if statement, with the body in its else branch, so
+   an else following the body can't be confused for the inner if's.
+   @param ht A pointer to the hash table.
+   @param index An unsigned int variable, set to the index of each bucket.
+   @param key_var A DATA variable, set to each key in turn.
+   @param value_var A DATA variable, set to each value in turn.
+ */
+#define HT_FOR_EACH(ht, index, key_var, value_var)                      \
+  for ((index) = 0; (index) < (ht)->allocated; (index)++)               \
+    if ((ht)->table[(index)].mark != HT_FULL) {                         \
+    } else if (((key_var) = (ht)->table[(index)].key,                   \
+                (value_var) = (ht)->table[(index)].value, 0)) {         \
+    } else
+
 /**
    @brief Return the hash of the data, interpreting it as a string.
+
+   This is ht_hash_bytes() of the string, up to its NUL terminator.
    @param data The string to hash, assuming that the value contained is a char*.
    @returns The hash value of the string.
  */
 unsigned int ht_string_hash(DATA data);
+/**
+   @brief Return the hash of a block of memory.
+
+   It reads 8 bytes at a time (based on XXH64), so it's fast for long keys, and
+   keys which aren't NUL terminated can be hashed given their length.  Hashes
+   depend on byte order, so they shouldn't be stored or sent elsewhere.
+   @param data The bytes to hash.
+   @param len The number of bytes.
+   @returns The hash value of the bytes.
+ */
+unsigned int ht_hash_bytes(const void *data, size_t len);
+/**
+   @brief Measure how full a hash table is, and how long its probes are.
+
+   This looks at each slot once, replaying each item's probe sequence from its
+   stored hash, so it doesn't call the hash or comparison functions.
+   @param table The table to measure.
+   @param[out] stats The statistics.
+ */
+void ht_stats(smb_ht const *table, smb_ht_stats *stats);
 /**
    @brief Print the entire hash table.
 
@@ -229,4 +371,9 @@ void ht_print(smb_ht const *table, int full_mode);
    The next hash table size.  Not really public, but shared for hta.
  */
 int ht_next_size(int current);
+/**
+   Mix a hash before using it to find a slot.  Not really public, but shared for
+   hta.
+ */
+unsigned int ht_mix_hash(unsigned int hash);
 #endif // LIBSTEPHEN_HT_H
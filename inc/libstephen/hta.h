@@ -18,8 +18,14 @@
 #define LIBSTEPHEN_HTA_H
 
 #include "base.h"
+#include "ht.h" /* smb_ht_stats */
 
-#define HTA_KEY_OFFSET 1
+/*
+  Each item in the table is a mark byte, the mixed hash of its key (at
+  HTA_HASH_OFFSET), the key, and then the value.
+ */
+#define HTA_HASH_OFFSET 4
+#define HTA_KEY_OFFSET 8
 
 #define HTA_MARK(t, i) ((int8_t*)t->table)[i]
 
@@ -63,6 +69,12 @@ typedef struct smb_hta
    */
   unsigned int allocated;
 
+  /**
+     @brief The number of slots marked with a gravestone.  They count towards
+     the load factor, since probes don't stop at them.
+   */
+  unsigned int graves;
+
   /**
      @brief Size of keys
    */
@@ -138,6 +150,13 @@ void hta_delete(smb_hta *table);
    @param value The value to insert at the key.
  */
 void hta_insert(smb_hta *table, void *key, void *value);
+/**
+   @brief Make room for n items, so that inserting up to n doesn't resize the
+   table.
+   @param table A pointer to the hash table.
+   @param n The number of items (including those already in the table).
+ */
+void hta_reserve(smb_hta *table, unsigned int n);
 /**
    @brief Remove the key, value pair stored in the hash table.
 
@@ -172,6 +191,14 @@ bool hta_contains(smb_hta const *table, void *key);
 unsigned int hta_string_hash(void *data);
 int hta_string_comp(void *left, void *right);
 int hta_int_comp(void *left, void *right);
+/**
+   @brief Measure how full a hash table is, and how long its probes are.
+
+   Like ht_stats(), this doesn't call the hash or comparison functions.
+   @param table The table to measure.
+   @param[out] stats The statistics.
+ */
+void hta_stats(smb_hta const *table, smb_ht_stats *stats);
 /**
    @brief Print the entire hash table.
 
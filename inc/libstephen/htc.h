@@ -0,0 +1,155 @@
+/***************************************************************************//**
+
+  @file         libstephen/htc.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        A concurrent Hash Table for any data, made of locked shards.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  The table is split into a power of two number of smb_hta shards, each with
+  its own reader/writer lock, and the top bits of a key's hash choose its
+  shard.  So threads only contend when they use the same shard, and readers of
+  a shard don't block each other.  Values are copied out under the lock, since
+  a pointer into a shard could be moved by another thread's insertion.
+
+*******************************************************************************/
+
+#ifndef LIBSTEPHEN_HTC_H
+#define LIBSTEPHEN_HTC_H
+
+#include <pthread.h>
+
+#include "base.h"
+#include "hta.h" /* HTA_HASH, HTA_COMP */
+
+/**
+   @brief One shard of a concurrent hash table.
+ */
+typedef struct smb_htc_shard
+{
+  /**
+     @brief Held for reading by lookups, and for writing by changes.
+   */
+  pthread_rwlock_t lock;
+
+  /**
+     @brief The items whose hashes select this shard.
+   */
+  smb_hta table;
+
+  /**
+     @brief Keeps neighbouring shards' locks out of the same cache line.
+   */
+  char pad[64];
+
+} smb_htc_shard;
+
+/**
+   @brief A concurrent hash table data structure.
+ */
+typedef struct smb_htc
+{
+  /**
+     @brief The number of shards, a power of two.
+   */
+  unsigned int nshards;
+
+  /**
+     @brief How far to shift a mixed hash right to get its shard.
+   */
+  unsigned int shift;
+
+  /**
+     @brief The hash function for this hash table.
+   */
+  HTA_HASH hash;
+
+  /**
+     @brief The shards.
+   */
+  smb_htc_shard *shards;
+
+} smb_htc;
+
+/**
+   @brief Initialize a concurrent hash table in memory already allocated.
+   @param table A pointer to the table to initialize.
+   @param nshards The number of shards, rounded up to a power of two.  A few
+   times the number of threads using the table is plenty.
+   @param hash_func A hash function for the table.
+   @param equal A comparison function for keys.
+   @param key_size Size of keys.
+   @param value_size Size of values.
+ */
+void htc_init(smb_htc *table, unsigned int nshards, HTA_HASH hash_func,
+              HTA_COMP equal, unsigned int key_size, unsigned int value_size);
+/**
+   @brief Allocate and initialize a concurrent hash table.
+   @param nshards The number of shards, rounded up to a power of two.
+   @param hash_func A hash function for the table.
+   @param equal A comparison function for keys.
+   @param key_size Size of keys.
+   @param value_size Size of values.
+   @returns A pointer to the new hash table.
+ */
+smb_htc *htc_create(unsigned int nshards, HTA_HASH hash_func, HTA_COMP equal,
+                    unsigned int key_size, unsigned int value_size);
+/**
+   @brief Free any resources used by the hash table, but doesn't free the
+   pointer.  No other thread may be using it.
+   @param table The table to destroy.
+ */
+void htc_destroy(smb_htc *table);
+/**
+   @brief Free the hash table and its resources.  No other thread may be using
+   it.
+   @param table The table to free.
+ */
+void htc_delete(smb_htc *table);
+
+/**
+   @brief Insert data into the hash table, replacing the value of a key which
+   is already there.
+   @param table A pointer to the hash table.
+   @param key The key to insert.
+   @param value The value to insert at the key.
+ */
+void htc_insert(smb_htc *table, void *key, void *value);
+/**
+   @brief Remove the key, value pair stored in the hash table.
+   @param table A pointer to the hash table.
+   @param key The key to delete.
+   @param[out] status Status variable.
+   @exception SMB_NOT_FOUND_ERROR If an item with the given key is not found.
+ */
+void htc_remove(smb_htc *table, void *key, smb_status *status);
+/**
+   @brief Copy the value associated with a key.
+   @param table A pointer to the hash table.
+   @param key The key whose value to retrieve.
+   @param[out] value Where to copy the value, if it's found.
+   @param[out] status Status variable.
+   @exception SMB_NOT_FOUND_ERROR If an item with the given key is not found.
+ */
+void htc_get(smb_htc *table, void *key, void *value, smb_status *status);
+/**
+   @brief Return true when a key is contained in the table.
+   @param table A pointer to the hash table.
+   @param key The key to search for.
+   @returns Whether the key is present.
+ */
+bool htc_contains(smb_htc *table, void *key);
+/**
+   @brief Return the number of items in the table.  Shards are counted one at a
+   time, so the total may be out of date by the time it returns.
+   @param table A pointer to the hash table.
+   @returns The number of items.
+ */
+unsigned int htc_length(smb_htc *table);
+
+#endif // LIBSTEPHEN_HTC_H
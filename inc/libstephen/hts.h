@@ -0,0 +1,168 @@
+/***************************************************************************//**
+
+  @file         libstephen/hts.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Hash Table for any data, probed in groups of slots ("Swiss").
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  Like smb_hta, keys and values are stored inline.  But the marks are kept
+  apart from the items, in an array of control bytes, and each full slot's
+  control byte holds 7 bits of its key's hash.  A lookup checks 16 control
+  bytes at once (with SSE2 or NEON, where available), and only compares the
+  keys whose 7 bits match.  So most lookups touch one group of control bytes
+  and one item, even when the table is nearly full.
+
+*******************************************************************************/
+
+#ifndef LIBSTEPHEN_HTS_H
+#define LIBSTEPHEN_HTS_H
+
+#include "base.h"
+#include "hta.h" /* HTA_HASH, HTA_COMP */
+
+/**
+   @brief The number of slots whose control bytes are checked at once.
+ */
+#define HTS_GROUP 16
+
+/**
+   @brief Control byte of a slot which has never held anything.
+ */
+#define HTS_EMPTY ((int8_t)-128)
+
+/**
+   @brief Control byte of a slot whose item was removed.  Like HT_GRAVE, it
+   doesn't end a probe.
+ */
+#define HTS_DELETED ((int8_t)-2)
+
+/**
+   @brief A hash table data structure.
+ */
+typedef struct smb_hts
+{
+  /**
+     @brief The number of items in the hash table.
+   */
+  unsigned int length;
+
+  /**
+     @brief The number of slots allocated in the hash table.  Always a power of
+     two, and a multiple of HTS_GROUP.
+   */
+  unsigned int allocated;
+
+  /**
+     @brief The number of empty slots which can be filled before the table
+     must be rehashed.
+   */
+  unsigned int growth_left;
+
+  /**
+     @brief Size of keys
+   */
+  unsigned int key_size;
+
+  /**
+     @brief Size of values
+   */
+  unsigned int value_size;
+
+  /**
+     @brief The hash function for this hash table.
+   */
+  HTA_HASH hash;
+
+  /**
+     @brief Function to use to compare equality.
+   */
+  HTA_COMP equal;
+
+  /**
+     @brief A control byte per slot: HTS_EMPTY, HTS_DELETED, or the low 7 bits
+     of the full slot's hash.
+   */
+  int8_t *ctrl;
+
+  /**
+     @brief The items, each a key followed by its value.
+   */
+  void *slots;
+
+} smb_hts;
+
+/**
+   @brief Initialize a hash table in memory already allocated.
+   @param table A pointer to the table to initialize.
+   @param hash_func A hash function for the table.
+   @param equal A comparison function for keys.
+   @param key_size Size of keys.
+   @param value_size Size of values.
+ */
+void hts_init(smb_hts *table, HTA_HASH hash_func, HTA_COMP equal,
+              unsigned int key_size, unsigned int value_size);
+/**
+   @brief Allocate and initialize a hash table.
+   @param hash_func A hash function for the table.
+   @param equal A comparison function for keys.
+   @param key_size Size of keys.
+   @param value_size Size of values.
+   @returns A pointer to the new hash table.
+ */
+smb_hts *hts_create(HTA_HASH hash_func, HTA_COMP equal,
+                    unsigned int key_size, unsigned int value_size);
+/**
+   @brief Free any resources used by the hash table, but doesn't free the
+   pointer.
+   @param table The table to destroy.
+ */
+void hts_destroy(smb_hts *table);
+/**
+   @brief Free the hash table and its resources.
+   @param table The table to free.
+ */
+void hts_delete(smb_hts *table);
+
+/**
+   @brief Insert data into the hash table.
+
+   If the key already exists in the table, then the function will overwrite it
+   with the new data provided.
+   @param table A pointer to the hash table.
+   @param key The key to insert.
+   @param value The value to insert at the key.
+ */
+void hts_insert(smb_hts *table, void *key, void *value);
+/**
+   @brief Remove the key, value pair stored in the hash table.
+   @param table A pointer to the hash table.
+   @param key The key to delete.
+   @param[out] status Status variable.
+   @exception SMB_NOT_FOUND_ERROR If an item with the given key is not found.
+ */
+void hts_remove(smb_hts *table, void *key, smb_status *status);
+/**
+   @brief Return the value associated with the key provided.
+   @param table A pointer to the hash table.
+   @param key The key whose value to retrieve.
+   @param[out] status Status variable.
+   @returns A pointer to the value in the table, valid until it is next
+   changed.
+   @exception SMB_NOT_FOUND_ERROR If an item with the given key is not found.
+ */
+void *hts_get(smb_hts const *table, void *key, smb_status *status);
+/**
+   @brief Return true when a key is contained in the table.
+   @param table A pointer to the hash table.
+   @param key The key to search for.
+   @returns Whether the key is present.
+ */
+bool hts_contains(smb_hts const *table, void *key);
+
+#endif // LIBSTEPHEN_HTS_H
@@ -19,18 +19,23 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include "libstephen/al.h"
 #include "libstephen/ht.h"
 #include "libstephen/rb.h"
 
 #define GC_NOMARK 'w'
 #define GC_QUEUED 'g'
 #define GC_MARKED 'b'
+#define GC_YOUNG 'y'
+#define GC_OLD 'o'
 
 #define LISP_VALUE_HEAD             \
   struct {                          \
     struct lisp_type  *type;        \
     struct lisp_value *next;        \
     char mark;                      \
+    char gen;                       \
+    char dirty;                     \
   }
 
 // Type declarations.
@@ -38,6 +43,28 @@ typedef struct lisp_value {
   LISP_VALUE_HEAD;
 } lisp_value;
 
+// A call frame of the bytecode VM.
+typedef struct {
+  struct lisp_lambda *lambda;
+  struct lisp_env *env; // arguments, if lambdas in the body capture them
+  int pc;       // index of the next op in the lambda's bytecode
+  size_t base;  // index of the first argument on the value stack
+} lisp_frame;
+
+// Objects are allocated from pools, one for each multiple of LISP_POOL_GRAIN
+// bytes up to LISP_POOL_CLASSES of them.
+#define LISP_POOL_GRAIN 16
+#define LISP_POOL_CLASSES 8
+
+// Integers in this range are made once per runtime and shared.
+#define LISP_SMALLINT_MIN -128
+#define LISP_SMALLINT_MAX 1023
+typedef struct {
+  void *free;         // list of freed objects
+  char *next, *end;   // unused part of the newest slab
+  struct lisp_slab *slabs;
+} lisp_pool;
+
 // A lisp_runtime is NOT a lisp_value!
 typedef struct {
   lisp_value *head;
@@ -47,6 +74,39 @@ typedef struct {
   lisp_value *nil;
 
   smb_rb rb;
+  lisp_pool pools[LISP_POOL_CLASSES];
+  struct lisp_integer *smallints[LISP_SMALLINT_MAX - LISP_SMALLINT_MIN + 1];
+
+  // Generations: every object after young in the list is young.  Objects of
+  // types which mutate can be changed after they are made, so the old ones are
+  // kept to find old objects pointing at young ones.
+  lisp_value *young;
+  lisp_value **oldmutable;
+  size_t noldmutable, oldmutablealloc;
+  size_t nold;    // number of old objects
+  size_t majorat; // number of old objects at which to do a full collection
+
+  // Values the evaluator is using which may not be reachable from anything
+  // else.  lisp_safepoint() collects once nalloc objects have been made since
+  // the last collection, and these are traced along with the VM's stack.
+  lisp_value **roots;
+  size_t nroots, rootsalloc;
+  size_t nalloc;
+  size_t collectat;
+
+  // Every symbol, by name, so that each name exists only once.
+  smb_ht symbols;
+
+  // The bytecode VM's value stack and call frames.
+  lisp_value **stack;
+  size_t nstack, stackalloc;
+  lisp_frame *frames;
+  size_t nframes, framealloc;
+
+  // Counters kept by lisp_profile_start(), or NULL.  Nothing is counted or
+  // timed while it's NULL, so a runtime which isn't profiled only pays for
+  // checking it.
+  struct lisp_profile *profile;
 } lisp_runtime;
 
 // The below ARE lisp_values!
@@ -71,11 +131,23 @@ typedef struct lisp_type {
   smb_iter (*expand)(lisp_value*);
   lisp_value * (*eval)(lisp_runtime *rt, lisp_scope *scope, lisp_value *value);
   lisp_value * (*call)(lisp_runtime *rt, lisp_scope *scope, lisp_value *callable, lisp_value *arg);
+  // If size is not 0, objects are allocated from the runtime's pools and
+  // zeroed instead of calling new, then passed to init (if it isn't NULL).
+  // Then free (if it isn't NULL) only frees what the object owns.
+  size_t size;
+  void (*init)(lisp_value *value);
+  // If true, objects may be changed after they are made, and must be marked
+  // dirty when they are.
+  bool mutates;
 } lisp_type;
 
+// Symbols are interned, so two symbols are the same name only when they are the
+// same object.
 typedef struct {
   LISP_VALUE_HEAD;
   char *sym;
+  unsigned int hash;
+  unsigned int epoch; // changed whenever the symbol is bound in any scope
 } lisp_symbol;
 
 typedef struct {
@@ -83,7 +155,8 @@ typedef struct {
   char *message;
 } lisp_error;
 
-typedef struct {
+// Integers are shared, so they must not be changed once they are made.
+typedef struct lisp_integer {
   LISP_VALUE_HEAD;
   int x;
 } lisp_integer;
@@ -93,39 +166,180 @@ typedef struct {
   char *s;
 } lisp_string;
 
+// A vector of lisp_value pointers.
+typedef struct {
+  LISP_VALUE_HEAD;
+  smb_al items;
+} lisp_vector;
+
+// A hash table from lisp_value to lisp_value.  Integers, strings and symbols
+// are compared by value, and everything else by identity.
+typedef struct {
+  LISP_VALUE_HEAD;
+  smb_ht table;
+} lisp_hashmap;
+
 typedef lisp_value * (*lisp_builtin_func)(lisp_runtime*, lisp_scope*,lisp_value*);
+// A builtin which takes a list of already evaluated arguments.
+typedef lisp_value * (*lisp_apply_func)(lisp_runtime*, lisp_list*);
+// A builtin which takes its evaluated arguments as an array, after they've been
+// checked against its signature (see lisp_native_new()).  The array is on the
+// runtime's stack, so it's only valid until the builtin calls back into the
+// evaluator.
+typedef lisp_value * (*lisp_native_func)(lisp_runtime*, int argc,
+                                         lisp_value **argv);
+#define LISP_NATIVE_MAX_ARGS 4
 typedef struct {
   LISP_VALUE_HEAD;
   lisp_builtin_func call;
+  lisp_apply_func apply;   // if not NULL, call is not used
+  lisp_native_func native; // if not NULL, neither call nor apply is used
   char *name;
+  // A native builtin's signature: the types of its first nargs arguments (NULL
+  // for any type), and if it's variadic, the type of any after them.
+  int nargs;
+  bool variadic;
+  lisp_type *types[LISP_NATIVE_MAX_ARGS];
+  lisp_type *rest;
 } lisp_builtin;
 
+// Bytecode ops.  Each one except RETURN is followed by an int operand (OUTER and
+// LAMBDA by two).
+enum lisp_opcode {
+  LISP_CONST,   // push constant k
+  LISP_ARG,     // push argument i of the current frame
+  LISP_GLOBAL,  // push the value of symbol constant k in the closure
+  LISP_CALL,    // call the value below the top n values, with them as args
+  LISP_JUMP,    // jump to op t
+  LISP_JUMPF,   // pop a value, and jump to op t if it isn't true
+  LISP_RETURN,  // return the value on top of the stack
+  LISP_OUTER,   // followed by depth d and index i: push argument i of the
+                // d'th enclosing lambda
+  LISP_LAMBDA,  // followed by constant k and index n: make a lambda with the
+                // argument list and body in k, and the nested code n
+  LISP_TAILCALL,// like CALL, but replacing the current frame when it can
+};
+
+// What a LISP_GLOBAL op last found, which is good until its symbol is bound
+// again.
 typedef struct {
+  lisp_scope *closure; // the scope it was looked up from, or NULL if unused
+  lisp_value *value;
+  unsigned int epoch;  // the symbol's epoch then
+} lisp_global_cache;
+
+typedef struct lisp_bytecode {
+  int *ops;
+  int nops;
+  lisp_value **consts; // all of these are within the lambda's code
+  lisp_global_cache *globals; // one for each constant, used by LISP_GLOBAL
+  int nconsts;
+  int nargs;
+  struct lisp_bytecode **lambdas; // code of the lambdas in the body
+  int nlambdas;
+} lisp_bytecode;
+
+// The arguments of a call, kept for the lambdas made during it.
+typedef struct lisp_env {
+  LISP_VALUE_HEAD;
+  struct lisp_lambda *lambda; // the lambda that was called
+  struct lisp_env *up;        // that lambda's env
+  lisp_value **slots;
+  int nslots;
+} lisp_env;
+
+typedef struct lisp_lambda {
   LISP_VALUE_HEAD;
   lisp_list *args;
   lisp_value *code;
   lisp_scope *closure;
+  lisp_bytecode *bytecode; // compiled on the first call
+  bool interpret;          // true if the code couldn't be compiled
+  // Arguments of the enclosing lambdas, when made by bytecode.  Its bytecode
+  // then belongs to the lambda that made it.
+  lisp_env *env;
 } lisp_lambda;
 
+// Reads top-level forms one at a time, from a file or from chunks of text
+// which are fed to it.  Only the text of the form being read is kept.
+typedef struct {
+  FILE *file;   // NULL if the text is fed to the reader
+  bool end;     // true once there is no more text to come
+  char *buf;
+  size_t start; // where the form being read starts in buf
+  size_t scan;  // how far it has been scanned
+  size_t len, alloc;
+  int depth;    // open parentheses
+  bool started, instring, escape, inatom;
+} lisp_reader;
+
+// Calls to one builtin (by name), or to lambdas made from one piece of code.
+typedef struct {
+  char *name;       // the builtin's, or NULL for a lambda
+  lisp_value *args; // the lambda's argument list and code
+  lisp_value *code;
+  size_t calls;
+  // Nanoseconds spent in calls, counting those within them.  Recursive calls
+  // are only timed once, as part of the outermost one.
+  unsigned long long ns;
+  int active;       // calls which haven't returned yet
+  unsigned long long started;
+} lisp_profile_entry;
+
+typedef struct lisp_profile {
+  smb_ht calls;   // lisp_profile_entry* by builtin name or lambda code
+  smb_ht allocs;  // number of objects made, by type
+  size_t minor, major;
+  unsigned long long pause, maxpause; // nanoseconds spent collecting
+  unsigned long long markstart;       // when the current collection started
+  size_t survivors;                   // total objects kept by collections
+  size_t lastsurvivors;
+} lisp_profile;
+
 // Interpreter stuff
 void lisp_init(lisp_runtime *rt);
 void lisp_mark(lisp_runtime *rt, lisp_value *v);
 void lisp_sweep(lisp_runtime *rt);
+void lisp_mark_young(lisp_runtime *rt, lisp_value *v);
+void lisp_sweep_young(lisp_runtime *rt);
+void lisp_collect(lisp_runtime *rt, lisp_value *root);
+void lisp_push_root(lisp_runtime *rt, lisp_value *v);
+void lisp_restore_roots(lisp_runtime *rt, size_t nroots);
+void lisp_safepoint(lisp_runtime *rt);
 void lisp_destroy(lisp_runtime *rt);
+void lisp_profile_start(lisp_runtime *rt);
+void lisp_profile_stop(lisp_runtime *rt);
+void lisp_profile_report(lisp_runtime *rt, FILE *f);
+void lisp_profile_enter(lisp_runtime *rt, lisp_value *callable);
+void lisp_profile_exit(lisp_runtime *rt, lisp_value *callable);
+void lisp_profile_alloc(lisp_runtime *rt, lisp_type *type);
+void lisp_profile_mark(lisp_runtime *rt);
+void lisp_profile_sweep(lisp_runtime *rt, size_t kept, bool major);
+void lisp_pools_init(lisp_runtime *rt);
+void lisp_pools_destroy(lisp_runtime *rt);
+void *lisp_alloc(lisp_runtime *rt, size_t size);
+void lisp_release(lisp_runtime *rt, void *v, size_t size);
 
 // Shortcuts for type operations.
 void lisp_print(FILE *f, lisp_value *value);
-void lisp_free(lisp_value *value);
+void lisp_free(lisp_runtime *rt, lisp_value *value);
 lisp_value *lisp_eval(lisp_runtime *rt, lisp_scope *scope, lisp_value *value);
 lisp_value *lisp_call(lisp_runtime *rt, lisp_scope *scope, lisp_value *callable,
                       lisp_value *arguments);
+lisp_value *lisp_apply(lisp_runtime *rt, lisp_value *callable, int argc,
+                       lisp_value **argv);
 lisp_value *lisp_new(lisp_runtime *rt, lisp_type *typ);
 
 // Shortcuts for creation of objects
 lisp_symbol *lisp_symbol_new(lisp_runtime *rt, char *string);
 lisp_error *lisp_error_new(lisp_runtime *rt, char *message);
+lisp_integer *lisp_integer_new(lisp_runtime *rt, int x);
 lisp_builtin *lisp_builtin_new(lisp_runtime *rt, char *name,
                                lisp_builtin_func call);
+lisp_builtin *lisp_function_new(lisp_runtime *rt, char *name,
+                                lisp_apply_func apply);
+lisp_builtin *lisp_native_new(lisp_runtime *rt, char *name,
+                              lisp_native_func native, const char *signature);
 lisp_value *lisp_nil_new(lisp_runtime *rt);
 
 // Helper functions
@@ -133,23 +347,49 @@ void lisp_scope_bind(lisp_scope *scope, lisp_symbol *symbol, lisp_value *value);
 lisp_value *lisp_scope_lookup(lisp_runtime *rt, lisp_scope *scope,
                               lisp_symbol *symbol);
 void lisp_scope_add_builtin(lisp_runtime *rt, lisp_scope *scope, char *name, lisp_builtin_func call);
+void lisp_scope_add_function(lisp_runtime *rt, lisp_scope *scope, char *name,
+                             lisp_apply_func apply);
+void lisp_scope_add_native(lisp_runtime *rt, lisp_scope *scope, char *name,
+                           lisp_native_func native, const char *signature);
 void lisp_scope_populate_builtins(lisp_runtime *rt, lisp_scope *scope);
+lisp_scope *lisp_scope_clone(lisp_runtime *rt, lisp_scope *scope);
 lisp_value *lisp_eval_list(lisp_runtime *rt, lisp_scope *scope, lisp_value *list);
 lisp_value *lisp_parse(lisp_runtime *rt, char *input);
+void lisp_reader_init(lisp_reader *reader, FILE *file);
+void lisp_reader_feed(lisp_reader *reader, const char *text, size_t len);
+void lisp_reader_end(lisp_reader *reader);
+lisp_value *lisp_read(lisp_runtime *rt, lisp_reader *reader);
+void lisp_reader_destroy(lisp_reader *reader);
 bool lisp_get_args(lisp_list *list, char *format, ...);
+lisp_value *lisp_native_call(lisp_runtime *rt, lisp_builtin *builtin, int argc,
+                             lisp_value **argv);
+bool lisp_special_form_p(lisp_value *v);
 lisp_value *lisp_quote(lisp_runtime *rt, lisp_value *value);
+// Lambdas and bytecode
+lisp_value *lisp_lambda_apply(lisp_runtime *rt, lisp_lambda *lambda,
+                              lisp_list *args);
+lisp_bytecode *lisp_compile(lisp_runtime *rt, lisp_lambda *lambda);
+void lisp_bytecode_free(lisp_bytecode *code);
+lisp_value *lisp_vm_run(lisp_runtime *rt, lisp_lambda *lambda, lisp_list *args);
+lisp_value *lisp_vm_call(lisp_runtime *rt, lisp_lambda *lambda, int argc,
+                         lisp_value **argv);
 // List functions
 int lisp_list_length(lisp_list *list);
 bool lisp_nil_p(lisp_value *l);
 
-extern lisp_type *type_type;
-extern lisp_type *type_scope;
-extern lisp_type *type_list;
-extern lisp_type *type_symbol;
-extern lisp_type *type_error;
-extern lisp_type *type_integer;
-extern lisp_type *type_string;
-extern lisp_type *type_builtin;
-extern lisp_type *type_lambda;
+// The type objects are constant, and there is no other global state, so
+// runtimes on different threads don't interfere with each other.
+extern lisp_type *const type_type;
+extern lisp_type *const type_scope;
+extern lisp_type *const type_list;
+extern lisp_type *const type_symbol;
+extern lisp_type *const type_error;
+extern lisp_type *const type_integer;
+extern lisp_type *const type_string;
+extern lisp_type *const type_builtin;
+extern lisp_type *const type_lambda;
+extern lisp_type *const type_env;
+extern lisp_type *const type_vector;
+extern lisp_type *const type_hashmap;
 
 #endif//SMB_LIBSTEPHEN_LISP_H
@@ -200,6 +200,19 @@ typedef struct smb_iter {
    */
   void (*delete)(struct smb_iter *iter);
 
+  /**
+     @brief Copies up to n of the next elements into a buffer.
+
+     This lets a loop pay for one indirect call per batch instead of two per
+     element.  It may be NULL, in which case iter_next_n() uses next and
+     has_next instead.
+     @param iter The iterator being used.
+     @param buf Where to put the elements.
+     @param n The most elements to copy.
+     @return The number copied, which is less than n only at the end.
+   */
+  int (*next_n)(struct smb_iter *iter, DATA *buf, int n);
+
 } smb_iter;
 
 /**
@@ -209,5 +222,16 @@ typedef struct smb_iter {
    @param printer The printer for handling DATA objects.
  */
 void iter_print(smb_iter it, FILE *f, DATA_PRINTER printer);
+/**
+   @brief Copy up to n of an iterator's next elements into a buffer.
+
+   Uses the iterator's next_n when it has one, and otherwise its next and
+   has_next.
+   @param it The iterator.
+   @param buf Where to put the elements.
+   @param n The most elements to copy.
+   @returns The number copied, which is less than n only at the end.
+ */
+int iter_next_n(smb_iter *it, DATA *buf, int n);
 
 #endif // LIBSTEPHEN_LIST_H
@@ -51,6 +51,46 @@ typedef struct smb_ll_node
 
 } smb_ll_node;
 
+/**
+   @brief A pool of linked list nodes, which may be shared by many lists.
+
+   Nodes are cut from slabs of SMB_LL_POOL_SLAB at a time, and the nodes of
+   removed items are kept on a free list to be reused.  So a list's nodes are
+   mostly next to each other in memory, and making and removing them doesn't go
+   to the system allocator.  Slabs are only freed when the pool is destroyed.
+
+   A pool isn't locked, so lists sharing one must be used by one thread at a
+   time.
+ */
+typedef struct smb_ll_pool
+{
+  /**
+     @brief Nodes which have been freed, linked through their next pointers.
+   */
+  smb_ll_node *free;
+
+  /**
+     @brief The next node of the newest slab which has never been used.
+   */
+  smb_ll_node *next;
+
+  /**
+     @brief The end of the newest slab.
+   */
+  smb_ll_node *end;
+
+  /**
+     @brief Every slab the pool has allocated.
+   */
+  struct smb_ll_slab *slabs;
+
+} smb_ll_pool;
+
+/**
+   @brief The number of nodes in each slab of a smb_ll_pool.
+ */
+#define SMB_LL_POOL_SLAB 256
+
 /**
    @brief The actual linked list data type.  "Bare" functions return a pointer
    to this structure.
@@ -73,8 +113,81 @@ typedef struct smb_ll
    */
   int length;
 
+  /**
+     @brief The pool nodes come from, or NULL to allocate each one.
+   */
+  smb_ll_pool *pool;
+
+  /**
+     @brief The node most recently navigated to by index, or NULL.  Getting or
+     setting nearby indices starts from here instead of the head or tail, so
+     looping over the list by index is linear, not quadratic.
+   */
+  struct smb_ll_node *cursor;
+
+  /**
+     @brief The index of the cursor node.
+   */
+  int cursor_index;
+
+  /**
+     @brief The allocator nodes come from when there's no pool, or NULL for the
+     default.
+   */
+  const smb_allocator *alloc;
+
 } smb_ll;
 
+/**
+   @brief A position in a linked list, for walking it while inserting or
+   removing items in place.
+
+   A cursor is either on an item, or past the end of the list.  Changing the
+   list other than through the cursor invalidates it (except to change items'
+   values).
+ */
+typedef struct smb_ll_cursor
+{
+  /**
+     @brief The list the cursor is in.
+   */
+  smb_ll *list;
+
+  /**
+     @brief The node the cursor is on, or NULL past the end.
+   */
+  smb_ll_node *node;
+
+  /**
+     @brief The index of the node, or the list's length past the end.
+   */
+  int index;
+
+} smb_ll_cursor;
+
+/**
+   @brief Initialize a node pool in memory which has already been allocated.
+   @param pool A pointer to the pool to initialize.
+ */
+void ll_pool_init(smb_ll_pool *pool);
+/**
+   @brief Allocate and initialize a node pool.
+   @returns A pointer to the new pool.
+ */
+smb_ll_pool *ll_pool_create();
+/**
+   @brief Free the slabs of a node pool, without freeing the pointer.  Every
+   list using the pool must have been destroyed first.
+   @param pool The pool to destroy.
+ */
+void ll_pool_destroy(smb_ll_pool *pool);
+/**
+   @brief Free a node pool and its slabs.  Every list using the pool must have
+   been destroyed first.
+   @param pool The pool to delete.
+ */
+void ll_pool_delete(smb_ll_pool *pool);
+
 /**
    @brief Initializes a new list in memory which has already been allocated.
    @param new_list A pointer to the memory to initialize.
@@ -85,6 +198,25 @@ void ll_init(smb_ll *new_list);
    @returns A pointer to the new list.
  */
 smb_ll *ll_create();
+/**
+   @brief Initializes a new list whose nodes come from a pool.
+   @param new_list A pointer to the memory to initialize.
+   @param pool The pool, which must outlive the list.
+ */
+void ll_init_pooled(smb_ll *new_list, smb_ll_pool *pool);
+/**
+   @brief Allocates and initializes a new, empty list whose nodes come from a
+   pool.
+   @param pool The pool, which must outlive the list.
+   @returns A pointer to the new list.
+ */
+smb_ll *ll_create_pooled(smb_ll_pool *pool);
+/**
+   @brief Initializes a new list whose nodes come from an allocator.
+   @param new_list A pointer to the memory to initialize.
+   @param allocator The allocator, or NULL for the default.
+ */
+void ll_init_alloc(smb_ll *new_list, const smb_allocator *allocator);
 /**
    @brief Frees all the resources held by the linked list without freeing the
    actual pointer to the list.
@@ -258,6 +390,25 @@ int  ll_index_of(const smb_ll *list, DATA d, DATA_COMPARE comp);
  */
 void ll_sort(smb_ll *list, DATA_COMPARE cmp);
 
+/**
+   @brief Loop over every item of a linked list, without any function calls.
+
+   The current node may be changed, but not removed.  For example:
+
+       smb_ll_node *node;
+       DATA d;
+       LL_FOR_EACH(list, node, d) {
+         printf("%lld\n", d.data_llint);
+       }
+
+   @param list A pointer to the list.
+   @param node A smb_ll_node pointer variable, set to each node in turn.
+   @param item A DATA variable, set to each item in turn.
+ */
+#define LL_FOR_EACH(list, node, item)                                   \
+  for ((node) = (list)->head; (node) && ((item) = (node)->data, 1);     \
+       (node) = (node)->next)
+
 /**
    @brief Get an iterator for the linked list.
    @param list A pointer to the list.
@@ -309,4 +460,68 @@ DATA ll_foldl(smb_ll *list, DATA start_value, DATA (*reduction)(DATA,DATA));
  */
 DATA ll_foldr(smb_ll *list, DATA start_value, DATA (*reduction)(DATA,DATA));
 
+/**
+   @brief Return a cursor on the first item of a list.
+   @param list The list.
+   @returns A cursor on index 0 (which is past the end of an empty list).
+ */
+smb_ll_cursor ll_cursor(smb_ll *list);
+/**
+   @brief Move a cursor to an index, from wherever is closest.
+   @param cursor The cursor to move.
+   @param index The index to move to, from 0 up to the length of the list (past
+   the end).
+   @param[out] status Status variable.
+   @exception SMB_INDEX_ERROR If the index is out of range.  The cursor isn't
+   moved.
+ */
+void ll_cursor_seek(smb_ll_cursor *cursor, int index, smb_status *status);
+/**
+   @brief Return whether a cursor is on an item, rather than past the end.
+   @param cursor The cursor.
+   @returns Whether there's an item to get, set or remove.
+ */
+bool ll_cursor_valid(const smb_ll_cursor *cursor);
+/**
+   @brief Move a cursor to the next item, or past the end after the last one.
+   It must be on an item.
+   @param cursor The cursor.
+ */
+void ll_cursor_next(smb_ll_cursor *cursor);
+/**
+   @brief Move a cursor to the previous item.  Past the end, this is the last
+   item.
+   @param cursor The cursor.
+   @param[out] status Status variable.
+   @exception SMB_INDEX_ERROR If the cursor is already on the first item (or
+   the list is empty).
+ */
+void ll_cursor_prev(smb_ll_cursor *cursor, smb_status *status);
+/**
+   @brief Return the item a cursor is on, which must be valid.
+   @param cursor The cursor.
+   @returns The item's data.
+ */
+DATA ll_cursor_get(const smb_ll_cursor *cursor);
+/**
+   @brief Change the item a cursor is on, which must be valid.
+   @param cursor The cursor.
+   @param data The new data.
+ */
+void ll_cursor_set(smb_ll_cursor *cursor, DATA data);
+/**
+   @brief Insert an item before the cursor, which stays on the same item (or
+   past the end, so inserting there appends).
+   @param cursor The cursor.
+   @param data The data to insert.
+ */
+void ll_cursor_insert(smb_ll_cursor *cursor, DATA data);
+/**
+   @brief Remove the item a cursor is on, which must be valid, and move it to
+   the next item.
+   @param cursor The cursor.
+   @returns The data which was removed.
+ */
+DATA ll_cursor_remove(smb_ll_cursor *cursor);
+
 #endif // LIBSTEPHEN_LL_H
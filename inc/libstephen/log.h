@@ -43,6 +43,21 @@
  */
 #define LEVEL_CRITICAL 50
 
+/**
+   @brief The lowest level compiled in.  LOG() calls (and the macros built on
+   it) below this level compile to nothing, though their arguments must still
+   compile.  Define it before including this header, or on the command line,
+   e.g. -DSMB_LOG_MIN_LEVEL=LEVEL_INFO for release builds.
+ */
+#ifndef SMB_LOG_MIN_LEVEL
+#define SMB_LOG_MIN_LEVEL LEVEL_NOTSET
+#endif
+
+/**
+   @brief Room for the name of a level without one, like "11".
+ */
+#define SL_LEVEL_BUF 20
+
 /**
    @brief Max number of log handlers to be held by a logger.
  */
@@ -86,6 +101,48 @@ typedef struct {
 
 } smb_loghandler;
 
+/**
+   @brief sl_log() waits for room when an asynchronous logger's queue is full.
+ */
+#define SL_ASYNC_BLOCK 0
+/**
+   @brief sl_log() drops the message when an asynchronous logger's queue is
+   full.  Dropped messages are counted by sl_dropped().
+ */
+#define SL_ASYNC_DROP  1
+
+/**
+   @brief Settings for an asynchronous logger, passed to sl_start_async().
+
+   Like smb_loghandler, just pass it by value.
+ */
+typedef struct {
+
+  /**
+     @brief The most messages which may be waiting to be written.
+   */
+  size_t capacity;
+  /**
+     @brief What to do when the queue is full: SL_ASYNC_BLOCK or SL_ASYNC_DROP.
+   */
+  int policy;
+  /**
+     @brief Write out waiting messages once they add up to this many bytes.
+   */
+  size_t flush_bytes;
+  /**
+     @brief Write out waiting messages once the oldest has waited this many
+     milliseconds.
+   */
+  int flush_ms;
+
+} smb_logasync;
+
+/**
+   @brief The state of an asynchronous logger, private to log.c.
+ */
+struct sl_async;
+
 /**
    @brief Specifies a logger.
 
@@ -107,6 +164,17 @@ typedef struct {
     @brief The number of handlers actually contained in the handlers array.
    */
   int num;
+  /**
+     @brief The lowest level of any handler (INT_MAX with none), kept up to
+     date by the sl_ functions, so that sl_enabled() needn't look at each one.
+     A literal may leave this 0: it just won't skip anything early.
+   */
+  int min_level;
+  /**
+     @brief The writer thread and queue, when the logger is asynchronous.
+     Otherwise NULL, and messages are written by the thread that logs them.
+   */
+  struct sl_async *async;
 
 } smb_logger;
 
@@ -169,6 +237,72 @@ void sl_clear_handlers(smb_logger *l);
  */
 void sl_set_default_logger(smb_logger *l);
 
+/**
+   @brief Start writing a logger's messages from a background thread.
+
+   After this, sl_log() only formats a message and queues it, and the writer
+   thread writes queued messages in batches, with one writev() per handler.  A
+   batch is written when it reaches config.flush_bytes, when its oldest message
+   has waited config.flush_ms, or when it's as large as it can be.  The
+   handlers mustn't be changed while the logger is asynchronous.
+   @param l The logger. (NULL for default)
+   @param config The queue's size, policy, and flush thresholds.
+   @param[out] status For error reporting.
+   @exception SMB_IO_ERROR If the writer thread or its state couldn't be set
+   up.  The logger stays synchronous.
+ */
+void sl_start_async(smb_logger *l, smb_logasync config, smb_status *status);
+/**
+   @brief Write out every queued message, and make the logger synchronous
+   again.  No other thread may be logging to it.  sl_destroy() does this too.
+   @param l The logger. (NULL for default)
+ */
+void sl_stop_async(smb_logger *l);
+/**
+   @brief Wait until every message this thread has logged has been written.
+   For a synchronous logger, this just flushes the handlers' files.
+   @param l The logger. (NULL for default)
+ */
+void sl_flush(smb_logger *l);
+/**
+   @brief Return the number of messages an asynchronous logger has dropped
+   because its queue was full.
+   @param l The logger. (NULL for default)
+   @returns The number of dropped messages.
+ */
+unsigned long sl_dropped(smb_logger *l);
+
+/**
+   @brief Return the name of a log level, like "INFO".
+   @param level The level.
+   @param buf Where a level without a name is written as a number.  Each thread
+   should give its own.
+   @returns The name, which is either static or buf.
+ */
+char *sl_level_string(int level, char buf[SL_LEVEL_BUF]);
+
+/**
+   @brief The logger used when NULL is given.  Set it with
+   sl_set_default_logger().
+ */
+extern smb_logger *sl_default_logger;
+
+/**
+   @brief Return whether any handler of a logger might accept a level.
+
+   This is the check LOG() makes before calling sl_log(), so that messages
+   nobody wants cost a comparison, and not a call.  Loggers may be shared by
+   threads which log at once, but they should be set up (handlers, levels,
+   default logger) before other threads use them.
+   @param l Logger to check. (NULL for default)
+   @param level The level of a message.
+   @returns False if no handler would accept the message.
+ */
+static inline bool sl_enabled(smb_logger *l, int level)
+{
+  return level >= (l ? l : sl_default_logger)->min_level;
+}
+
 /**
    @brief Log a message.
 
@@ -190,12 +324,20 @@ void sl_log(smb_logger *l, char *file, int line, const char *function, int level
    @brief Log a message.
 
    This macro fills out the file, line, and function parameters of sl_log() so
-   that you only need to figure out the logger, level, and message.
+   that you only need to figure out the logger, level, and message.  Messages
+   below SMB_LOG_MIN_LEVEL are compiled out, and messages no handler wants are
+   skipped before their arguments are evaluated.  The logger and level may be
+   evaluated more than once.
    @param logger Logger to log to.
    @param level Level the message is at.
    @param ... Format string and format arguments.
  */
-#define LOG(logger, level, ...) sl_log(logger, __FILE__, __LINE__, __func__, level, __VA_ARGS__);
+#define LOG(logger, level, ...)                                         \
+  do {                                                                  \
+    if ((level) >= SMB_LOG_MIN_LEVEL && sl_enabled(logger, level)) {    \
+      sl_log(logger, __FILE__, __LINE__, __func__, level, __VA_ARGS__); \
+    }                                                                   \
+  } while (0)
 
 /**
    @brief Log to default logger at LEVEL_DEBUG.
@@ -16,6 +16,12 @@
 #ifndef LIBSTEPHEN_RB_H
 #define LIBSTEPHEN_RB_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct smb_allocator; /* "libstephen/base.h" */
+
 /**
    A ring buffer data structure. This buffer can be inserted into and removed
    from at either end in constant time, except for memory allocations which may
@@ -32,6 +38,11 @@ typedef struct {
   int start;
   int count;
 
+  /**
+     @brief The allocator the data comes from, or NULL for the default.
+   */
+  const struct smb_allocator *alloc;
+
 } smb_rb;
 
 /**
@@ -41,6 +52,15 @@ typedef struct {
    @param init Initial amount of space to allocate.
  */
 void rb_init(smb_rb *rb, int dsize, int init);
+/**
+   @brief Initialize a ring buffer whose data comes from an allocator.
+   @param rb Pointer to a ring buffer struct.
+   @param dsize Size of data type to store in ring buffer.
+   @param init Initial amount of space to allocate.
+   @param allocator The allocator, or NULL for the default.
+ */
+void rb_init_alloc(smb_rb *rb, int dsize, int init,
+                   const struct smb_allocator *allocator);
 /**
    @brief Free all resources held by the ring buffer.
    @param rb Pointer to the ring buffer struct.
@@ -70,6 +90,60 @@ void rb_push_back(smb_rb *rb, void *src);
    Note that behavior is undefined if you decide to pop from an empty buffer.
 */
 void rb_pop_back(smb_rb *rb, void *dst);
+/**
+   @brief Add n items to the end of the ring buffer, with at most two copies.
+   May trigger expansion.
+   @param rb Pointer to ring buffer.
+   @param src An array of n items.
+   @param n The number of items.
+ */
+void rb_push_back_n(smb_rb *rb, const void *src, int n);
+/**
+   @brief Remove up to n items from the front of the ring buffer, with at most
+   two copies.
+   @param rb Pointer to ring buffer.
+   @param dst Room for n items.
+   @param n The most items to remove.
+   @returns The number removed, which is less than n if the buffer had fewer.
+ */
+int rb_pop_front_n(smb_rb *rb, void *dst, int n);
+
+/**
+   @brief Return the longest run of items at the front of the buffer which are
+   next to each other in memory, so they can be used (e.g. written to a file)
+   in place.  Call rb_consume() to remove them afterwards.
+   @param rb Pointer to ring buffer.
+   @param[out] n The number of items in the run, which is less than the count
+   of items when they wrap around the end of the buffer.
+   @returns A pointer to the first item.
+ */
+void *rb_readable_span(smb_rb *rb, int *n);
+/**
+   @brief Remove n items from the front of the ring buffer without copying
+   them anywhere.
+   @param rb Pointer to ring buffer.
+   @param n The number of items, at most the count of items.
+ */
+void rb_consume(smb_rb *rb, int n);
+/**
+   @brief Make room for at least want more items, and return the longest run
+   of free space after the last item, so items can be put there (e.g. read
+   from a file) in place.  Call rb_commit() to add them afterwards.
+   @param rb Pointer to ring buffer.
+   @param want The number of items to make room for.  May trigger expansion.
+   @param[out] n The number of items which fit in the run.  When the free space
+   wraps around the end of the buffer, this may be less than want, and the rest
+   is in the next span.
+   @returns A pointer to the free space.
+ */
+void *rb_writable_span(smb_rb *rb, int want, int *n);
+/**
+   @brief Add n items which have been put in the space returned by
+   rb_writable_span().
+   @param rb Pointer to ring buffer.
+   @param n The number of items, at most the size of that run.
+ */
+void rb_commit(smb_rb *rb, int n);
 
 /**
    @brief Expand a ring buffer (by doubling its size).
@@ -81,4 +155,185 @@ void rb_pop_back(smb_rb *rb, void *dst);
  */
 void rb_grow(smb_rb *rb);
 
+/**
+   @brief The size which smb_rb_spsc keeps its producer's and consumer's fields
+   apart by, so that they don't share a cache line.
+ */
+#define RB_CACHE_LINE 64
+
+/**
+   A ring buffer for handing items from one thread to another, without a lock.
+   Exactly one thread may push, and exactly one other may pop.
+
+   Unlike smb_rb, its capacity is fixed (and a power of two), so pushing to a
+   full buffer fails instead of growing it.  The head and tail are counters
+   which only go up, and an item's slot is its counter masked by the capacity.
+   The producer only writes the tail and the consumer only writes the head,
+   each on its own cache line.  Each side also keeps a copy of the other's
+   counter, and only reads the real one (which the other thread is writing)
+   when its copy says the buffer is full or empty.
+ */
+typedef struct {
+
+  /**
+     @brief The count of items ever popped.  Written by the consumer.
+   */
+  _Alignas(RB_CACHE_LINE) atomic_size_t head;
+  /**
+     @brief The consumer's last look at the tail.
+   */
+  size_t tail_cache;
+
+  /**
+     @brief The count of items ever pushed.  Written by the producer.
+   */
+  _Alignas(RB_CACHE_LINE) atomic_size_t tail;
+  /**
+     @brief The producer's last look at the head.
+   */
+  size_t head_cache;
+
+  /**
+     @brief The items.  Neither thread changes these fields.
+   */
+  _Alignas(RB_CACHE_LINE) char *data;
+  int dsize;
+  size_t mask;
+
+} smb_rb_spsc;
+
+/**
+   @brief Initialize a single producer, single consumer ring buffer.
+   @param rb Pointer to the ring buffer struct.
+   @param dsize Size of data type to store in the ring buffer.
+   @param capacity The most items it can hold, rounded up to a power of two.
+ */
+void rb_spsc_init(smb_rb_spsc *rb, int dsize, size_t capacity);
+/**
+   @brief Free all resources held by the ring buffer.  Neither thread may be
+   using it.
+   @param rb Pointer to the ring buffer struct.
+ */
+void rb_spsc_destroy(smb_rb_spsc *rb);
+/**
+   @brief Add an item to the back of the buffer.  Only the producer may call
+   this.
+   @param rb Pointer to the ring buffer struct.
+   @param src Area of memory to read from.
+   @returns Whether it was added, which it isn't if the buffer is full.
+ */
+bool rb_spsc_push(smb_rb_spsc *rb, const void *src);
+/**
+   @brief Remove an item from the front of the buffer.  Only the consumer may
+   call this.
+   @param rb Pointer to the ring buffer struct.
+   @param dst Area of memory to write the item to.
+   @returns Whether there was an item to remove.
+ */
+bool rb_spsc_pop(smb_rb_spsc *rb, void *dst);
+/**
+   @brief Add as many of n items as fit to the back of the buffer, with one
+   update of the tail.  Only the producer may call this.
+   @param rb Pointer to the ring buffer struct.
+   @param src An array of n items.
+   @param n The number of items.
+   @returns The number added, from the start of src.
+ */
+size_t rb_spsc_push_n(smb_rb_spsc *rb, const void *src, size_t n);
+/**
+   @brief Remove up to n items from the front of the buffer, with one update of
+   the head.  Only the consumer may call this.
+   @param rb Pointer to the ring buffer struct.
+   @param dst Room for n items.
+   @param n The most items to remove.
+   @returns The number removed.
+ */
+size_t rb_spsc_pop_n(smb_rb_spsc *rb, void *dst, size_t n);
+/**
+   @brief Return the number of items in the buffer.  If the other thread is
+   using it, this may be out of date by the time it returns.
+   @param rb Pointer to the ring buffer struct.
+   @returns The number of items.
+ */
+size_t rb_spsc_count(smb_rb_spsc *rb);
+
+/**
+   A bounded ring buffer which any number of threads may push to and pop from
+   at once, without a lock.
+
+   This is Dmitry Vyukov's queue.  Each slot has a sequence number next to its
+   item, which says whether the slot is ready for the push or the pop at some
+   position.  A thread claims a position by advancing the tail (or head) with a
+   compare and swap, copies its item, and then moves the slot's sequence number
+   on to hand it to the other side.  So threads only contend on the counter,
+   and never wait for a thread which is still copying, unless they need the
+   very slot it's in.
+ */
+typedef struct {
+
+  /**
+     @brief The position of the next pop.
+   */
+  _Alignas(RB_CACHE_LINE) atomic_size_t head;
+
+  /**
+     @brief The position of the next push.
+   */
+  _Alignas(RB_CACHE_LINE) atomic_size_t tail;
+
+  /**
+     @brief The slots, each a sequence number followed by an item.  None of
+     these fields change after initialization.
+   */
+  _Alignas(RB_CACHE_LINE) char *slots;
+  int dsize;
+  size_t stride;
+  size_t mask;
+
+} smb_rb_mpmc;
+
+/**
+   @brief Initialize a multi producer, multi consumer ring buffer.
+   @param rb Pointer to the ring buffer struct.
+   @param dsize Size of data type to store in the ring buffer.
+   @param capacity The most items it can hold, rounded up to a power of two
+   (and at least two).
+ */
+void rb_mpmc_init(smb_rb_mpmc *rb, int dsize, size_t capacity);
+/**
+   @brief Free all resources held by the ring buffer.  No thread may be using
+   it.
+   @param rb Pointer to the ring buffer struct.
+ */
+void rb_mpmc_destroy(smb_rb_mpmc *rb);
+/**
+   @brief Add an item to the back of the buffer, if there's room.
+   @param rb Pointer to the ring buffer struct.
+   @param src Area of memory to read from.
+   @returns Whether it was added.
+ */
+bool rb_mpmc_try_push(smb_rb_mpmc *rb, const void *src);
+/**
+   @brief Remove an item from the front of the buffer, if there is one.
+   @param rb Pointer to the ring buffer struct.
+   @param dst Area of memory to write the item to.
+   @returns Whether an item was removed.
+ */
+bool rb_mpmc_try_pop(smb_rb_mpmc *rb, void *dst);
+/**
+   @brief Add an item to the back of the buffer, waiting for room if it's full.
+   A waiting thread spins for a while, and then yields the processor between
+   tries.
+   @param rb Pointer to the ring buffer struct.
+   @param src Area of memory to read from.
+ */
+void rb_mpmc_push(smb_rb_mpmc *rb, const void *src);
+/**
+   @brief Remove an item from the front of the buffer, waiting for one if it's
+   empty.  Waiting is like rb_mpmc_push().
+   @param rb Pointer to the ring buffer struct.
+   @param dst Area of memory to write the item to.
+ */
+void rb_mpmc_pop(smb_rb_mpmc *rb, void *dst);
+
 #endif //LIBSTEPHEN_RB_H
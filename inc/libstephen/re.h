@@ -16,6 +16,7 @@
 #ifndef SMB_PIKE_REGEX_H
 #define SMB_PIKE_REGEX_H
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <wchar.h>
@@ -30,6 +31,12 @@
  */
 typedef struct Instr Instr;
 struct Instr;
+/**
+   A lazily built DFA, used to execute a regex when no captures are requested.
+   See dfa.c for details.
+ */
+typedef struct DFA DFA;
+struct DFA;
 /// @endcond HIDDEN_SYMBOLS
 
 /**
@@ -51,8 +58,40 @@ struct Regex {
      Pointer to instruction buffer.
    */
   Instr *i;
+  /**
+     DFA cache used by reexec() when no captures are requested.  This is
+     created by recomp() and reread(), and may be NULL, in which case the Pike
+     VM is always used.  Since reexec() modifies it, reexec() must not be called
+     on the same Regex from several threads at once.  Use a RegexContext per
+     thread instead.
+   */
+  DFA *dfa;
 };
 
+/**
+   Holds the state needed to execute a regex: thread lists, visited marks, a
+   capture pool, and a DFA cache.  A context is created for one Regex and may be
+   reused for any number of executions, with no setup cost per execution.  The
+   Regex itself is never modified by an execution with a context, so several
+   threads may each execute the same Regex with their own context.  A context
+   must only be used by one thread at a time.
+ */
+typedef struct RegexContext RegexContext;
+
+/**
+   Many patterns compiled into one program, so that all of them can be tested
+   against an input in a single pass.  A set owns a context, so it must only be
+   used by one thread at a time.
+ */
+typedef struct RegexSet RegexSet;
+
+/**
+   A cache of compiled regexes, keyed by their pattern, which evicts the least
+   recently used ones to stay within a memory budget.  A cache is not locked,
+   so it must only be used by one thread at a time.
+ */
+typedef struct RegexCache RegexCache;
+
 /**
    A convenience data structure for getting copies of captured strings.
 
@@ -93,6 +132,55 @@ typedef struct {
 
 } WCaptures;
 
+/**
+   A view of a captured string, pointing into the input it was matched in.
+ */
+typedef struct {
+  /**
+     The first character of the capture.  This is not NUL terminated.
+   */
+  const char *str;
+  /**
+     The number of characters in the capture.
+   */
+  size_t len;
+
+} Span;
+
+/**
+   A view of a captured wide string.  This is just a wide version of Span.
+ */
+typedef struct {
+  /**
+     The first character of the capture.  This is not NUL terminated.
+   */
+  const wchar_t *str;
+  /**
+     The number of characters in the capture.
+   */
+  size_t len;
+
+} WSpan;
+
+/**
+   A line of a buffer matched by regrep().
+ */
+typedef struct {
+  /**
+     The number of the line (starting from zero) within the buffer.
+   */
+  size_t line;
+  /**
+     The offset of the match within the buffer (not within the line).
+   */
+  size_t start;
+  /**
+     The length of the match.
+   */
+  size_t length;
+
+} RegexMatch;
+
 /**
    Read in a program from a string.  This takes the "assembly like"
    representation and turns it into compiled instructions.  Every instruction
@@ -122,6 +210,35 @@ Regex refread(FILE *f);
    @param f The file to write to.
  */
 void rewrite(Regex r, FILE *f);
+/**
+   Write a program in a compact binary format.
+
+   The format contains no pointers or text to parse, so rebinread() can load it
+   very quickly.  Programs may be written one after another into a bundle.
+   @param r The regex to write.
+   @param[out] len Where to store the size of the result.
+   @returns A buffer of len bytes, to be freed with free().
+ */
+void *rebinwrite(Regex r, size_t *len);
+/**
+   Write a program to a file in binary format.  See rebinwrite().
+   @param r The regex to write.
+   @param f The file to write to.
+ */
+void rebinfwrite(Regex r, FILE *f);
+/**
+   Read a program written by rebinwrite().
+
+   The data does not need to be aligned, so it may come straight from a mapped
+   file.  It is validated, so malformed data gives an error rather than a
+   broken program.
+   @param data The binary program.
+   @param len Number of bytes available at data.
+   @param[out] used Where to store the number of bytes read, which is where the
+   next program of a bundle begins (may be NULL).
+   @returns The regex bytecode.  On error, its instruction pointer is NULL.
+ */
+Regex rebinread(const void *data, size_t len, size_t *used);
 /**
    Free a Regex object.  You must do this when you're done with it.
    @param r Regex to free.
@@ -144,6 +261,11 @@ Regex recompw(const wchar_t *regex);
 
 /**
    Execute a regex on a string.
+
+   When saved is NULL, the match is computed with a lazily built DFA, which
+   costs a single table lookup per character once the states it needs have been
+   built.  Otherwise (or if the DFA's memory budget is exhausted), the Pike VM
+   is used.  Both give the same match length.
    @param r Compiled regular expression bytecode to execute.
    @param input Text to use as input.
    @param saved Out pointer for captured indices.
@@ -158,6 +280,271 @@ ssize_t reexec(Regex r, const char *input, size_t **saved);
    @returns Length of match, or -1 if no match.
 */
 ssize_t reexecw(Regex r, const wchar_t *input, size_t **saved);
+/**
+   Create a context for executing a regex.
+   @param r The regex the context will execute.  It must outlive the context.
+   @returns A new context, to be freed with recontextfree().
+ */
+RegexContext *recontext(Regex r);
+/**
+   Free a context created by recontext().
+   @param ctx The context to free.
+ */
+void recontextfree(RegexContext *ctx);
+/**
+   Execute a regex on a string, using a context.  This behaves exactly like
+   reexec(), except that it uses the context's state instead of allocating its
+   own.
+   @param ctx Context for the regex to execute.
+   @param input Text to use as input.
+   @param saved Out pointer for captured indices.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t reexecctx(RegexContext *ctx, const char *input, size_t **saved);
+/**
+   Execute a regex on a wide string, using a context.
+   @param ctx Context for the regex to execute.
+   @param input Text to use as input.
+   @param saved Out pointer for captured indices.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t reexecwctx(RegexContext *ctx, const wchar_t *input, size_t **saved);
+/**
+   Search for the leftmost match of a regex anywhere in a string.
+
+   This is like trying reexec() at every index of the string, but it is done in
+   a single pass over the input.  If every match of the regex must begin with a
+   literal string, the search skips directly between occurrences of it.
+   @param r Compiled regular expression bytecode to execute.
+   @param input Text to search.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Out pointer for captured indices.  These are indices into the
+   whole input, not relative to the start of the match.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t research(Regex r, const char *input, size_t *start, size_t **saved);
+/**
+   Search for the leftmost match of a regex anywhere in a wide string.
+   @param r Compiled regular expression bytecode to execute.
+   @param input Text to search.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Out pointer for captured indices.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t researchw(Regex r, const wchar_t *input, size_t *start, size_t **saved);
+/**
+   Search for a regex in a string, using a context.  See research().
+   @param ctx Context for the regex to execute.
+   @param input Text to search.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Out pointer for captured indices.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t researchctx(RegexContext *ctx, const char *input, size_t *start,
+                    size_t **saved);
+/**
+   Search for a regex in a wide string, using a context.  See research().
+   @param ctx Context for the regex to execute.
+   @param input Text to search.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Out pointer for captured indices.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t researchwctx(RegexContext *ctx, const wchar_t *input, size_t *start,
+                     size_t **saved);
+/**
+   Execute a regex on a string, storing captures in an array you provide.
+
+   Once the context has warmed up, this allocates no memory at all.  Only the
+   first n capture indices are tracked, so there is no cost for the rest.
+   @param ctx Context to execute with.
+   @param input Text to use as input.
+   @param saved Array of n indices.  Filled with the first n captured indices
+   (or as many as the regex has) when there is a match, and untouched otherwise.
+   @param n Number of indices saved has room for (may be zero).
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t reexecinto(RegexContext *ctx, const char *input, size_t *saved,
+                   size_t n);
+/**
+   Execute a regex on a wide string, storing captures in an array you provide.
+   See reexecinto().
+   @param ctx Context to execute with.
+   @param input Text to use as input.
+   @param saved Array of n indices for the captures.
+   @param n Number of indices saved has room for.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t reexecwinto(RegexContext *ctx, const wchar_t *input, size_t *saved,
+                    size_t n);
+/**
+   Search for a regex in a string, storing captures in an array you provide.
+   See researchctx() and reexecinto().
+   @param ctx Context to execute with.
+   @param input Text to search.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Array of n indices for the captures.
+   @param n Number of indices saved has room for.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t researchinto(RegexContext *ctx, const char *input, size_t *start,
+                     size_t *saved, size_t n);
+/**
+   Search for a regex in a wide string, storing captures in an array you
+   provide.  See researchinto().
+   @param ctx Context to execute with.
+   @param input Text to search.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Array of n indices for the captures.
+   @param n Number of indices saved has room for.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t researchwinto(RegexContext *ctx, const wchar_t *input, size_t *start,
+                      size_t *saved, size_t n);
+/**
+   Begin matching a regex against a stream of input, fed in chunks.
+
+   The execution state is kept in the context between chunks, so the input
+   never needs to be in memory all at once.  Indices (the match start and the
+   captures) count from the beginning of the stream.  Starting a new stream
+   discards any stream the context was already running.
+   @param ctx Context to run the stream in.
+   @param search If true, find the leftmost match anywhere in the stream (like
+   research()).  Otherwise, only match at the beginning (like reexec()).
+   @param captures Whether restreamfinish() should return the captures.
+ */
+void restreamstart(RegexContext *ctx, bool search, bool captures);
+/**
+   Feed the next chunk of a stream.
+
+   A NUL character ends the input, as it would for reexec().
+   @param ctx Context running the stream.
+   @param chunk The next characters of input (need not be NUL terminated).
+   @param len Number of characters in the chunk.
+   @returns True if more input could change the result, false once the result
+   is decided (in which case there is no need to feed any more).
+ */
+bool restreamfeed(RegexContext *ctx, const char *chunk, size_t len);
+/**
+   Feed the next chunk of a wide stream.  See restreamfeed().
+   @param ctx Context running the stream.
+   @param chunk The next characters of input (need not be NUL terminated).
+   @param len Number of characters in the chunk.
+   @returns True if more input could change the result.
+ */
+bool restreamfeedw(RegexContext *ctx, const wchar_t *chunk, size_t len);
+/**
+   End a stream and return its result.
+   @param ctx Context running the stream.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Out pointer for captured indices.  Set to NULL if there is no
+   match, or if the stream was started without captures.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t restreamfinish(RegexContext *ctx, size_t *start, size_t **saved);
+/**
+   Match a regex against the contents of a file, reading it in chunks.
+
+   Reading stops as soon as the result is decided, so the file may be left
+   partway through.
+   @param ctx Context to run the stream in.
+   @param f File to read from.
+   @param search Find the leftmost match, rather than matching at the start.
+   @param start Out pointer for the index where the match begins (may be NULL).
+   @param saved Out pointer for captured indices.
+   @returns Length of match, or -1 if no match.
+ */
+ssize_t restreamfile(RegexContext *ctx, FILE *f, bool search, size_t *start,
+                     size_t **saved);
+/**
+   Compile several regular expressions into a set.
+   @param regexes Array of patterns (at least one).
+   @param n Number of patterns.
+   @returns A new set, to be freed with refreeset().
+ */
+RegexSet *recompset(const char **regexes, size_t n);
+/**
+   Compile several wide regular expressions into a set.
+   @param regexes Array of patterns (at least one).
+   @param n Number of patterns.
+   @returns A new set, to be freed with refreeset().
+ */
+RegexSet *recompsetw(const wchar_t **regexes, size_t n);
+/**
+   Find which patterns of a set match a string.
+
+   Pattern k matches when reexec() on pattern k alone would not return -1.  All
+   of the patterns are run in one pass over the input.
+   @param set The set to execute.
+   @param input Text to use as input.
+   @param matched Array of one bool per pattern, set to whether it matched.
+   @returns The number of patterns which matched.
+ */
+size_t reexecset(RegexSet *set, const char *input, bool *matched);
+/**
+   Find which patterns of a set match a wide string.  See reexecset().
+   @param set The set to execute.
+   @param input Text to use as input.
+   @param matched Array of one bool per pattern, set to whether it matched.
+   @returns The number of patterns which matched.
+ */
+size_t reexecsetw(RegexSet *set, const wchar_t *input, bool *matched);
+/**
+   Free a set created by recompset().
+   @param set The set to free.
+ */
+void refreeset(RegexSet *set);
+/**
+   Create a cache for compiled regexes.
+   @param budget Number of bytes the cache should try to stay under.
+   @returns A new cache, to be freed with recachefree().
+ */
+RegexCache *recachenew(size_t budget);
+/**
+   Free a cache, along with every regex in it.
+   @param c The cache to free.  None of its regexes may still be in use.
+ */
+void recachefree(RegexCache *c);
+/**
+   Return the compiled form of a pattern, compiling it only if it isn't cached.
+
+   The regex is shared with every other caller that asks for the same pattern,
+   so it must not be modified or freed.  Since reexec() updates its DFA, either
+   execute it with a RegexContext, or don't share the cache between threads.
+   The regex stays valid (and won't be evicted) until it is released.
+   @param c The cache.
+   @param regex The pattern to compile.
+   @returns The compiled regex.
+ */
+const Regex *recacheget(RegexCache *c, const char *regex);
+/**
+   Release a regex returned by recacheget().  Each recacheget() must be
+   released exactly once; releasing more is a bug, caught by an assertion.
+   @param c The cache it came from.
+   @param r The regex.
+ */
+void recacherelease(RegexCache *c, const Regex *r);
+/**
+   Return the number of bytes used by a cache.
+   @param c The cache.
+ */
+size_t recacheused(const RegexCache *c);
+/**
+   Search each line of a buffer for a regex, on several threads.
+
+   The buffer is split into lines at each '\n', and the last line need not end
+   with one.  Each line with a match gets one entry, holding the leftmost match
+   in the line, and the entries are in the order of the lines.  The buffer need
+   not be NUL terminated, but a NUL within a line ends the input for that line.
+   @param r The regex to search for.
+   @param buf The buffer to search.
+   @param len The length of the buffer.
+   @param nthreads The number of threads to search with (zero means one).
+   @param[out] nmatches Where to store the number of matches.
+   @returns A new array of matches, which you must free().
+ */
+RegexMatch *regrep(Regex r, const char *buf, size_t len, size_t nthreads,
+                   size_t *nmatches);
 /**
    Return the number of saved index slots required by a regex.
    @param r The regular expression bytecode.
@@ -219,6 +606,26 @@ WCaptures recapw(const wchar_t *s, const size_t *l, size_t n);
    @param c Captures to free.
  */
 void recapwfree(WCaptures c);
+/**
+   Convert a string and a capture list into views of the captured strings.
+
+   Unlike recap(), nothing is copied or allocated: each Span points into s, so
+   it is only valid as long as s is.
+   @param s String the captures are from.
+   @param l List of captures returned from reexec().
+   @param n Number of saves - use renumsaves() if you don't know.
+   @param spans Array with room for n/2 spans, which are filled in.
+ */
+void recapspan(const char *s, const size_t *l, size_t n, Span *spans);
+/**
+   Convert a wide string and a capture list into views of the captured strings.
+   See recapspan().
+   @param s String the captures are from.
+   @param l List of captures returned from reexecw().
+   @param n Number of saves.
+   @param spans Array with room for n/2 spans, which are filled in.
+ */
+void recapwspan(const wchar_t *s, const size_t *l, size_t n, WSpan *spans);
 
 
 /**
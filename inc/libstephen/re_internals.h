@@ -16,6 +16,7 @@
 #ifndef SMB_REGEX_REGPARSE_H
 #define SMB_REGEX_REGPARSE_H
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <wchar.h>
@@ -29,11 +30,132 @@ enum code {
 struct Instr {
   enum code code; // opcode
   wchar_t c;      // character
-  size_t s;       // slot for "saving" a string index
+  size_t s;       // slot for "saving" a string index (pattern id for Match)
   Instr *x, *y;   // targets for jump and split
-  size_t lastidx; // used by Pike VM for fast membership testing
 };
 
+/*
+  Range and NRange instructions keep their s range pairs in x (as a char block),
+  which is what rewrite() prints.  For matching, y points to a ClassTable.
+ */
+
+/**
+   @brief Lookup table for testing a character against a Range or NRange.
+
+   Characters below 256 are tested with a bitmap (which already accounts for
+   negation).  Anything else is found by binary search in a sorted list of
+   non-overlapping ranges.
+ */
+typedef struct ClassTable ClassTable;
+struct ClassTable {
+  unsigned long long bits[4];
+  size_t n;          // number of ranges
+  wchar_t ranges[];  // 2n characters: lo, hi, lo, hi, etc.
+};
+
+/**
+   @brief Create the lookup table for a character class.
+   @param pairs Array of 2n characters, each pair an inclusive range.
+   @param n Number of ranges.
+   @param negate True for NRange (match characters outside the ranges).
+ */
+ClassTable *newclass(const wchar_t *pairs, size_t n, bool negate);
+
+/**
+   @brief Create the lookup table for a Range/NRange from its char block.
+ */
+void classfromblock(Instr *in);
+
+/**
+   @brief Return true if a Range or NRange instruction accepts a character.
+ */
+bool range(const Instr *in, wchar_t test);
+
+/**
+   @brief Default number of bytes a DFA may spend on cached states.
+ */
+#define DFA_BUDGET (1024 * 1024)
+/**
+   @brief Returned by redfaexec() when the DFA can't complete the match.
+ */
+#define DFA_GAVEUP -2
+
+/**
+   @brief Create an empty DFA cache for a program.
+   @param r The program the DFA will execute.
+   @param budget Maximum number of bytes to spend on states.
+ */
+DFA *redfanew(Regex r, size_t budget);
+/**
+   @brief Free a DFA cache (NULL is allowed).
+ */
+void redfafree(DFA *d);
+/**
+   @brief Execute a program on a string using its DFA.
+
+   States are constructed as they are needed.  If the budget runs out, the cache
+   is flushed and DFA_GAVEUP is returned, so that the caller can fall back to
+   the Pike VM.
+   @returns Length of match, -1 for no match, or DFA_GAVEUP.
+ */
+ssize_t redfaexec(DFA *d, Regex r, const char *input);
+/**
+   @brief Return the number of bytes a DFA uses (0 for NULL).
+ */
+size_t redfasize(DFA *d);
+
+/**
+   @brief Bytes of stack the backtracker may use for its visited set.
+ */
+#define BT_BUDGET 4096
+/**
+   @brief Returned by rebacktrack() when a problem is too big for it.
+ */
+#define BT_GAVEUP -2
+
+/**
+   @brief Execute a regex with the bounded backtracker.
+
+   This gives the same result as the Pike VM, but it is only usable when the
+   program length times the input length is small enough for the visited set
+   to fit in BT_BUDGET.
+   @returns Length of match, -1 for no match, or BT_GAVEUP.
+ */
+ssize_t rebacktrack(Regex r, const char *input, size_t **saved);
+
+/**
+   @brief Bytes of the arena's first block, which is inside the Arena itself.
+ */
+#define ARENA_LOCAL 4096
+typedef struct ArenaBlock ArenaBlock;
+/**
+   @brief Bump allocator for data that lives only as long as one compile.
+ */
+typedef struct Arena Arena;
+struct Arena {
+  ArenaBlock *blocks;  // heap blocks, most recent first
+  char *next, *end;    // free space in the current block
+  size_t blocksize;    // size of the current block
+  max_align_t local[ARENA_LOCAL / sizeof(max_align_t)];
+};
+
+/**
+   @brief Initialize an empty arena.
+ */
+void arenainit(Arena *a);
+/**
+   @brief Allocate zeroed memory from an arena (or from calloc() when NULL).
+ */
+void *arenaalloc(Arena *a, size_t size);
+/**
+   @brief Free memory from arenaalloc().  This does nothing unless a is NULL.
+ */
+void arenarelease(Arena *a, void *p);
+/**
+   @brief Free everything allocated from an arena, leaving it empty.
+ */
+void arenafree(Arena *a);
+
 /**
    @brief Types of terminal symbols!
  */
@@ -114,6 +236,7 @@ struct Lexer {
   Token tok, prev;
   Token buf[LEXER_BUFSIZE];
   size_t nbuf;
+  Arena *arena; // where parse trees are allocated (NULL for calloc)
 };
 
 /* Lexing */
@@ -121,6 +244,12 @@ void escape(Lexer *l);
 Token nextsym(Lexer *l);
 void unget(Token t, Lexer *l);
 Regex codegen(PTree *tree);
+// Like codegen(), but allocating temporary data in an existing arena.
+Regex codegenin(PTree *tree, Arena *a);
+// Joins several patterns into one program.  Pattern k's Match has s == k.
+Regex codegenset(PTree **trees, size_t n, Arena *a);
+// Peephole optimizes a program, consuming it and returning the result.
+Regex reoptimize(Regex r);
 
 /* Parsing */
 PTree *TERM(Lexer *l);
@@ -130,6 +259,8 @@ PTree *CLASS(Lexer *l);
 PTree *SUB(Lexer *l);
 PTree *reparse(const char *regex);
 PTree *reparsew(const wchar_t *winput);
+// Parses into an arena. Free the tree with arenafree() instead of free_tree().
+PTree *reparsein(struct Input input, Arena *a);
 
 /* Utitlites */
 void free_tree(PTree *tree);
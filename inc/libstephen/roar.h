@@ -0,0 +1,227 @@
+/***************************************************************************//**
+
+  @file         libstephen/roar.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        A compressed bitmap of 32 bit integers ("Roaring").
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  Integers are split into chunks of 65536 by their high 16 bits, and each chunk
+  which has any members gets a container for their low 16 bits, in whichever
+  form is smallest:
+
+  - An array container is a sorted array of up to ROAR_ARRAY_MAX values.
+  - A bitset container is a bitfield (see "libstephen/bf.h") of the whole
+    chunk, for chunks with more members than an array may hold.
+  - A run container is a sorted array of ranges of values, for chunks made of
+    long runs.
+
+  Arrays and bitsets are chosen as items are added and removed.  Runs are only
+  made by roar_optimize(), and a run container is turned back into one of the
+  others when it's changed.  So a set of a few million scattered ids takes
+  about two bytes per id, instead of a bit per possible id.
+
+*******************************************************************************/
+
+#ifndef LIBSTEPHEN_ROAR_H
+#define LIBSTEPHEN_ROAR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "base.h"
+#include "list.h" /* smb_iter */
+
+/**
+   @brief The number of values in a chunk, and bits in a bitset container.
+ */
+#define ROAR_CHUNK 65536
+
+/**
+   @brief The most values an array container holds.  At this size, the array
+   is as large as a bitset.
+ */
+#define ROAR_ARRAY_MAX 4096
+
+/**
+   @brief Container types.
+ */
+#define ROAR_ARRAY  0
+#define ROAR_BITSET 1
+#define ROAR_RUN    2
+
+/**
+   @brief A range of values in a run container, from start to start + length.
+ */
+typedef struct {
+
+  uint16_t start;
+  uint16_t length;
+
+} smb_roar_run;
+
+/**
+   @brief The members of one chunk of a compressed bitmap.
+ */
+typedef struct {
+
+  /**
+     @brief The high 16 bits shared by every member.
+   */
+  uint16_t key;
+  /**
+     @brief ROAR_ARRAY, ROAR_BITSET or ROAR_RUN.
+   */
+  uint8_t type;
+  /**
+     @brief The number of members.
+   */
+  int cardinality;
+  /**
+     @brief The number of values in an array, or runs in a run container.
+   */
+  int length;
+  /**
+     @brief The number of values or runs allocated.
+   */
+  int capacity;
+  /**
+     @brief The members' low 16 bits, in the form type says.
+   */
+  union {
+    uint16_t *array;
+    unsigned char *bits;
+    smb_roar_run *runs;
+  };
+
+} smb_roar_container;
+
+/**
+   @brief A compressed bitmap.
+ */
+typedef struct {
+
+  /**
+     @brief The containers, sorted by key.  None are empty.
+   */
+  smb_roar_container *containers;
+  /**
+     @brief The number of containers.
+   */
+  int length;
+  /**
+     @brief The number of containers allocated.
+   */
+  int capacity;
+
+} smb_roar;
+
+/**
+   @brief Initialize an empty bitmap.
+   @param r The bitmap to initialize.
+ */
+void roar_init(smb_roar *r);
+/**
+   @brief Allocate an empty bitmap.
+   @returns The new bitmap.
+ */
+smb_roar *roar_create(void);
+/**
+   @brief Free the bitmap's resources, but not the bitmap.
+   @param r The bitmap to destroy.
+ */
+void roar_destroy(smb_roar *r);
+/**
+   @brief Free the bitmap and its resources.
+   @param r The bitmap to delete.
+ */
+void roar_delete(smb_roar *r);
+
+/**
+   @brief Add an integer to the bitmap.
+   @param r The bitmap.
+   @param value The integer.
+ */
+void roar_add(smb_roar *r, uint32_t value);
+/**
+   @brief Remove an integer from the bitmap, if it's there.
+   @param r The bitmap.
+   @param value The integer.
+ */
+void roar_remove(smb_roar *r, uint32_t value);
+/**
+   @brief Return whether an integer is in the bitmap.
+   @param r The bitmap.
+   @param value The integer.
+   @returns Whether it's there.
+ */
+bool roar_contains(const smb_roar *r, uint32_t value);
+/**
+   @brief Return the number of integers in the bitmap.
+   @param r The bitmap.
+   @returns The number of integers.
+ */
+uint64_t roar_length(const smb_roar *r);
+/**
+   @brief Return the number of bytes of memory the bitmap uses.
+   @param r The bitmap.
+   @returns The number of bytes.
+ */
+size_t roar_memory(const smb_roar *r);
+
+/**
+   @brief Set dst to the union of two bitmaps.  dst must be initialized, and
+   may be either operand.
+   @param dst The bitmap to store the result in.
+   @param a The first operand.
+   @param b The second operand.
+ */
+void roar_or(smb_roar *dst, const smb_roar *a, const smb_roar *b);
+/**
+   @brief Set dst to the intersection of two bitmaps.  dst must be
+   initialized, and may be either operand.
+   @param dst The bitmap to store the result in.
+   @param a The first operand.
+   @param b The second operand.
+ */
+void roar_and(smb_roar *dst, const smb_roar *a, const smb_roar *b);
+/**
+   @brief Store each container as runs, where that makes it smaller, and give
+   back any extra memory.
+   @param r The bitmap.
+ */
+void roar_optimize(smb_roar *r);
+
+/**
+   @brief Write the bitmap to a file.  The format is the same on every
+   machine, with the values in little endian order.
+   @param r The bitmap.
+   @param f The file to write to.
+   @param[out] status For error reporting.
+   @exception SMB_IO_ERROR If writing failed.
+ */
+void roar_write(const smb_roar *r, FILE *f, smb_status *status);
+/**
+   @brief Read a bitmap written by roar_write(), into an uninitialized one.
+   @param r The bitmap to initialize.
+   @param f The file to read from.
+   @param[out] status For error reporting.
+   @exception SMB_IO_ERROR If the file is cut short or malformed.  The bitmap
+   is left empty.
+ */
+void roar_read(smb_roar *r, FILE *f, smb_status *status);
+
+/**
+   @brief Return an iterator over the integers in the bitmap, in order.  Each
+   is returned in data_llint.  The bitmap mustn't change during iteration.
+   @param r The bitmap.
+   @returns The iterator.
+ */
+smb_iter roar_get_iter(const smb_roar *r);
+
+#endif // LIBSTEPHEN_ROAR_H
@@ -17,10 +17,190 @@
 #define SMB_STR_H
 
 #include <wchar.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
 #include "libstephen/ll.h"
 
+/**
+   @brief A piece of a larger string, which isn't NUL terminated.
+ */
+typedef struct smb_span
+{
+  /**
+     @brief The first character.
+   */
+  const char *str;
+
+  /**
+     @brief The number of characters.
+   */
+  size_t length;
+
+} smb_span;
+
+/**
+   @brief The contents of a file, from fv_open().
+
+   A regular file is mapped into memory, so opening it doesn't copy anything,
+   and pages are only read as they're used.  Anything else (a pipe, a terminal)
+   is read into a buffer instead.  Either way, the data is read only, and isn't
+   NUL terminated.
+ */
+typedef struct smb_file_view
+{
+  /**
+     @brief The file's contents.
+   */
+  const char *data;
+
+  /**
+     @brief The number of bytes of data.
+   */
+  size_t length;
+
+  /**
+     @brief The start of the mapping (which begins at a page boundary), or NULL
+     if the data was read into a buffer.
+   */
+  void *map;
+
+  /**
+     @brief The size of the mapping.
+   */
+  size_t map_length;
+
+} smb_file_view;
+
+/**
+   @brief Iterator over the lines of a string, from line_iter().
+ */
+typedef struct smb_line_iter
+{
+  /**
+     @brief The start of the next line.
+   */
+  const char *next;
+
+  /**
+     @brief The end of the string.
+   */
+  const char *end;
+
+} smb_line_iter;
+
+/**
+   @brief A good buffer size for a smb_line_reader.
+ */
+#define LR_DEFAULT_SIZE 65536
+
+/**
+   @brief Reads lines from a file through one large buffer.
+
+   Each line is returned as a view into the buffer, so lines are never copied
+   or allocated one at a time.  Newlines are found with memchr(), which the C
+   library vectorizes.  A line longer than the buffer grows it.
+ */
+typedef struct smb_line_reader
+{
+  /**
+     @brief The file being read.
+   */
+  FILE *file;
+
+  /**
+     @brief The buffer.
+   */
+  char *buf;
+
+  /**
+     @brief The size of the buffer.
+   */
+  size_t capacity;
+
+  /**
+     @brief The start of the next line in the buffer.
+   */
+  size_t start;
+
+  /**
+     @brief How far from start has been searched for a newline already.
+   */
+  size_t scanned;
+
+  /**
+     @brief The end of the data in the buffer.
+   */
+  size_t end;
+
+  /**
+     @brief Whether the end of the file has been read.
+   */
+  bool eof;
+
+} smb_line_reader;
+
+/**
+   @brief Initialize a line reader.
+   @param lr The reader.
+   @param f The file to read from.  It may already have been read from (say,
+   a header line with fgets()), and the reader starts where that left off.
+   @param capacity The initial size of the buffer, like LR_DEFAULT_SIZE.
+ */
+void lr_init(smb_line_reader *lr, FILE *f, size_t capacity);
+/**
+   @brief Free the reader's buffer.  It doesn't close the file.
+   @param lr The reader.
+ */
+void lr_destroy(smb_line_reader *lr);
+/**
+   @brief Read the next line.
+
+   Lines are split like split_lines(): the newline isn't part of a line, and a
+   last line without one is still returned.
+   @param lr The reader.
+   @param[out] line The line, which is valid until the next call.
+   @param[out] status Status variable.
+   @returns Whether a line was read, which is false at the end of the file or
+   on an error.
+   @exception SMB_IO_ERROR If reading the file failed.
+ */
+bool lr_next(smb_line_reader *lr, smb_span *line, smb_status *status);
+
+/**
+   @brief View the rest of a file, from its current position to the end.
+   @param view The view to fill in.
+   @param f The file.  It can be closed once the view is open.
+   @param[out] status Status variable.
+   @exception SMB_IO_ERROR If the file couldn't be read (errno says why).
+ */
+void fv_open(smb_file_view *view, FILE *f, smb_status *status);
+/**
+   @brief Unmap or free the contents of a file view.
+   @param view The view to close.
+ */
+void fv_close(smb_file_view *view);
+
+/**
+   @brief Return an iterator over the lines of a string (such as a file view's
+   data), which needn't be NUL terminated.
+   @param data The string.
+   @param length Its length.
+   @returns The iterator.
+ */
+smb_line_iter line_iter(const char *data, size_t length);
+/**
+   @brief Get the next line from a line iterator, without copying it.
+
+   Lines are split like split_lines(): the newline isn't part of a line, and a
+   last line without one is still returned.
+   @param it The iterator.
+   @param[out] line The line, pointing into the iterator's string.
+   @returns Whether there was another line.
+ */
+bool line_next(smb_line_iter *it, smb_span *line);
+
 /**
    @brief Read a file into a string and return a pointer to it.
    @param f The file to read.
@@ -16,6 +16,7 @@
 #ifndef LIBSTEPHEN_UT_H
 #define LIBSTEPHEN_UT_H
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <wchar.h>
@@ -30,6 +31,24 @@
  */
 #define SMB_UNIT_TESTS_PER_GROUP 50
 
+/**
+   @brief The number of timed samples a benchmark takes by default.
+ */
+#define SMB_UNIT_BENCH_SAMPLES 50
+
+/**
+   @brief How long each sample of a benchmark runs for by default, in seconds.
+   The number of iterations per sample is calibrated to take at least this
+   long.
+ */
+#define SMB_UNIT_BENCH_SAMPLE_SECONDS 0.002
+
+/**
+   @brief How long a benchmark runs before it's timed, in seconds (counting
+   calibration).
+ */
+#define SMB_UNIT_BENCH_WARMUP_SECONDS 0.02
+
 /**
    @brief Asserts that an expression is true.  If false, returns line number.
 
@@ -213,6 +232,106 @@ typedef struct smb_ut_test
 
 } smb_ut_test;
 
+/**
+   @brief A suite of groups for su_run_parallel(), as a function which creates,
+   runs and deletes them.
+ */
+typedef struct smb_ut_suite
+{
+  /**
+     @brief The name printed with the suite's result.
+   */
+  const char *name;
+
+  /**
+     @brief The function which runs the suite.  It fails by exiting with a
+     nonzero status, as su_run_group() does.
+   */
+  void (*run)(void);
+
+} smb_ut_suite;
+
+/**
+   @brief Defines a single benchmark.
+
+   The function is given the benchmark's argument and a number of iterations,
+   and should do the operation being measured that many times.  Setup which
+   shouldn't be timed belongs in the argument, made before the group is run.
+ */
+typedef struct smb_ut_bench
+{
+  /**
+     @brief A null-terminated string that identifies this benchmark.
+   */
+  char description[SMB_UNIT_DESCRIPTION_SIZE];
+
+  /**
+     @brief The function to time.
+   */
+  void (*run)(void *arg, long iterations);
+
+  /**
+     @brief The argument passed to run.
+   */
+  void *arg;
+
+  /**
+     @brief The number of timed samples.
+   */
+  int samples;
+
+  /**
+     @brief The least time each sample takes, in seconds.
+   */
+  double sample_seconds;
+
+  /**
+     @brief Whether to count allocations, with one more untimed sample.
+     They're counted by swapping in an allocator behind smb_new() (see
+     smb_set_allocator()), so only libstephen's allocations are seen, and
+     only while the default allocator is malloc().
+   */
+  bool count_allocs;
+
+} smb_ut_bench;
+
+/**
+   @brief The measurements of a benchmark, from su_run_bench().
+ */
+typedef struct smb_ut_bench_result
+{
+  /**
+     @brief The number of iterations in each sample.
+   */
+  long iterations;
+
+  /**
+     @brief The number of samples.
+   */
+  int samples;
+
+  /**
+     @brief The median time of an iteration, in nanoseconds.
+   */
+  double median_ns;
+
+  /**
+     @brief The 99th percentile time of an iteration, in nanoseconds.
+   */
+  double p99_ns;
+
+  /**
+     @brief The fastest time of an iteration, in nanoseconds.
+   */
+  double min_ns;
+
+  /**
+     @brief Allocations per iteration, or -1 if they weren't counted.
+   */
+  double allocs;
+
+} smb_ut_bench_result;
+
 /**
    @brief A structure holding a group of unit tests that are all related.
 
@@ -237,6 +356,16 @@ typedef struct smb_ut_group
    */
   smb_ut_test *tests[SMB_UNIT_TESTS_PER_GROUP];
 
+  /**
+     @brief The number of benchmarks in the group.
+  */
+  int num_benches;
+
+  /**
+     @brief Pointers to the benchmarks contained.
+   */
+  smb_ut_bench *benches[SMB_UNIT_TESTS_PER_GROUP];
+
 } smb_ut_group;
 
 /**
@@ -278,7 +407,8 @@ int su_run_test(smb_ut_test *test, char *file);
    @brief Run a group of tests.
 
    The tests are run sequentially (in the order they were added to the group).
-   If a test fails, the remaining tests are not executed.
+   If a test fails, the remaining tests are not executed, and the process exits.
+   The wall time of each test, and of the group, is printed with its result.
    @param group A pointer to the smb_ut_group to run.
    @returns An integer.  Since the tests are run sequentially via the
    su_run_test() function, it returns 0 if all tests succeeded, or else the
@@ -308,4 +438,66 @@ void su_delete_test(smb_ut_test *test);
  */
 void su_delete_group(smb_ut_group *group);
 
+/**
+   @brief Run suites in parallel worker processes.
+
+   Each suite is run in a child process, so a failure or crash in one doesn't
+   stop the others.  A child's output is saved and printed in suite order once
+   it finishes, followed by its result and wall time.  With one job, the suites
+   are run in this process one after another, and the first failure exits, the
+   same as calling them directly.
+   @param suites The suites to run.
+   @param num_suites The number of suites.
+   @param jobs The most workers to run at once, or 0 for one per online CPU.
+   @returns The number of suites which failed.
+ */
+int su_run_parallel(const smb_ut_suite *suites, int num_suites, int jobs);
+
+/**
+   @brief Create and return a new benchmark, with the default number of samples
+   and sample time, which counts allocations.
+   @param description A description of the benchmark.
+   @param run The function to time.
+   @param arg The argument to pass it.
+   @returns A pointer to the new benchmark.
+ */
+smb_ut_bench *su_create_bench(char *description,
+                              void (*run)(void *arg, long iterations),
+                              void *arg);
+/**
+   @brief Add a benchmark to the given group.  Like su_add_test(), this fails
+   silently once the group is full.
+   @param group A pointer to the group.
+   @param bench A pointer to the benchmark.
+ */
+void su_add_bench(smb_ut_group *group, smb_ut_bench *bench);
+/**
+   @brief Run a benchmark.
+
+   The number of iterations per sample is doubled (or scaled by the last
+   sample's time) until a sample takes at least sample_seconds, and samples
+   keep running until SMB_UNIT_BENCH_WARMUP_SECONDS have passed.  Then each
+   sample is timed with the monotonic clock.
+   @param bench The benchmark.
+   @param[out] result The measurements.
+ */
+void su_run_bench(smb_ut_bench *bench, smb_ut_bench_result *result);
+/**
+   @brief Run every benchmark in a group, printing a line of results for each.
+   Its tests aren't run.
+   @param group A pointer to the group.
+ */
+void su_run_benches(smb_ut_group *group);
+/**
+   @brief Free a benchmark.  su_delete_group() frees a group's benchmarks.
+   @param bench The benchmark.
+ */
+void su_delete_bench(smb_ut_bench *bench);
+/**
+   @brief Make the compiler assume a value is used, so that work a benchmark
+   does only to produce it isn't optimized away.
+   @param p A pointer to the value.
+ */
+void su_bench_keep(const void *p);
+
 #endif // LIBSTEPHEN_UT_H
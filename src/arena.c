@@ -0,0 +1,263 @@
+/***************************************************************************//**
+
+  @file         arena.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Implementation of "libstephen/arena.h".
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libstephen/arena.h"
+
+struct smb_arena_block {
+  struct smb_arena_block *next;
+  size_t size;
+  max_align_t data[];
+};
+
+/*******************************************************************************
+
+                               Private Functions
+
+*******************************************************************************/
+
+static size_t arena_round(size_t size)
+{
+  return (size + SMB_ARENA_ALIGN - 1) & ~(size_t)(SMB_ARENA_ALIGN - 1);
+}
+
+static char *arena_align(char *p, size_t align)
+{
+  return (char*)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+static char *block_start(struct smb_arena_block *b)
+{
+  return (char*)b->data;
+}
+
+static size_t arena_used(const smb_arena *a)
+{
+  return a->blocks ? a->closed + (a->next - block_start(a->blocks)) : 0;
+}
+
+static void arena_update_peak(smb_arena *a)
+{
+  size_t used = arena_used(a);
+  if (used > a->peak) {
+    a->peak = used;
+  }
+}
+
+static void arena_free_blocks(smb_arena *a, struct smb_arena_block *b)
+{
+  struct smb_arena_block *next;
+  while (b) {
+    next = b->next;
+    smb_dealloc(a->parent, char, b, sizeof(*b) + b->size);
+    b = next;
+  }
+}
+
+/*
+  The arena's allocator functions.  Freeing and reallocating only do anything
+  in place for the most recent allocation, which is the common case of a
+  single container growing in an arena.
+ */
+
+static void *arena_vt_alloc(void *ctx, size_t size)
+{
+  return arena_alloc(ctx, size ? size : 1);
+}
+
+static void *arena_vt_realloc(void *ctx, void *ptr, size_t old_size,
+                              size_t new_size)
+{
+  smb_arena *a = ctx;
+  size_t old_rounded = arena_round(old_size ? old_size : 1);
+  size_t new_rounded = arena_round(new_size ? new_size : 1);
+  char *p = ptr;
+
+  if (p && p + old_rounded == a->next && (size_t)(a->end - p) >= new_rounded) {
+    a->next = p + new_rounded;
+    return p;
+  }
+  p = arena_alloc(a, new_rounded);
+  if (ptr) {
+    memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+  }
+  return p;
+}
+
+static void arena_vt_free(void *ctx, void *ptr, size_t size)
+{
+  smb_arena *a = ctx;
+  char *p = ptr;
+  if (p + arena_round(size ? size : 1) == a->next) {
+    a->next = p;
+  }
+}
+
+/*******************************************************************************
+
+                           Public Interface Functions
+
+*******************************************************************************/
+
+void arena_init(smb_arena *a)
+{
+  arena_init_alloc(a, NULL);
+}
+
+void arena_init_alloc(smb_arena *a, const smb_allocator *parent)
+{
+  a->next = NULL;
+  a->end = NULL;
+  a->blocks = NULL;
+  a->spare = NULL;
+  a->blocksize = SMB_ARENA_FIRST_BLOCK;
+  a->closed = 0;
+  a->peak = 0;
+  a->parent = parent;
+  a->allocator = (smb_allocator) {
+    arena_vt_alloc, arena_vt_realloc, arena_vt_free, a
+  };
+}
+
+smb_arena *arena_create(void)
+{
+  smb_arena *a = smb_new(smb_arena, 1);
+  arena_init(a);
+  return a;
+}
+
+void arena_destroy(smb_arena *a)
+{
+  arena_free_blocks(a, a->blocks);
+  arena_free_blocks(a, a->spare);
+  arena_init_alloc(a, a->parent);
+}
+
+void arena_delete(smb_arena *a)
+{
+  arena_destroy(a);
+  smb_free(a);
+}
+
+void *arena_alloc_block(smb_arena *a, size_t size, size_t align)
+{
+  struct smb_arena_block *b, **prev;
+  size_t need = size + (align > SMB_ARENA_ALIGN ? align : 0);
+  char *p;
+
+  arena_update_peak(a);
+
+  // Reuse the first spare block which is large enough, or make a new one.
+  for (prev = &a->spare; *prev && (*prev)->size < need; prev = &(*prev)->next) {
+  }
+  if (*prev) {
+    b = *prev;
+    *prev = b->next;
+  } else {
+    size_t blocksize = a->blocksize > need ? a->blocksize : need;
+    b = (struct smb_arena_block*) smb_alloc(a->parent, char,
+                                            sizeof(*b) + blocksize);
+    b->size = blocksize;
+    if (a->blocksize < SMB_ARENA_MAX_BLOCK) {
+      a->blocksize *= 2;
+    }
+  }
+
+  if (a->blocks) {
+    a->closed += a->blocks->size;
+  }
+  b->next = a->blocks;
+  a->blocks = b;
+  a->end = block_start(b) + b->size;
+
+  p = arena_align(block_start(b), align);
+  a->next = p + size;
+  return p;
+}
+
+void *arena_alloc_aligned(smb_arena *a, size_t size, size_t align)
+{
+  char *p;
+  if (align < SMB_ARENA_ALIGN) {
+    align = SMB_ARENA_ALIGN;
+  }
+  size = arena_round(size);
+  if (a->blocks) {
+    p = arena_align(a->next, align);
+    if (p <= a->end && (size_t)(a->end - p) >= size) {
+      a->next = p + size;
+      return p;
+    }
+  }
+  return arena_alloc_block(a, size, align);
+}
+
+smb_arena_mark arena_save(const smb_arena *a)
+{
+  smb_arena_mark mark = {a->blocks, a->next, a->closed};
+  return mark;
+}
+
+void arena_restore(smb_arena *a, smb_arena_mark mark)
+{
+  struct smb_arena_block *b;
+
+  arena_update_peak(a);
+  while (a->blocks != mark.block) {
+    b = a->blocks;
+    a->blocks = b->next;
+    b->next = a->spare;
+    a->spare = b;
+  }
+  if (a->blocks) {
+    a->next = mark.next;
+    a->end = block_start(a->blocks) + a->blocks->size;
+  } else {
+    a->next = NULL;
+    a->end = NULL;
+  }
+  a->closed = mark.closed;
+}
+
+void arena_reset(smb_arena *a)
+{
+  smb_arena_mark start = {NULL, NULL, 0};
+  arena_restore(a, start);
+}
+
+void arena_stats(smb_arena *a, smb_arena_stats *stats)
+{
+  struct smb_arena_block *lists[2] = {a->blocks, a->spare}, *b;
+  int i;
+
+  arena_update_peak(a);
+  stats->used = arena_used(a);
+  stats->peak = a->peak;
+  stats->reserved = 0;
+  stats->blocks = 0;
+  for (i = 0; i < 2; i++) {
+    for (b = lists[i]; b; b = b->next) {
+      stats->reserved += b->size;
+      stats->blocks++;
+    }
+  }
+}
+
+const smb_allocator *arena_allocator(smb_arena *a)
+{
+  return &a->allocator;
+}
@@ -21,7 +21,10 @@
 #include "libstephen/base.h"
 #include "libstephen/list.h"
 #include "libstephen/ad.h"
+#include "libstephen/arena.h"
+#include "libstephen/ht.h"
 #include "libstephen/ll.h"
+#include "libstephen/str.h"
 
 /*******************************************************************************
 
@@ -88,6 +91,12 @@ char *process_long_flag(smb_ad *pData, char *sTitle)
 
   e.data_ptr = NULL;
   ll_append(pData->long_flag_strings, e);
+
+  // Lookups find the first occurrence, as they did when they searched the list.
+  if (!ht_contains(pData->long_flag_index, d)) {
+    e.data_llint = ll_length(pData->long_flags) - 1;
+    ht_insert(pData->long_flag_index, d, e);
+  }
   return sTitle + 2;
 }
 
@@ -107,51 +116,158 @@ void process_bare_string(smb_ad *pData, char *sStr, char *previous_long_flag,
                          int previous_flag)
 {
   if (previous_long_flag) {
-    DATA d;
+    DATA d, key;
+    int index = ll_length(pData->long_flag_strings) - 1;
     d.data_ptr = sStr;
     smb_status status;
-    ll_set(pData->long_flag_strings, ll_length(pData->long_flag_strings) - 1, d,
-           &status);
+    ll_set(pData->long_flag_strings, index, d, &status);
     assert(status == SMB_SUCCESS);
+
+    key.data_ptr = previous_long_flag;
+    if (ht_get(pData->long_flag_index, key, &status).data_llint == index) {
+      ht_insert(pData->long_flag_params, key, d);
+    }
   } else if (previous_flag != EOF) {
     int idx = flag_index(previous_flag);
     // The flag index would be negative if the previous flag was not a
     // letter.  We'll accept the segfault as an error.
     pData->flag_strings[idx] = sStr;
   } else {
-    DATA d;
+    DATA d, e;
     d.data_ptr = sStr;
     ll_append(pData->bare_strings, d);
+    if (!ht_contains(pData->bare_string_index, d)) {
+      e.data_llint = ll_length(pData->bare_strings) - 1;
+      ht_insert(pData->bare_string_index, d, e);
+    }
   }
 }
 
 /**
-   @brief Find the string in the list and return its index, or -1.
+   @brief Find the string in an index and return its index, or -1.
 
-   @param toSearch Pointer to list to search.
+   @param index Table mapping strings to their first index.
    @param toFind String to find.
    @returns Index of the string.
-   @retval -1 String is not in the list.
+   @retval -1 String is not in the table.
  */
-int find_string(smb_ll *toSearch, char *toFind)
+int find_string(smb_ht *index, char *toFind)
 {
   DATA d;
-  char *sCurr;
-  smb_iter iter = ll_get_iter(toSearch);
-  int retVal = -1;
-  smb_status status;
-  while (iter.has_next(&iter)) {
-    d = iter.next(&iter, &status);
-    // We are using 'has_next' to check first!
-    assert(status == SMB_SUCCESS);
-    sCurr = (char *)d.data_ptr;
-    if (strcmp(toFind, sCurr) == 0) {
-      retVal = iter.index-1; // previous index
+  smb_status status = SMB_SUCCESS;
+  d.data_ptr = toFind;
+  d = ht_get(index, d, &status);
+  return status == SMB_SUCCESS ? (int) d.data_llint : -1;
+}
+
+/**
+   @brief The state carried from one argument to the next by process_args().
+ */
+typedef struct {
+  char *previous_long_flag;
+  int previous_flag;
+} ad_state;
+
+void process_arg(smb_ad *data, char *arg, ad_state *state, int depth);
+
+/**
+   @brief Process the lines of a response file as arguments.
+
+   @param data The structure with argument data.
+   @param path The file's name.
+   @param state The state from the argument before.
+   @param depth How many response files this one is within.
+   @returns Whether the file could be read.
+ */
+bool process_response_file(smb_ad *data, char *path, ad_state *state,
+                           int depth)
+{
+  smb_line_reader lr;
+  smb_span line;
+  smb_status status = SMB_SUCCESS;
+  FILE *f;
+  char *arg;
+
+  if (depth >= AD_MAX_RESPONSE_DEPTH || !(f = fopen(path, "r"))) {
+    return false;
+  }
+  if (!data->response_strings) {
+    data->response_strings = arena_create();
+  }
+
+  lr_init(&lr, f, LR_DEFAULT_SIZE);
+  while (lr_next(&lr, &line, &status)) {
+    if (line.length > 0 && line.str[line.length - 1] == '\r') {
+      line.length--;
+    }
+    if (line.length == 0) {
+      continue;
+    }
+    // Lines are only valid until the next read, and arguments last as long as
+    // the arg data, so they're copied into its arena.
+    arg = arena_new(data->response_strings, char, line.length + 1);
+    memcpy(arg, line.str, line.length);
+    arg[line.length] = '\0';
+    process_arg(data, arg, state, depth + 1);
+  }
+  lr_destroy(&lr);
+  fclose(f);
+  return true;
+}
+
+/**
+   @brief Process one argument.
+
+   @param data The structure with argument data.
+   @param arg The argument.
+   @param state The state from the argument before, which is updated.
+   @param depth How many response files the argument is within.
+ */
+void process_arg(smb_ad *data, char *arg, ad_state *state, int depth)
+{
+  switch (*arg) {
+  case '-':
+    // Processing new flag type, so set previous variables to invalid.
+    state->previous_long_flag = NULL;
+    state->previous_flag = EOF;
+    switch (*(arg + 1)) {
+    case '-':
+      // Long flag
+      state->previous_long_flag = process_long_flag(data, arg);
+      state->previous_flag = EOF;
+      break;
+    case '\0':
+      // A single '-'...counts as a bare string in my book
+      process_bare_string(data, arg, state->previous_long_flag,
+                          state->previous_flag);
+
+      state->previous_long_flag = NULL;
+      state->previous_flag = EOF;
+      break;
+    default:
+      // The input is a short flag
+      state->previous_flag = process_flag(data, arg);
+      state->previous_long_flag = NULL;
+      break;
+    }
+    break;
+
+  case '@':
+    // A response file, if they are on and it can be read.
+    if (data->response_files && arg[1] != '\0' &&
+        process_response_file(data, arg + 1, state, depth)) {
       break;
     }
+    // fall through
+
+  default:
+    // This is a raw string.  We first need to check if it belongs to a flag.
+    process_bare_string(data, arg, state->previous_long_flag,
+                        state->previous_flag);
+    state->previous_long_flag = NULL;
+    state->previous_flag = EOF;
+    break;
   }
-  iter.destroy(&iter);
-  return retVal;
 }
 
 /*******************************************************************************
@@ -170,6 +286,11 @@ void arg_data_init(smb_ad *data)
   data->long_flags = ll_create();
   data->long_flag_strings = ll_create();
   data->bare_strings = ll_create();
+  data->long_flag_index = ht_create(ht_string_hash, data_compare_string);
+  data->long_flag_params = ht_create(ht_string_hash, data_compare_string);
+  data->bare_string_index = ht_create(ht_string_hash, data_compare_string);
+  data->response_strings = NULL;
+  data->response_files = false;
   return;
 }
 
@@ -185,6 +306,12 @@ void arg_data_destroy(smb_ad * data)
   ll_delete(data->long_flags);
   ll_delete(data->bare_strings);
   ll_delete(data->long_flag_strings);
+  ht_delete(data->long_flag_index);
+  ht_delete(data->long_flag_params);
+  ht_delete(data->bare_string_index);
+  if (data->response_strings) {
+    arena_delete(data->response_strings);
+  }
 }
 
 void arg_data_delete(smb_ad *data)
@@ -195,46 +322,12 @@ void arg_data_delete(smb_ad *data)
 
 void process_args(smb_ad *data, int argc, char **argv)
 {
-  char *previous_long_flag = NULL;
-  int previous_flag = EOF;
+  ad_state state = {NULL, EOF};
 
   while (argc--) {
     // At the beginning of the loop, argc refers to number of remaining args,
     // and argv points at the pointer to the current arg.
-    switch (**argv) {
-    case '-':
-      // Processing new flag type, so set previous variables to invalid.
-      previous_long_flag = NULL;
-      previous_flag = EOF;
-      switch (*(*argv + 1)) {
-      case '-':
-        // Long flag
-        previous_long_flag = process_long_flag(data, *argv);
-        previous_flag = EOF;
-        break;
-      case '\0':
-        // A single '-'...counts as a bare string in my book
-        process_bare_string(data, *argv, previous_long_flag, previous_flag);
-
-        previous_long_flag = NULL;
-        previous_flag = EOF;
-        break;
-      default:
-        // The input is a short flag
-        previous_flag = process_flag(data, *argv);
-        previous_long_flag = NULL;
-        break;
-      }
-      break;
-
-    default:
-      // This is a raw string.  We first need to check if it belongs to a flag.
-      process_bare_string(data, *argv, previous_long_flag, previous_flag);
-      previous_long_flag = NULL;
-      previous_flag = EOF;
-      break;
-    }
-
+    process_arg(data, *argv, &state, 0);
     argv++;
   }
 }
@@ -254,12 +347,12 @@ int check_flag(smb_ad *pData, char flag)
 
 int check_long_flag(smb_ad *data, char *flag)
 {
-  return find_string(data->long_flags, flag) + 1;
+  return find_string(data->long_flag_index, flag) + 1;
 }
 
 int check_bare_string(smb_ad *data, char *string)
 {
-  return find_string(data->bare_strings, string) + 1;
+  return find_string(data->bare_string_index, string) + 1;
 }
 
 char *get_flag_parameter(smb_ad *data, char flag)
@@ -273,16 +366,11 @@ char *get_flag_parameter(smb_ad *data, char flag)
 
 char *get_long_flag_parameter(smb_ad *data, char *string)
 {
-  int index = find_string(data->long_flags, string);
-  if (index == -1)
-    return NULL;
-  else {
-    DATA d;
-    smb_status status;
-    d = ll_get(data->long_flag_strings, index, &status);
-    assert(status == SMB_SUCCESS);
-    return (char*)d.data_ptr;
-  }
+  DATA d;
+  smb_status status = SMB_SUCCESS;
+  d.data_ptr = string;
+  d = ht_get(data->long_flag_params, d, &status);
+  return status == SMB_SUCCESS ? (char*)d.data_ptr : NULL;
 }
 
 void ad_print(smb_ad *data, FILE *f)
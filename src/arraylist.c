@@ -13,13 +13,14 @@
 
 *******************************************************************************/
 
-#include <stdlib.h>      /* memcpy    */
+#include <stdlib.h>
+#include <string.h>      /* memcpy, memmove */
 
 #include "libstephen/al.h"
 
 /**
-   @brief The default size that an array list is allocated with, and is added to
-   the capacity each time it expands.
+   @brief The default size that an array list is allocated with, and the least
+   that is added to the capacity each time it expands.
 */
 #define SMB_AL_BLOCK_SIZE 20
 
@@ -30,18 +31,29 @@
 *******************************************************************************/
 
 /**
-   @brief Expands the smb_al by adding anothur chunk of the default size.
+   @brief Expands the smb_al until it can hold at least needed items.
+
+   The capacity is multiplied by the list's growth factor (but grows by at least
+   SMB_AL_BLOCK_SIZE), so appending n items copies each one a constant number
+   of times on average.
 
    Note that this is a *private* function, not defined in libstephen.h for a
    reason.
 
    @param list The list to expand.
-   @param[out] status Status variable.
+   @param needed The number of items it must be able to hold.
  */
-void al_expand(smb_al *list)
+void al_expand(smb_al *list, int needed)
 {
-  list->allocated = list->allocated + SMB_AL_BLOCK_SIZE;
-  list->data = smb_renew(DATA, list->data, list->allocated);
+  int allocated = list->allocated;
+  while (allocated < needed) {
+    int grown = (int) (allocated * list->growth);
+    allocated = grown > allocated + SMB_AL_BLOCK_SIZE ?
+      grown : allocated + SMB_AL_BLOCK_SIZE;
+  }
+  list->data = smb_realloc(list->alloc, DATA, list->data, list->allocated,
+                           allocated);
+  list->allocated = allocated;
 }
 
 /**
@@ -62,14 +74,11 @@ void al_shift_up(smb_al *list, int from_index)
 {
   // Check if there's space and allocate more if necessary
   if (list->length >= list->allocated) {
-    al_expand(list);
-  }
-
-  // Starting at the last element in the array, shift up by one
-  for (int i = list->length - 1; i >= from_index; i--) {
-    list->data[i + 1] = list->data[i];
+    al_expand(list, list->length + 1);
   }
 
+  memmove(&list->data[from_index + 1], &list->data[from_index],
+          (list->length - from_index) * sizeof(DATA));
   list->length++;
 }
 
@@ -89,10 +98,8 @@ void al_shift_up(smb_al *list, int from_index)
  */
 void al_shift_down(smb_al *list, int to_index)
 {
-  for (int i = to_index + 1; i < list->length; i++) {
-    list->data[i - 1] = list->data[i];
-  }
-
+  memmove(&list->data[to_index], &list->data[to_index + 1],
+          (list->length - to_index - 1) * sizeof(DATA));
   list->length--;
 }
 
@@ -104,9 +111,16 @@ void al_shift_down(smb_al *list, int to_index)
 
 void al_init(smb_al *list)
 {
-  list->data = smb_new(DATA, SMB_AL_BLOCK_SIZE);
+  al_init_alloc(list, NULL);
+}
+
+void al_init_alloc(smb_al *list, const smb_allocator *allocator)
+{
+  list->alloc = allocator;
+  list->data = smb_alloc(allocator, DATA, SMB_AL_BLOCK_SIZE);
   list->length = 0;
   list->allocated = SMB_AL_BLOCK_SIZE;
+  list->growth = SMB_AL_GROWTH;
 }
 
 smb_al *al_create()
@@ -118,7 +132,7 @@ smb_al *al_create()
 
 void al_destroy(smb_al *list)
 {
-  smb_free(list->data);
+  smb_dealloc(list->alloc, DATA, list->data, list->allocated);
 }
 
 void al_delete(smb_al *list)
@@ -129,14 +143,57 @@ void al_delete(smb_al *list)
 
 void al_append(smb_al *list, DATA newData)
 {
-  if (list->length < list->allocated) {
-    list->data[list->length++] = newData;
-  } else {
-    al_expand(list);
-    list->data[list->length++] = newData;
+  if (list->length >= list->allocated) {
+    al_expand(list, list->length + 1);
+  }
+  list->data[list->length++] = newData;
+}
+
+void al_append_many(smb_al *list, const DATA *items, int n)
+{
+  al_reserve(list, list->length + n);
+  memcpy(&list->data[list->length], items, n * sizeof(DATA));
+  list->length += n;
+}
+
+void al_insert_many(smb_al *list, int index, const DATA *items, int n)
+{
+  if (index < 0) {
+    index = 0;
+  } else if (index > list->length) {
+    index = list->length;
+  }
+
+  al_reserve(list, list->length + n);
+  memmove(&list->data[index + n], &list->data[index],
+          (list->length - index) * sizeof(DATA));
+  memcpy(&list->data[index], items, n * sizeof(DATA));
+  list->length += n;
+}
+
+void al_reserve(smb_al *list, int n)
+{
+  if (n > list->allocated) {
+    al_expand(list, n);
   }
 }
 
+void al_shrink_to_fit(smb_al *list)
+{
+  // Keep room for one, so that the data is never a zero-size allocation.
+  int allocated = list->length > 0 ? list->length : 1;
+  if (allocated != list->allocated) {
+    list->data = smb_realloc(list->alloc, DATA, list->data, list->allocated,
+                             allocated);
+    list->allocated = allocated;
+  }
+}
+
+void al_set_growth(smb_al *list, double growth)
+{
+  list->growth = growth;
+}
+
 void al_prepend(smb_al *list, DATA newData)
 {
   al_shift_up(list, 0);
@@ -249,6 +306,26 @@ int al_index_of(const smb_al *list, DATA d, DATA_COMPARE comp)
   return -1;
 }
 
+void al_sort(smb_al *list, DATA_COMPARE cmp)
+{
+  data_sort(list->data, list->length, cmp);
+}
+
+void al_sort_parallel(smb_al *list, DATA_COMPARE cmp, int nthreads)
+{
+  data_sort_parallel(list->data, list->length, cmp, nthreads);
+}
+
+void al_sort_llint(smb_al *list)
+{
+  data_sort_llint(list->data, list->length);
+}
+
+void al_sort_dbl(smb_al *list)
+{
+  data_sort_dbl(list->data, list->length);
+}
+
 /**
    @brief Return the next item in the array list.
    @param iter The iterator being used.
@@ -275,6 +352,25 @@ bool al_iter_has_next(smb_iter *iter)
   return iter->index < al_length((const smb_al *)iter->ds);
 }
 
+/**
+   @brief Copy up to n of the next items in the array list.
+   @param iter The iterator being used.
+   @param buf Where to copy them.
+   @param n The most to copy.
+   @return The number copied.
+ */
+int al_iter_next_n(smb_iter *iter, DATA *buf, int n)
+{
+  const smb_al *list = iter->ds;
+  int left = list->length - iter->index;
+  if (n > left) {
+    n = left > 0 ? left : 0;
+  }
+  memcpy(buf, list->data + iter->index, n * sizeof(DATA));
+  iter->index += n;
+  return n;
+}
+
 /**
    @brief Free whatever resources are held by the iterator.
    @param iter The iterator to clean up.
@@ -306,7 +402,8 @@ smb_iter al_get_iter(const smb_al *list)
     .next = &al_iter_next,
     .has_next = &al_iter_has_next,
     .destroy = &al_iter_destroy,
-    .delete = &al_iter_delete
+    .delete = &al_iter_delete,
+    .next_n = &al_iter_next_n
   };
   return iter;
 }
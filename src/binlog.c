@@ -0,0 +1,723 @@
+/***************************************************************************//**
+
+  @file         binlog.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Implementation of "libstephen/binlog.h".
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  The encoder and decoder walk format strings with the same parser, so they
+  always agree on which arguments a message has.  The decoder prints each
+  conversion with snprintf(), after swapping its length modifier for the one
+  matching how the argument was stored, and its '*'s for the stored numbers.
+
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+#include "libstephen/binlog.h"
+#include "libstephen/cb.h"
+
+/**
+   @brief Record type of a site definition.
+ */
+#define BL_DEFINE 1
+/**
+   @brief Record type of a message.
+ */
+#define BL_MESSAGE 2
+
+/**
+   @brief The size of a message record before its arguments.
+ */
+#define BL_MESSAGE_HEADER (1 + 4 + 4 + 8 + 4)
+
+/**
+   @brief Marks the byte order of a stream.
+ */
+#define BL_BYTE_ORDER 0x01020304u
+
+/**
+   @brief The most sites a stream may define.  Ids come from a counter, so a
+   larger one can only come from a corrupt stream.
+ */
+#define BL_MAX_SITES (1u << 20)
+
+/**
+   @brief How much of a string or message the decoder reads at once.  Buffers
+   only grow as data actually arrives, so a corrupt length can't make the
+   decoder allocate more than the stream holds.
+ */
+#define BL_READ_CHUNK 4096
+
+/**
+   @brief The widest width or precision the decoder will format.  Larger ones
+   would have printf pad out gigabytes, so they're taken as corruption.
+ */
+#define BL_MAX_WIDTH 4096
+
+static const char bl_magic[4] = {'S', 'M', 'B', 'L'};
+
+/**
+   @brief The next id to give a site.  Ids are shared by every stream, so that
+   a site needs only one.
+ */
+static atomic_uint bl_next_id = 1;
+
+/**
+   @brief One conversion of a format string.
+ */
+typedef struct {
+  /**
+     @brief The conversion's text, from the '%' to past the conversion letter.
+   */
+  const char *start, *end;
+  /**
+     @brief The number of '*'s, each of which takes an int argument.
+   */
+  int stars;
+  /**
+     @brief The width written as digits, or -1 when there is none.  Like the
+     precision, it stops growing once it's past BL_MAX_WIDTH.
+   */
+  int width;
+  /**
+     @brief The precision: -1 when there is none, and -2 when it's a '*'.
+   */
+  int precision;
+  /**
+     @brief The length modifier ("hh", "l", ...), or "".
+   */
+  char length[3];
+  /**
+     @brief The conversion letter.
+   */
+  char conv;
+} bl_spec;
+
+/**
+   @brief How an argument is stored.
+ */
+enum bl_kind { BL_NONE, BL_SIGNED, BL_UNSIGNED, BL_DOUBLE, BL_STRING,
+               BL_POINTER, BL_SKIP, BL_UNKNOWN };
+
+/*******************************************************************************
+
+                               Private Functions
+
+*******************************************************************************/
+
+/**
+   @brief Parse the conversion starting at the '%' p points to.
+ */
+static void bl_parse_spec(const char *p, bl_spec *spec)
+{
+  int n = 0;
+  spec->start = p++;
+  spec->stars = 0;
+  spec->width = -1;
+  spec->precision = -1;
+
+  while (*p && strchr("-+ #0'", *p)) {
+    p++;
+  }
+  if (*p == '*') {
+    spec->stars++;
+    p++;
+  } else if (*p >= '0' && *p <= '9') {
+    spec->width = 0;
+    while (*p >= '0' && *p <= '9') {
+      if (spec->width <= BL_MAX_WIDTH) {
+        spec->width = spec->width * 10 + (*p - '0');
+      }
+      p++;
+    }
+  }
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      spec->stars++;
+      spec->precision = -2;
+      p++;
+    } else {
+      spec->precision = 0;
+      while (*p >= '0' && *p <= '9') {
+        if (spec->precision <= BL_MAX_WIDTH) {
+          spec->precision = spec->precision * 10 + (*p - '0');
+        }
+        p++;
+      }
+    }
+  }
+  while (n < 2 && *p && strchr("hljztL", *p) &&
+         (n == 0 || *p == spec->length[0])) {
+    spec->length[n++] = *p++;
+  }
+  spec->length[n] = '\0';
+  spec->conv = *p;
+  spec->end = *p ? p + 1 : p;
+}
+
+/**
+   @brief Return how a conversion's argument is stored.
+ */
+static enum bl_kind bl_kind_of(const bl_spec *spec)
+{
+  switch (spec->conv) {
+  case '%':
+    return BL_NONE;
+  case 'd': case 'i':
+    return BL_SIGNED;
+  case 'o': case 'u': case 'x': case 'X':
+    return BL_UNSIGNED;
+  case 'c':
+    return spec->length[0] == 'l' ? BL_STRING : BL_SIGNED;
+  case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a':
+  case 'A':
+    return BL_DOUBLE;
+  case 's': case 'm':
+    return BL_STRING;
+  case 'p':
+    return BL_POINTER;
+  case 'n':
+    return BL_SKIP;
+  default:
+    return BL_UNKNOWN;
+  }
+}
+
+static void bl_put(cbuf *cb, const void *data, size_t size)
+{
+  cb_append_n(cb, data, size);
+}
+
+static void bl_put_str(cbuf *cb, const char *str, size_t length)
+{
+  uint32_t n = length;
+  bl_put(cb, &n, sizeof(n));
+  bl_put(cb, str, length);
+}
+
+/**
+   @brief Fetch a signed integer argument, converted as printf would.
+ */
+static int64_t bl_signed_arg(const bl_spec *spec, va_list *va)
+{
+  const char *l = spec->length;
+  if (spec->conv == 'c') return (unsigned char)va_arg(*va, int);
+  if (!strcmp(l, "hh"))  return (signed char)va_arg(*va, int);
+  if (!strcmp(l, "h"))   return (short)va_arg(*va, int);
+  if (!strcmp(l, "l"))   return va_arg(*va, long);
+  if (!strcmp(l, "ll"))  return va_arg(*va, long long);
+  if (!strcmp(l, "j"))   return va_arg(*va, intmax_t);
+  if (!strcmp(l, "z"))   return (int64_t)va_arg(*va, size_t);
+  if (!strcmp(l, "t"))   return va_arg(*va, ptrdiff_t);
+  return va_arg(*va, int);
+}
+
+/**
+   @brief Fetch an unsigned integer argument, converted as printf would.
+ */
+static uint64_t bl_unsigned_arg(const bl_spec *spec, va_list *va)
+{
+  const char *l = spec->length;
+  if (!strcmp(l, "hh"))  return (unsigned char)va_arg(*va, unsigned int);
+  if (!strcmp(l, "h"))   return (unsigned short)va_arg(*va, unsigned int);
+  if (!strcmp(l, "l"))   return va_arg(*va, unsigned long);
+  if (!strcmp(l, "ll"))  return va_arg(*va, unsigned long long);
+  if (!strcmp(l, "j"))   return va_arg(*va, uintmax_t);
+  if (!strcmp(l, "z"))   return va_arg(*va, size_t);
+  if (!strcmp(l, "t"))   return (uint64_t)va_arg(*va, ptrdiff_t);
+  return va_arg(*va, unsigned int);
+}
+
+/**
+   @brief Store a string argument: multibyte strings are copied up to their
+   precision, and the others are converted by snprintf().
+ */
+static void bl_put_string(cbuf *cb, const bl_spec *spec, int precision,
+                          va_list *va)
+{
+  char local[256];
+  cbuf tmp;
+  const char *str;
+
+  if (spec->conv == 's' && spec->length[0] != 'l') {
+    str = va_arg(*va, const char *);
+    if (!str) {
+      str = "(null)";
+    }
+    bl_put_str(cb, str, precision >= 0 ? strnlen(str, precision) : strlen(str));
+    return;
+  }
+
+  cb_init_local(&tmp, local, sizeof(local));
+  if (spec->conv == 'm') {
+    cb_concat(&tmp, strerror(errno));
+  } else if (spec->conv == 'c') {
+    cb_printf(&tmp, "%lc", va_arg(*va, wint_t));
+  } else if (precision >= 0) {
+    cb_printf(&tmp, "%.*ls", precision, va_arg(*va, const wchar_t *));
+  } else {
+    cb_printf(&tmp, "%ls", va_arg(*va, const wchar_t *));
+  }
+  bl_put_str(cb, tmp.buf, tmp.length);
+  cb_destroy(&tmp);
+}
+
+/**
+   @brief Store the arguments of a format string.
+ */
+static void bl_put_args(cbuf *cb, const char *format, va_list *va)
+{
+  bl_spec spec;
+  int64_t i;
+  uint64_t u;
+  double d;
+  int star, precision;
+
+  for (format = strchr(format, '%'); format; format = strchr(spec.end, '%')) {
+    bl_parse_spec(format, &spec);
+    enum bl_kind kind = bl_kind_of(&spec);
+    if (kind == BL_UNKNOWN) {
+      return;
+    }
+
+    precision = spec.precision;
+    for (star = 0; star < spec.stars; star++) {
+      i = va_arg(*va, int);
+      bl_put(cb, &i, sizeof(i));
+      if (star == spec.stars - 1 && spec.precision == -2) {
+        precision = i;
+      }
+    }
+
+    switch (kind) {
+    case BL_SIGNED:
+      i = bl_signed_arg(&spec, va);
+      bl_put(cb, &i, sizeof(i));
+      break;
+    case BL_UNSIGNED:
+      u = bl_unsigned_arg(&spec, va);
+      bl_put(cb, &u, sizeof(u));
+      break;
+    case BL_DOUBLE:
+      d = spec.length[0] == 'L' ? (double)va_arg(*va, long double)
+                                : va_arg(*va, double);
+      bl_put(cb, &d, sizeof(d));
+      break;
+    case BL_STRING:
+      bl_put_string(cb, &spec, precision, va);
+      break;
+    case BL_POINTER:
+      u = (uintptr_t)va_arg(*va, void *);
+      bl_put(cb, &u, sizeof(u));
+      break;
+    case BL_SKIP:
+      (void)va_arg(*va, void *);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/**
+   @brief Return a site's id, giving it one if it has none yet.
+ */
+static unsigned int bl_site_id(smb_binlog_site *site)
+{
+  unsigned int id = atomic_load(&site->id);
+  if (id == 0) {
+    unsigned int fresh = atomic_fetch_add(&bl_next_id, 1);
+    // If another thread got there first, its id wins, and ours goes unused.
+    id = atomic_compare_exchange_strong(&site->id, &id, fresh) ? fresh : id;
+  }
+  return id;
+}
+
+/**
+   @brief Write a site's definition, unless the stream already has it.  The
+   lock must be held.
+ */
+static void bl_define(smb_binlog *obj, smb_binlog_site *site, unsigned int id,
+                      const char *format)
+{
+  char local[256];
+  cbuf cb;
+  uint8_t type = BL_DEFINE;
+  int32_t line = site->line;
+
+  if (id < obj->ndefined && obj->defined[id]) {
+    return;
+  }
+  if (id >= obj->ndefined) {
+    unsigned int n = obj->ndefined ? obj->ndefined : 64;
+    while (n <= id) {
+      n *= 2;
+    }
+    obj->defined = smb_renew(bool, obj->defined, n);
+    memset(obj->defined + obj->ndefined, 0, n - obj->ndefined);
+    obj->ndefined = n;
+  }
+  obj->defined[id] = true;
+
+  cb_init_local(&cb, local, sizeof(local));
+  bl_put(&cb, &type, sizeof(type));
+  bl_put(&cb, &id, sizeof(uint32_t));
+  bl_put(&cb, &line, sizeof(line));
+  bl_put_str(&cb, format, strlen(format));
+  bl_put_str(&cb, site->file, strlen(site->file));
+  bl_put_str(&cb, site->function, strlen(site->function));
+  fwrite(cb.buf, 1, cb.length, obj->dst);
+  cb_destroy(&cb);
+}
+
+/**
+   @brief Read exactly size bytes from a stream, or fail.
+ */
+static bool bl_get(FILE *in, void *dst, size_t size)
+{
+  return fread(dst, 1, size, in) == size;
+}
+
+/**
+   @brief Read n bytes from a stream into a heap buffer, with room for one more
+   after them.  The buffer grows a chunk at a time as the bytes are read.
+   @param buf The buffer to reuse (may be NULL).
+   @returns The buffer, or NULL (having freed it) if the stream ends first.
+ */
+static char *bl_get_buf(FILE *in, char *buf, size_t n)
+{
+  size_t have = 0, chunk;
+  while (have < n) {
+    chunk = n - have < BL_READ_CHUNK ? n - have : BL_READ_CHUNK;
+    buf = smb_renew(char, buf, have + chunk + 1);
+    if (!bl_get(in, buf + have, chunk)) {
+      smb_free(buf);
+      return NULL;
+    }
+    have += chunk;
+  }
+  return have ? buf : smb_renew(char, buf, 1);
+}
+
+/**
+   @brief Read a str from a stream into a new heap string.
+ */
+static char *bl_get_str(FILE *in)
+{
+  uint32_t n;
+  char *str;
+  if (!bl_get(in, &n, sizeof(n)) || !(str = bl_get_buf(in, NULL, n))) {
+    return NULL;
+  }
+  str[n] = '\0';
+  return str;
+}
+
+/**
+   @brief A site definition read by the decoder.
+ */
+typedef struct {
+  char *format, *file, *function;
+  int32_t line;
+} bl_def;
+
+/**
+   @brief Take the next size bytes of a message's arguments.
+ */
+static bool bl_take(const char **args, const char *end, void *dst, size_t size)
+{
+  if ((size_t)(end - *args) < size) {
+    return false;
+  }
+  memcpy(dst, *args, size);
+  *args += size;
+  return true;
+}
+
+/**
+   @brief Build the spec to print a stored argument with: the original text,
+   with the stored numbers for its '*'s, and its length modifier replaced.
+ */
+static void bl_decode_spec(const bl_spec *spec, const int64_t *stars,
+                           const char *length, char conv, cbuf *out)
+{
+  const char *p;
+  int star = 0;
+  for (p = spec->start; p < spec->end - 1 - strlen(spec->length); p++) {
+    if (*p == '*') {
+      cb_append_int(out, stars[star++]);
+    } else {
+      cb_append(out, *p);
+    }
+  }
+  cb_append_n(out, length, strlen(length));
+  cb_append(out, conv);
+}
+
+/**
+   @brief Render a message's format and stored arguments.
+   @returns Whether the arguments were all there.
+ */
+static bool bl_render(const char *format, const char *args, const char *end,
+                      cbuf *msg)
+{
+  char local[64];
+  cbuf fmt;
+  bl_spec spec;
+  int64_t stars[2], i;
+  uint64_t u;
+  double d;
+  uint32_t n;
+  const char *p = format;
+  bool ok = true;
+  int star;
+
+  cb_init_local(&fmt, local, sizeof(local));
+  while ((format = strchr(p, '%'))) {
+    cb_append_n(msg, p, format - p);
+    bl_parse_spec(format, &spec);
+    enum bl_kind kind = bl_kind_of(&spec);
+    p = spec.end;
+
+    if (kind == BL_UNKNOWN) {
+      p = format;
+      break;
+    } else if (kind == BL_NONE) {
+      cb_append(msg, '%');
+      continue;
+    } else if (kind == BL_SKIP) {
+      continue;
+    }
+
+    if (spec.width > BL_MAX_WIDTH || spec.precision > BL_MAX_WIDTH) {
+      ok = false;
+      goto out;
+    }
+    for (star = 0; star < spec.stars; star++) {
+      if (!bl_take(&args, end, &stars[star], sizeof(int64_t)) ||
+          stars[star] > BL_MAX_WIDTH || stars[star] < -BL_MAX_WIDTH) {
+        ok = false;
+        goto out;
+      }
+    }
+
+    cb_clear(&fmt);
+    switch (kind) {
+    case BL_SIGNED:
+      if (!(ok = bl_take(&args, end, &i, sizeof(i)))) goto out;
+      if (spec.conv == 'c') {
+        bl_decode_spec(&spec, stars, "", 'c', &fmt);
+        cb_printf(msg, fmt.buf, (int)i);
+      } else {
+        bl_decode_spec(&spec, stars, "ll", spec.conv, &fmt);
+        cb_printf(msg, fmt.buf, (long long)i);
+      }
+      break;
+    case BL_UNSIGNED:
+      if (!(ok = bl_take(&args, end, &u, sizeof(u)))) goto out;
+      bl_decode_spec(&spec, stars, "ll", spec.conv, &fmt);
+      cb_printf(msg, fmt.buf, (unsigned long long)u);
+      break;
+    case BL_DOUBLE:
+      if (!(ok = bl_take(&args, end, &d, sizeof(d)))) goto out;
+      bl_decode_spec(&spec, stars, "", spec.conv, &fmt);
+      cb_printf(msg, fmt.buf, d);
+      break;
+    case BL_STRING:
+      if (!(ok = bl_take(&args, end, &n, sizeof(n)) &&
+            (size_t)(end - args) >= n)) goto out;
+      {
+        char *str = smb_new(char, (size_t)n + 1);
+        memcpy(str, args, n);
+        str[n] = '\0';
+        args += n;
+        bl_decode_spec(&spec, stars, "", 's', &fmt);
+        cb_printf(msg, fmt.buf, str);
+        smb_free(str);
+      }
+      break;
+    case BL_POINTER:
+      if (!(ok = bl_take(&args, end, &u, sizeof(u)))) goto out;
+      bl_decode_spec(&spec, stars, "", 'p', &fmt);
+      cb_printf(msg, fmt.buf, (void *)(uintptr_t)u);
+      break;
+    default:
+      break;
+    }
+  }
+  cb_append_n(msg, p, strlen(p));
+
+out:
+  cb_destroy(&fmt);
+  return ok;
+}
+
+/*******************************************************************************
+
+                           Public Interface Functions
+
+*******************************************************************************/
+
+void bl_init(smb_binlog *obj, FILE *dst, int level)
+{
+  uint32_t version = BL_VERSION, order = BL_BYTE_ORDER;
+  obj->dst = dst;
+  obj->level = level;
+  pthread_mutex_init(&obj->lock, NULL);
+  obj->defined = NULL;
+  obj->ndefined = 0;
+  fwrite(bl_magic, 1, sizeof(bl_magic), dst);
+  fwrite(&version, sizeof(version), 1, dst);
+  fwrite(&order, sizeof(order), 1, dst);
+}
+
+smb_binlog *bl_create(FILE *dst, int level)
+{
+  smb_binlog *obj = smb_new(smb_binlog, 1);
+  bl_init(obj, dst, level);
+  return obj;
+}
+
+void bl_destroy(smb_binlog *obj)
+{
+  fflush(obj->dst);
+  pthread_mutex_destroy(&obj->lock);
+  smb_free(obj->defined);
+}
+
+void bl_delete(smb_binlog *obj)
+{
+  bl_destroy(obj);
+  smb_free(obj);
+}
+
+void bl_log(smb_binlog *obj, smb_binlog_site *site, int level,
+            const char *format, ...)
+{
+  char local[512];
+  cbuf cb;
+  va_list va;
+  struct timespec ts;
+  uint8_t type = BL_MESSAGE;
+  uint32_t id = bl_site_id(site), size = 0;
+  int32_t lvl = level;
+  uint64_t ns;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+
+  // The header's size is filled in once the arguments are stored.
+  cb_init_local(&cb, local, sizeof(local));
+  bl_put(&cb, &type, sizeof(type));
+  bl_put(&cb, &id, sizeof(id));
+  bl_put(&cb, &lvl, sizeof(lvl));
+  bl_put(&cb, &ns, sizeof(ns));
+  bl_put(&cb, &size, sizeof(size));
+  va_start(va, format);
+  bl_put_args(&cb, format, &va);
+  va_end(va);
+  size = cb.length - BL_MESSAGE_HEADER;
+  memcpy(cb.buf + BL_MESSAGE_HEADER - sizeof(size), &size, sizeof(size));
+
+  pthread_mutex_lock(&obj->lock);
+  bl_define(obj, site, id, format);
+  fwrite(cb.buf, 1, cb.length, obj->dst);
+  pthread_mutex_unlock(&obj->lock);
+  cb_destroy(&cb);
+}
+
+void bl_decode(FILE *in, FILE *out, smb_status *status)
+{
+  char magic[4], level_buf[SL_LEVEL_BUF];
+  uint32_t version, order, id, size;
+  bl_def *defs = NULL;
+  unsigned int ndefs = 0, i;
+  char *args = NULL;
+  cbuf msg;
+  uint8_t type;
+
+  *status = SMB_SUCCESS;
+  if (!bl_get(in, magic, sizeof(magic)) || memcmp(magic, bl_magic, 4) ||
+      !bl_get(in, &version, sizeof(version)) || version != BL_VERSION ||
+      !bl_get(in, &order, sizeof(order)) || order != BL_BYTE_ORDER) {
+    *status = SMB_IO_ERROR;
+    return;
+  }
+
+  cb_init(&msg, 256);
+  while (bl_get(in, &type, sizeof(type))) {
+    if (!bl_get(in, &id, sizeof(id))) {
+      goto error;
+    }
+
+    if (type == BL_DEFINE) {
+      if (id >= BL_MAX_SITES) {
+        goto error;
+      }
+      if (id >= ndefs) {
+        unsigned int n = ndefs ? ndefs : 64;
+        while (n <= id) {
+          n *= 2;
+        }
+        defs = smb_renew(bl_def, defs, n);
+        memset(defs + ndefs, 0, (n - ndefs) * sizeof(bl_def));
+        ndefs = n;
+      }
+      bl_def *def = &defs[id];
+      if (def->format || !bl_get(in, &def->line, sizeof(def->line)) ||
+          !(def->format = bl_get_str(in)) || !(def->file = bl_get_str(in)) ||
+          !(def->function = bl_get_str(in))) {
+        goto error;
+      }
+    } else if (type == BL_MESSAGE) {
+      int32_t level;
+      uint64_t ns;
+      if (id >= ndefs || !defs[id].format ||
+          !bl_get(in, &level, sizeof(level)) ||
+          !bl_get(in, &ns, sizeof(ns)) || !bl_get(in, &size, sizeof(size))) {
+        goto error;
+      }
+      if (!(args = bl_get_buf(in, args, size))) {
+        goto error;
+      }
+      cb_clear(&msg);
+      if (!bl_render(defs[id].format, args, args + size, &msg)) {
+        goto error;
+      }
+      fprintf(out, "%llu.%09llu %s:%d: (%s) %s: %s\n",
+              (unsigned long long)(ns / 1000000000u),
+              (unsigned long long)(ns % 1000000000u), defs[id].file,
+              defs[id].line, defs[id].function,
+              sl_level_string(level, level_buf), msg.buf);
+    } else {
+      goto error;
+    }
+  }
+  goto out;
+
+error:
+  *status = SMB_IO_ERROR;
+out:
+  for (i = 0; i < ndefs; i++) {
+    smb_free(defs[i].format);
+    smb_free(defs[i].file);
+    smb_free(defs[i].function);
+  }
+  smb_free(defs);
+  smb_free(args);
+  cb_destroy(&msg);
+}
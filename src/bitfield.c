@@ -11,11 +11,24 @@
   @copyright    Copyright (c) 2013-2016, Stephen Brennan.  Released under the
                 Revised BSD License.  See the LICENSE.txt file for details.
 
+  The bulk operations load bitfields 64 bits at a time, with memcpy(), since
+  they may be unaligned.  Bit i of a bitfield is bit i % 8 of byte i / 8, which
+  makes it bit i % 64 of a little endian word, so words are byte swapped on big
+  endian machines before their bits are searched.
+
 *******************************************************************************/
 
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BF_NEON
+#endif
+
 #include "libstephen/base.h"
 #include "libstephen/bf.h"
 
@@ -67,3 +80,159 @@ void bf_flip(unsigned char *data, int index) {
   unsigned char value = ~(data[byte_index] & bit_mask) & bit_mask;
   data[byte_index] = (data[byte_index] & ~bit_mask) | value;
 }
+
+/*******************************************************************************
+
+                               Bulk Operations
+
+*******************************************************************************/
+
+/**
+   @brief Load the 64 bits at p, so that bit i of the word is bit i from p.
+ */
+static uint64_t bf_load(const unsigned char *p)
+{
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  return word;
+}
+
+/**
+   @brief Load the last, partial word of a bitfield, from nbytes bytes.
+ */
+static uint64_t bf_load_tail(const unsigned char *p, int nbytes)
+{
+  unsigned char buf[8] = {0};
+  memcpy(buf, p, nbytes);
+  return bf_load(buf);
+}
+
+static int bf_popcount(uint64_t word)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(word);
+#else
+  int count;
+  for (count = 0; word; count++) {
+    word &= word - 1;
+  }
+  return count;
+#endif
+}
+
+static int bf_lowest(uint64_t word)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int i = 0;
+  while (!(word & 1)) {
+    word >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/*
+  Each set operation is the same loop: 16 bytes at a time with SIMD where it's
+  available, then 8 byte words, then single bytes.  Only the operator changes.
+ */
+#if defined(__SSE2__)
+#define BF_VECTOR_LOOP(sse, neon)                                         \
+  for (; i + 16 <= size; i += 16) {                                       \
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));                \
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));                \
+    _mm_storeu_si128((__m128i*)(dst + i), sse);                           \
+  }
+#elif defined(BF_NEON)
+#define BF_VECTOR_LOOP(sse, neon)                                         \
+  for (; i + 16 <= size; i += 16) {                                       \
+    uint8x16_t va = vld1q_u8(a + i), vb = vld1q_u8(b + i);                \
+    vst1q_u8(dst + i, neon);                                              \
+  }
+#else
+#define BF_VECTOR_LOOP(sse, neon)
+#endif
+
+#define BF_SET_OPERATION(name, op, sse, neon)                             \
+  void name(unsigned char *dst, const unsigned char *a,                   \
+            const unsigned char *b, int num_bools)                        \
+  {                                                                       \
+    int i = 0, size = SMB_BITFIELD_SIZE(num_bools);                       \
+    uint64_t wa, wb;                                                      \
+    BF_VECTOR_LOOP(sse, neon)                                             \
+    for (; i + 8 <= size; i += 8) {                                       \
+      memcpy(&wa, a + i, 8);                                              \
+      memcpy(&wb, b + i, 8);                                              \
+      wa = wa op wb;                                                      \
+      memcpy(dst + i, &wa, 8);                                            \
+    }                                                                     \
+    for (; i < size; i++) {                                               \
+      dst[i] = a[i] op b[i];                                              \
+    }                                                                     \
+  }
+
+BF_SET_OPERATION(bf_and, &, _mm_and_si128(va, vb), vandq_u8(va, vb))
+BF_SET_OPERATION(bf_or, |, _mm_or_si128(va, vb), vorrq_u8(va, vb))
+BF_SET_OPERATION(bf_xor, ^, _mm_xor_si128(va, vb), veorq_u8(va, vb))
+// _mm_andnot_si128() and vbicq_u8() take their operands in opposite orders.
+BF_SET_OPERATION(bf_andnot, & ~, _mm_andnot_si128(vb, va), vbicq_u8(va, vb))
+
+int bf_count(const unsigned char *data, int num_bools)
+{
+  int i, count = 0, full = num_bools / 64, rest = num_bools % 64;
+  for (i = 0; i < full; i++) {
+    count += bf_popcount(bf_load(data + 8 * i));
+  }
+  if (rest) {
+    uint64_t word = bf_load_tail(data + 8 * full, SMB_BITFIELD_SIZE(rest));
+    count += bf_popcount(word & ((UINT64_C(1) << rest) - 1));
+  }
+  return count;
+}
+
+/**
+   @brief Find the first bit at or after start which differs from invert.
+ */
+static int bf_next(const unsigned char *data, int num_bools, int start,
+                   uint64_t invert)
+{
+  int base = start - start % 64;
+  uint64_t word;
+
+  if (start < 0 || start >= num_bools) {
+    return -1;
+  }
+
+  for (; base < num_bools; base += 64) {
+    if (num_bools - base >= 64) {
+      word = bf_load(data + base / 8);
+    } else {
+      word = bf_load_tail(data + base / 8,
+                          SMB_BITFIELD_SIZE(num_bools - base));
+    }
+    word ^= invert;
+    if (base < start) {
+      word &= ~UINT64_C(0) << (start - base);
+    }
+    if (word) {
+      int index = base + bf_lowest(word);
+      return index < num_bools ? index : -1;
+    }
+  }
+  return -1;
+}
+
+int bf_next_set(const unsigned char *data, int num_bools, int start)
+{
+  return bf_next(data, num_bools, start, 0);
+}
+
+int bf_next_clear(const unsigned char *data, int num_bools, int start)
+{
+  return bf_next(data, num_bools, start, ~UINT64_C(0));
+}
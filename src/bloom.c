@@ -0,0 +1,228 @@
+/***************************************************************************//**
+
+  @file         bloom.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Implementation of "libstephen/bloom.h".
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <limits.h>
+#include <stdint.h>
+
+#include "libstephen/bf.h"
+#include "libstephen/bloom.h"
+
+/**
+   @brief The natural logarithm of 2.
+ */
+#define BLOOM_LN2 0.69314718055994530942
+
+/**
+   @brief The number of bits in a block.
+ */
+#define BLOOM_BLOCK_BITS (BLOOM_BLOCK * BIT_PER_CHAR)
+
+/*******************************************************************************
+
+                               Private Functions
+
+*******************************************************************************/
+
+/**
+   @brief Return the base 2 logarithm of a positive number, without libm.
+
+   The number is scaled into [0.5, 1) by powers of two, and the log of what's
+   left comes from the series ln x = 2 atanh((x - 1) / (x + 1)), whose argument
+   is then at most 1/3.
+ */
+static double bloom_log2(double x)
+{
+  double y, y2, term, sum = 0;
+  int exponent = 0, n;
+
+  while (x < 0.5) {
+    x *= 2;
+    exponent--;
+  }
+  while (x >= 1) {
+    x /= 2;
+    exponent++;
+  }
+  y = (x - 1) / (x + 1);
+  y2 = y * y;
+  term = y;
+  for (n = 1; n < 40; n += 2) {
+    sum += term / n;
+    term *= y2;
+  }
+  return exponent + 2 * sum / BLOOM_LN2;
+}
+
+/**
+   @brief Mix a 32 bit hash out to 64 bits.  This is the finalizer of
+   MurmurHash3's 64 bit variant.
+ */
+static uint64_t bloom_mix(uint64_t hash)
+{
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+   @brief Map a 32 bit value onto [0, n) with a multiply instead of a divide.
+ */
+static uint32_t bloom_range(uint32_t value, uint32_t n)
+{
+  return (uint32_t)(((uint64_t)value * n) >> 32);
+}
+
+/*******************************************************************************
+
+                           Public Interface Functions
+
+*******************************************************************************/
+
+void bloom_init(smb_bloom *obj, int capacity, double fp_rate,
+                HASH_FUNCTION hash, bool blocked)
+{
+  double bits_log, num_bits;
+  int granule = blocked ? BLOOM_BLOCK_BITS : BIT_PER_CHAR;
+
+  if (capacity < 1) {
+    capacity = 1;
+  }
+  if (!(fp_rate > 1e-12)) {
+    fp_rate = 1e-12;
+  } else if (fp_rate > 0.5) {
+    fp_rate = 0.5;
+  }
+
+  // For the best k, each key takes -log2(p) bits' worth of hashes, and the
+  // filter is half full at capacity, which works out to -log2(p) / ln 2 bits
+  // per key.
+  bits_log = -bloom_log2(fp_rate);
+  obj->k = (int)(bits_log + 0.5);
+  if (obj->k < 1) {
+    obj->k = 1;
+  } else if (obj->k > BLOOM_MAX_K) {
+    obj->k = BLOOM_MAX_K;
+  }
+  num_bits = capacity * bits_log / BLOOM_LN2;
+  if (num_bits > INT_MAX - BLOOM_BLOCK_BITS) {
+    num_bits = INT_MAX - BLOOM_BLOCK_BITS;
+  }
+  obj->num_bits = ((int)num_bits + granule) / granule * granule;
+
+  obj->blocked = blocked;
+  obj->hash = hash;
+  if (blocked) {
+    obj->alloc = smb_new(unsigned char,
+                         SMB_BITFIELD_SIZE(obj->num_bits) + BLOOM_BLOCK - 1);
+    obj->bits = obj->alloc + (-(uintptr_t)obj->alloc & (BLOOM_BLOCK - 1));
+    bf_init(obj->bits, obj->num_bits);
+  } else {
+    obj->alloc = obj->bits = bf_create(obj->num_bits);
+  }
+}
+
+smb_bloom *bloom_create(int capacity, double fp_rate, HASH_FUNCTION hash,
+                        bool blocked)
+{
+  smb_bloom *obj = smb_new(smb_bloom, 1);
+  bloom_init(obj, capacity, fp_rate, hash, blocked);
+  return obj;
+}
+
+void bloom_destroy(smb_bloom *obj)
+{
+  smb_free(obj->alloc);
+  obj->alloc = obj->bits = NULL;
+}
+
+void bloom_delete(smb_bloom *obj)
+{
+  bloom_destroy(obj);
+  smb_free(obj);
+}
+
+void bloom_add(smb_bloom *obj, DATA key)
+{
+  bloom_add_hash(obj, bloom_mix(obj->hash(key)));
+}
+
+bool bloom_check(const smb_bloom *obj, DATA key)
+{
+  return bloom_check_hash(obj, bloom_mix(obj->hash(key)));
+}
+
+/*
+  Both layouts make their bits from the hash by double hashing.  The standard
+  layout spreads h1 + i * h2 across the whole bitfield.  The blocked one uses
+  the low half of the hash to choose a block, and so makes its own pair from
+  the high half and a remix of the whole hash, using the top nine bits of each
+  step as an offset into the block's 512.  h2 is made odd, so that no step is
+  repeated when it's zero.
+ */
+
+void bloom_add_hash(smb_bloom *obj, uint64_t hash)
+{
+  uint32_t h1, h2;
+  int i, base = 0, n = obj->num_bits;
+
+  if (obj->blocked) {
+    base = bloom_range(hash, n / BLOOM_BLOCK_BITS) * BLOOM_BLOCK_BITS;
+    h1 = hash >> 32;
+    h2 = (uint32_t)((hash * 0x9e3779b97f4a7c15ull) >> 32) | 1;
+    for (i = 0; i < obj->k; i++) {
+      bf_set(obj->bits, base + ((h1 + i * h2) >> 23));
+    }
+  } else {
+    h1 = hash;
+    h2 = (hash >> 32) | 1;
+    for (i = 0; i < obj->k; i++) {
+      bf_set(obj->bits, bloom_range(h1 + i * h2, n));
+    }
+  }
+}
+
+bool bloom_check_hash(const smb_bloom *obj, uint64_t hash)
+{
+  uint32_t h1, h2;
+  int i, base = 0, n = obj->num_bits;
+
+  if (obj->blocked) {
+    base = bloom_range(hash, n / BLOOM_BLOCK_BITS) * BLOOM_BLOCK_BITS;
+    h1 = hash >> 32;
+    h2 = (uint32_t)((hash * 0x9e3779b97f4a7c15ull) >> 32) | 1;
+    for (i = 0; i < obj->k; i++) {
+      if (!bf_check(obj->bits, base + ((h1 + i * h2) >> 23))) {
+        return false;
+      }
+    }
+  } else {
+    h1 = hash;
+    h2 = (hash >> 32) | 1;
+    for (i = 0; i < obj->k; i++) {
+      if (!bf_check(obj->bits, bloom_range(h1 + i * h2, n))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void bloom_clear(smb_bloom *obj)
+{
+  bf_init(obj->bits, obj->num_bits);
+}
@@ -13,6 +13,9 @@
 
 *******************************************************************************/
 
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <stdarg.h>
 #include <wchar.h>
 #include <string.h>
@@ -27,12 +30,29 @@
 *******************************************************************************/
 
 void cb_init(cbuf *obj, int capacity)
+{
+  cb_init_alloc(obj, capacity, NULL);
+}
+
+void cb_init_alloc(cbuf *obj, int capacity, const smb_allocator *allocator)
 {
   // Initialization logic
-  obj->buf = smb_new(char, capacity);
+  obj->buf = smb_alloc(allocator, char, capacity);
   obj->buf[0] = '\0';
   obj->capacity = capacity;
   obj->length = 0;
+  obj->local = NULL;
+  obj->alloc = allocator;
+}
+
+void cb_init_local(cbuf *obj, char *local, int capacity)
+{
+  obj->buf = local;
+  obj->buf[0] = '\0';
+  obj->capacity = capacity;
+  obj->length = 0;
+  obj->local = local;
+  obj->alloc = NULL;
 }
 
 cbuf *cb_create(int capacity)
@@ -44,7 +64,9 @@ cbuf *cb_create(int capacity)
 
 void cb_destroy(cbuf *obj)
 {
-  smb_free(obj->buf);
+  if (obj->buf != obj->local) {
+    smb_dealloc(obj->alloc, char, obj->buf, obj->capacity);
+  }
   obj->buf = NULL;
 }
 
@@ -53,6 +75,23 @@ void cb_delete(cbuf *obj) {
   smb_free(obj);
 }
 
+/**
+   @brief Move the buffer's contents to the heap, if they're in local memory.
+   @param obj The cbuf.
+   @param capacity The size to allocate on the heap.
+ */
+static void cb_resize(cbuf *obj, int capacity)
+{
+  if (obj->buf == obj->local) {
+    char *heap = smb_alloc(obj->alloc, char, capacity);
+    memcpy(heap, obj->buf, obj->length + 1);
+    obj->buf = heap;
+  } else {
+    obj->buf = smb_realloc(obj->alloc, char, obj->buf, obj->capacity, capacity);
+  }
+  obj->capacity = capacity;
+}
+
 /**
    @brief Ensure that the cbuf can fit a certain amount of characters.
    @param obj The cbuf to expand (if necessary).
@@ -66,20 +105,43 @@ static void cb_expand_to_fit(cbuf *obj, int minsize)
 {
   int newcapacity = obj->capacity;
   while (newcapacity < minsize) {
-    newcapacity *= 2;
+    newcapacity = newcapacity > INT_MAX / 2 ? minsize : newcapacity * 2;
   }
   if (newcapacity != obj->capacity) {
-    obj->buf = smb_renew(char, obj->buf, newcapacity);
-    obj->capacity = newcapacity;
+    cb_resize(obj, newcapacity);
   }
 }
 
 void cb_concat(cbuf *obj, char *buf)
 {
-  int length = strlen(buf);
-  cb_expand_to_fit(obj, obj->length + length + 1);
-  strcpy(obj->buf + obj->length, buf);
-  obj->length += length;
+  cb_append_n(obj, buf, strlen(buf));
+}
+
+void cb_append_n(cbuf *obj, const char *str, int n)
+{
+  cb_expand_to_fit(obj, obj->length + n + 1);
+  memcpy(obj->buf + obj->length, str, n);
+  obj->length += n;
+  obj->buf[obj->length] = '\0';
+}
+
+void cb_reserve(cbuf *obj, int n)
+{
+  cb_expand_to_fit(obj, obj->length + n + 1);
+}
+
+char *cb_steal(cbuf *obj)
+{
+  char *str = obj->buf;
+  if (str == obj->local || obj->alloc) {
+    str = smb_new(char, obj->length + 1);
+    memcpy(str, obj->buf, obj->length + 1);
+    if (obj->buf != obj->local) {
+      smb_dealloc(obj->alloc, char, obj->buf, obj->capacity);
+    }
+  }
+  obj->buf = NULL;
+  return str;
 }
 
 void cb_append(cbuf *obj, char next)
@@ -92,8 +154,7 @@ void cb_append(cbuf *obj, char next)
 
 void cb_trim(cbuf *obj)
 {
-  obj->buf = smb_renew(char, obj->buf, obj->length + 1);
-  obj->capacity = obj->length + 1;
+  cb_resize(obj, obj->length + 1);
 }
 
 void cb_clear(cbuf *obj)
@@ -105,18 +166,29 @@ void cb_clear(cbuf *obj)
 void cb_vprintf(cbuf *obj, char *format, va_list va)
 {
   va_list v2;
-  int length;
+  int length, room = obj->capacity - obj->length;
   va_copy(v2, va);
 
-  // Find the length of the formatted string.
-  length = vsnprintf(NULL, 0, format, va);
-
-  // Make sure we have enough room for everything.
-  cb_expand_to_fit(obj, obj->length + length + 1);
-
-  // Put the formatted string into the buffer.
-  vsnprintf(obj->buf + obj->length, length + 1, format, v2);
+  // Usually the formatted string fits in the room left, and one pass is all it
+  // takes.  If not, we at least know how much room it needs the second time.
+  length = vsnprintf(obj->buf + obj->length, room, format, va);
+  if (length >= room) {
+    // The total has to fit in an int, like the rest of the buffer's sizes.
+    if ((size_t)obj->length + (size_t)length + 1 > INT_MAX) {
+      obj->buf[obj->length] = '\0';
+      va_end(v2);
+      return;
+    }
+    cb_expand_to_fit(obj, obj->length + length + 1);
+    vsnprintf(obj->buf + obj->length, length + 1, format, v2);
+  }
   va_end(v2);
+
+  if (length > 0) {
+    obj->length += length;
+  } else {
+    obj->buf[obj->length] = '\0';
+  }
 }
 
 void cb_printf(cbuf *obj, char *format, ...)
@@ -127,6 +199,76 @@ void cb_printf(cbuf *obj, char *format, ...)
   va_end(va);  // Have to va_stop() it when you're done using it.
 }
 
+void cb_append_uint(cbuf *obj, unsigned long long value)
+{
+  char digits[CB_UINT_DIGITS];
+  int i = CB_UINT_DIGITS;
+  do {
+    digits[--i] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  cb_append_n(obj, digits + i, CB_UINT_DIGITS - i);
+}
+
+void cb_append_int(cbuf *obj, long long value)
+{
+  if (value < 0) {
+    cb_append(obj, '-');
+    // Negate as unsigned, so that LLONG_MIN doesn't overflow.
+    cb_append_uint(obj, 0 - (unsigned long long)value);
+  } else {
+    cb_append_uint(obj, value);
+  }
+}
+
+void cb_append_dbl(cbuf *obj, double value, int precision)
+{
+  static const unsigned long long powers[CB_DBL_PRECISION + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL
+  };
+  double magnitude = value < 0 ? -value : value, scaled, rest, off;
+  unsigned long long n, frac;
+  char digits[CB_DBL_PRECISION];
+  int i;
+
+  // NaN, infinity, numbers too big to scale into 64 bits, and more digits than
+  // we round to are all left to printf.
+  if (precision < 0 || precision > CB_DBL_PRECISION ||
+      !(magnitude * powers[precision] < 1e19)) {
+    cb_printf(obj, "%.*f", precision, value);
+    return;
+  }
+
+  // Scaling can be off by an ulp, which only matters when it lands within an
+  // ulp of a half: then printf, working from the exact value, decides.
+  scaled = magnitude * powers[precision];
+  n = (unsigned long long)scaled;
+  rest = scaled - n;
+  off = rest < 0.5 ? 0.5 - rest : rest - 0.5;
+  if (off <= scaled * DBL_EPSILON) {
+    cb_printf(obj, "%.*f", precision, value);
+    return;
+  }
+  if (rest > 0.5) {
+    n++;
+  }
+
+  if (signbit(value)) {
+    cb_append(obj, '-');
+  }
+  cb_append_uint(obj, n / powers[precision]);
+  if (precision > 0) {
+    frac = n % powers[precision];
+    for (i = precision - 1; i >= 0; i--) {
+      digits[i] = '0' + frac % 10;
+      frac /= 10;
+    }
+    cb_append(obj, '.');
+    cb_append_n(obj, digits, precision);
+  }
+}
+
 /*******************************************************************************
 
                                 wcbuf Functions
@@ -140,6 +282,16 @@ void wcb_init(wcbuf *obj, int capacity)
   obj->buf[0] = L'\0';
   obj->capacity = capacity;
   obj->length = 0;
+  obj->local = NULL;
+}
+
+void wcb_init_local(wcbuf *obj, wchar_t *local, int capacity)
+{
+  obj->buf = local;
+  obj->buf[0] = L'\0';
+  obj->capacity = capacity;
+  obj->length = 0;
+  obj->local = local;
 }
 
 wcbuf *wcb_create(int capacity)
@@ -152,7 +304,9 @@ wcbuf *wcb_create(int capacity)
 void wcb_destroy(wcbuf *obj)
 {
   // Cleanup logic
-  smb_free(obj->buf);
+  if (obj->buf != obj->local) {
+    smb_free(obj->buf);
+  }
   obj->buf = NULL;
 }
 
@@ -162,6 +316,24 @@ void wcb_delete(wcbuf *obj)
   smb_free(obj);
 }
 
+/**
+   @brief Move the wide buffer's contents to the heap, if they're in local
+   memory.
+   @param obj The wcbuf.
+   @param capacity The number of characters to allocate on the heap.
+ */
+static void wcb_resize(wcbuf *obj, int capacity)
+{
+  if (obj->buf == obj->local) {
+    wchar_t *heap = smb_new(wchar_t, capacity);
+    wmemcpy(heap, obj->buf, obj->length + 1);
+    obj->buf = heap;
+  } else {
+    obj->buf = smb_renew(wchar_t, obj->buf, capacity);
+  }
+  obj->capacity = capacity;
+}
+
 /**
    @brief Ensure that the wcbuf can fit a certain amount of characters.
    @param obj The wcbuf to expand (if necessary).
@@ -178,17 +350,37 @@ static void wcb_expand_to_fit(wcbuf *obj, int minsize)
     newcapacity *= 2;
   }
   if (newcapacity != obj->capacity) {
-    obj->buf = smb_renew(wchar_t, obj->buf, newcapacity);
-    obj->capacity = newcapacity;
+    wcb_resize(obj, newcapacity);
   }
 }
 
 void wcb_concat(wcbuf *obj, wchar_t *str)
 {
-  int length = wcslen(str);
-  wcb_expand_to_fit(obj, obj->length + length + 1);
-  wcscpy(obj->buf + obj->length, str);
-  obj->length += length;
+  wcb_append_n(obj, str, wcslen(str));
+}
+
+void wcb_append_n(wcbuf *obj, const wchar_t *str, int n)
+{
+  wcb_expand_to_fit(obj, obj->length + n + 1);
+  wmemcpy(obj->buf + obj->length, str, n);
+  obj->length += n;
+  obj->buf[obj->length] = L'\0';
+}
+
+void wcb_reserve(wcbuf *obj, int n)
+{
+  wcb_expand_to_fit(obj, obj->length + n + 1);
+}
+
+wchar_t *wcb_steal(wcbuf *obj)
+{
+  wchar_t *str = obj->buf;
+  if (str == obj->local) {
+    str = smb_new(wchar_t, obj->length + 1);
+    wmemcpy(str, obj->buf, obj->length + 1);
+  }
+  obj->buf = NULL;
+  return str;
 }
 
 void wcb_append(wcbuf *obj, wchar_t next)
@@ -201,8 +393,7 @@ void wcb_append(wcbuf *obj, wchar_t next)
 
 void wcb_trim(wcbuf *obj)
 {
-  obj->buf = smb_renew(wchar_t, obj->buf, obj->length + 1);
-  obj->capacity = obj->length + 1;
+  wcb_resize(obj, obj->length + 1);
 }
 
 void wcb_clear(wcbuf *obj)
@@ -216,6 +407,19 @@ void wcb_vprintf(wcbuf *obj, wchar_t *format, va_list v1)
   va_list v2;
   char *mbformat, *mbout;
   size_t mbformat_len, mbout_len, wcout_len;
+  int length, room = obj->capacity - obj->length;
+
+  // Try formatting straight into the room left.  vswprintf() only says that
+  // the output didn't fit, not how much room it needs, so when it fails, the
+  // output's length is found by the slower path through multibyte strings.
+  va_copy(v2, v1);
+  length = vswprintf(obj->buf + obj->length, room, format, v2);
+  va_end(v2);
+  if (length >= 0) {
+    obj->length += length;
+    return;
+  }
+  obj->buf[obj->length] = L'\0';
 
   // First, convert the wide format string to a multibyte one.
   mbformat_len = wcstombs(NULL, format, 0);
@@ -13,11 +13,11 @@
 
 *******************************************************************************/
 
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "libstephen/ht.h"
-#include "libstephen/re.h" // nelem()
 
 /*******************************************************************************
 
@@ -25,120 +25,98 @@
 
 *******************************************************************************/
 
-unsigned int ht_primes[] = {
-  31, // 2^5
-  61,
-  127,
-  257,
-  509,
-  1021,
-  2053,
-  4093,
-  8191,
-  16381,
-  32771,
-  65537,
-  131071,
-  262147,
-  524287,
-  1048573,
-  2097143,
-  4194301,
-  8388617,
-  16777213,
-  33554467,
-  67108859,
-  134217757,
-  268435459,
-  536870909,
-  1073741827,
-  2147483647,
-  4294967291 // 2^32
-};
-
-int binary_search(unsigned int *array, int len, unsigned int value)
-{
-  int lo = 0, hi = len, mid;
-  while (lo < hi) {
-    mid = (lo + hi) / 2;
-    if (value <= array[mid]) {
-      hi = mid;
-    } else {
-      lo = mid + 1;
-    }
-  }
-  return lo;
-}
-
 /**
    @brief Returns the next hashtable size.
 
+   Tables are always a power of two in size, so that an index can be found with
+   a mask instead of a division.
+
    @param current The current size of the hash table.
    @returns The next size in the sequence for hash tables.
  */
 int ht_next_size(int current)
 {
-  int curridx = binary_search(ht_primes, nelem(ht_primes), current);
-  return ht_primes[curridx + 1];
+  return current * 2;
+}
+
+/**
+   @brief Mix the bits of a hash, so that every bit of it affects the low ones.
+
+   Only the low bits of a hash choose its slot in a power of two sized table,
+   and hash functions like the identity on integers, or pointers (whose low bits
+   are usually zero) would otherwise collide constantly.  This is the finalizer
+   of MurmurHash3.
+
+   @param hash The hash returned by the table's hash function.
+   @returns The mixed hash.
+ */
+unsigned int ht_mix_hash(unsigned int hash)
+{
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return hash;
 }
 
 /**
-   @brief Find the proper index for insertion into the table.
+   @brief Find the first slot for a hash which isn't full.
+
+   Used once we know the key isn't in the table.  The probe sequence is
+   triangular (offsets 1, 3, 6, 10, ...), which visits every slot of a power of
+   two sized table.
    @param obj Hash table object.
-   @param key Key we're inserting.
+   @param hash Mixed hash of the key we're inserting.
  */
-unsigned int ht_find_insert(const smb_ht *obj, DATA key)
+unsigned int ht_find_insert(const smb_ht *obj, unsigned int hash)
 {
-  unsigned int index = obj->hash(key) % obj->allocated;
+  unsigned int mask = obj->allocated - 1;
+  unsigned int index = hash & mask;
   unsigned int j = 1;
 
-  // Continue searching until we either find a non-full slot, or we find the key
-  // we're trying to insert.
-  // until (cell.mark != full || cell.key == key)
-  // while (cell.mark == full && cell.key != key)
-  while (obj->table[index].mark == HT_FULL &&
-         obj->equal(key, obj->table[index].key) != 0) {
-    // This is quadratic probing, but I'm avoiding squaring numbers:
-    // j:     1, 3, 5, 7,  9, 11, ..
-    // index: 0, 1, 4, 9, 16, 25, 36
-    index = (index + j) % obj->allocated;
-    j += 2;
+  while (obj->table[index].mark == HT_FULL) {
+    index = (index + j++) & mask;
   }
-
   return index;
 }
 
 /**
    @brief Find the proper index for retrieval from the table.
+
+   Each bucket keeps the hash of its key, so keys are only compared when the
+   hashes match.
    @param obj Hash table object.
    @param key Key we're looking up.
+   @param hash Mixed hash of the key.
  */
-unsigned int ht_find_retrieve(const smb_ht *obj, DATA key)
+unsigned int ht_find_retrieve(const smb_ht *obj, DATA key, unsigned int hash)
 {
-  unsigned int index = obj->hash(key) % obj->allocated;
+  unsigned int mask = obj->allocated - 1;
+  unsigned int index = hash & mask;
   unsigned int j = 1;
 
   // Continue searching until we either find an empty slot, or we find the key
-  // we're trying to insert.
-  // until (cell.mark == empty || cell.key == key)
-  // while (cell.mark != empty && cell.key != key)
+  // we're trying to insert.  Keys in gravestones aren't compared, since they
+  // may have been freed after they were removed.
+  // until (cell.mark == empty || (cell.mark == full && cell.key == key))
   while (obj->table[index].mark != HT_EMPTY &&
-         obj->equal(key, obj->table[index].key) != 0) {
-    // This is quadratic probing, but I'm avoiding squaring numbers:
-    // j:     1, 3, 5, 7,  9, 11, ..
-    // index: 0, 1, 4, 9, 16, 25, 36
-    index = (index + j) % obj->allocated;
-    j += 2;
+         (obj->table[index].mark == HT_GRAVE ||
+          obj->table[index].hash != hash ||
+          obj->equal(key, obj->table[index].key) != 0)) {
+    index = (index + j++) & mask;
   }
   return index;
 }
 
 /**
-   @brief Expand the hash table, adding increment to the capacity of the table.
+   @brief Move every item into a new table of the given size, leaving the
+   gravestones behind.
 
-   @param table The table to expand.
+   @param table The table to rebuild.
+   @param allocated The new size, a power of two.
  */
-void ht_resize(smb_ht *table)
+void ht_rebuild(smb_ht *table, unsigned int allocated)
 {
   smb_ht_bckt *old_table;
   unsigned int index, old_allocated;
@@ -146,22 +124,45 @@ void ht_resize(smb_ht *table)
   // Step one: allocate new space for the table
   old_table = table->table;
   old_allocated = table->allocated;
+  table->allocated = allocated;
   table->length = 0;
-  table->allocated = ht_next_size(old_allocated);
-  table->table = smb_new(smb_ht_bckt, table->allocated);
+  table->graves = 0;
+  table->table = smb_alloc(table->alloc, smb_ht_bckt, table->allocated);
 
   // Zero out the new block too.
   memset((void*)table->table, 0, table->allocated * sizeof(smb_ht_bckt));
 
-  // Step two, add the old items to the new table.
+  // Step two, add the old items to the new table.  Their keys are all
+  // different, and their hashes are kept, so they are just moved into place.
   for (index = 0; index < old_allocated; index++) {
     if (old_table[index].mark == HT_FULL) {
-      ht_insert(table, old_table[index].key, old_table[index].value);
+      table->table[ht_find_insert(table, old_table[index].hash)] =
+        old_table[index];
+      table->length++;
     }
   }
 
   // Step three: free old data.
-  smb_free(old_table);
+  smb_dealloc(table->alloc, smb_ht_bckt, old_table, old_allocated);
+}
+
+/**
+   @brief Rebuild the hash table once its full slots and gravestones reach the
+   maximum load factor.
+
+   The table grows if the full slots alone are more than half of the maximum
+   load.  Otherwise it is rebuilt at the same size without the gravestones, so a
+   table with many insertions and removals doesn't keep growing, and its probes
+   stay short.
+   @param table The table to expand.
+ */
+void ht_resize(smb_ht *table)
+{
+  if (table->length > table->allocated * HASH_TABLE_MAX_LOAD_FACTOR / 2) {
+    ht_rebuild(table, ht_next_size(table->allocated));
+  } else {
+    ht_rebuild(table, table->allocated);
+  }
 }
 
 /**
@@ -175,6 +176,19 @@ double ht_load_factor(smb_ht *table)
   return ((double) table->length) / ((double) table->allocated);
 }
 
+/**
+   @brief Return the fraction of slots which are full or gravestones.  Probes
+   only stop at empty slots, so this is what has to be kept low.
+
+   @param table The table to find the used fraction of.
+   @returns The used fraction of the hash table.
+ */
+double ht_used_factor(smb_ht *table)
+{
+  return ((double) (table->length + table->graves)) /
+    ((double) table->allocated);
+}
+
 /*******************************************************************************
 
                            Public Interface Functions
@@ -182,15 +196,23 @@ double ht_load_factor(smb_ht *table)
 *******************************************************************************/
 
 void ht_init(smb_ht *table, HASH_FUNCTION hash_func, DATA_COMPARE equal)
+{
+  ht_init_alloc(table, hash_func, equal, NULL);
+}
+
+void ht_init_alloc(smb_ht *table, HASH_FUNCTION hash_func, DATA_COMPARE equal,
+                   const smb_allocator *allocator)
 {
   // Initialize values
+  table->alloc = allocator;
   table->length = 0;
+  table->graves = 0;
   table->allocated = HASH_TABLE_INITIAL_SIZE;
   table->hash = hash_func;
   table->equal = equal;
 
   // Create the bucket list
-  table->table = smb_new(smb_ht_bckt, HASH_TABLE_INITIAL_SIZE);
+  table->table = smb_alloc(allocator, smb_ht_bckt, HASH_TABLE_INITIAL_SIZE);
 
   // Zero out the entries in the table so we don't get segmentation faults.
   memset((void*)table->table, 0, HASH_TABLE_INITIAL_SIZE * sizeof(smb_ht_bckt));
@@ -219,7 +241,7 @@ void ht_destroy_act(smb_ht *table, DATA_ACTION deleter)
   }
 
   // Delete the table.
-  smb_free(table->table);
+  smb_dealloc(table->alloc, smb_ht_bckt, table->table, table->allocated);
 }
 
 void ht_destroy(smb_ht *table)
@@ -242,34 +264,82 @@ void ht_delete(smb_ht *table)
   ht_delete_act(table, NULL);
 }
 
-void ht_insert(smb_ht *table, DATA key, DATA value)
+/**
+   @brief Insert a key whose mixed hash is already known.
+ */
+void ht_insert_hashed(smb_ht *table, DATA key, DATA value, unsigned int hash)
 {
   unsigned int index;
-  if (ht_load_factor(table) >= HASH_TABLE_MAX_LOAD_FACTOR) {
+  if (ht_used_factor(table) > HASH_TABLE_MAX_LOAD_FACTOR) {
     ht_resize(table);
   }
 
   // First, probe for the key as if we're trying to return it.  If we find it,
   // we update the existing key.
-  index = ht_find_retrieve(table, key);
+  index = ht_find_retrieve(table, key, hash);
   if (table->table[index].mark == HT_FULL) {
     table->table[index].value = value;
     return;
   }
 
   // If we don't find the key, then we find the first open slot or gravestone.
-  index = ht_find_insert(table, key);
+  index = ht_find_insert(table, hash);
+  if (table->table[index].mark == HT_GRAVE) {
+    table->graves--;
+  }
   table->table[index].key = key;
+  table->table[index].hash = hash;
   table->table[index].value = value;
   table->table[index].mark = HT_FULL;
   table->length++;
 }
 
+void ht_insert(smb_ht *table, DATA key, DATA value)
+{
+  ht_insert_hashed(table, key, value, ht_mix_hash(table->hash(key)));
+}
+
+void ht_reserve(smb_ht *table, unsigned int n)
+{
+  unsigned int allocated = table->allocated;
+  while (n > allocated * HASH_TABLE_MAX_LOAD_FACTOR) {
+    allocated = ht_next_size(allocated);
+  }
+  if (allocated != table->allocated) {
+    ht_rebuild(table, allocated);
+  }
+}
+
+void ht_insert_many(smb_ht *table, const DATA *keys, const DATA *values,
+                    unsigned int n)
+{
+  unsigned int hashes[HT_INSERT_BATCH];
+  unsigned int i, j, batch;
+
+  ht_reserve(table, table->length + table->graves + n);
+
+  // Hash a batch of keys and prefetch their first buckets, so that the cache
+  // misses of a batch overlap instead of happening one insertion at a time.
+  for (i = 0; i < n; i += batch) {
+    batch = n - i < HT_INSERT_BATCH ? n - i : HT_INSERT_BATCH;
+    for (j = 0; j < batch; j++) {
+      hashes[j] = ht_mix_hash(table->hash(keys[i + j]));
+#if defined(__GNUC__)
+      __builtin_prefetch(&table->table[hashes[j] & (table->allocated - 1)], 1);
+#endif
+    }
+    for (j = 0; j < batch; j++) {
+      ht_insert_hashed(table, keys[i + j], values[i + j], hashes[j]);
+    }
+  }
+}
+
 void ht_remove_act(smb_ht *table, DATA key, DATA_ACTION deleter,
                    smb_status *status)
 {
   *status = SMB_SUCCESS;
-  unsigned int index = ht_find_retrieve(table, key);
+  unsigned int index = ht_find_retrieve(table, key,
+                                       ht_mix_hash(table->hash(key)));
 
   // If the returned slot isn't full, that means we couldn't find it.
   if (table->table[index].mark != HT_FULL) {
@@ -285,6 +355,7 @@ void ht_remove_act(smb_ht *table, DATA key, DATA_ACTION deleter,
   // Mark the slot with a "grave stone", indicating it is deleted.
   table->table[index].mark = HT_GRAVE;
   table->length--;
+  table->graves++;
 }
 
 void ht_remove(smb_ht *table, DATA key, smb_status *status)
@@ -295,7 +366,8 @@ void ht_remove(smb_ht *table, DATA key, smb_status *status)
 DATA ht_get(smb_ht const *table, DATA key, smb_status *status)
 {
   *status = SMB_SUCCESS;
-  unsigned int index = ht_find_retrieve(table, key);
+  unsigned int index = ht_find_retrieve(table, key,
+                                       ht_mix_hash(table->hash(key)));
 
   // If the slot is not marked full, we didn't find the key.
   if (table->table[index].mark != HT_FULL) {
@@ -346,6 +418,22 @@ bool ht_iter_has_next(smb_iter *iter)
   return iter->index < (int)ht->length;
 }
 
+int ht_iter_next_n(smb_iter *iter, DATA *buf, int n)
+{
+  long long int i = iter->state.data_llint + 1;
+  const smb_ht *ht = iter->ds;
+  int count = 0;
+
+  for (; count < n && i < ht->allocated; i++) {
+    if (ht->table[i].mark == HT_FULL) {
+      buf[count++] = ht->table[i].key;
+    }
+  }
+  iter->state.data_llint = i - 1;
+  iter->index += count;
+  return count;
+}
+
 void ht_iter_destroy(smb_iter *iter)
 {
   (void)iter; //unused
@@ -369,23 +457,100 @@ smb_iter ht_get_iter(const smb_ht *ht)
     .next = &ht_iter_next,
     .has_next = &ht_iter_has_next,
     .destroy = &ht_iter_destroy,
-    .delete = &ht_iter_delete
+    .delete = &ht_iter_delete,
+    .next_n = &ht_iter_next_n
   };
   return iter;
 }
 
+/*
+  Primes from xxHash.
+ */
+#define HT_PRIME1 0x9E3779B185EBCA87ull
+#define HT_PRIME2 0xC2B2AE3D27D4EB4Full
+#define HT_PRIME3 0x165667B19E3779F9ull
+#define HT_PRIME4 0x85EBCA77C2B2AE63ull
+#define HT_PRIME5 0x27D4EB2F165667C5ull
+
+static uint64_t ht_rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+unsigned int ht_hash_bytes(const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  uint64_t hash = HT_PRIME5 + len;
+  uint64_t word;
+  uint32_t half;
+
+  // This is the short input path of XXH64, used for any length: a multiply
+  // and rotate per 8 bytes, then the tail, then a final mix.
+  while (len >= 8) {
+    memcpy(&word, p, sizeof(word));
+    hash ^= ht_rotl(word * HT_PRIME2, 31) * HT_PRIME1;
+    hash = ht_rotl(hash, 27) * HT_PRIME1 + HT_PRIME4;
+    p += 8;
+    len -= 8;
+  }
+  if (len >= 4) {
+    memcpy(&half, p, sizeof(half));
+    hash ^= (uint64_t)half * HT_PRIME1;
+    hash = ht_rotl(hash, 23) * HT_PRIME2 + HT_PRIME3;
+    p += 4;
+    len -= 4;
+  }
+  while (len > 0) {
+    hash ^= *p * HT_PRIME5;
+    hash = ht_rotl(hash, 11) * HT_PRIME1;
+    p++;
+    len--;
+  }
+
+  hash ^= hash >> 33;
+  hash *= HT_PRIME2;
+  hash ^= hash >> 29;
+  hash *= HT_PRIME3;
+  hash ^= hash >> 32;
+  return (unsigned int) hash;
+}
+
 unsigned int ht_string_hash(DATA data)
 {
   char *theString = (char *)data.data_ptr;
-  unsigned int hash = 0;
-
-  while (theString && *theString != '\0' ) {
-    hash = (hash << 5) - hash + *theString;
-    theString++;
+  if (!theString) {
+    return 0;
   }
+  return ht_hash_bytes(theString, strlen(theString));
+}
 
-  // printf("Hash of \"%s\": %u\n", (char*)data.data_ptr, hash);
-  return hash;
+void ht_stats(smb_ht const *table, smb_ht_stats *stats)
+{
+  unsigned int mask = table->allocated - 1;
+  unsigned int i, index, j, probe;
+  unsigned long long total = 0;
+
+  stats->length = table->length;
+  stats->allocated = table->allocated;
+  stats->graves = 0;
+  stats->max_probe = 0;
+  stats->bytes = table->allocated * sizeof(smb_ht_bckt);
+
+  for (i = 0; i < table->allocated; i++) {
+    if (table->table[i].mark == HT_GRAVE) {
+      stats->graves++;
+    } else if (table->table[i].mark == HT_FULL) {
+      index = table->table[i].hash & mask;
+      for (probe = 1, j = 1; index != i; probe++) {
+        index = (index + j++) & mask;
+      }
+      total += probe;
+      if (probe > stats->max_probe) {
+        stats->max_probe = probe;
+      }
+    }
+  }
+  stats->mean_probe = table->length ? (double) total / table->length : 0;
 }
 
 void ht_print(smb_ht const *table, int full_mode)
@@ -39,42 +39,45 @@ unsigned int convert_idx(const smb_hta *obj, unsigned int orig)
   return orig * item_size(obj);
 }
 
+unsigned int hta_stored_hash(const smb_hta *obj, unsigned int bufidx)
+{
+  unsigned int hash;
+  memcpy(&hash, obj->table + bufidx + HTA_HASH_OFFSET, sizeof(hash));
+  return hash;
+}
+
 /**
-   @brief Find the proper index for insertion into the table.
+   @brief Find the first slot for a hash which isn't full.
+
+   Used once we know the key isn't in the table.  The probe sequence is
+   triangular, which visits every slot of a power of two sized table.
    @param obj Hash table object.
-   @param key Key we're inserting.
+   @param hash Mixed hash of the key we're inserting.
  */
-unsigned int hta_find_insert(const smb_hta *obj, void *key)
+unsigned int hta_find_insert(const smb_hta *obj, unsigned int hash)
 {
-  unsigned int index = obj->hash(key) % obj->allocated;
-  unsigned int bufidx = convert_idx(obj, index);
+  unsigned int mask = obj->allocated - 1;
+  unsigned int index = hash & mask;
   unsigned int j = 1;
 
-  // Continue searching until we either find a non-full slot, or we find the key
-  // we're trying to insert.
-  // until (cell.mark != full || cell.key == key)
-  // while (cell.mark == full && cell.key != key)
-  while (HTA_MARK(obj, bufidx) == HT_FULL &&
-         obj->equal(key, obj->table + bufidx + HTA_KEY_OFFSET) != 0) {
-    // This is quadratic probing, but I'm avoiding squaring numbers:
-    // j:     1, 3, 5, 7,  9, 11, ..
-    // index: 0, 1, 4, 9, 16, 25, 36
-    index = (index + j) % obj->allocated;
-    j += 2;
-    bufidx = convert_idx(obj, index);
+  while (HTA_MARK(obj, convert_idx(obj, index)) == HT_FULL) {
+    index = (index + j++) & mask;
   }
-
   return index;
 }
 
 /**
    @brief Find the proper index for retrieval from the table.
+
+   Keys are only compared when the hash stored with them matches.
    @param obj Hash table object.
    @param key Key we're looking up.
+   @param hash Mixed hash of the key.
  */
-unsigned int hta_find_retrieve(const smb_hta *obj, void *key)
+unsigned int hta_find_retrieve(const smb_hta *obj, void *key, unsigned int hash)
 {
-  unsigned int index = obj->hash(key) % obj->allocated;
+  unsigned int mask = obj->allocated - 1;
+  unsigned int index = hash & mask;
   unsigned int bufidx = convert_idx(obj, index);
   unsigned int j = 1;
 
@@ -83,12 +86,9 @@ unsigned int hta_find_retrieve(const smb_hta *obj, void *key)
   // until (cell.mark == empty || cell.key == key)
   // while (cell.mark != empty && cell.key != key)
   while (HTA_MARK(obj, bufidx) != HT_EMPTY &&
-         obj->equal(key, obj->table + bufidx + HTA_KEY_OFFSET) != 0) {
-    // This is quadratic probing, but I'm avoiding squaring numbers:
-    // j:     1, 3, 5, 7,  9, 11, ..
-    // index: 0, 1, 4, 9, 16, 25, 36
-    index = (index + j) % obj->allocated;
-    j += 2;
+         (hta_stored_hash(obj, bufidx) != hash ||
+          obj->equal(key, obj->table + bufidx + HTA_KEY_OFFSET) != 0)) {
+    index = (index + j++) & mask;
     bufidx = convert_idx(obj, index);
   }
 
@@ -96,11 +96,12 @@ unsigned int hta_find_retrieve(const smb_hta *obj, void *key)
 }
 
 /**
-   @brief Expand the hash table, adding increment to the capacity of the table.
+   @brief Move every item into a new table of the given size.
 
-   @param table The table to expand.
+   @param table The table to rebuild.
+   @param allocated The new size, a power of two.
  */
-void hta_resize(smb_hta *table)
+void hta_rebuild(smb_hta *table, unsigned int allocated)
 {
   void *old_table;
   unsigned int index, old_allocated, bufidx;
@@ -109,15 +110,21 @@ void hta_resize(smb_hta *table)
   old_table = table->table;
   old_allocated = table->allocated;
   table->length = 0;
-  table->allocated = ht_next_size(old_allocated);
-  table->table = calloc(table->allocated, item_size(table));
+  table->graves = 0;
+  table->allocated = allocated;
+  table->table = smb_new(char, table->allocated * item_size(table));
+  memset(table->table, 0, table->allocated * item_size(table));
 
-  // Step two, add the old items to the new table.
+  // Step two, add the old items to the new table.  Their keys are all
+  // different, and their hashes are kept, so they are just copied into place.
   for (index = 0; index < old_allocated; index++) {
     bufidx = convert_idx(table, index);
     if (((int8_t*)old_table)[bufidx] == HT_FULL) {
-      hta_insert(table, old_table + bufidx + HTA_KEY_OFFSET,
-                 old_table + bufidx + HTA_KEY_OFFSET + table->value_size);
+      unsigned int hash;
+      memcpy(&hash, old_table + bufidx + HTA_HASH_OFFSET, sizeof(hash));
+      unsigned int newidx = convert_idx(table, hta_find_insert(table, hash));
+      memcpy(table->table + newidx, old_table + bufidx, item_size(table));
+      table->length++;
     }
   }
 
@@ -125,6 +132,23 @@ void hta_resize(smb_hta *table)
   smb_free(old_table);
 }
 
+/**
+   @brief Rebuild the hash table once its full slots and gravestones reach the
+   maximum load factor.
+
+   The table doubles if the full slots alone are more than half of the maximum
+   load.  Otherwise it is rebuilt at the same size without the gravestones.
+   @param table The table to expand.
+ */
+void hta_resize(smb_hta *table)
+{
+  if (table->length > table->allocated * HASH_TABLE_MAX_LOAD_FACTOR / 2) {
+    hta_rebuild(table, ht_next_size(table->allocated));
+  } else {
+    hta_rebuild(table, table->allocated);
+  }
+}
+
 /**
    @brief Return the load factor of a hash table.
 
@@ -136,6 +160,18 @@ double hta_load_factor(smb_hta *table)
   return ((double) table->length) / ((double) table->allocated);
 }
 
+/**
+   @brief Return the fraction of slots which are full or gravestones.
+
+   @param table The table to find the used fraction of.
+   @returns The used fraction of the hash table.
+ */
+double hta_used_factor(smb_hta *table)
+{
+  return ((double) (table->length + table->graves)) /
+    ((double) table->allocated);
+}
+
 /*******************************************************************************
 
                            Public Interface Functions
@@ -147,6 +183,7 @@ void hta_init(smb_hta *table, HTA_HASH hash_func, HTA_COMP equal,
 {
   // Initialize values
   table->length = 0;
+  table->graves = 0;
   table->allocated = HASH_TABLE_INITIAL_SIZE;
   table->key_size = key_size;
   table->value_size = value_size;
@@ -154,7 +191,8 @@ void hta_init(smb_hta *table, HTA_HASH hash_func, HTA_COMP equal,
   table->equal = equal;
 
   // Allocate table
-  table->table = calloc(HASH_TABLE_INITIAL_SIZE, item_size(table));
+  table->table = smb_new(char, HASH_TABLE_INITIAL_SIZE * item_size(table));
+  memset(table->table, 0, HASH_TABLE_INITIAL_SIZE * item_size(table));
 }
 
 smb_hta *hta_create(HTA_HASH hash_func, HTA_COMP equal,
@@ -184,14 +222,15 @@ void hta_delete(smb_hta *table)
 
 void hta_insert(smb_hta *table, void *key, void *value)
 {
-  unsigned int index, bufidx;
-  if (hta_load_factor(table) > HASH_TABLE_MAX_LOAD_FACTOR) {
+  unsigned int index, bufidx, hash;
+  if (hta_used_factor(table) > HASH_TABLE_MAX_LOAD_FACTOR) {
     hta_resize(table);
   }
 
   // First, probe for the key as if we're trying to return it.  If we find it,
   // we update the existing key.
-  index = hta_find_retrieve(table, key);
+  hash = ht_mix_hash(table->hash(key));
+  index = hta_find_retrieve(table, key, hash);
   bufidx = convert_idx(table, index);
   if (HTA_MARK(table, bufidx) == HT_FULL) {
     memcpy(table->table + bufidx + HTA_KEY_OFFSET + table->key_size, value,
@@ -200,19 +239,35 @@ void hta_insert(smb_hta *table, void *key, void *value)
   }
 
   // If we don't find the key, then we find the first open slot or gravestone.
-  index = hta_find_insert(table, key);
+  index = hta_find_insert(table, hash);
   bufidx = convert_idx(table, index);
+  if (HTA_MARK(table, bufidx) == HT_GRAVE) {
+    table->graves--;
+  }
   HTA_MARK(table, bufidx) = HT_FULL;
+  memcpy(table->table + bufidx + HTA_HASH_OFFSET, &hash, sizeof(hash));
   memcpy(table->table + bufidx + HTA_KEY_OFFSET, key, table->key_size);
   memcpy(table->table + bufidx + HTA_KEY_OFFSET + table->key_size, value,
          table->value_size);
   table->length++;
 }
 
+void hta_reserve(smb_hta *table, unsigned int n)
+{
+  unsigned int allocated = table->allocated;
+  while (n > allocated * HASH_TABLE_MAX_LOAD_FACTOR) {
+    allocated = ht_next_size(allocated);
+  }
+  if (allocated != table->allocated) {
+    hta_rebuild(table, allocated);
+  }
+}
+
 void hta_remove(smb_hta *table, void *key, smb_status *status)
 {
   *status = SMB_SUCCESS;
-  unsigned int index = hta_find_retrieve(table, key);
+  unsigned int index = hta_find_retrieve(table, key,
+                                         ht_mix_hash(table->hash(key)));
   unsigned int bufidx = convert_idx(table, index);
 
   // If the returned slot isn't full, that means we couldn't find it.
@@ -224,12 +279,14 @@ void hta_remove(smb_hta *table, void *key, smb_status *status)
   // Mark the slot with a "grave stone", indicating it is deleted.
   HTA_MARK(table, bufidx) = HT_GRAVE;
   table->length--;
+  table->graves++;
 }
 
 void *hta_get(smb_hta const *table, void *key, smb_status *status)
 {
   *status = SMB_SUCCESS;
-  unsigned int index = hta_find_retrieve(table, key);
+  unsigned int index = hta_find_retrieve(table, key,
+                                         ht_mix_hash(table->hash(key)));
   unsigned int bufidx = convert_idx(table, index);
 
   // If the slot is not marked full, we didn't find the key.
@@ -252,15 +309,10 @@ bool hta_contains(smb_hta const *table, void *key)
 unsigned int hta_string_hash(void *data)
 {
   char *theString = *(char**)data;
-  unsigned int hash = 0;
-
-  while (theString && *theString != '\0' ) {
-    hash = (hash << 5) - hash + *theString;
-    theString++;
+  if (!theString) {
+    return 0;
   }
-
-  // printf("Hash of \"%s\": %u\n", (char*)data.data_ptr, hash);
-  return hash;
+  return ht_hash_bytes(theString, strlen(theString));
 }
 
 int hta_string_comp(void *left, void *right)
@@ -275,6 +327,36 @@ int hta_int_comp(void *left, void *right)
   return *l - *r;
 }
 
+void hta_stats(smb_hta const *table, smb_ht_stats *stats)
+{
+  unsigned int mask = table->allocated - 1;
+  unsigned int i, index, j, probe;
+  unsigned long long total = 0;
+
+  stats->length = table->length;
+  stats->allocated = table->allocated;
+  stats->graves = 0;
+  stats->max_probe = 0;
+  stats->bytes = (size_t) table->allocated * item_size(table);
+
+  for (i = 0; i < table->allocated; i++) {
+    unsigned int bufidx = convert_idx(table, i);
+    if (HTA_MARK(table, bufidx) == HT_GRAVE) {
+      stats->graves++;
+    } else if (HTA_MARK(table, bufidx) == HT_FULL) {
+      index = hta_stored_hash(table, bufidx) & mask;
+      for (probe = 1, j = 1; index != i; probe++) {
+        index = (index + j++) & mask;
+      }
+      total += probe;
+      if (probe > stats->max_probe) {
+        stats->max_probe = probe;
+      }
+    }
+  }
+  stats->mean_probe = table->length ? (double) total / table->length : 0;
+}
+
 void hta_print(FILE* f, smb_hta const *table, HTA_PRINT key, HTA_PRINT value,
                int full_mode)
 {
@@ -0,0 +1,134 @@
+/***************************************************************************//**
+
+  @file         htc.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Implementation of "libstephen/htc.h".
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  Shards are chosen by the top bits of the mixed hash, since smb_hta uses the
+  low bits to find a slot.  Using the same bits for both would put every key of
+  a shard in the same few slots.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "libstephen/ht.h" // ht_mix_hash()
+#include "libstephen/htc.h"
+
+/*******************************************************************************
+
+                               Private Functions
+
+*******************************************************************************/
+
+static smb_htc_shard *htc_shard(smb_htc *table, void *key)
+{
+  unsigned int hash = ht_mix_hash(table->hash(key));
+  return &table->shards[(hash >> table->shift) & (table->nshards - 1)];
+}
+
+/*******************************************************************************
+
+                           Public Interface Functions
+
+*******************************************************************************/
+
+void htc_init(smb_htc *table, unsigned int nshards, HTA_HASH hash_func,
+              HTA_COMP equal, unsigned int key_size, unsigned int value_size)
+{
+  unsigned int i, bits = 0;
+
+  while ((1u << bits) < nshards) {
+    bits++;
+  }
+  table->nshards = 1u << bits;
+  table->shift = bits ? 32 - bits : 0;
+  table->hash = hash_func;
+  table->shards = smb_new(smb_htc_shard, table->nshards);
+  for (i = 0; i < table->nshards; i++) {
+    pthread_rwlock_init(&table->shards[i].lock, NULL);
+    hta_init(&table->shards[i].table, hash_func, equal, key_size, value_size);
+  }
+}
+
+smb_htc *htc_create(unsigned int nshards, HTA_HASH hash_func, HTA_COMP equal,
+                    unsigned int key_size, unsigned int value_size)
+{
+  smb_htc *table = smb_new(smb_htc, 1);
+  htc_init(table, nshards, hash_func, equal, key_size, value_size);
+  return table;
+}
+
+void htc_destroy(smb_htc *table)
+{
+  unsigned int i;
+  for (i = 0; i < table->nshards; i++) {
+    pthread_rwlock_destroy(&table->shards[i].lock);
+    hta_destroy(&table->shards[i].table);
+  }
+  smb_free(table->shards);
+}
+
+void htc_delete(smb_htc *table)
+{
+  if (!table) {
+    return;
+  }
+
+  htc_destroy(table);
+  smb_free(table);
+}
+
+void htc_insert(smb_htc *table, void *key, void *value)
+{
+  smb_htc_shard *shard = htc_shard(table, key);
+  pthread_rwlock_wrlock(&shard->lock);
+  hta_insert(&shard->table, key, value);
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+void htc_remove(smb_htc *table, void *key, smb_status *status)
+{
+  smb_htc_shard *shard = htc_shard(table, key);
+  pthread_rwlock_wrlock(&shard->lock);
+  hta_remove(&shard->table, key, status);
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+void htc_get(smb_htc *table, void *key, void *value, smb_status *status)
+{
+  smb_htc_shard *shard = htc_shard(table, key);
+  pthread_rwlock_rdlock(&shard->lock);
+  void *found = hta_get(&shard->table, key, status);
+  if (found) {
+    memcpy(value, found, shard->table.value_size);
+  }
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+bool htc_contains(smb_htc *table, void *key)
+{
+  smb_htc_shard *shard = htc_shard(table, key);
+  pthread_rwlock_rdlock(&shard->lock);
+  bool found = hta_contains(&shard->table, key);
+  pthread_rwlock_unlock(&shard->lock);
+  return found;
+}
+
+unsigned int htc_length(smb_htc *table)
+{
+  unsigned int i, length = 0;
+  for (i = 0; i < table->nshards; i++) {
+    pthread_rwlock_rdlock(&table->shards[i].lock);
+    length += table->shards[i].table.length;
+    pthread_rwlock_unlock(&table->shards[i].lock);
+  }
+  return length;
+}
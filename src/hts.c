@@ -0,0 +1,333 @@
+/***************************************************************************//**
+
+  @file         hts.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Implementation of "libstephen/hts.h".
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  A key's mixed hash is split in two.  The low 7 bits go in its slot's control
+  byte, and the rest choose the first group of HTS_GROUP slots to probe.
+  Groups are probed in a triangular sequence, which reaches every group, and a
+  probe stops at the first group with an empty slot in it, since the key would
+  have been put there.
+
+  A removed item's slot can be made empty again, instead of deleted, when its
+  group already has an empty slot: no probe ever went past that group.
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HTS_NEON
+#endif
+
+#include "libstephen/ht.h" // ht_mix_hash()
+#include "libstephen/hts.h"
+
+/*******************************************************************************
+
+                               Private Functions
+
+*******************************************************************************/
+
+static unsigned int item_size(const smb_hts *obj)
+{
+  return obj->key_size + obj->value_size;
+}
+
+static char *slot(const smb_hts *obj, unsigned int index)
+{
+  return (char*)obj->slots + index * item_size(obj);
+}
+
+/**
+   @brief The number of slots which may be filled before rehashing (7/8).
+ */
+static unsigned int max_load(unsigned int allocated)
+{
+  return allocated - allocated / 8;
+}
+
+#ifdef HTS_NEON
+/**
+   @brief Turn the result of a NEON comparison into a mask of one bit per slot.
+ */
+static unsigned int neon_mask(uint8x16_t matches)
+{
+  static const uint8_t bits[16] = {
+    1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+  };
+  uint8x16_t m = vandq_u8(matches, vld1q_u8(bits));
+  return vaddv_u8(vget_low_u8(m)) | (vaddv_u8(vget_high_u8(m)) << 8);
+}
+#endif
+
+/**
+   @brief Return a mask with bit i set when control byte i of a group is b.
+ */
+static unsigned int match_byte(const int8_t *group, int8_t b)
+{
+#if defined(__SSE2__)
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(b)));
+#elif defined(HTS_NEON)
+  return neon_mask(vceqq_s8(vld1q_s8(group), vdupq_n_s8(b)));
+#else
+  unsigned int mask = 0;
+  for (int i = 0; i < HTS_GROUP; i++) {
+    mask |= (unsigned int)(group[i] == b) << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+   @brief Return a mask of the slots in a group which are empty or deleted.
+   Both control bytes have the high bit set, and full ones don't.
+ */
+static unsigned int match_free(const int8_t *group)
+{
+#if defined(__SSE2__)
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#elif defined(HTS_NEON)
+  return neon_mask(vcltzq_s8(vld1q_s8(group)));
+#else
+  unsigned int mask = 0;
+  for (int i = 0; i < HTS_GROUP; i++) {
+    mask |= (unsigned int)(group[i] < 0) << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+   @brief Return the index of the lowest set bit of a non-zero mask.
+ */
+static unsigned int lowest(unsigned int mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  unsigned int i = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/**
+   @brief Find the slot holding a key.
+   @param obj Hash table object.
+   @param key Key we're looking up.
+   @param hash Mixed hash of the key.
+   @param[out] index The slot, if it was found.
+   @returns Whether the key was found.
+ */
+static bool hts_find(const smb_hts *obj, void *key, unsigned int hash,
+                     unsigned int *index)
+{
+  unsigned int gmask = obj->allocated / HTS_GROUP - 1;
+  unsigned int group = (hash >> 7) & gmask;
+  unsigned int j = 1;
+  int8_t h2 = hash & 0x7f;
+
+  while (true) {
+    const int8_t *ctrl = obj->ctrl + group * HTS_GROUP;
+    unsigned int matches = match_byte(ctrl, h2);
+    while (matches) {
+      unsigned int i = group * HTS_GROUP + lowest(matches);
+      if (obj->equal(key, slot(obj, i)) == 0) {
+        *index = i;
+        return true;
+      }
+      matches &= matches - 1;
+    }
+    if (match_byte(ctrl, HTS_EMPTY)) {
+      return false;
+    }
+    group = (group + j++) & gmask;
+  }
+}
+
+/**
+   @brief Find the first empty or deleted slot in a hash's probe sequence.
+   @param obj Hash table object.
+   @param hash Mixed hash of the key we're inserting.
+ */
+static unsigned int hts_find_free(const smb_hts *obj, unsigned int hash)
+{
+  unsigned int gmask = obj->allocated / HTS_GROUP - 1;
+  unsigned int group = (hash >> 7) & gmask;
+  unsigned int j = 1;
+
+  while (true) {
+    unsigned int free = match_free(obj->ctrl + group * HTS_GROUP);
+    if (free) {
+      return group * HTS_GROUP + lowest(free);
+    }
+    group = (group + j++) & gmask;
+  }
+}
+
+/**
+   @brief Allocate empty slots for a table.
+ */
+static void hts_alloc(smb_hts *table, unsigned int allocated)
+{
+  table->allocated = allocated;
+  table->growth_left = max_load(allocated) - table->length;
+  table->ctrl = smb_new(int8_t, allocated);
+  memset(table->ctrl, HTS_EMPTY, allocated);
+  table->slots = smb_new(char, allocated * item_size(table));
+}
+
+/**
+   @brief Move every item into new slots, dropping the deleted ones.  The table
+   doubles in size unless at least half of the filled slots were deleted.
+   @param table The table to rehash.
+ */
+static void hts_rehash(smb_hts *table)
+{
+  int8_t *old_ctrl = table->ctrl;
+  char *old_slots = table->slots;
+  unsigned int old_allocated = table->allocated, index;
+  unsigned int allocated = old_allocated;
+
+  if (table->length >= max_load(old_allocated) / 2) {
+    allocated *= 2;
+  }
+  hts_alloc(table, allocated);
+
+  for (index = 0; index < old_allocated; index++) {
+    if (old_ctrl[index] >= 0) {
+      char *item = old_slots + index * item_size(table);
+      unsigned int hash = ht_mix_hash(table->hash(item));
+      unsigned int newidx = hts_find_free(table, hash);
+      table->ctrl[newidx] = hash & 0x7f;
+      memcpy(slot(table, newidx), item, item_size(table));
+    }
+  }
+
+  smb_free(old_ctrl);
+  smb_free(old_slots);
+}
+
+/*******************************************************************************
+
+                           Public Interface Functions
+
+*******************************************************************************/
+
+void hts_init(smb_hts *table, HTA_HASH hash_func, HTA_COMP equal,
+              unsigned int key_size, unsigned int value_size)
+{
+  table->length = 0;
+  table->key_size = key_size;
+  table->value_size = value_size;
+  table->hash = hash_func;
+  table->equal = equal;
+  hts_alloc(table, HASH_TABLE_INITIAL_SIZE);
+}
+
+smb_hts *hts_create(HTA_HASH hash_func, HTA_COMP equal,
+                    unsigned int key_size, unsigned int value_size)
+{
+  smb_hts *table = smb_new(smb_hts, 1);
+  hts_init(table, hash_func, equal, key_size, value_size);
+  return table;
+}
+
+void hts_destroy(smb_hts *table)
+{
+  smb_free(table->ctrl);
+  smb_free(table->slots);
+}
+
+void hts_delete(smb_hts *table)
+{
+  if (!table) {
+    return;
+  }
+
+  hts_destroy(table);
+  smb_free(table);
+}
+
+void hts_insert(smb_hts *table, void *key, void *value)
+{
+  unsigned int hash = ht_mix_hash(table->hash(key));
+  unsigned int index;
+
+  if (hts_find(table, key, hash, &index)) {
+    memcpy(slot(table, index) + table->key_size, value, table->value_size);
+    return;
+  }
+
+  // Reusing a deleted slot is always fine.  Filling an empty one uses up some
+  // of the room left before the table has to be rehashed.
+  index = hts_find_free(table, hash);
+  if (table->ctrl[index] == HTS_EMPTY && table->growth_left == 0) {
+    hts_rehash(table);
+    index = hts_find_free(table, hash);
+  }
+  if (table->ctrl[index] == HTS_EMPTY) {
+    table->growth_left--;
+  }
+  table->ctrl[index] = hash & 0x7f;
+  memcpy(slot(table, index), key, table->key_size);
+  memcpy(slot(table, index) + table->key_size, value, table->value_size);
+  table->length++;
+}
+
+void hts_remove(smb_hts *table, void *key, smb_status *status)
+{
+  *status = SMB_SUCCESS;
+  unsigned int hash = ht_mix_hash(table->hash(key));
+  unsigned int index;
+
+  if (!hts_find(table, key, hash, &index)) {
+    *status = SMB_NOT_FOUND_ERROR;
+    return;
+  }
+
+  unsigned int group = index - index % HTS_GROUP;
+  if (match_byte(table->ctrl + group, HTS_EMPTY)) {
+    table->ctrl[index] = HTS_EMPTY;
+    table->growth_left++;
+  } else {
+    table->ctrl[index] = HTS_DELETED;
+  }
+  table->length--;
+}
+
+void *hts_get(smb_hts const *table, void *key, smb_status *status)
+{
+  *status = SMB_SUCCESS;
+  unsigned int index;
+
+  if (!hts_find(table, key, ht_mix_hash(table->hash(key)), &index)) {
+    *status = SMB_NOT_FOUND_ERROR;
+    return NULL;
+  }
+  return slot(table, index) + table->key_size;
+}
+
+bool hts_contains(smb_hts const *table, void *key)
+{
+  smb_status status = SMB_SUCCESS;
+  hts_get(table, key, &status);
+  return status == SMB_SUCCESS;
+}
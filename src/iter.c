@@ -19,18 +19,38 @@
 #include "libstephen/base.h"
 #include "libstephen/list.h"
 
+/**
+   @brief The number of elements iter_print() takes from an iterator at once.
+ */
+#define ITER_BATCH 32
+
 void iter_print(smb_iter it, FILE *f, DATA_PRINTER printer)
 {
-  DATA d;
-  smb_status status;
+  DATA batch[ITER_BATCH];
+  int i, n;
   fprintf(f, "smb_iter {\n");
-  while (it.has_next(&it)) {
-    d = it.next(&it, &status);
+  do {
+    n = iter_next_n(&it, batch, ITER_BATCH);
+    for (i = 0; i < n; i++) {
+      printer(f, batch[i]);
+      fprintf(f, ",\n");
+    }
+  } while (n == ITER_BATCH);
+  it.destroy(&it);
+  fprintf(f, "}\n");
+}
+
+int iter_next_n(smb_iter *it, DATA *buf, int n)
+{
+  smb_status status = SMB_SUCCESS;
+  int i = 0;
+  if (it->next_n) {
+    return it->next_n(it, buf, n);
+  }
+  while (i < n && it->has_next(it)) {
+    buf[i++] = it->next(it, &status);
     // used has_next
     assert(status == SMB_SUCCESS);
-    printer(f, d);
-    fprintf(f, ",\n");
   }
-  it.destroy(&it);
-  fprintf(f, "}\n");
+  return i;
 }
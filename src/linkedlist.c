@@ -20,18 +20,47 @@
 
 #include "libstephen/ll.h"
 
+/**
+   @brief A block of nodes belonging to a smb_ll_pool.
+ */
+struct smb_ll_slab
+{
+  struct smb_ll_slab *next;
+  smb_ll_node nodes[SMB_LL_POOL_SLAB];
+};
+
 /*******************************************************************************
 
                                Private Functions
 
 *******************************************************************************/
 
+/**
+   @brief Returns a node to the list's pool, or frees it if it has none.
+
+   This function is a *private* function, not declared in libstephen.h for a
+   reason.
+
+   @param list The list the node belonged to.
+   @param node The node to free.
+ */
+void ll_free_node(smb_ll *list, smb_ll_node *node)
+{
+  if (list->pool) {
+    node->next = list->pool->free;
+    list->pool->free = node;
+  } else {
+    smb_dealloc(list->alloc, smb_ll_node, node, 1);
+  }
+}
+
 /**
    @brief Removes the given node, reassigning the links to and from it.
 
    Frees the node, in addition no reassigning links.  Once this function is
    called, the_node is invlidated.  Please note that this function *does not*
-   decrement the list's length!
+   decrement the list's length!  Since the indices after the node all change,
+   the list's cursor is dropped.
 
    This function is a *private* function, not declared in libstephen.h for a
    reason.  It is only necessary for the implementation functions within this
@@ -54,7 +83,8 @@ void ll_remove_node(smb_ll *list, smb_ll_node *the_node)
   } else {
     list->tail = previous;
   }
-  smb_free(the_node);
+  list->cursor = NULL;
+  ll_free_node(list, the_node);
 }
 
 smb_ll_node *ll_node_navigate(smb_ll_node *node, int index)
@@ -67,10 +97,51 @@ smb_ll_node *ll_node_navigate(smb_ll_node *node, int index)
   return node;
 }
 
+/**
+   @brief Navigates to an index from a node which is at another index, going
+   forward or back.
+   @param node The node to start from.
+   @param from The index of that node.
+   @param index The index to navigate to.
+   @returns The node at index.
+ */
+static smb_ll_node *ll_node_walk(smb_ll_node *node, int from, int index)
+{
+  while (from > index) {
+    node = node->prev;
+    from--;
+  }
+  return ll_node_navigate(node, index - from);
+}
+
+/**
+   @brief Find the node at an index, starting from whichever of the head, the
+   tail, or the list's cursor is closest.  The index must be in range.
+ */
+static smb_ll_node *ll_node_find(const smb_ll *list, int index)
+{
+  int from_tail = list->length - 1 - index;
+  int from_cursor = index - list->cursor_index;
+  if (from_cursor < 0) {
+    from_cursor = -from_cursor;
+  }
+
+  if (list->cursor && from_cursor <= index && from_cursor <= from_tail) {
+    return ll_node_walk(list->cursor, list->cursor_index, index);
+  } else if (from_tail < index) {
+    return ll_node_walk(list->tail, list->length - 1, index);
+  } else {
+    return ll_node_navigate(list->head, index);
+  }
+}
+
 /**
    @brief Navigates to the given index in the list, returning the correct node,
    or NULL.
 
+   The node found becomes the list's cursor.  That's only a cache, so it's
+   updated even though the list is const.
+
    This function is a *private* function, not declared in libstephen.h for a
    reason.
 
@@ -83,24 +154,45 @@ smb_ll_node *ll_node_navigate(smb_ll_node *node, int index)
  */
 smb_ll_node * ll_navigate(const smb_ll *list, int index, smb_status *status)
 {
-  smb_ll_node *node = list->head;
+  smb_ll *mutable = (smb_ll*) list;
   if (index < 0 || index >= list->length) {
     *status = SMB_INDEX_ERROR;
     return NULL;
   }
-  return ll_node_navigate(node, index);
+  mutable->cursor = ll_node_find(list, index);
+  mutable->cursor_index = index;
+  return mutable->cursor;
 }
 
 /**
    @brief Allocates and initializes a node with the given data.
 
+   The node comes from the list's pool, if it has one: first from the pool's
+   free nodes, then from its newest slab, and then from a new slab.
+
+   @param list The list the node is for.
    @param data The data to insert into the new node.
-   @param[out] status Status variable.
    @return A pointer to the node created.
  */
-smb_ll_node *ll_create_node(DATA data)
-{
-  smb_ll_node *new_node = smb_new(smb_ll_node, 1);
+smb_ll_node *ll_create_node(smb_ll *list, DATA data)
+{
+  smb_ll_pool *pool = list->pool;
+  smb_ll_node *new_node;
+  if (!pool) {
+    new_node = smb_alloc(list->alloc, smb_ll_node, 1);
+  } else if (pool->free) {
+    new_node = pool->free;
+    pool->free = new_node->next;
+  } else {
+    if (pool->next == pool->end) {
+      struct smb_ll_slab *slab = smb_new(struct smb_ll_slab, 1);
+      slab->next = pool->slabs;
+      pool->slabs = slab;
+      pool->next = slab->nodes;
+      pool->end = slab->nodes + SMB_LL_POOL_SLAB;
+    }
+    new_node = pool->next++;
+  }
   new_node->data = data;
   new_node->next = NULL;
   new_node->prev = NULL;
@@ -113,20 +205,72 @@ smb_ll_node *ll_create_node(DATA data)
 
 *******************************************************************************/
 
+void ll_pool_init(smb_ll_pool *pool)
+{
+  pool->free = NULL;
+  pool->next = NULL;
+  pool->end = NULL;
+  pool->slabs = NULL;
+}
+
+smb_ll_pool *ll_pool_create()
+{
+  smb_ll_pool *pool = smb_new(smb_ll_pool, 1);
+  ll_pool_init(pool);
+  return pool;
+}
+
+void ll_pool_destroy(smb_ll_pool *pool)
+{
+  struct smb_ll_slab *slab = pool->slabs, *next;
+  while (slab) {
+    next = slab->next;
+    smb_free(slab);
+    slab = next;
+  }
+  ll_pool_init(pool);
+}
+
+void ll_pool_delete(smb_ll_pool *pool)
+{
+  ll_pool_destroy(pool);
+  smb_free(pool);
+}
+
 void ll_init(smb_ll *new_list)
+{
+  ll_init_pooled(new_list, NULL);
+}
+
+smb_ll *ll_create()
+{
+  return ll_create_pooled(NULL);
+}
+
+void ll_init_pooled(smb_ll *new_list, smb_ll_pool *pool)
 {
   new_list->length = 0;
   new_list->head = NULL;
   new_list->tail = NULL;
+  new_list->pool = pool;
+  new_list->cursor = NULL;
+  new_list->cursor_index = 0;
+  new_list->alloc = NULL;
 }
 
-smb_ll *ll_create()
+smb_ll *ll_create_pooled(smb_ll_pool *pool)
 {
   smb_ll *new_list = smb_new(smb_ll, 1);
-  ll_init(new_list);
+  ll_init_pooled(new_list, pool);
   return new_list;
 }
 
+void ll_init_alloc(smb_ll *new_list, const smb_allocator *allocator)
+{
+  ll_init_pooled(new_list, NULL);
+  new_list->alloc = allocator;
+}
+
 void ll_destroy(smb_ll *list)
 {
   // Iterate through each node, deleting them as we go
@@ -148,7 +292,7 @@ void ll_delete(smb_ll *list)
 void ll_append(smb_ll *list, DATA new_data)
 {
   // Create the new node
-  smb_ll_node *new_node = ll_create_node(new_data);
+  smb_ll_node *new_node = ll_create_node(list, new_data);
 
   // Get the last node in the list
   smb_ll_node *last_node = list->tail;
@@ -166,7 +310,7 @@ void ll_append(smb_ll *list, DATA new_data)
 void ll_prepend(smb_ll *list, DATA new_data)
 {
   // Create the new smb_ll_node
-  smb_ll_node *new_node = ll_create_node(new_data);
+  smb_ll_node *new_node = ll_create_node(list, new_data);
   smb_ll_node *first_node = list->head;
   new_node->next = first_node;
   if (first_node)
@@ -175,6 +319,7 @@ void ll_prepend(smb_ll *list, DATA new_data)
     list->tail = new_node;
   list->head = new_node;
   list->length++;
+  list->cursor_index++;
 }
 
 void ll_push_back(smb_ll *list, DATA new_data)
@@ -261,9 +406,13 @@ void ll_remove(smb_ll *list, int index, smb_status *status)
   if (*status == SMB_INDEX_ERROR) {
     return; // Return the INDEX_ERROR
   }
-  // Remove it (managing the links and the list header)
+  // Remove it (managing the links and the list header), and leave the cursor
+  // on the node which took its place.
+  smb_ll_node *next = the_node->next;
   ll_remove_node(list, the_node);
   list->length--;
+  list->cursor = next;
+  list->cursor_index = index;
 }
 
 void ll_insert(smb_ll *list, int index, DATA new_data)
@@ -273,7 +422,7 @@ void ll_insert(smb_ll *list, int index, DATA new_data)
   } else if (index >= list->length) {
     ll_append(list, new_data);
   } else {
-    smb_ll_node *new_node = ll_create_node(new_data);
+    smb_ll_node *new_node = ll_create_node(list, new_data);
 
     smb_status status = SMB_SUCCESS;
     smb_ll_node *current = ll_navigate(list, index, &status);
@@ -286,6 +435,7 @@ void ll_insert(smb_ll *list, int index, DATA new_data)
     new_node->next = current;
     current->prev = new_node;
     list->length++;
+    list->cursor = new_node;
   }
 }
 
@@ -305,72 +455,27 @@ int ll_length(const smb_ll *list)
   return list->length;
 }
 
-/**
-   @brief Recursive mergesort helper function.
-   @param head Pointer to the head pointer (will be updated to reflect new list
-   after sorting).
-   @param length Length of sublist.  Expects the trailing node will not point to
-   the next sublist.
-   @param cmp Comparator.
-   @returns The tail of the sorted list!
- */
-static smb_ll_node *ll_sort_rec(smb_ll_node **head, int length, DATA_COMPARE cmp)
+void ll_sort(smb_ll *list, DATA_COMPARE comp)
 {
-  smb_ll_node *left = *head;
-  smb_ll_node *right, *tail, *next;
+  // Following links to compare and merge is slow, since every node is a cache
+  // miss.  So copy the data out to an array, sort that, and put it back in
+  // order.  The nodes themselves stay where they are.
+  DATA *items;
+  smb_ll_node *node;
+  int i;
 
-  // BASE CASE!
-  if (length <= 1) {
-    return *head;
+  if (list->length < 2) {
+    return;
   }
-
-  // Find midpoint and bisect list.
-  right = ll_node_navigate(*head, length/2);
-  right->prev->next = NULL;
-  right->prev = NULL;
-
-  // Sort each sublist.
-  ll_sort_rec(&left, length/2, cmp);
-  ll_sort_rec(&right, length-length/2, cmp);
-
-  // Pick the first element.
-  if (cmp(left->data, right->data) <= 0) {
-    *head = left;
-    tail = left;
-    left = left->next;
-  } else {
-    *head = right;
-    tail = right;
-    right = right->next;
-  }
-
-  // Merge the remaining elements.
-  while (--length) {
-    if (left == NULL) {
-      next = right;
-      right = right->next;
-    } else if (right == NULL) {
-      next = left;
-      left = left->next;
-    } else if (cmp(left->data, right->data) <= 0) {
-      next = left;
-      left = left->next;
-    } else {
-      next = right;
-      right = right->next;
-    }
-    tail->next = next;
-    next->prev = tail;
-    next->next = NULL;
-    tail = next;
+  items = smb_new(DATA, list->length);
+  for (node = list->head, i = 0; node; node = node->next, i++) {
+    items[i] = node->data;
   }
-  tail->next = NULL;
-  return tail;
-}
-
-void ll_sort(smb_ll *list, DATA_COMPARE comp)
-{
-  list->tail = ll_sort_rec(&list->head, list->length, comp);
+  data_sort(items, list->length, comp);
+  for (node = list->head, i = 0; node; node = node->next, i++) {
+    node->data = items[i];
+  }
+  smb_free(items);
 }
 
 int ll_index_of(const smb_ll *list, DATA d, DATA_COMPARE comp)
@@ -439,6 +544,26 @@ bool ll_iter_has_next(smb_iter *iter)
   return node_clean;
 }
 
+/**
+   @brief Copy up to n of the next items in the linked list.
+   @param iter A pointer to the iterator.
+   @param buf Where to copy them.
+   @param n The most to copy.
+   @returns The number copied.
+ */
+int ll_iter_next_n(smb_iter *iter, DATA *buf, int n)
+{
+  smb_ll_node *node = iter->state.data_ptr;
+  int i;
+  for (i = 0; i < n && node; i++) {
+    buf[i] = node->data;
+    node = node->next;
+  }
+  iter->state.data_ptr = node;
+  iter->index += i;
+  return i;
+}
+
 /**
    @brief Free the resources held by the iterator.
    @param iter A pointer to the iterator.
@@ -473,7 +598,8 @@ smb_iter ll_get_iter(const smb_ll *list)
     .next = &ll_iter_next,
     .has_next = &ll_iter_has_next,
     .destroy = &ll_iter_destroy,
-    .delete = &ll_iter_delete
+    .delete = &ll_iter_delete,
+    .next_n = &ll_iter_next_n
   };
 
   return iter;
@@ -665,3 +791,93 @@ smb_list ll_cast_to_list(smb_ll *list)
 
   return generic_list;
 }
+
+smb_ll_cursor ll_cursor(smb_ll *list)
+{
+  return (smb_ll_cursor){.list=list, .node=list->head, .index=0};
+}
+
+void ll_cursor_seek(smb_ll_cursor *cursor, int index, smb_status *status)
+{
+  *status = SMB_SUCCESS;
+  smb_ll *list = cursor->list;
+  if (index < 0 || index > list->length) {
+    *status = SMB_INDEX_ERROR;
+    return;
+  }
+  // Past the end, there's no node to remember it by.
+  if (index == list->length) {
+    cursor->node = NULL;
+  } else if (cursor->node && abs(index - cursor->index) < index &&
+             abs(index - cursor->index) < list->length - 1 - index) {
+    cursor->node = ll_node_walk(cursor->node, cursor->index, index);
+  } else {
+    cursor->node = ll_navigate(list, index, status);
+  }
+  cursor->index = index;
+}
+
+bool ll_cursor_valid(const smb_ll_cursor *cursor)
+{
+  return cursor->node != NULL;
+}
+
+void ll_cursor_next(smb_ll_cursor *cursor)
+{
+  cursor->node = cursor->node->next;
+  cursor->index++;
+}
+
+void ll_cursor_prev(smb_ll_cursor *cursor, smb_status *status)
+{
+  *status = SMB_SUCCESS;
+  smb_ll_node *prev = cursor->node ? cursor->node->prev : cursor->list->tail;
+  if (!prev) {
+    *status = SMB_INDEX_ERROR;
+    return;
+  }
+  cursor->node = prev;
+  cursor->index--;
+}
+
+DATA ll_cursor_get(const smb_ll_cursor *cursor)
+{
+  return cursor->node->data;
+}
+
+void ll_cursor_set(smb_ll_cursor *cursor, DATA data)
+{
+  cursor->node->data = data;
+}
+
+void ll_cursor_insert(smb_ll_cursor *cursor, DATA data)
+{
+  smb_ll *list = cursor->list;
+  smb_ll_node *node = cursor->node;
+
+  if (!node) {
+    ll_append(list, data);
+  } else if (!node->prev) {
+    ll_prepend(list, data);
+  } else {
+    smb_ll_node *new_node = ll_create_node(list, data);
+    node->prev->next = new_node;
+    new_node->prev = node->prev;
+    new_node->next = node;
+    node->prev = new_node;
+    list->length++;
+    list->cursor = new_node;
+    list->cursor_index = cursor->index;
+  }
+  cursor->index++;
+}
+
+DATA ll_cursor_remove(smb_ll_cursor *cursor)
+{
+  smb_ll_node *node = cursor->node;
+  DATA data = node->data;
+  cursor->node = node->next;
+  ll_remove_node(cursor->list, node);
+  cursor->list->length--;
+  return data;
+}
@@ -0,0 +1,316 @@
+/*
+  Compiling lambdas to bytecode.
+
+  A lambda's body is compiled the first time it is called.  Parameters are
+  resolved to argument slots, so they are read straight from the VM's stack
+  instead of being looked up in a scope.  Every other symbol is a "global",
+  looked up in the lambda's closure when it is used, so later definitions are
+  still seen.
+
+  Lambdas within the body are compiled along with it.  Their references to the
+  parameters of the lambdas around them are resolved to a depth and an index,
+  which the VM follows through the envs each lambda captured when it was made.
+  So only globals and define still use hash table scopes.
+
+  Most builtins evaluate all of their arguments, so calls to them are compiled
+  like any other call.  The builtins that don't (special forms, with no apply
+  or native function) can't be called with evaluated arguments.  "quote", "if" and
+  "lambda" are compiled into constants, jumps and closures, when the head of a
+  form refers to them when the lambda is compiled.  A body using any other
+  special form (or that can't be compiled for any other reason) is left to the
+  tree-walking interpreter.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/lisp.h"
+
+typedef struct compiler {
+  lisp_runtime *rt;
+  lisp_scope *closure;
+  lisp_list *params;
+  struct compiler *up; // the compiler of the enclosing lambda
+  int *ops;
+  int nops, opsalloc;
+  lisp_value **consts;
+  int nconsts, constsalloc;
+  lisp_bytecode **lambdas;
+  int nlambdas, lambdasalloc;
+} compiler;
+
+static compiler newcompiler(lisp_runtime *rt, lisp_scope *closure,
+                            lisp_list *params, compiler *up)
+{
+  compiler c = {
+    .rt=rt,
+    .closure=closure,
+    .params=params,
+    .up=up,
+    .ops=malloc(16 * sizeof(int)),
+    .nops=0,
+    .opsalloc=16,
+    .consts=malloc(8 * sizeof(lisp_value*)),
+    .nconsts=0,
+    .constsalloc=8,
+    .lambdas=NULL,
+    .nlambdas=0,
+    .lambdasalloc=0,
+  };
+  return c;
+}
+
+static void discard(compiler *c)
+{
+  for (int i = 0; i < c->nlambdas; i++) {
+    lisp_bytecode_free(c->lambdas[i]);
+  }
+  free(c->lambdas);
+  free(c->ops);
+  free(c->consts);
+}
+
+static lisp_bytecode *finish(compiler *c)
+{
+  lisp_bytecode *code = malloc(sizeof(lisp_bytecode));
+  code->ops = c->ops;
+  code->nops = c->nops;
+  code->consts = c->consts;
+  code->globals = calloc(c->nconsts > 0 ? c->nconsts : 1,
+                         sizeof(lisp_global_cache));
+  code->nconsts = c->nconsts;
+  code->nargs = lisp_list_length(c->params);
+  code->lambdas = c->lambdas;
+  code->nlambdas = c->nlambdas;
+  return code;
+}
+
+static int emit(compiler *c, int op)
+{
+  if (c->nops == c->opsalloc) {
+    c->opsalloc *= 2;
+    c->ops = realloc(c->ops, c->opsalloc * sizeof(int));
+  }
+  c->ops[c->nops] = op;
+  return c->nops++;
+}
+
+static int constant(compiler *c, lisp_value *v)
+{
+  if (c->nconsts == c->constsalloc) {
+    c->constsalloc *= 2;
+    c->consts = realloc(c->consts, c->constsalloc * sizeof(lisp_value*));
+  }
+  c->consts[c->nconsts] = v;
+  return c->nconsts++;
+}
+
+/*
+  Return the slot of a parameter, or -1 if the symbol isn't one.  When a name
+  is repeated, the last one wins, just like binding them in a scope.
+ */
+static int argindex(lisp_list *params, lisp_symbol *symbol)
+{
+  int index = -1, i = 0;
+  while (!lisp_nil_p((lisp_value*)params)) {
+    if (params->left == (lisp_value*)symbol) {
+      index = i;
+    }
+    params = (lisp_list*) params->right;
+    i++;
+  }
+  return index;
+}
+
+/*
+  Find the parameter a symbol refers to, in this lambda (depth 0) or the ones
+  around it.  Returns false if it's a global.
+ */
+static bool resolve(compiler *c, lisp_symbol *symbol, int *depth, int *index)
+{
+  for (*depth = 0; c; c = c->up, (*depth)++) {
+    *index = argindex(c->params, symbol);
+    if (*index != -1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+  Return the special form a head of a form refers to, or NULL.
+ */
+static lisp_builtin *special_form(compiler *c, lisp_value *head)
+{
+  int depth, index;
+  if (head->type != type_symbol ||
+      resolve(c, (lisp_symbol*)head, &depth, &index)) {
+    return NULL;
+  }
+  lisp_value *v = lisp_scope_lookup(c->rt, c->closure, (lisp_symbol*)head);
+  if (lisp_special_form_p(v)) {
+    return (lisp_builtin*)v;
+  }
+  return NULL;
+}
+
+static bool compile_expr(compiler *c, lisp_value *v, bool tail);
+
+static bool compile_if(compiler *c, lisp_list *args, bool tail)
+{
+  lisp_list *body_true = (lisp_list*) args->right;
+  lisp_list *body_false = (lisp_list*) body_true->right;
+
+  if (!compile_expr(c, args->left, false)) {
+    return false;
+  }
+  emit(c, LISP_JUMPF);
+  int to_false = emit(c, 0);
+  if (!compile_expr(c, body_true->left, tail)) {
+    return false;
+  }
+  emit(c, LISP_JUMP);
+  int to_end = emit(c, 0);
+  c->ops[to_false] = c->nops;
+  if (!compile_expr(c, body_false->left, tail)) {
+    return false;
+  }
+  c->ops[to_end] = c->nops;
+  return true;
+}
+
+static bool compile_lambda(compiler *c, lisp_list *args)
+{
+  lisp_value *params = args->left;
+  lisp_value *body = ((lisp_list*)args->right)->left;
+
+  // Check the argument list like the lambda builtin does.
+  lisp_value *it = params;
+  while (it->type == type_list && !lisp_nil_p(it)) {
+    if (((lisp_list*)it)->left->type != type_symbol) {
+      return false;
+    }
+    it = ((lisp_list*)it)->right;
+  }
+  if (it->type != type_list) {
+    return false;
+  }
+
+  compiler inner = newcompiler(c->rt, c->closure, (lisp_list*)params, c);
+  if (!compile_expr(&inner, body, true)) {
+    discard(&inner);
+    return false;
+  }
+  emit(&inner, LISP_RETURN);
+
+  if (c->nlambdas == c->lambdasalloc) {
+    c->lambdasalloc = c->lambdasalloc ? 2 * c->lambdasalloc : 4;
+    c->lambdas = realloc(c->lambdas, c->lambdasalloc * sizeof(lisp_bytecode*));
+  }
+  c->lambdas[c->nlambdas] = finish(&inner);
+  emit(c, LISP_LAMBDA);
+  emit(c, constant(c, (lisp_value*)args));
+  emit(c, c->nlambdas++);
+  return true;
+}
+
+static bool compile_form(compiler *c, lisp_list *form, bool tail)
+{
+  lisp_list *args = (lisp_list*) form->right;
+  int argc = 0;
+
+  // Only proper lists can be calls.
+  lisp_value *it = form->right;
+  while (it->type == type_list && !lisp_nil_p(it)) {
+    argc++;
+    it = ((lisp_list*)it)->right;
+  }
+  if (it->type != type_list) {
+    return false;
+  }
+
+  lisp_builtin *special = special_form(c, form->left);
+  if (special) {
+    if (strcmp(special->name, "quote") == 0 && argc == 1) {
+      emit(c, LISP_CONST);
+      emit(c, constant(c, args->left));
+      return true;
+    } else if (strcmp(special->name, "if") == 0 && argc == 3) {
+      return compile_if(c, args, tail);
+    } else if (strcmp(special->name, "lambda") == 0 && argc == 2) {
+      return compile_lambda(c, args);
+    }
+    return false;
+  }
+
+  if (!compile_expr(c, form->left, false)) {
+    return false;
+  }
+  while (!lisp_nil_p((lisp_value*)args)) {
+    if (!compile_expr(c, args->left, false)) {
+      return false;
+    }
+    args = (lisp_list*) args->right;
+  }
+  emit(c, tail ? LISP_TAILCALL : LISP_CALL);
+  emit(c, argc);
+  return true;
+}
+
+/*
+  Compile an expression.  It's in tail position if its value is returned by the
+  lambda, so a call there can reuse the lambda's frame.
+ */
+static bool compile_expr(compiler *c, lisp_value *v, bool tail)
+{
+  if (v->type == type_symbol) {
+    int depth, index;
+    if (!resolve(c, (lisp_symbol*)v, &depth, &index)) {
+      emit(c, LISP_GLOBAL);
+      emit(c, constant(c, v));
+    } else if (depth == 0) {
+      emit(c, LISP_ARG);
+      emit(c, index);
+    } else {
+      emit(c, LISP_OUTER);
+      emit(c, depth);
+      emit(c, index);
+    }
+    return true;
+  } else if (v->type == type_integer || v->type == type_string ||
+             v->type == type_error) {
+    // These evaluate to themselves.
+    emit(c, LISP_CONST);
+    emit(c, constant(c, v));
+    return true;
+  } else if (v->type == type_list && !lisp_nil_p(v)) {
+    return compile_form(c, (lisp_list*)v, tail);
+  }
+  return false;
+}
+
+lisp_bytecode *lisp_compile(lisp_runtime *rt, lisp_lambda *lambda)
+{
+  compiler c = newcompiler(rt, lambda->closure, lambda->args, NULL);
+
+  if (!compile_expr(&c, lambda->code, true)) {
+    discard(&c);
+    return NULL;
+  }
+  emit(&c, LISP_RETURN);
+  return finish(&c);
+}
+
+void lisp_bytecode_free(lisp_bytecode *code)
+{
+  if (code) {
+    for (int i = 0; i < code->nlambdas; i++) {
+      lisp_bytecode_free(code->lambdas[i]);
+    }
+    free(code->lambdas);
+    free(code->ops);
+    free(code->consts);
+    free(code->globals);
+    free(code);
+  }
+}
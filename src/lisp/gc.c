@@ -1,60 +1,289 @@
+/*
+  Garbage collection.
+
+  The collector is generational.  Objects are kept in a list in the order they
+  were made, and every object after rt->young is young.  A minor collection
+  (lisp_mark_young() and lisp_sweep_young()) only traces and sweeps the young
+  objects, treating every old one as alive, and the survivors become old.  So
+  its pause depends on what was made since the last collection, not on the
+  size of the heap.
+
+  That only works if every young object reachable from an old one is found.
+  Lists, lambdas and envs are never changed after they are made, so they can
+  only point at objects older than themselves.  Scopes, vectors and hashmaps
+  are the exception (their types have mutates set), so binding a name or
+  setting an item marks them dirty, and a minor collection traces the dirty old
+  ones as roots.
+
+  A major collection (lisp_mark() and lisp_sweep()) traces and sweeps
+  everything.  lisp_collect() does a minor collection, or a major one once the
+  old generation has doubled since the last one.
+
+  Collections may also happen during evaluation, at the safe points where
+  lisp_safepoint() is called: when a lambda is called, by the VM or the
+  interpreter.  Everything the evaluator is using at that point must be
+  reachable from the runtime's roots.  The VM's stack and frames are roots, and
+  the interpreter pushes its temporaries onto rt->roots (lisp_eval() and
+  lisp_call() push their arguments), so a C caller only needs to root values it
+  holds across a call into the evaluator.
+ */
+
 #include <assert.h>
+#include <stdlib.h>
 
 #include "libstephen/lisp.h"
 
+#define GC_MAJOR_MIN 1024
+#define GC_COLLECT_AT 8192
+
 void lisp_init(lisp_runtime *rt)
 {
-  rt->nil = type_list->new();
+  lisp_pools_init(rt);
+  for (int i = 0; i < LISP_SMALLINT_MAX - LISP_SMALLINT_MIN + 1; i++) {
+    rt->smallints[i] = NULL;
+  }
+  rt->nil = lisp_alloc(rt, type_list->size);
   rt->nil->mark = 0;
+  rt->nil->gen = GC_OLD;
   rt->nil->type = type_list;
   rt->nil->next = NULL;
   rt->head = rt->nil;
   rt->tail = rt->nil;
   rb_init(&rt->rb, sizeof(lisp_value*), 16);
+  ht_init(&rt->symbols, ht_string_hash, data_compare_string);
+  rt->young = rt->nil;
+  rt->oldmutable = NULL;
+  rt->noldmutable = rt->oldmutablealloc = 0;
+  rt->nold = 0;
+  rt->majorat = GC_MAJOR_MIN;
+  rt->roots = NULL;
+  rt->nroots = rt->rootsalloc = 0;
+  rt->nalloc = 0;
+  rt->collectat = GC_COLLECT_AT;
+  rt->stack = NULL;
+  rt->nstack = rt->stackalloc = 0;
+  rt->frames = NULL;
+  rt->nframes = rt->framealloc = 0;
+  rt->profile = NULL;
 }
 
 void lisp_destroy(lisp_runtime *rt)
 {
+  lisp_profile_stop(rt);
   lisp_sweep(rt);
   rb_destroy(&rt->rb);
-  lisp_free(rt->nil);
+  ht_destroy(&rt->symbols);
+  free(rt->oldmutable);
+  free(rt->roots);
+  free(rt->stack);
+  free(rt->frames);
+  lisp_free(rt, rt->nil);
+  for (int i = 0; i < LISP_SMALLINT_MAX - LISP_SMALLINT_MIN + 1; i++) {
+    if (rt->smallints[i]) {
+      lisp_release(rt, rt->smallints[i], sizeof(lisp_integer));
+    }
+  }
+  lisp_pools_destroy(rt);
 }
 
-void lisp_mark(lisp_runtime *rt, lisp_value *v)
+/*
+  Mark everything reachable from the values in the queue.  For a minor
+  collection, old objects aren't followed.
+ */
+static void mark_queued(lisp_runtime *rt, bool young)
 {
-  smb_status status = SMB_SUCCESS;
-  rb_push_back(&rt->rb, &v);
+  DATA batch[16];
+  lisp_value *v;
+  int i, n;
 
   while (rt->rb.count > 0) {
     rb_pop_front(&rt->rb, &v);
     v->mark = GC_MARKED;
     smb_iter it = v->type->expand(v);
-    while (it.has_next(&it)) {
-      v = it.next(&it, &status).data_ptr;
-      if (v->mark == GC_NOMARK) {
-        v->mark = GC_QUEUED;
-        rb_push_back(&rt->rb, &v);
+    do {
+      n = iter_next_n(&it, batch, 16);
+      for (i = 0; i < n; i++) {
+        v = batch[i].data_ptr;
+        if (v->mark == GC_NOMARK && (!young || v->gen == GC_YOUNG)) {
+          v->mark = GC_QUEUED;
+          rb_push_back(&rt->rb, &v);
+        }
       }
+    } while (n == 16);
+    it.destroy(&it);
+  }
+}
+
+static void queue(lisp_runtime *rt, lisp_value *v, bool young)
+{
+  if (v && v->mark == GC_NOMARK && (!young || v->gen == GC_YOUNG)) {
+    v->mark = GC_QUEUED;
+    rb_push_back(&rt->rb, &v);
+  }
+}
+
+void lisp_mark(lisp_runtime *rt, lisp_value *v)
+{
+  if (rt->profile) {
+    lisp_profile_mark(rt);
+  }
+  queue(rt, v, false);
+  mark_queued(rt, false);
+}
+
+void lisp_mark_young(lisp_runtime *rt, lisp_value *v)
+{
+  if (rt->profile) {
+    lisp_profile_mark(rt);
+  }
+  queue(rt, v, true);
+  mark_queued(rt, true);
+}
+
+/*
+  Mark everything the evaluator is using.
+ */
+static void mark_roots(lisp_runtime *rt, bool young)
+{
+  for (size_t i = 0; i < rt->nroots; i++) {
+    queue(rt, rt->roots[i], young);
+  }
+  for (size_t i = 0; i < rt->nstack; i++) {
+    queue(rt, rt->stack[i], young);
+  }
+  for (size_t i = 0; i < rt->nframes; i++) {
+    queue(rt, (lisp_value*)rt->frames[i].env, young);
+  }
+  if (rt->profile) {
+    // The code of profiled lambdas is kept, since it identifies them.
+    smb_status status = SMB_SUCCESS;
+    smb_iter it = ht_get_iter(&rt->profile->calls);
+    while (it.has_next(&it)) {
+      DATA key = it.next(&it, &status);
+      lisp_profile_entry *e = ht_get(&rt->profile->calls, key, &status).data_ptr;
+      queue(rt, e->args, young);
+      queue(rt, e->code, young);
     }
     it.destroy(&it);
   }
+  mark_queued(rt, young);
 }
 
-void lisp_sweep(lisp_runtime *rt)
+void lisp_push_root(lisp_runtime *rt, lisp_value *v)
 {
-  lisp_value *curr = rt->head;
+  if (rt->nroots == rt->rootsalloc) {
+    rt->rootsalloc = rt->rootsalloc ? 2 * rt->rootsalloc : 64;
+    rt->roots = realloc(rt->roots, rt->rootsalloc * sizeof(lisp_value*));
+  }
+  rt->roots[rt->nroots++] = v;
+}
+
+/*
+  Pop the roots pushed since there were nroots of them.
+ */
+void lisp_restore_roots(lisp_runtime *rt, size_t nroots)
+{
+  rt->nroots = nroots;
+}
+
+static void add_old_mutable(lisp_runtime *rt, lisp_value *v)
+{
+  if (rt->noldmutable == rt->oldmutablealloc) {
+    rt->oldmutablealloc = rt->oldmutablealloc ? 2 * rt->oldmutablealloc : 16;
+    rt->oldmutable = realloc(rt->oldmutable,
+                             rt->oldmutablealloc * sizeof(lisp_value*));
+  }
+  rt->oldmutable[rt->noldmutable++] = v;
+}
+
+/*
+  Free the unmarked objects after start, and make the rest old.  Returns the
+  number that were kept.
+ */
+static size_t sweep_from(lisp_runtime *rt, lisp_value *start)
+{
+  lisp_value *curr = start;
+  size_t kept = 0;
 
   while (curr->next) {
     if (curr->next->mark != GC_MARKED) {
       lisp_value *tmp = curr->next->next;
-      lisp_free(curr->next);
+      if (curr->next->type == type_symbol) {
+        // Its name is free for a new symbol.
+        smb_status status = SMB_SUCCESS;
+        ht_remove(&rt->symbols, PTR(((lisp_symbol*)curr->next)->sym), &status);
+      }
+      lisp_free(rt, curr->next);
       curr->next = tmp;
     } else {
       curr->mark = GC_NOMARK;
       curr = curr->next;
+      curr->gen = GC_OLD;
+      kept++;
+      if (curr->type->mutates) {
+        curr->dirty = false;
+        add_old_mutable(rt, curr);
+      }
     }
   }
 
   curr->mark = GC_NOMARK;
   rt->tail = curr;
+  rt->young = curr;
+  rt->nalloc = 0;
+  return kept;
+}
+
+void lisp_sweep(lisp_runtime *rt)
+{
+  rt->noldmutable = 0;
+  rt->nold = sweep_from(rt, rt->head);
+  rt->majorat = 2 * rt->nold > GC_MAJOR_MIN ? 2 * rt->nold : GC_MAJOR_MIN;
+  if (rt->profile) {
+    lisp_profile_sweep(rt, rt->nold, true);
+  }
+}
+
+void lisp_sweep_young(lisp_runtime *rt)
+{
+  if (rt->profile) {
+    lisp_profile_mark(rt);
+  }
+  // Young objects in changed old ones are alive too.
+  size_t noldmutable = rt->noldmutable;
+  for (size_t i = 0; i < noldmutable; i++) {
+    lisp_value *v = rt->oldmutable[i];
+    if (v->dirty) {
+      v->mark = GC_QUEUED;
+      rb_push_back(&rt->rb, &v);
+      mark_queued(rt, true);
+      v->mark = GC_NOMARK;
+      v->dirty = false;
+    }
+  }
+  size_t kept = sweep_from(rt, rt->young);
+  rt->nold += kept;
+  if (rt->profile) {
+    lisp_profile_sweep(rt, kept, false);
+  }
+}
+
+void lisp_collect(lisp_runtime *rt, lisp_value *root)
+{
+  if (rt->nold >= rt->majorat) {
+    lisp_mark(rt, root);
+    mark_roots(rt, false);
+    lisp_sweep(rt);
+  } else {
+    lisp_mark_young(rt, root);
+    mark_roots(rt, true);
+    lisp_sweep_young(rt);
+  }
+}
+
+void lisp_safepoint(lisp_runtime *rt)
+{
+  if (rt->nalloc >= rt->collectat) {
+    lisp_collect(rt, NULL);
+  }
 }
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 #include "libstephen/lisp.h"
 #include "libstephen/cb.h"
@@ -14,10 +15,9 @@ result lisp_parse_value(lisp_runtime *rt, char *input, int index);
 result lisp_parse_integer(lisp_runtime *rt, char *input, int index)
 {
   //printf("lisp_parse_integer(%s, %d)\n", input, index);
-  int n;
-  lisp_integer *v = (lisp_integer*)lisp_new(rt, type_integer);
-  sscanf(input + index, "%d%n", &v->x, &n);
-  return (result){(lisp_value*)v, index + n};
+  int n, x;
+  sscanf(input + index, "%d%n", &x, &n);
+  return (result){(lisp_value*)lisp_integer_new(rt, x), index + n};
 }
 
 char lisp_escape(char escape)
@@ -107,10 +107,10 @@ result lisp_parse_symbol(lisp_runtime *rt, char *input, int index)
          input[index + n] != '\'') {
     n++;
   }
-  lisp_symbol *s = (lisp_symbol*)lisp_new(rt, type_symbol);
-  s->sym = malloc(n + 1);
-  strncpy(s->sym, input + index, n);
-  s->sym[n] = '\0';
+  char name[n + 1];
+  strncpy(name, input + index, n);
+  name[n] = '\0';
+  lisp_symbol *s = lisp_symbol_new(rt, name);
   return (result){(lisp_value*)s, index + n};
 }
 
@@ -152,3 +152,170 @@ lisp_value *lisp_parse(lisp_runtime *rt, char *input)
 {
   return lisp_parse_value(rt, input, 0).result;
 }
+
+/*
+  The reader.  Text is kept in a buffer until a whole top-level form has been
+  scanned, and then that form is parsed as if it were the whole input.  The
+  scanner only needs to know where a form ends: it counts parentheses, skips
+  over strings, and ends a form that isn't a list at the next delimiter.
+ */
+
+#define LISP_READ_CHUNK 4096
+
+void lisp_reader_init(lisp_reader *reader, FILE *file)
+{
+  reader->file = file;
+  reader->end = false;
+  reader->buf = NULL;
+  reader->start = reader->scan = reader->len = reader->alloc = 0;
+  reader->depth = 0;
+  reader->started = reader->instring = reader->escape = false;
+  reader->inatom = false;
+}
+
+void lisp_reader_destroy(lisp_reader *reader)
+{
+  free(reader->buf);
+}
+
+/*
+  Drop the text before the current form, and make room for len more bytes.
+ */
+static void reader_reserve(lisp_reader *reader, size_t len)
+{
+  size_t need;
+  if (reader->start > 0 && reader->len > reader->start) {
+    memmove(reader->buf, reader->buf + reader->start,
+            reader->len - reader->start);
+  }
+  reader->len -= reader->start;
+  reader->scan -= reader->start;
+  reader->start = 0;
+  // Keep one byte for the NUL put after a form while it is parsed.  Doubling
+  // keeps feeding a byte at a time linear.
+  need = reader->len + len + 1;
+  if (need > reader->alloc) {
+    reader->alloc = reader->alloc ? reader->alloc : 64;
+    while (reader->alloc < need) {
+      reader->alloc *= 2;
+    }
+    reader->buf = realloc(reader->buf, reader->alloc);
+  }
+}
+
+void lisp_reader_feed(lisp_reader *reader, const char *text, size_t len)
+{
+  if (len == 0) {
+    return;
+  }
+  reader_reserve(reader, len);
+  memcpy(reader->buf + reader->len, text, len);
+  reader->len += len;
+}
+
+void lisp_reader_end(lisp_reader *reader)
+{
+  reader->end = true;
+}
+
+static bool delimiter(char c)
+{
+  return isspace(c) || c == '(' || c == ')' || c == '"' || c == '\'';
+}
+
+/*
+  Scan the buffered text, returning true and setting *end once a form is
+  complete.
+ */
+static bool reader_scan(lisp_reader *reader, size_t *end)
+{
+  for (; reader->scan < reader->len; reader->scan++) {
+    char c = reader->buf[reader->scan];
+    if (reader->instring) {
+      if (reader->escape) {
+        reader->escape = false;
+      } else if (c == '\\') {
+        reader->escape = true;
+      } else if (c == '"') {
+        reader->instring = false;
+        if (reader->depth == 0) {
+          *end = reader->scan + 1;
+          return true;
+        }
+      }
+      continue;
+    }
+    if (reader->inatom) {
+      if (!delimiter(c)) {
+        continue;
+      }
+      reader->inatom = false;
+      if (reader->depth == 0) {
+        *end = reader->scan;
+        return true;
+      }
+    }
+
+    if (isspace(c)) {
+      if (!reader->started) {
+        reader->start = reader->scan + 1;
+      }
+      continue;
+    }
+    reader->started = true;
+    if (c == '(') {
+      reader->depth++;
+    } else if (c == ')') {
+      if (reader->depth > 0) {
+        reader->depth--;
+      }
+      if (reader->depth == 0) {
+        *end = reader->scan + 1;
+        return true;
+      }
+    } else if (c == '"') {
+      reader->instring = true;
+    } else if (c != '\'') {
+      reader->inatom = true;
+    }
+  }
+
+  // An atom at the end of the input is a whole form.
+  if (reader->end && reader->inatom && reader->depth == 0) {
+    reader->inatom = false;
+    *end = reader->scan;
+    return true;
+  }
+  return false;
+}
+
+lisp_value *lisp_read(lisp_runtime *rt, lisp_reader *reader)
+{
+  size_t end;
+  while (!reader_scan(reader, &end)) {
+    if (!reader->file || reader->end) {
+      if (!reader->end || !reader->started) {
+        return NULL;
+      }
+      // Don't try to parse what's left of a form that never ended.
+      reader->start = reader->scan;
+      reader->started = reader->instring = reader->escape = false;
+      reader->depth = 0;
+      return (lisp_value*) lisp_error_new(rt, "unexpected end of input");
+    }
+    reader_reserve(reader, LISP_READ_CHUNK);
+    size_t n = fread(reader->buf + reader->len, 1, LISP_READ_CHUNK,
+                     reader->file);
+    reader->len += n;
+    reader->end = (n == 0);
+  }
+
+  char saved = reader->buf[end];
+  reader->buf[end] = '\0';
+  lisp_value *v = lisp_parse(rt, reader->buf + reader->start);
+  reader->buf[end] = saved;
+
+  reader->start = reader->scan = end;
+  reader->started = false;
+  return v;
+}
@@ -0,0 +1,99 @@
+/*
+  Object pools.
+
+  Most objects are one of a few small sizes, and a program makes and frees a
+  great many of them.  So instead of going to malloc() for each one, every
+  runtime keeps a pool for each size class (a multiple of LISP_POOL_GRAIN
+  bytes).  A pool cuts objects out of large slabs by bumping a pointer, and
+  keeps freed objects on a list to hand out again.  Slabs are only freed with
+  the runtime.
+
+  Objects made one after another come out of the same slab, so walking the
+  object list (which is in the order objects were made) mostly walks memory in
+  order too.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/lisp.h"
+
+#define LISP_SLAB_SIZE 16384
+
+struct lisp_slab {
+  struct lisp_slab *next;
+  max_align_t data[];
+};
+
+void lisp_pools_init(lisp_runtime *rt)
+{
+  for (int i = 0; i < LISP_POOL_CLASSES; i++) {
+    rt->pools[i] = (lisp_pool){.free=NULL, .next=NULL, .end=NULL, .slabs=NULL};
+  }
+}
+
+void lisp_pools_destroy(lisp_runtime *rt)
+{
+  for (int i = 0; i < LISP_POOL_CLASSES; i++) {
+    struct lisp_slab *slab = rt->pools[i].slabs, *next;
+    while (slab) {
+      next = slab->next;
+      free(slab);
+      slab = next;
+    }
+  }
+  lisp_pools_init(rt);
+}
+
+/*
+  Return the pool for objects of a size, or NULL if they are too big for one.
+ */
+static lisp_pool *pool(lisp_runtime *rt, size_t size, size_t *rounded)
+{
+  size_t index = (size + LISP_POOL_GRAIN - 1) / LISP_POOL_GRAIN;
+  *rounded = index * LISP_POOL_GRAIN;
+  if (index == 0 || index > LISP_POOL_CLASSES) {
+    return NULL;
+  }
+  return &rt->pools[index - 1];
+}
+
+void *lisp_alloc(lisp_runtime *rt, size_t size)
+{
+  size_t rounded;
+  lisp_pool *p = pool(rt, size, &rounded);
+  void *v;
+
+  if (p == NULL) {
+    return calloc(1, size);
+  } else if (p->free) {
+    v = p->free;
+    p->free = *(void**)v;
+  } else {
+    if (p->next + rounded > p->end) {
+      struct lisp_slab *slab = malloc(sizeof(struct lisp_slab) + LISP_SLAB_SIZE);
+      slab->next = p->slabs;
+      p->slabs = slab;
+      p->next = (char*) slab->data;
+      p->end = (char*) slab->data + LISP_SLAB_SIZE;
+    }
+    v = p->next;
+    p->next += rounded;
+  }
+  memset(v, 0, size);
+  return v;
+}
+
+void lisp_release(lisp_runtime *rt, void *v, size_t size)
+{
+  size_t rounded;
+  lisp_pool *p = pool(rt, size, &rounded);
+
+  if (p == NULL) {
+    free(v);
+  } else {
+    *(void**)v = p->free;
+    p->free = v;
+  }
+}
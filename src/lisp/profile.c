@@ -0,0 +1,214 @@
+/*
+  Profiling.
+
+  lisp_profile_start() gives a runtime a lisp_profile, and until it's stopped
+  the evaluator counts calls and the time spent in them, the collector times
+  its pauses, and lisp_new() counts objects by type.  Every hook is behind a
+  check that rt->profile isn't NULL, so there's no other cost when profiling is
+  off.
+
+  Builtins are counted by name.  Lambdas are counted by their code, so every
+  closure made from the same lambda form shares an entry.  The profile keeps
+  that code alive, so that a later lambda can't reuse its address.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "libstephen/lisp.h"
+
+static unsigned long long now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static unsigned int pointer_hash(DATA d)
+{
+  return (unsigned int) ((uintptr_t)d.data_ptr >> 4);
+}
+
+void lisp_profile_start(lisp_runtime *rt)
+{
+  if (rt->profile) {
+    return;
+  }
+  lisp_profile *p = malloc(sizeof(lisp_profile));
+  ht_init(&p->calls, pointer_hash, data_compare_pointer);
+  ht_init(&p->allocs, pointer_hash, data_compare_pointer);
+  p->minor = p->major = 0;
+  p->pause = p->maxpause = p->markstart = 0;
+  p->survivors = p->lastsurvivors = 0;
+  rt->profile = p;
+}
+
+void lisp_profile_stop(lisp_runtime *rt)
+{
+  smb_status status = SMB_SUCCESS;
+  lisp_profile *p = rt->profile;
+  if (!p) {
+    return;
+  }
+  smb_iter it = ht_get_iter(&p->calls);
+  while (it.has_next(&it)) {
+    DATA key = it.next(&it, &status);
+    free(ht_get(&p->calls, key, &status).data_ptr);
+  }
+  it.destroy(&it);
+  ht_destroy(&p->calls);
+  ht_destroy(&p->allocs);
+  free(p);
+  rt->profile = NULL;
+}
+
+/*
+  Return the entry for a builtin or lambda, making it on its first call.
+ */
+static lisp_profile_entry *entry(lisp_runtime *rt, lisp_value *callable)
+{
+  smb_status status = SMB_SUCCESS;
+  lisp_builtin *builtin = (lisp_builtin*) callable;
+  lisp_lambda *lambda = (lisp_lambda*) callable;
+  DATA key = callable->type == type_builtin ? PTR(builtin->name) :
+    PTR(lambda->code);
+
+  lisp_profile_entry *e = ht_get(&rt->profile->calls, key, &status).data_ptr;
+  if (status == SMB_SUCCESS) {
+    return e;
+  }
+  e = malloc(sizeof(lisp_profile_entry));
+  if (callable->type == type_builtin) {
+    e->name = builtin->name;
+    e->args = e->code = NULL;
+  } else {
+    e->name = NULL;
+    e->args = (lisp_value*) lambda->args;
+    e->code = lambda->code;
+  }
+  e->calls = 0;
+  e->ns = 0;
+  e->active = 0;
+  e->started = 0;
+  ht_insert(&rt->profile->calls, key, PTR(e));
+  return e;
+}
+
+void lisp_profile_enter(lisp_runtime *rt, lisp_value *callable)
+{
+  lisp_profile_entry *e = entry(rt, callable);
+  e->calls++;
+  if (e->active++ == 0) {
+    e->started = now();
+  }
+}
+
+void lisp_profile_exit(lisp_runtime *rt, lisp_value *callable)
+{
+  lisp_profile_entry *e = entry(rt, callable);
+  if (--e->active == 0) {
+    e->ns += now() - e->started;
+  }
+}
+
+void lisp_profile_alloc(lisp_runtime *rt, lisp_type *type)
+{
+  smb_status status = SMB_SUCCESS;
+  lisp_profile *p = rt->profile;
+  long long int count = ht_get(&p->allocs, PTR(type), &status).data_llint;
+  if (status != SMB_SUCCESS) {
+    count = 0;
+  }
+  ht_insert(&p->allocs, PTR(type), LLINT(count + 1));
+}
+
+/*
+  Called when marking starts.  A collection may mark more than once before it
+  sweeps, and its pause is timed from the first.
+ */
+void lisp_profile_mark(lisp_runtime *rt)
+{
+  if (rt->profile->markstart == 0) {
+    rt->profile->markstart = now();
+  }
+}
+
+void lisp_profile_sweep(lisp_runtime *rt, size_t kept, bool major)
+{
+  lisp_profile *p = rt->profile;
+  unsigned long long pause = p->markstart ? now() - p->markstart : 0;
+  p->markstart = 0;
+  p->pause += pause;
+  if (pause > p->maxpause) {
+    p->maxpause = pause;
+  }
+  p->survivors += kept;
+  p->lastsurvivors = kept;
+  if (major) {
+    p->major++;
+  } else {
+    p->minor++;
+  }
+}
+
+static int by_time(const void *a, const void *b)
+{
+  const lisp_profile_entry *x = *(lisp_profile_entry *const*)a;
+  const lisp_profile_entry *y = *(lisp_profile_entry *const*)b;
+  if (x->ns != y->ns) {
+    return x->ns < y->ns ? 1 : -1;
+  }
+  return x->calls < y->calls ? 1 : (x->calls > y->calls ? -1 : 0);
+}
+
+void lisp_profile_report(lisp_runtime *rt, FILE *f)
+{
+  smb_status status = SMB_SUCCESS;
+  lisp_profile *p = rt->profile;
+  if (!p) {
+    return;
+  }
+
+  // Calls, the slowest first.
+  int n = p->calls.length, i = 0;
+  lisp_profile_entry **entries = malloc(n * sizeof(lisp_profile_entry*));
+  smb_iter it = ht_get_iter(&p->calls);
+  while (it.has_next(&it)) {
+    DATA key = it.next(&it, &status);
+    entries[i++] = ht_get(&p->calls, key, &status).data_ptr;
+  }
+  it.destroy(&it);
+  qsort(entries, n, sizeof(lisp_profile_entry*), by_time);
+
+  fprintf(f, "%10s %12s  %s\n", "calls", "ms", "function");
+  for (i = 0; i < n; i++) {
+    fprintf(f, "%10zu %12.3f  ", entries[i]->calls, entries[i]->ns / 1e6);
+    if (entries[i]->name) {
+      fprintf(f, "%s", entries[i]->name);
+    } else {
+      fprintf(f, "(lambda ");
+      lisp_print(f, entries[i]->args);
+      fprintf(f, " ");
+      lisp_print(f, entries[i]->code);
+      fprintf(f, ")");
+    }
+    fprintf(f, "\n");
+  }
+  free(entries);
+
+  fprintf(f, "\n%10s  %s\n", "objects", "type");
+  it = ht_get_iter(&p->allocs);
+  while (it.has_next(&it)) {
+    lisp_type *type = it.next(&it, &status).data_ptr;
+    fprintf(f, "%10lld  %s\n",
+            ht_get(&p->allocs, PTR(type), &status).data_llint, type->name);
+  }
+  it.destroy(&it);
+
+  fprintf(f, "\ncollections: %zu minor, %zu major\n", p->minor, p->major);
+  fprintf(f, "pauses: %.3f ms total, %.3f ms longest\n", p->pause / 1e6,
+          p->maxpause / 1e6);
+  fprintf(f, "survivors: %zu total, %zu in the last collection\n",
+          p->survivors, p->lastsurvivors);
+}
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -89,8 +90,8 @@ static smb_iter expand_nothing(lisp_value *v)
 static void type_print(FILE *f, lisp_value *v);
 static lisp_value *type_new(void);
 
-static lisp_type type_type_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_type_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="type",
   .print=type_print,
   .new=type_new,
@@ -99,7 +100,7 @@ static lisp_type type_type_obj = {
   .call=call_error,
   .expand=expand_nothing,
 };
-lisp_type *type_type = &type_type_obj;
+lisp_type *const type_type = (lisp_type*)&type_type_obj;
 
 static void type_print(FILE *f, lisp_value *v)
 {
@@ -116,48 +117,45 @@ static lisp_value *type_new(void)
 // scope
 
 static void scope_print(FILE *f, lisp_value*v);
-static lisp_value *scope_new(void);
+static void scope_init(lisp_value *v);
 static void scope_free(void *v);
 static smb_iter scope_expand(lisp_value *);
 
-static lisp_type type_scope_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_scope_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="scope",
   .print=scope_print,
-  .new=scope_new,
+  .size=sizeof(lisp_scope),
+  .init=scope_init,
   .eval=eval_error,
   .free=scope_free,
   .call=call_error,
   .expand=scope_expand,
+  .mutates=true,
 };
-lisp_type *type_scope = &type_scope_obj;
+lisp_type *const type_scope = (lisp_type*)&type_scope_obj;
 
 static unsigned int symbol_hash(DATA symbol)
 {
   lisp_symbol *sym = symbol.data_ptr;
-  return ht_string_hash(PTR(sym->sym));
+  return sym->hash;
 }
 
 static int symbol_compare(DATA d1, DATA d2)
 {
-  lisp_symbol *sym1 = d1.data_ptr;
-  lisp_symbol *sym2 = d2.data_ptr;
-  return data_compare_string(PTR(sym1->sym), PTR(sym2->sym));;
+  return data_compare_pointer(d1, d2);
 }
 
-static lisp_value *scope_new(void)
+static void scope_init(lisp_value *v)
 {
-  lisp_scope *scope = malloc(sizeof(lisp_scope));
-  scope->up = NULL;
+  lisp_scope *scope = (lisp_scope*) v;
   ht_init(&scope->scope, symbol_hash, symbol_compare);
-  return (lisp_value*)scope;
 }
 
 static void scope_free(void *v)
 {
   lisp_scope *scope = (lisp_scope*) v;
   ht_destroy(&scope->scope);
-  free(scope);
 }
 
 static void scope_print(FILE *f, lisp_value *v)
@@ -181,7 +179,7 @@ static void scope_print(FILE *f, lisp_value *v)
 
 static DATA scope_expand_next(struct smb_iter *it, smb_status *status)
 {
-  smb_iter *htiter = it->ds;
+  smb_iter *htiter = (smb_iter*) it->ds;
   if (it->index == 0) {
     it->index++;
     return it->state; // contains the upper scope
@@ -198,7 +196,7 @@ static DATA scope_expand_next(struct smb_iter *it, smb_status *status)
 
 static bool scope_expand_has_next(struct smb_iter *it)
 {
-  smb_iter *htiter = it->ds;
+  smb_iter *htiter = (smb_iter*) it->ds;
   if (it->index % 2 == 0) {
     return true;
   } else {
@@ -208,7 +206,7 @@ static bool scope_expand_has_next(struct smb_iter *it)
 
 static void scope_expand_destroy(struct smb_iter *it)
 {
-  smb_iter *htiter = it->ds;
+  smb_iter *htiter = (smb_iter*) it->ds;
   htiter->delete(htiter);
 }
 
@@ -219,7 +217,7 @@ static smb_iter scope_expand(lisp_value *v)
   *htiter = ht_get_iter(&scope->scope);
   smb_iter it = {
     .ds=htiter,
-    .state=PTR(scope),
+    .state=PTR(scope->up ? scope->up : scope),
     .index=0,
     .next=scope_expand_next,
     .has_next=scope_expand_has_next,
@@ -232,21 +230,19 @@ static smb_iter scope_expand(lisp_value *v)
 // list
 
 static void list_print(FILE *f, lisp_value *v);
-static lisp_value *list_new(void);
 static lisp_value *list_eval(lisp_runtime*, lisp_scope*, lisp_value*);
 static smb_iter list_expand(lisp_value*);
 
-static lisp_type type_list_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_list_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="list",
   .print=list_print,
-  .new=list_new,
+  .size=sizeof(lisp_list),
   .eval=list_eval,
-  .free=free,
   .call=call_error,
   .expand=list_expand,
 };
-lisp_type *type_list = &type_list_obj;
+lisp_type *const type_list = (lisp_type*)&type_list_obj;
 
 static lisp_value *list_eval(lisp_runtime *rt, lisp_scope *scope, lisp_value *v)
 {
@@ -282,14 +278,6 @@ static void list_print(FILE *f, lisp_value *v)
   fprintf(f, ")");
 }
 
-static lisp_value *list_new(void)
-{
-  lisp_list *list = malloc(sizeof(lisp_list));
-  list->left = NULL;
-  list->right = NULL;
-  return (lisp_value*) list;
-}
-
 bool lisp_nil_p(lisp_value *l)
 {
   return (l->type == type_list) &&
@@ -339,22 +327,20 @@ static smb_iter list_expand(lisp_value *v)
 // symbol
 
 static void symbol_print(FILE *f, lisp_value *v);
-static lisp_value *symbol_new(void);
 static lisp_value *symbol_eval(lisp_runtime*, lisp_scope*, lisp_value*);
 static void symbol_free(void *v);
-static smb_iter symbol_expand(lisp_value*v);
 
-static lisp_type type_symbol_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_symbol_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="symbol",
   .print=symbol_print,
-  .new=symbol_new,
+  .size=sizeof(lisp_symbol),
   .eval=symbol_eval,
   .free=symbol_free,
   .call=call_error,
   .expand=expand_nothing,
 };
-lisp_type *type_symbol = &type_symbol_obj;
+lisp_type *const type_symbol = (lisp_type*)&type_symbol_obj;
 
 static void symbol_print(FILE *f, lisp_value *v)
 {
@@ -362,13 +348,6 @@ static void symbol_print(FILE *f, lisp_value *v)
   fprintf(f, "%s", symbol->sym);
 }
 
-static lisp_value *symbol_new(void)
-{
-  lisp_symbol *symbol = malloc(sizeof(lisp_symbol));
-  symbol->sym = NULL;
-  return (lisp_value*)symbol;
-}
-
 static lisp_value *symbol_eval(lisp_runtime *rt, lisp_scope *scope,
                                lisp_value *value)
 {
@@ -381,26 +360,24 @@ static void symbol_free(void *v)
 {
   lisp_symbol *symbol = (lisp_symbol*) v;
   free(symbol->sym);
-  free(symbol);
 }
 
 // error
 
 static void error_print(FILE *f, lisp_value *v);
-static lisp_value *error_new(void);
 static void error_free(void *v);
 
-static lisp_type type_error_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_error_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="error",
   .print=error_print,
-  .new=error_new,
+  .size=sizeof(lisp_error),
   .eval=eval_same,
   .free=error_free,
   .call=call_same,
   .expand=expand_nothing,
 };
-lisp_type *type_error = &type_error_obj;
+lisp_type *const type_error = (lisp_type*)&type_error_obj;
 
 static void error_print(FILE *f, lisp_value *v)
 {
@@ -408,37 +385,26 @@ static void error_print(FILE *f, lisp_value *v)
   fprintf(f, "error: %s", error->message);
 }
 
-static lisp_value *error_new(void)
-{
-  lisp_error *error = malloc(sizeof(lisp_error));
-  error->type = type_error;
-  error->message = NULL;
-  return (lisp_value*)error;
-}
-
 static void error_free(void *v)
 {
   lisp_error *error = (lisp_error*) v;
   free(error->message);
-  free(error);
 }
 
 // integer
 
 static void integer_print(FILE *f, lisp_value *v);
-static lisp_value *integer_new(void);
 
-static lisp_type type_integer_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_integer_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="integer",
   .print=integer_print,
-  .new=integer_new,
+  .size=sizeof(lisp_integer),
   .eval=eval_same,
-  .free=free,
   .call=call_error,
   .expand=expand_nothing,
 };
-lisp_type *type_integer = &type_integer_obj;
+lisp_type *const type_integer = (lisp_type*)&type_integer_obj;
 
 static void integer_print(FILE *f, lisp_value *v)
 {
@@ -446,30 +412,22 @@ static void integer_print(FILE *f, lisp_value *v)
   fprintf(f, "%d", integer->x);
 }
 
-static lisp_value *integer_new(void)
-{
-  lisp_integer *integer = malloc(sizeof(lisp_integer));
-  integer->x = 0;
-  return (lisp_value*)integer;
-}
-
 // string
 
 static void string_print(FILE *f, lisp_value *v);
-static lisp_value *string_new(void);
 static void string_free(void *v);
 
-static lisp_type type_string_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_string_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="string",
   .print=string_print,
-  .new=string_new,
+  .size=sizeof(lisp_string),
   .eval=eval_same,
   .free=string_free,
   .call=call_error,
   .expand=expand_nothing,
 };
-lisp_type *type_string = &type_string_obj;
+lisp_type *const type_string = (lisp_type*)&type_string_obj;
 
 static void string_print(FILE *f, lisp_value *v)
 {
@@ -477,38 +435,28 @@ static void string_print(FILE *f, lisp_value *v)
   fprintf(f, "%s", str->s);
 }
 
-static lisp_value *string_new(void)
-{
-  lisp_string *str = malloc(sizeof(lisp_string));
-  str->s = NULL;
-  return (lisp_value*)str;
-}
-
 static void string_free(void *v)
 {
   lisp_string *str = (lisp_string*) v;
   free(str->s);
-  free(str);
 }
 
 // builtin
 
 static void builtin_print(FILE *f, lisp_value *v);
-static lisp_value *builtin_new(void);
 static lisp_value *builtin_call(lisp_runtime *rt, lisp_scope *scope,
                                 lisp_value *c, lisp_value *arguments);
 
-static lisp_type type_builtin_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_builtin_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="builtin",
   .print=builtin_print,
-  .new=builtin_new,
+  .size=sizeof(lisp_builtin),
   .eval=eval_error,
-  .free=free,
   .call=builtin_call,
   .expand=expand_nothing,
 };
-lisp_type *type_builtin = &type_builtin_obj;
+lisp_type *const type_builtin = (lisp_type*)&type_builtin_obj;
 
 static void builtin_print(FILE *f, lisp_value *v)
 {
@@ -516,40 +464,95 @@ static void builtin_print(FILE *f, lisp_value *v)
   fprintf(f, "<builtin function %s>", builtin->name);
 }
 
-static lisp_value *builtin_new()
-{
-  lisp_builtin *builtin = malloc(sizeof(lisp_builtin));
-  builtin->call = NULL;
-  builtin->name = NULL;
-  return (lisp_value*) builtin;
-}
-
 static lisp_value *builtin_call(lisp_runtime *rt, lisp_scope *scope,
                                 lisp_value *c, lisp_value *arguments)
 {
   lisp_builtin *builtin = (lisp_builtin*) c;
-  return builtin->call(rt, scope, arguments);
+  lisp_value *result;
+  if (builtin->native) {
+    // The arguments are kept as roots, next to each other, so the roots are
+    // the argument array.
+    size_t roots = rt->nroots;
+    int argc = 0;
+    lisp_value *it = arguments;
+    while (it->type == type_list && !lisp_nil_p(it)) {
+      lisp_push_root(rt, lisp_eval(rt, scope, ((lisp_list*)it)->left));
+      it = ((lisp_list*)it)->right;
+      argc++;
+    }
+    result = lisp_native_call(rt, builtin, argc, rt->roots + roots);
+    lisp_restore_roots(rt, roots);
+    return result;
+  } else if (builtin->apply) {
+    size_t roots = rt->nroots;
+    lisp_value *args = lisp_eval_list(rt, scope, arguments);
+    lisp_push_root(rt, args);
+    if (rt->profile) {
+      lisp_profile_enter(rt, c);
+    }
+    result = builtin->apply(rt, (lisp_list*)args);
+    lisp_restore_roots(rt, roots);
+  } else {
+    if (rt->profile) {
+      lisp_profile_enter(rt, c);
+    }
+    result = builtin->call(rt, scope, arguments);
+  }
+  if (rt->profile) {
+    lisp_profile_exit(rt, c);
+  }
+  return result;
+}
+
+/*
+  Check the arguments to a native builtin against its signature, and call it.
+ */
+lisp_value *lisp_native_call(lisp_runtime *rt, lisp_builtin *builtin, int argc,
+                             lisp_value **argv)
+{
+  char message[128];
+  if (argc < builtin->nargs || (argc > builtin->nargs && !builtin->variadic)) {
+    snprintf(message, sizeof(message), "wrong number of arguments to %s",
+             builtin->name);
+    return (lisp_value*) lisp_error_new(rt, message);
+  }
+  for (int i = 0; i < argc; i++) {
+    lisp_type *type = i < builtin->nargs ? builtin->types[i] : builtin->rest;
+    if (type && argv[i]->type != type) {
+      snprintf(message, sizeof(message), "argument %d of %s must be %s", i + 1,
+               builtin->name, type->name);
+      return (lisp_value*) lisp_error_new(rt, message);
+    }
+  }
+
+  if (rt->profile) {
+    lisp_profile_enter(rt, (lisp_value*)builtin);
+    lisp_value *result = builtin->native(rt, argc, argv);
+    lisp_profile_exit(rt, (lisp_value*)builtin);
+    return result;
+  }
+  return builtin->native(rt, argc, argv);
 }
 
 // lambda
 
 static void lambda_print(FILE *f, lisp_value *v);
-static lisp_value *lambda_new(void);
+static void lambda_free(void *v);
 static lisp_value *lambda_call(lisp_runtime *rt, lisp_scope *scope,
                                lisp_value *c, lisp_value *arguments);
 static smb_iter lambda_expand(lisp_value *v);
 
-static lisp_type type_lambda_obj = {
-  .type=&type_type_obj,
+static const lisp_type type_lambda_obj = {
+  .type=(lisp_type*)&type_type_obj,
   .name="lambda",
   .print=lambda_print,
-  .new=lambda_new,
+  .size=sizeof(lisp_lambda),
   .eval=eval_error,
-  .free=free,
+  .free=lambda_free,
   .call=lambda_call,
   .expand=lambda_expand,
 };
-lisp_type *type_lambda = &type_lambda_obj;
+lisp_type *const type_lambda = (lisp_type*)&type_lambda_obj;
 
 static void lambda_print(FILE *f, lisp_value *v)
 {
@@ -557,12 +560,12 @@ static void lambda_print(FILE *f, lisp_value *v)
   fprintf(f, "<lambda function>");
 }
 
-static lisp_value *lambda_new()
+static void lambda_free(void *v)
 {
-  lisp_lambda *lambda = malloc(sizeof(lisp_lambda));
-  lambda->args = NULL;
-  lambda->code = NULL;
-  return (lisp_value*) lambda;
+  lisp_lambda *lambda = (lisp_lambda*) v;
+  if (!lambda->env) {
+    lisp_bytecode_free(lambda->bytecode);
+  }
 }
 
 static lisp_value *lambda_call(lisp_runtime *rt, lisp_scope *scope,
@@ -570,24 +573,118 @@ static lisp_value *lambda_call(lisp_runtime *rt, lisp_scope *scope,
 {
   lisp_lambda *lambda = (lisp_lambda*) c;
   lisp_list *argvalues = (lisp_list*)lisp_eval_list(rt, scope, arguments);
-  lisp_scope *inner = (lisp_scope*)lisp_new(rt, type_scope);
-  inner->up = lambda->closure;
+  return lisp_lambda_apply(rt, lambda, argvalues);
+}
+
+/*
+  Return true if a form is a call to "if" which the if builtin would accept.
+ */
+static bool if_form(lisp_value *head, lisp_list *form)
+{
+  lisp_builtin *builtin = (lisp_builtin*) head;
+  return lisp_special_form_p(head) && strcmp(builtin->name, "if") == 0 &&
+    lisp_list_length((lisp_list*)form->right) == 3;
+}
 
-  lisp_list *it1 = lambda->args, *it2 = argvalues;
-  while (!lisp_nil_p((lisp_value*)it1) && !lisp_nil_p((lisp_value*)it2)) {
-    lisp_scope_bind(inner, (lisp_symbol*) it1->left, it2->left);
-    it1 = (lisp_list*) it1->right;
-    it2 = (lisp_list*) it2->right;
+/*
+  Return a lambda's bytecode, compiling it on the first call, or NULL if it has
+  to be interpreted.
+ */
+static lisp_bytecode *compiled(lisp_runtime *rt, lisp_lambda *lambda)
+{
+  if (!lambda->bytecode && !lambda->interpret) {
+    lambda->bytecode = lisp_compile(rt, lambda);
+    lambda->interpret = (lambda->bytecode == NULL);
   }
+  return lambda->bytecode;
+}
 
-  if (!lisp_nil_p((lisp_value*)it1)) {
-    return (lisp_value*) lisp_error_new(rt, "not enough arguments");
+/*
+  End the profile of an interpreted call, which returned result.
+ */
+static lisp_value *leave(lisp_runtime *rt, lisp_lambda *lambda,
+                         lisp_value *result)
+{
+  if (rt->profile) {
+    lisp_profile_exit(rt, (lisp_value*)lambda);
   }
-  if (!lisp_nil_p((lisp_value*)it2)) {
-    return (lisp_value*) lisp_error_new(rt, "too many arguments");
+  return result;
+}
+
+static lisp_value *lambda_apply(lisp_runtime *rt, lisp_lambda *lambda,
+                                lisp_list *argvalues, size_t roots)
+{
+  while (true) {
+    // Each call is a safe point.  Only this call's values need to be kept.
+    lisp_restore_roots(rt, roots);
+    lisp_push_root(rt, (lisp_value*)lambda);
+    lisp_push_root(rt, (lisp_value*)argvalues);
+    lisp_safepoint(rt);
+
+    if (compiled(rt, lambda)) {
+      return lisp_vm_run(rt, lambda, argvalues);
+    }
+
+    lisp_scope *inner = (lisp_scope*)lisp_new(rt, type_scope);
+    inner->up = lambda->closure;
+    lisp_push_root(rt, (lisp_value*)inner);
+
+    lisp_list *it1 = lambda->args, *it2 = argvalues;
+    while (!lisp_nil_p((lisp_value*)it1) && !lisp_nil_p((lisp_value*)it2)) {
+      lisp_scope_bind(inner, (lisp_symbol*) it1->left, it2->left);
+      it1 = (lisp_list*) it1->right;
+      it2 = (lisp_list*) it2->right;
+    }
+
+    if (!lisp_nil_p((lisp_value*)it1)) {
+      return (lisp_value*) lisp_error_new(rt, "not enough arguments");
+    }
+    if (!lisp_nil_p((lisp_value*)it2)) {
+      return (lisp_value*) lisp_error_new(rt, "too many arguments");
+    }
+    if (rt->profile) {
+      lisp_profile_enter(rt, (lisp_value*)lambda);
+    }
+
+    // Evaluate the body here, following the branches of ifs and looping on
+    // calls to lambdas, so that tail calls don't grow the C stack.
+    lisp_value *expr = lambda->code;
+    while (true) {
+      if (expr->type != type_list || lisp_nil_p(expr) ||
+          ((lisp_list*)expr)->right->type != type_list) {
+        return leave(rt, lambda, lisp_eval(rt, inner, expr));
+      }
+      lisp_list *form = (lisp_list*) expr;
+      lisp_value *head = lisp_eval(rt, inner, form->left);
+      if (if_form(head, form)) {
+        lisp_list *args = (lisp_list*) form->right;
+        lisp_value *condition = lisp_eval(rt, inner, args->left);
+        args = (lisp_list*) args->right;
+        if (condition->type == type_integer && ((lisp_integer*)condition)->x) {
+          expr = args->left;
+        } else {
+          expr = ((lisp_list*)args->right)->left;
+        }
+      } else if (head->type == type_lambda) {
+        lisp_push_root(rt, head);
+        argvalues = (lisp_list*) lisp_eval_list(rt, inner, form->right);
+        leave(rt, lambda, NULL);
+        lambda = (lisp_lambda*) head;
+        break;
+      } else {
+        return leave(rt, lambda, lisp_call(rt, inner, head, form->right));
+      }
+    }
   }
+}
 
-  return lisp_eval(rt, inner, lambda->code);
+lisp_value *lisp_lambda_apply(lisp_runtime *rt, lisp_lambda *lambda,
+                              lisp_list *argvalues)
+{
+  size_t roots = rt->nroots;
+  lisp_value *result = lambda_apply(rt, lambda, argvalues, roots);
+  lisp_restore_roots(rt, roots);
+  return result;
 }
 
 static DATA lambda_expand_next(smb_iter *it, smb_status *status)
@@ -602,6 +699,8 @@ static DATA lambda_expand_next(smb_iter *it, smb_status *status)
     return PTR(l->code);
   case 3:
     return PTR(l->closure);
+  case 4:
+    return PTR(l->env);
   default:
     return PTR(NULL);
   }
@@ -609,9 +708,10 @@ static DATA lambda_expand_next(smb_iter *it, smb_status *status)
 
 static smb_iter lambda_expand(lisp_value *v)
 {
+  lisp_lambda *l = (lisp_lambda*) v;
   smb_iter it = {
     .ds=v,
-    .state=LLINT(3),
+    .state=LLINT(l->env ? 4 : 3),
     .index=0,
     .next=lambda_expand_next,
     .has_next=has_next_index_lt_state,
@@ -621,6 +721,228 @@ static smb_iter lambda_expand(lisp_value *v)
   return it;
 }
 
+// env
+
+static void env_print(FILE *f, lisp_value *v);
+static void env_free(void *v);
+static smb_iter env_expand(lisp_value *v);
+
+static const lisp_type type_env_obj = {
+  .type=(lisp_type*)&type_type_obj,
+  .name="env",
+  .print=env_print,
+  .size=sizeof(lisp_env),
+  .eval=eval_error,
+  .free=env_free,
+  .call=call_error,
+  .expand=env_expand,
+};
+lisp_type *const type_env = (lisp_type*)&type_env_obj;
+
+static void env_print(FILE *f, lisp_value *v)
+{
+  (void)v;
+  fprintf(f, "<env>");
+}
+
+static void env_free(void *v)
+{
+  lisp_env *env = (lisp_env*) v;
+  free(env->slots);
+}
+
+static DATA env_expand_next(smb_iter *it, smb_status *status)
+{
+  (void)status;
+  lisp_env *env = (lisp_env*)it->ds;
+  int index = it->index++;
+  if (index == 0) {
+    return PTR(env->lambda);
+  } else if (index <= env->nslots) {
+    return PTR(env->slots[index - 1]);
+  } else {
+    return PTR(env->up);
+  }
+}
+
+static smb_iter env_expand(lisp_value *v)
+{
+  lisp_env *env = (lisp_env*) v;
+  smb_iter it = {
+    .ds=v,
+    .state=LLINT(1 + env->nslots + (env->up ? 1 : 0)),
+    .index=0,
+    .next=env_expand_next,
+    .has_next=has_next_index_lt_state,
+    .destroy=destroy_nop,
+    .delete=delete_filler,
+  };
+  return it;
+}
+
+// vector
+
+static void vector_print(FILE *f, lisp_value *v);
+static void vector_init(lisp_value *v);
+static void vector_free(void *v);
+static smb_iter vector_expand(lisp_value *v);
+
+static const lisp_type type_vector_obj = {
+  .type=(lisp_type*)&type_type_obj,
+  .name="vector",
+  .print=vector_print,
+  .size=sizeof(lisp_vector),
+  .init=vector_init,
+  .eval=eval_same,
+  .free=vector_free,
+  .call=call_error,
+  .expand=vector_expand,
+  .mutates=true,
+};
+lisp_type *const type_vector = (lisp_type*)&type_vector_obj;
+
+static void vector_print(FILE *f, lisp_value *v)
+{
+  lisp_vector *vector = (lisp_vector*) v;
+  fprintf(f, "#(");
+  for (int i = 0; i < vector->items.length; i++) {
+    if (i > 0) {
+      fprintf(f, " ");
+    }
+    lisp_print(f, vector->items.data[i].data_ptr);
+  }
+  fprintf(f, ")");
+}
+
+static void vector_init(lisp_value *v)
+{
+  lisp_vector *vector = (lisp_vector*) v;
+  al_init(&vector->items);
+}
+
+static void vector_free(void *v)
+{
+  lisp_vector *vector = (lisp_vector*) v;
+  al_destroy(&vector->items);
+}
+
+static smb_iter vector_expand(lisp_value *v)
+{
+  lisp_vector *vector = (lisp_vector*) v;
+  return al_get_iter(&vector->items);
+}
+
+// hashmap
+
+static void hashmap_print(FILE *f, lisp_value *v);
+static void hashmap_init(lisp_value *v);
+static void hashmap_free(void *v);
+static smb_iter hashmap_expand(lisp_value *v);
+
+static const lisp_type type_hashmap_obj = {
+  .type=(lisp_type*)&type_type_obj,
+  .name="hashmap",
+  .print=hashmap_print,
+  .size=sizeof(lisp_hashmap),
+  .init=hashmap_init,
+  .eval=eval_same,
+  .free=hashmap_free,
+  .call=call_error,
+  .expand=hashmap_expand,
+  .mutates=true,
+};
+lisp_type *const type_hashmap = (lisp_type*)&type_hashmap_obj;
+
+static unsigned int value_hash(DATA d)
+{
+  lisp_value *v = d.data_ptr;
+  if (v->type == type_integer) {
+    return (unsigned int) ((lisp_integer*)v)->x;
+  } else if (v->type == type_string) {
+    return ht_string_hash(PTR(((lisp_string*)v)->s));
+  } else if (v->type == type_symbol) {
+    return ((lisp_symbol*)v)->hash;
+  }
+  return (unsigned int) ((uintptr_t)v >> 4);
+}
+
+static int value_compare(DATA d1, DATA d2)
+{
+  lisp_value *v1 = d1.data_ptr, *v2 = d2.data_ptr;
+  if (v1->type != v2->type) {
+    return 1;
+  } else if (v1->type == type_integer) {
+    return ((lisp_integer*)v1)->x != ((lisp_integer*)v2)->x;
+  } else if (v1->type == type_string) {
+    return strcmp(((lisp_string*)v1)->s, ((lisp_string*)v2)->s);
+  }
+  return data_compare_pointer(d1, d2);
+}
+
+static void hashmap_print(FILE *f, lisp_value *v)
+{
+  lisp_hashmap *map = (lisp_hashmap*) v;
+  smb_iter it = ht_get_iter(&map->table);
+  fprintf(f, "(hashmap:");
+  while (it.has_next(&it)) {
+    smb_status status = SMB_SUCCESS;
+    lisp_value *key = it.next(&it, &status).data_ptr;
+    lisp_value *value = ht_get(&map->table, PTR(key), &status).data_ptr;
+    fprintf(f, " ");
+    lisp_print(f, key);
+    fprintf(f, ": ");
+    lisp_print(f, value);
+  }
+  it.destroy(&it);
+  fprintf(f, ")");
+}
+
+static void hashmap_init(lisp_value *v)
+{
+  lisp_hashmap *map = (lisp_hashmap*) v;
+  ht_init(&map->table, value_hash, value_compare);
+}
+
+static void hashmap_free(void *v)
+{
+  lisp_hashmap *map = (lisp_hashmap*) v;
+  ht_destroy(&map->table);
+}
+
+static DATA hashmap_expand_next(struct smb_iter *it, smb_status *status)
+{
+  smb_iter *htiter = (smb_iter*) it->ds;
+  if (it->index++ % 2 == 0) {
+    it->state = htiter->next(htiter, status);
+    return it->state; // the key
+  } else {
+    return ht_get(htiter->ds, it->state, status);
+  }
+}
+
+static bool hashmap_expand_has_next(struct smb_iter *it)
+{
+  smb_iter *htiter = (smb_iter*) it->ds;
+  return it->index % 2 == 1 || htiter->has_next(htiter);
+}
+
+static smb_iter hashmap_expand(lisp_value *v)
+{
+  lisp_hashmap *map = (lisp_hashmap*) v;
+  smb_iter *htiter = malloc(sizeof(smb_iter));
+  *htiter = ht_get_iter(&map->table);
+  smb_iter it = {
+    .ds=htiter,
+    .state=PTR(NULL),
+    .index=0,
+    .next=hashmap_expand_next,
+    .has_next=hashmap_expand_has_next,
+    .destroy=scope_expand_destroy,
+    .delete=delete_filler,
+  };
+  return it;
+}
+
 // Shortcuts for type objects.
 
 void lisp_print(FILE *f, lisp_value *value)
@@ -628,14 +950,27 @@ void lisp_print(FILE *f, lisp_value *value)
   value->type->print(f, value);
 }
 
-void lisp_free(lisp_value *value)
+void lisp_free(lisp_runtime *rt, lisp_value *value)
 {
-  value->type->free(value);
+  lisp_type *typ = value->type;
+  if (typ->size == 0) {
+    typ->free(value);
+    return;
+  }
+  if (typ->free) {
+    typ->free(value);
+  }
+  lisp_release(rt, value, typ->size);
 }
 
 lisp_value *lisp_eval(lisp_runtime *rt, lisp_scope *scope, lisp_value *value)
 {
-  return value->type->eval(rt, scope, value);
+  size_t roots = rt->nroots;
+  lisp_push_root(rt, (lisp_value*)scope);
+  lisp_push_root(rt, value);
+  lisp_value *result = value->type->eval(rt, scope, value);
+  lisp_restore_roots(rt, roots);
+  return result;
 }
 
 lisp_value *lisp_call(lisp_runtime *rt, lisp_scope *scope,
@@ -645,15 +980,81 @@ lisp_value *lisp_call(lisp_runtime *rt, lisp_scope *scope,
     return callable;
   }
 
-  return callable->type->call(rt, scope, callable, args);
+  size_t roots = rt->nroots;
+  lisp_push_root(rt, (lisp_value*)scope);
+  lisp_push_root(rt, callable);
+  lisp_push_root(rt, args);
+  lisp_value *result = callable->type->call(rt, scope, callable, args);
+  lisp_restore_roots(rt, roots);
+  return result;
+}
+
+/*
+  Call something with arguments which have already been evaluated.  Compiled
+  lambdas and natives get them straight from argv, and anything else gets them
+  in a list.
+ */
+lisp_value *lisp_apply(lisp_runtime *rt, lisp_value *callable, int argc,
+                       lisp_value **argv)
+{
+  if (callable->type == type_error) {
+    return callable;
+  } else if (callable->type == type_lambda &&
+             compiled(rt, (lisp_lambda*)callable)) {
+    return lisp_vm_call(rt, (lisp_lambda*)callable, argc, argv);
+  } else if (callable->type == type_builtin &&
+             ((lisp_builtin*)callable)->native) {
+    return lisp_native_call(rt, (lisp_builtin*)callable, argc, argv);
+  } else if (lisp_special_form_p(callable)) {
+    return (lisp_value*) lisp_error_new(rt, "can't apply a special form");
+  } else if (callable->type != type_lambda &&
+             callable->type != type_builtin) {
+    return (lisp_value*) lisp_error_new(rt, "not callable!");
+  }
+
+  lisp_list *args = (lisp_list*) lisp_nil_new(rt);
+  for (int i = argc - 1; i >= 0; i--) {
+    lisp_list *l = (lisp_list*) lisp_new(rt, type_list);
+    l->left = argv[i];
+    l->right = (lisp_value*) args;
+    args = l;
+  }
+  if (callable->type == type_lambda) {
+    return lisp_lambda_apply(rt, (lisp_lambda*)callable, args);
+  }
+  size_t roots = rt->nroots;
+  lisp_push_root(rt, (lisp_value*)args);
+  if (rt->profile) {
+    lisp_profile_enter(rt, callable);
+  }
+  lisp_value *result = ((lisp_builtin*)callable)->apply(rt, args);
+  if (rt->profile) {
+    lisp_profile_exit(rt, callable);
+  }
+  lisp_restore_roots(rt, roots);
+  return result;
 }
 
 lisp_value *lisp_new(lisp_runtime *rt, lisp_type *typ)
 {
-  lisp_value *new = typ->new();
+  lisp_value *new;
+  if (typ->size == 0) {
+    new = typ->new();
+  } else {
+    new = lisp_alloc(rt, typ->size);
+    if (typ->init) {
+      typ->init(new);
+    }
+  }
   new->type = typ;
   new->next = NULL;
   new->mark = GC_NOMARK;
+  new->gen = GC_YOUNG;
+  new->dirty = false;
+  rt->nalloc++;
+  if (rt->profile) {
+    lisp_profile_alloc(rt, typ);
+  }
   if (rt->head == NULL) {
     rt->head = new;
     rt->tail = new;
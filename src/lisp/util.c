@@ -1,23 +1,16 @@
 #include <assert.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "libstephen/lisp.h"
 
-static lisp_list *lisp_new_pair_list(lisp_runtime *rt, lisp_value *one, lisp_value *two)
-{
-  lisp_list *first_node = (lisp_list*) lisp_new(rt, type_list);
-  lisp_list *second_node = (lisp_list*) lisp_new(rt, type_list);
-  first_node->left = one;
-  first_node->right = (lisp_value*) second_node;
-  second_node->left = two;
-  second_node->right = lisp_nil_new(rt);
-  return first_node;
-}
-
 void lisp_scope_bind(lisp_scope *scope, lisp_symbol *symbol, lisp_value *value)
 {
   ht_insert(&scope->scope, PTR(symbol), PTR(value));
+  scope->dirty = true;
+  symbol->epoch++; // lookups cached by the VM are out of date
 }
 
 lisp_value *lisp_scope_lookup(lisp_runtime *rt, lisp_scope *scope,
@@ -44,6 +37,22 @@ void lisp_scope_add_builtin(lisp_runtime *rt, lisp_scope *scope, char *name,
   lisp_scope_bind(scope, symbol, (lisp_value*)builtin);
 }
 
+void lisp_scope_add_function(lisp_runtime *rt, lisp_scope *scope, char *name,
+                             lisp_apply_func apply)
+{
+  lisp_symbol *symbol = lisp_symbol_new(rt, name);
+  lisp_builtin *builtin = lisp_function_new(rt, name, apply);
+  lisp_scope_bind(scope, symbol, (lisp_value*)builtin);
+}
+
+void lisp_scope_add_native(lisp_runtime *rt, lisp_scope *scope, char *name,
+                           lisp_native_func native, const char *signature)
+{
+  lisp_symbol *symbol = lisp_symbol_new(rt, name);
+  lisp_builtin *builtin = lisp_native_new(rt, name, native, signature);
+  lisp_scope_bind(scope, symbol, (lisp_value*)builtin);
+}
+
 void lisp_scope_replace_or_insert(lisp_scope *scope, lisp_symbol *key, lisp_value *value)
 {
   lisp_scope *s = scope;
@@ -53,6 +62,8 @@ void lisp_scope_replace_or_insert(lisp_scope *scope, lisp_symbol *key, lisp_valu
     if (ht_contains(&s->scope, PTR(key))) {
       // If we find it, replace it.
       ht_insert(&s->scope, PTR(key), PTR(value));
+      s->dirty = true;
+      key->epoch++;
       return;
     }
     s = s->up;
@@ -60,16 +71,27 @@ void lisp_scope_replace_or_insert(lisp_scope *scope, lisp_symbol *key, lisp_valu
 
   // If we never find it, insert it in the "lowest" scope.
   ht_insert(&scope->scope, PTR(key), PTR(value));
+  scope->dirty = true;
+  key->epoch++;
 }
 
 lisp_symbol *lisp_symbol_new(lisp_runtime *rt, char *sym)
 {
-  lisp_symbol *err = (lisp_symbol*)lisp_new(rt, type_symbol);
+  smb_status status = SMB_SUCCESS;
+  lisp_symbol *symbol = ht_get(&rt->symbols, PTR(sym), &status).data_ptr;
+  if (status == SMB_SUCCESS) {
+    return symbol;
+  }
+
+  symbol = (lisp_symbol*)lisp_new(rt, type_symbol);
   int len = strlen(sym);
-  err->sym = malloc(len + 1);
-  strncpy(err->sym, sym, len);
-  err->sym[len] = '\0';
-  return err;
+  symbol->sym = malloc(len + 1);
+  strncpy(symbol->sym, sym, len);
+  symbol->sym[len] = '\0';
+  symbol->hash = ht_string_hash(PTR(symbol->sym));
+  symbol->epoch = 0;
+  ht_insert(&rt->symbols, PTR(symbol->sym), PTR(symbol));
+  return symbol;
 }
 
 lisp_error *lisp_error_new(lisp_runtime *rt, char *message)
@@ -91,6 +113,68 @@ lisp_builtin *lisp_builtin_new(lisp_runtime *rt, char *name,
   return builtin;
 }
 
+lisp_builtin *lisp_function_new(lisp_runtime *rt, char *name,
+                                lisp_apply_func apply)
+{
+  lisp_builtin *builtin = (lisp_builtin*)lisp_new(rt, type_builtin);
+  builtin->apply = apply;
+  builtin->name = name;
+  return builtin;
+}
+
+static lisp_type *lisp_get_type(char c);
+
+/*
+  A signature is a format like lisp_get_args() takes, giving the type of each
+  argument.  If it ends with "...", the last type is repeated any number of
+  times (including none).  It's parsed here once, so calls only compare types.
+ */
+lisp_builtin *lisp_native_new(lisp_runtime *rt, char *name,
+                              lisp_native_func native, const char *signature)
+{
+  lisp_builtin *builtin = (lisp_builtin*)lisp_new(rt, type_builtin);
+  size_t len = strlen(signature);
+  builtin->native = native;
+  builtin->name = name;
+  builtin->variadic = len >= 4 && strcmp(signature + len - 3, "...") == 0;
+  if (builtin->variadic) {
+    len -= 4;
+    builtin->rest = lisp_get_type(signature[len]);
+  }
+  assert(len <= LISP_NATIVE_MAX_ARGS);
+  builtin->nargs = len;
+  for (size_t i = 0; i < len; i++) {
+    builtin->types[i] = lisp_get_type(signature[i]);
+  }
+  return builtin;
+}
+
+bool lisp_special_form_p(lisp_value *v)
+{
+  lisp_builtin *builtin = (lisp_builtin*) v;
+  return v->type == type_builtin && builtin->apply == NULL &&
+    builtin->native == NULL;
+}
+
+lisp_integer *lisp_integer_new(lisp_runtime *rt, int x)
+{
+  if (x >= LISP_SMALLINT_MIN && x <= LISP_SMALLINT_MAX) {
+    lisp_integer **cached = &rt->smallints[x - LISP_SMALLINT_MIN];
+    if (*cached == NULL) {
+      // Not in the object list, so never swept.  Freed with the runtime.
+      *cached = lisp_alloc(rt, sizeof(lisp_integer));
+      (*cached)->type = type_integer;
+      (*cached)->mark = GC_NOMARK;
+      (*cached)->gen = GC_OLD;
+      (*cached)->x = x;
+    }
+    return *cached;
+  }
+  lisp_integer *integer = (lisp_integer*)lisp_new(rt, type_integer);
+  integer->x = x;
+  return integer;
+}
+
 lisp_value *lisp_nil_new(lisp_runtime *rt)
 {
   if (rt->nil == NULL) {
@@ -105,9 +189,16 @@ lisp_value *lisp_eval_list(lisp_runtime *rt, lisp_scope *scope, lisp_value *l)
     return l;
   }
   lisp_list *list = (lisp_list*) l;
+  size_t roots = rt->nroots;
+  // Evaluate everything before making the list, so that no part of it can
+  // become old (in a collection) before it points at its young values.
+  lisp_value *left = lisp_eval(rt, scope, list->left);
+  lisp_push_root(rt, left);
+  lisp_value *right = lisp_eval_list(rt, scope, list->right);
+  lisp_restore_roots(rt, roots);
   lisp_list *result = (lisp_list*)lisp_new(rt, type_list);
-  result->left = lisp_eval(rt, scope, list->left);
-  result->right = lisp_eval_list(rt, scope, list->right);
+  result->left = left;
+  result->right = right;
   return (lisp_value*) result;
 }
 
@@ -151,6 +242,10 @@ static lisp_type *lisp_get_type(char c)
     return type_builtin;
   case 't':
     return type_type;
+  case 'v':
+    return type_vector;
+  case 'm':
+    return type_hashmap;
   }
   return NULL;
 }
@@ -184,30 +279,22 @@ static lisp_value *lisp_builtin_eval(lisp_runtime *rt, lisp_scope *scope,
   return result;
 }
 
-static lisp_value *lisp_builtin_car(lisp_runtime *rt, lisp_scope *scope,
-                                    lisp_value *a)
+static lisp_value *lisp_builtin_car(lisp_runtime *rt, int argc,
+                                    lisp_value **argv)
 {
-  lisp_list *firstarg;
-  lisp_list *arglist = (lisp_list*) lisp_eval_list(rt, scope, a);
-  if (!lisp_get_args(arglist, "l", &firstarg)) {
-    return (lisp_value*)lisp_error_new(rt, "wrong arguments to car");
-  }
-  if (lisp_list_length(firstarg) == 0) {
+  (void)argc;
+  if (lisp_nil_p(argv[0])) {
     return (lisp_value*)lisp_error_new(rt, "expected at least one item");
   }
-  return firstarg->left;
+  return ((lisp_list*)argv[0])->left;
 }
 
-static lisp_value *lisp_builtin_cdr(lisp_runtime *rt, lisp_scope *scope,
-                                    lisp_value *a)
+static lisp_value *lisp_builtin_cdr(lisp_runtime *rt, int argc,
+                                    lisp_value **argv)
 {
-  lisp_list *firstarg;
-  lisp_list *arglist = (lisp_list*) lisp_eval_list(rt, scope, a);
-  if (!lisp_get_args(arglist, "l", &firstarg)) {
-    return (lisp_value*) lisp_error_new(rt, "wrong arguments to cdr");
-  }
-  // save rv because firstarg may be deleted after decref
-  return firstarg->right;
+  (void)rt;
+  (void)argc;
+  return ((lisp_list*)argv[0])->right;
 }
 
 static lisp_value *lisp_builtin_quote(lisp_runtime *rt, lisp_scope *scope,
@@ -222,18 +309,13 @@ static lisp_value *lisp_builtin_quote(lisp_runtime *rt, lisp_scope *scope,
   return arglist->left;
 }
 
-static lisp_value *lisp_builtin_cons(lisp_runtime *rt, lisp_scope *scope,
-                                     lisp_value *a)
+static lisp_value *lisp_builtin_cons(lisp_runtime *rt, int argc,
+                                     lisp_value **argv)
 {
-  lisp_value *a1;
-  lisp_value *l;
-  lisp_list *arglist = (lisp_list*) lisp_eval_list(rt, scope, a);
-  if (!lisp_get_args(arglist, "**", &a1, &l)) {
-    return (lisp_value*) lisp_error_new(rt, "wrong arguments to cons");
-  }
+  (void)argc;
   lisp_list *new = (lisp_list*)lisp_new(rt, type_list);
-  new->left = a1;
-  new->right = (lisp_value*)l;
+  new->left = argv[0];
+  new->right = argv[1];
   return (lisp_value*)new;
 }
 
@@ -280,174 +362,91 @@ static lisp_value *lisp_builtin_define(lisp_runtime *rt, lisp_scope *scope,
   return evald;
 }
 
-static lisp_value *lisp_builtin_plus(lisp_runtime *rt, lisp_scope *scope,
-                                     lisp_value *a)
+/*
+  The arithmetic and comparison builtins are natives, so their arguments are
+  known to be integers.
+ */
+#define INT(v) (((lisp_integer*)(v))->x)
+
+static lisp_value *lisp_builtin_plus(lisp_runtime *rt, int argc,
+                                     lisp_value **argv)
 {
-  lisp_integer *i;
-  lisp_list *args = (lisp_list*)lisp_eval_list(rt, scope, a);
   int sum = 0;
-
-  while (!lisp_nil_p((lisp_value*)args)) {
-    if (args->left->type != type_integer) {
-      return (lisp_value*) lisp_error_new(rt, "expect integers for addition");
-    }
-    i = (lisp_integer*) args->left;
-    sum += i->x;
-    args = (lisp_list*)args->right;
+  for (int i = 0; i < argc; i++) {
+    sum += INT(argv[i]);
   }
-
-  i = (lisp_integer*)lisp_new(rt, type_integer);
-  i->x = sum;
-  return (lisp_value*)i;
+  return (lisp_value*) lisp_integer_new(rt, sum);
 }
 
-static lisp_value *lisp_builtin_minus(lisp_runtime *rt, lisp_scope *scope,
-                                      lisp_value *a)
+static lisp_value *lisp_builtin_minus(lisp_runtime *rt, int argc,
+                                      lisp_value **argv)
 {
-  lisp_integer *i;
-  lisp_list *args = (lisp_list*)lisp_eval_list(rt, scope, a);
-  int val = 0;
-  int len = lisp_list_length(args);
-
-  if (len < 1) {
-    return (lisp_value*) lisp_error_new(rt, "expected at least one arg");
-  } else if (len == 1) {
-    i = (lisp_integer*) args->left;
-    val = - i->x;
-  } else {
-    i = (lisp_integer*) args->left;
-    val = i->x;
-    args = (lisp_list*)args->right;
-    while (!lisp_nil_p((lisp_value*)args)) {
-      if (args->left->type != type_integer) {
-        return (lisp_value*)lisp_error_new(rt, "expected integer");
-      }
-      i = (lisp_integer*) args->left;
-      val -= i->x;
-      args = (lisp_list*) args->right;
-    }
+  if (argc == 1) {
+    return (lisp_value*) lisp_integer_new(rt, -INT(argv[0]));
   }
-
-  i = (lisp_integer*)lisp_new(rt, type_integer);
-  i->x = val;
-  return (lisp_value*)i;
+  int val = INT(argv[0]);
+  for (int i = 1; i < argc; i++) {
+    val -= INT(argv[i]);
+  }
+  return (lisp_value*) lisp_integer_new(rt, val);
 }
 
-static lisp_value *lisp_builtin_multiply(lisp_runtime *rt, lisp_scope *scope,
-                                         lisp_value *a)
+static lisp_value *lisp_builtin_multiply(lisp_runtime *rt, int argc,
+                                         lisp_value **argv)
 {
-  lisp_integer *i;
-  lisp_list *args = (lisp_list*) lisp_eval_list(rt, scope, a);
   int product = 1;
-
-  while (!lisp_nil_p((lisp_value*)args)) {
-    if (args->left->type != type_integer) {
-      return (lisp_value*) lisp_error_new(rt, "expect integers for multiplication");
-    }
-    i = (lisp_integer*) args->left;
-    product *= i->x;
-    args = (lisp_list*)args->right;
+  for (int i = 0; i < argc; i++) {
+    product *= INT(argv[i]);
   }
-
-  i = (lisp_integer*)lisp_new(rt, type_integer);
-  i->x = product;
-  return (lisp_value*)i;
+  return (lisp_value*) lisp_integer_new(rt, product);
 }
 
-static lisp_value *lisp_builtin_divide(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_value *a)
+static lisp_value *lisp_builtin_divide(lisp_runtime *rt, int argc,
+                                       lisp_value **argv)
 {
-  lisp_integer *i;
-  lisp_list *args = (lisp_list*)lisp_eval_list(rt, scope, a);
-  int val = 0;
-  int len = lisp_list_length(args);
-
-  if (len < 1) {
-    return (lisp_value*) lisp_error_new(rt, "expected at least one arg");
-  }
-  i = (lisp_integer*) args->left;
-  val = i->x;
-  args = (lisp_list*)args->right;
-  while (!lisp_nil_p((lisp_value*)args)) {
-    if (args->left->type != type_integer) {
-      return (lisp_value*)lisp_error_new(rt, "expected integer");
-    }
-    i = (lisp_integer*) args->left;
-    if (i->x == 0) {
+  int val = INT(argv[0]);
+  for (int i = 1; i < argc; i++) {
+    if (INT(argv[i]) == 0) {
       return (lisp_value*) lisp_error_new(rt, "divide by zero");
     }
-    val /= i->x;
-    args = (lisp_list*) args->right;
+    val /= INT(argv[i]);
   }
-
-  i = (lisp_integer*)lisp_new(rt, type_integer);
-  i->x = val;
-  return (lisp_value*)i;
+  return (lisp_value*) lisp_integer_new(rt, val);
 }
 
-static lisp_value *lisp_builtin_cmp_util(lisp_runtime *rt, lisp_scope *scope,
-                                         lisp_value *a)
+static lisp_value *lisp_builtin_eq(lisp_runtime *rt, int argc,
+                                   lisp_value **argv)
 {
-  lisp_integer *first, *second;
-  lisp_list *args = (lisp_list*) lisp_eval_list(rt, scope, a);
-
-  if (!lisp_get_args((lisp_list*)args, "dd", &first, &second)) {
-    return (lisp_value*) lisp_error_new(rt, "expected two integers");
-  }
-
-  lisp_integer *result = (lisp_integer*)lisp_new(rt, type_integer);
-  result->x = first->x - second->x;
-  return (lisp_value*)result;
-}
-
-static lisp_value *lisp_builtin_eq(lisp_runtime *rt, lisp_scope *scope,
-                                   lisp_value *a)
-{
-  lisp_integer *v = (lisp_integer*)lisp_builtin_cmp_util(rt, scope, a);
-  if (v->type == type_integer) {
-    v->x = (v->x == 0);
-  }
-  return (lisp_value*)v;
+  (void)argc;
+  return (lisp_value*) lisp_integer_new(rt, INT(argv[0]) == INT(argv[1]));
 }
 
-static lisp_value *lisp_builtin_gt(lisp_runtime *rt, lisp_scope *scope,
-                                   lisp_value *a)
+static lisp_value *lisp_builtin_gt(lisp_runtime *rt, int argc,
+                                   lisp_value **argv)
 {
-  lisp_integer *v = (lisp_integer*)lisp_builtin_cmp_util(rt, scope, a);
-  if (v->type == type_integer) {
-    v->x = (v->x > 0);
-  }
-  return (lisp_value*)v;
+  (void)argc;
+  return (lisp_value*) lisp_integer_new(rt, INT(argv[0]) > INT(argv[1]));
 }
 
-static lisp_value *lisp_builtin_ge(lisp_runtime *rt, lisp_scope *scope,
-                                   lisp_value *a)
+static lisp_value *lisp_builtin_ge(lisp_runtime *rt, int argc,
+                                   lisp_value **argv)
 {
-  lisp_integer *v = (lisp_integer*)lisp_builtin_cmp_util(rt, scope, a);
-  if (v->type == type_integer) {
-    v->x = (v->x >= 0);
-  }
-  return (lisp_value*)v;
+  (void)argc;
+  return (lisp_value*) lisp_integer_new(rt, INT(argv[0]) >= INT(argv[1]));
 }
 
-static lisp_value *lisp_builtin_lt(lisp_runtime *rt, lisp_scope *scope,
-                                   lisp_value *a)
+static lisp_value *lisp_builtin_lt(lisp_runtime *rt, int argc,
+                                   lisp_value **argv)
 {
-  lisp_integer *v = (lisp_integer*)lisp_builtin_cmp_util(rt, scope, a);
-  if (v->type == type_integer) {
-    v->x = (v->x < 0);
-  }
-  return (lisp_value*)v;
+  (void)argc;
+  return (lisp_value*) lisp_integer_new(rt, INT(argv[0]) < INT(argv[1]));
 }
 
-static lisp_value *lisp_builtin_le(lisp_runtime *rt, lisp_scope *scope,
-                                   lisp_value *a)
+static lisp_value *lisp_builtin_le(lisp_runtime *rt, int argc,
+                                   lisp_value **argv)
 {
-  lisp_integer *v = (lisp_integer*)lisp_builtin_cmp_util(rt, scope, a);
-  if (v->type == type_integer) {
-    v->x = (v->x <= 0);
-  }
-  return (lisp_value*)v;
+  (void)argc;
+  return (lisp_value*) lisp_integer_new(rt, INT(argv[0]) <= INT(argv[1]));
 }
 
 static lisp_value *lisp_builtin_if(lisp_runtime *rt, lisp_scope *scope,
@@ -467,102 +466,59 @@ static lisp_value *lisp_builtin_if(lisp_runtime *rt, lisp_scope *scope,
   }
 }
 
-static lisp_value *lisp_builtin_null_p(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_value *a)
+static lisp_value *lisp_builtin_null_p(lisp_runtime *rt, int argc,
+                                       lisp_value **argv)
 {
-  lisp_value *v;
-  lisp_list *args = (lisp_list*) lisp_eval_list(rt, scope, a);
-
-  if (!lisp_get_args(args, "*", &v)) {
-    return (lisp_value*) lisp_error_new(rt, "expected one argument");
-  }
-
-  lisp_integer *result = (lisp_integer*) lisp_new(rt, type_integer);
-  result->x = (int) lisp_nil_p(v);
-  return (lisp_value*)result;
+  (void)argc;
+  return (lisp_value*) lisp_integer_new(rt, lisp_nil_p(argv[0]));
 }
 
-static lisp_list *get_quoted_left_items(lisp_runtime *rt, lisp_list *list_of_lists)
+static lisp_value *lisp_builtin_map(lisp_runtime *rt, lisp_list *args)
 {
-  lisp_list *left_items = NULL, *rv;
-  while (!lisp_nil_p((lisp_value*)list_of_lists)) {
-    // Create or advance left_items to the next list.
-    if (left_items == NULL) {
-      left_items = (lisp_list*) lisp_new(rt, type_list);
-      rv = left_items;
-    } else {
-      left_items->right = lisp_new(rt, type_list);
-      left_items = (lisp_list*) left_items->right;
-    }
-    // Check the next node in the list to make sure it's actually a list.
-    if (lisp_nil_p(list_of_lists->left)) {
-      return NULL;
-    }
-    // Get the next node in the list and get the argument.
-    lisp_list *l = (lisp_list*) list_of_lists->left;
-    left_items->left = lisp_quote(rt, l->left);
-    list_of_lists = (lisp_list*) list_of_lists->right;
+  int nlists = lisp_list_length(args) - 1;
+  if (nlists < 1) {
+    return (lisp_value*) lisp_error_new(rt, "need at least two arguments");
   }
-  left_items->right = lisp_nil_new(rt);
-  return rv;
-}
 
-static lisp_list *advance_lists(lisp_runtime *rt, lisp_list *list_of_lists)
-{
-  lisp_list *right_items = NULL, *rv;
-  while (!lisp_nil_p((lisp_value*)list_of_lists)) {
-    // Create or advance left_items to the next list.
-    if (right_items == NULL) {
-      right_items = (lisp_list*) lisp_new(rt, type_list);
-      rv = right_items;
-    } else {
-      right_items->right = lisp_new(rt, type_list);
-      right_items = (lisp_list*) right_items->right;
+  // Walk the lists side by side, passing their items straight to the function.
+  lisp_value *f = args->left;
+  lisp_value *lists[nlists], *argv[nlists];
+  lisp_list *it = (lisp_list*) args->right;
+  for (int i = 0; i < nlists; i++) {
+    lists[i] = it->left;
+    it = (lisp_list*) it->right;
+  }
+
+  // The results are kept as roots until the list of them is made.
+  size_t roots = rt->nroots;
+  bool more = true;
+  while (more) {
+    for (int i = 0; i < nlists && more; i++) {
+      if (lists[i]->type != type_list || lisp_nil_p(lists[i])) {
+        more = false;
+      } else {
+        argv[i] = ((lisp_list*)lists[i])->left;
+        lists[i] = ((lisp_list*)lists[i])->right;
+      }
     }
-    // Check the next node in the list to make sure it's actually a list.
-    if (list_of_lists->left->type != type_list) {
-      return NULL;
+    if (more) {
+      lisp_push_root(rt, lisp_apply(rt, f, nlists, argv));
     }
-    // Get the next node in the list and get the argument.
-    lisp_list *l = (lisp_list*) list_of_lists->left;
-    right_items->left = l->right;
-    list_of_lists = (lisp_list*) list_of_lists->right;
   }
-  right_items->right = lisp_nil_new(rt);
-  return rv;
-}
 
-static lisp_value *lisp_builtin_map(lisp_runtime *rt, lisp_scope *scope,
-                                    lisp_value *a)
-{
-  lisp_value *f;
-  lisp_list *ret = NULL, *args, *rv;
-  lisp_list *map_args = (lisp_list *) lisp_eval_list(rt, scope, a);
-
-  // Get the function from the first argument in the list.
-  f = map_args->left;
-  if (map_args->right->type != type_list) {
-    return (lisp_value*) lisp_error_new(rt, "need at least two arguments");
+  lisp_value *rv = lisp_nil_new(rt);
+  for (size_t i = rt->nroots; i > roots; i--) {
+    lisp_list *l = (lisp_list*) lisp_new(rt, type_list);
+    l->left = rt->roots[i - 1];
+    l->right = rv;
+    rv = (lisp_value*)l;
   }
-  map_args = (lisp_list*) map_args->right;
-  while ((args = get_quoted_left_items(rt, map_args)) != NULL) {
-    if (ret == NULL) {
-      ret = (lisp_list*) lisp_new(rt, type_list);
-      rv = ret;
-    } else {
-      ret->right = lisp_new(rt, type_list);
-      ret = (lisp_list*) ret->right;
-    }
-    ret->left = lisp_call(rt, scope, f, (lisp_value*)args);
-    map_args = advance_lists(rt, map_args);
-  }
-  ret->right = lisp_nil_new(rt);
-  return (lisp_value*) rv;
+  lisp_restore_roots(rt, roots);
+  return rv;
 }
 
-static lisp_value *lisp_builtin_reduce(lisp_runtime *rt, lisp_scope *scope, lisp_value *a)
+static lisp_value *lisp_builtin_reduce(lisp_runtime *rt, lisp_list *args)
 {
-  lisp_list *args = (lisp_list*) lisp_eval_list(rt, scope, a);
   int length = lisp_list_length(args);
   lisp_value *callable, *initializer;
   lisp_list *list;
@@ -588,34 +544,297 @@ static lisp_value *lisp_builtin_reduce(lisp_runtime *rt, lisp_scope *scope, lisp
   }
 
   while (!lisp_nil_p((lisp_value*)list)) {
-    initializer = lisp_call(rt, scope, callable,
-                            (lisp_value*) lisp_new_pair_list(rt, initializer, list->left));
+    lisp_value *argv[2] = {initializer, list->left};
+    initializer = lisp_apply(rt, callable, 2, argv);
     list = (lisp_list*) list->right;
   }
   return initializer;
 }
 
+static lisp_value *lisp_builtin_vector(lisp_runtime *rt, int argc,
+                                      lisp_value **argv)
+{
+  lisp_vector *vector = (lisp_vector*) lisp_new(rt, type_vector);
+  for (int i = 0; i < argc; i++) {
+    al_append(&vector->items, PTR(argv[i]));
+  }
+  return (lisp_value*) vector;
+}
+
+static lisp_value *lisp_builtin_vector_ref(lisp_runtime *rt, int argc,
+                                          lisp_value **argv)
+{
+  (void)argc;
+  lisp_vector *vector = (lisp_vector*) argv[0];
+  smb_status status = SMB_SUCCESS;
+  lisp_value *v = al_get(&vector->items, INT(argv[1]), &status).data_ptr;
+  if (status != SMB_SUCCESS) {
+    return (lisp_value*) lisp_error_new(rt, "index out of range");
+  }
+  return v;
+}
+
+static lisp_value *lisp_builtin_vector_set(lisp_runtime *rt, int argc,
+                                          lisp_value **argv)
+{
+  (void)argc;
+  lisp_vector *vector = (lisp_vector*) argv[0];
+  smb_status status = SMB_SUCCESS;
+  al_set(&vector->items, INT(argv[1]), PTR(argv[2]), &status);
+  if (status != SMB_SUCCESS) {
+    return (lisp_value*) lisp_error_new(rt, "index out of range");
+  }
+  vector->dirty = true;
+  return argv[2];
+}
+
+static lisp_value *lisp_builtin_vector_push(lisp_runtime *rt, int argc,
+                                           lisp_value **argv)
+{
+  (void)rt;
+  (void)argc;
+  lisp_vector *vector = (lisp_vector*) argv[0];
+  al_append(&vector->items, PTR(argv[1]));
+  vector->dirty = true;
+  return (lisp_value*) vector;
+}
+
+static lisp_value *lisp_builtin_vector_length(lisp_runtime *rt, int argc,
+                                             lisp_value **argv)
+{
+  (void)argc;
+  lisp_vector *vector = (lisp_vector*) argv[0];
+  return (lisp_value*) lisp_integer_new(rt, al_length(&vector->items));
+}
+
+static lisp_value *lisp_builtin_hashmap(lisp_runtime *rt, int argc,
+                                       lisp_value **argv)
+{
+  if (argc % 2 != 0) {
+    return (lisp_value*) lisp_error_new(rt, "expected keys and values");
+  }
+  lisp_hashmap *map = (lisp_hashmap*) lisp_new(rt, type_hashmap);
+  for (int i = 0; i < argc; i += 2) {
+    ht_insert(&map->table, PTR(argv[i]), PTR(argv[i + 1]));
+  }
+  return (lisp_value*) map;
+}
+
+static lisp_value *lisp_builtin_hashmap_get(lisp_runtime *rt, int argc,
+                                           lisp_value **argv)
+{
+  (void)argc;
+  lisp_hashmap *map = (lisp_hashmap*) argv[0];
+  smb_status status = SMB_SUCCESS;
+  lisp_value *v = ht_get(&map->table, PTR(argv[1]), &status).data_ptr;
+  if (status != SMB_SUCCESS) {
+    return (lisp_value*) lisp_error_new(rt, "key not found");
+  }
+  return v;
+}
+
+static lisp_value *lisp_builtin_hashmap_set(lisp_runtime *rt, int argc,
+                                           lisp_value **argv)
+{
+  (void)rt;
+  (void)argc;
+  lisp_hashmap *map = (lisp_hashmap*) argv[0];
+  ht_insert(&map->table, PTR(argv[1]), PTR(argv[2]));
+  map->dirty = true;
+  return argv[2];
+}
+
+static lisp_value *lisp_builtin_hashmap_has(lisp_runtime *rt, int argc,
+                                           lisp_value **argv)
+{
+  (void)argc;
+  lisp_hashmap *map = (lisp_hashmap*) argv[0];
+  return (lisp_value*) lisp_integer_new(rt,
+                                        ht_contains(&map->table, PTR(argv[1])));
+}
+
+static lisp_value *lisp_builtin_hashmap_remove(lisp_runtime *rt, int argc,
+                                              lisp_value **argv)
+{
+  (void)argc;
+  lisp_hashmap *map = (lisp_hashmap*) argv[0];
+  smb_status status = SMB_SUCCESS;
+  ht_remove(&map->table, PTR(argv[1]), &status);
+  if (status != SMB_SUCCESS) {
+    return (lisp_value*) lisp_error_new(rt, "key not found");
+  }
+  return (lisp_value*) map;
+}
+
+static lisp_value *lisp_builtin_hashmap_length(lisp_runtime *rt, int argc,
+                                              lisp_value **argv)
+{
+  (void)argc;
+  lisp_hashmap *map = (lisp_hashmap*) argv[0];
+  return (lisp_value*) lisp_integer_new(rt, map->table.length);
+}
+
 void lisp_scope_populate_builtins(lisp_runtime *rt, lisp_scope *scope)
 {
   lisp_scope_add_builtin(rt, scope, "eval", lisp_builtin_eval);
-  lisp_scope_add_builtin(rt, scope, "car", lisp_builtin_car);
-  lisp_scope_add_builtin(rt, scope, "cdr", lisp_builtin_cdr);
+  lisp_scope_add_native(rt, scope, "car", lisp_builtin_car, "l");
+  lisp_scope_add_native(rt, scope, "cdr", lisp_builtin_cdr, "l");
   lisp_scope_add_builtin(rt, scope, "quote", lisp_builtin_quote);
-  lisp_scope_add_builtin(rt, scope, "cons", lisp_builtin_cons);
+  lisp_scope_add_native(rt, scope, "cons", lisp_builtin_cons, "**");
   lisp_scope_add_builtin(rt, scope, "lambda", lisp_builtin_lambda);
   lisp_scope_add_builtin(rt, scope, "define", lisp_builtin_define);
-  lisp_scope_add_builtin(rt, scope, "+", lisp_builtin_plus);
-  lisp_scope_add_builtin(rt, scope, "-", lisp_builtin_minus);
-  lisp_scope_add_builtin(rt, scope, "*", lisp_builtin_multiply);
-  lisp_scope_add_builtin(rt, scope, "/", lisp_builtin_divide);
-  lisp_scope_add_builtin(rt, scope, "==", lisp_builtin_eq);
-  lisp_scope_add_builtin(rt, scope, "=", lisp_builtin_eq);
-  lisp_scope_add_builtin(rt, scope, ">", lisp_builtin_gt);
-  lisp_scope_add_builtin(rt, scope, ">=", lisp_builtin_ge);
-  lisp_scope_add_builtin(rt, scope, "<", lisp_builtin_lt);
-  lisp_scope_add_builtin(rt, scope, "<=", lisp_builtin_le);
+  lisp_scope_add_native(rt, scope, "+", lisp_builtin_plus, "d...");
+  lisp_scope_add_native(rt, scope, "-", lisp_builtin_minus, "dd...");
+  lisp_scope_add_native(rt, scope, "*", lisp_builtin_multiply, "d...");
+  lisp_scope_add_native(rt, scope, "/", lisp_builtin_divide, "dd...");
+  lisp_scope_add_native(rt, scope, "==", lisp_builtin_eq, "dd");
+  lisp_scope_add_native(rt, scope, "=", lisp_builtin_eq, "dd");
+  lisp_scope_add_native(rt, scope, ">", lisp_builtin_gt, "dd");
+  lisp_scope_add_native(rt, scope, ">=", lisp_builtin_ge, "dd");
+  lisp_scope_add_native(rt, scope, "<", lisp_builtin_lt, "dd");
+  lisp_scope_add_native(rt, scope, "<=", lisp_builtin_le, "dd");
   lisp_scope_add_builtin(rt, scope, "if", lisp_builtin_if);
-  lisp_scope_add_builtin(rt, scope, "null?", lisp_builtin_null_p);
-  lisp_scope_add_builtin(rt, scope, "map", lisp_builtin_map);
-  lisp_scope_add_builtin(rt, scope, "reduce", lisp_builtin_reduce);
+  lisp_scope_add_native(rt, scope, "null?", lisp_builtin_null_p, "*");
+  // These call back into the evaluator, so they take a list.
+  lisp_scope_add_function(rt, scope, "map", lisp_builtin_map);
+  lisp_scope_add_function(rt, scope, "reduce", lisp_builtin_reduce);
+  lisp_scope_add_native(rt, scope, "vector", lisp_builtin_vector, "*...");
+  lisp_scope_add_native(rt, scope, "vector-ref", lisp_builtin_vector_ref, "vd");
+  lisp_scope_add_native(rt, scope, "vector-set!", lisp_builtin_vector_set,
+                        "vd*");
+  lisp_scope_add_native(rt, scope, "vector-push!", lisp_builtin_vector_push,
+                        "v*");
+  lisp_scope_add_native(rt, scope, "vector-length", lisp_builtin_vector_length,
+                        "v");
+  lisp_scope_add_native(rt, scope, "hashmap", lisp_builtin_hashmap, "*...");
+  lisp_scope_add_native(rt, scope, "hashmap-get", lisp_builtin_hashmap_get,
+                        "m*");
+  lisp_scope_add_native(rt, scope, "hashmap-set!", lisp_builtin_hashmap_set,
+                        "m**");
+  lisp_scope_add_native(rt, scope, "hashmap-has?", lisp_builtin_hashmap_has,
+                        "m*");
+  lisp_scope_add_native(rt, scope, "hashmap-remove!",
+                        lisp_builtin_hashmap_remove, "m*");
+  lisp_scope_add_native(rt, scope, "hashmap-length",
+                        lisp_builtin_hashmap_length, "m");
+}
+static unsigned int pointer_hash(DATA d)
+{
+  return (unsigned int) ((uintptr_t)d.data_ptr >> 4);
+}
+
+/*
+  Copy a value into rt.  Copies made so far are kept in memo, so values shared
+  (or cycles, through vectors and hashmaps) are copied once.
+ */
+static lisp_value *clone(lisp_runtime *rt, smb_ht *memo, lisp_value *v)
+{
+  smb_status status = SMB_SUCCESS;
+  lisp_value *copy = ht_get(memo, PTR(v), &status).data_ptr;
+  if (status == SMB_SUCCESS) {
+    return copy;
+  }
+
+  if (v->type == type_integer) {
+    copy = (lisp_value*) lisp_integer_new(rt, ((lisp_integer*)v)->x);
+  } else if (v->type == type_symbol) {
+    copy = (lisp_value*) lisp_symbol_new(rt, ((lisp_symbol*)v)->sym);
+  } else if (v->type == type_error) {
+    copy = (lisp_value*) lisp_error_new(rt, ((lisp_error*)v)->message);
+  } else if (v->type == type_string) {
+    lisp_string *str = (lisp_string*) lisp_new(rt, type_string);
+    str->s = malloc(strlen(((lisp_string*)v)->s) + 1);
+    strcpy(str->s, ((lisp_string*)v)->s);
+    copy = (lisp_value*) str;
+  } else if (v->type == type_builtin) {
+    lisp_builtin *from = (lisp_builtin*) v;
+    lisp_builtin *builtin = (lisp_builtin*) lisp_new(rt, type_builtin);
+    builtin->call = from->call;
+    builtin->apply = from->apply;
+    builtin->native = from->native;
+    builtin->name = from->name;
+    builtin->nargs = from->nargs;
+    builtin->variadic = from->variadic;
+    memcpy(builtin->types, from->types, sizeof(builtin->types));
+    builtin->rest = from->rest;
+    copy = (lisp_value*) builtin;
+  } else if (lisp_nil_p(v)) {
+    copy = lisp_nil_new(rt);
+  }
+  if (copy) {
+    ht_insert(memo, PTR(v), PTR(copy));
+    return copy;
+  }
+
+  // The rest can contain themselves, so they are in the memo before their
+  // contents are copied.
+  if (v->type == type_list) {
+    lisp_list *list = (lisp_list*) lisp_new(rt, type_list);
+    ht_insert(memo, PTR(v), PTR(list));
+    list->left = clone(rt, memo, ((lisp_list*)v)->left);
+    list->right = clone(rt, memo, ((lisp_list*)v)->right);
+    return (lisp_value*) list;
+  } else if (v->type == type_scope) {
+    lisp_scope *from = (lisp_scope*) v;
+    lisp_scope *scope = (lisp_scope*) lisp_new(rt, type_scope);
+    ht_insert(memo, PTR(v), PTR(scope));
+    scope->up = from->up ? (lisp_scope*) clone(rt, memo, (lisp_value*)from->up) : NULL;
+    smb_iter it = ht_get_iter(&from->scope);
+    while (it.has_next(&it)) {
+      lisp_value *key = it.next(&it, &status).data_ptr;
+      lisp_value *value = ht_get(&from->scope, PTR(key), &status).data_ptr;
+      lisp_scope_bind(scope, (lisp_symbol*) clone(rt, memo, key),
+                      clone(rt, memo, value));
+    }
+    it.destroy(&it);
+    return (lisp_value*) scope;
+  } else if (v->type == type_lambda && ((lisp_lambda*)v)->env == NULL) {
+    // The copy is compiled again when it is first called.
+    lisp_lambda *from = (lisp_lambda*) v;
+    lisp_lambda *lambda = (lisp_lambda*) lisp_new(rt, type_lambda);
+    ht_insert(memo, PTR(v), PTR(lambda));
+    lambda->args = (lisp_list*) clone(rt, memo, (lisp_value*)from->args);
+    lambda->code = clone(rt, memo, from->code);
+    lambda->closure = (lisp_scope*) clone(rt, memo, (lisp_value*)from->closure);
+    return (lisp_value*) lambda;
+  } else if (v->type == type_vector) {
+    lisp_vector *from = (lisp_vector*) v;
+    lisp_vector *vector = (lisp_vector*) lisp_new(rt, type_vector);
+    ht_insert(memo, PTR(v), PTR(vector));
+    for (int i = 0; i < from->items.length; i++) {
+      al_append(&vector->items,
+                PTR(clone(rt, memo, from->items.data[i].data_ptr)));
+    }
+    return (lisp_value*) vector;
+  } else if (v->type == type_hashmap) {
+    lisp_hashmap *from = (lisp_hashmap*) v;
+    lisp_hashmap *map = (lisp_hashmap*) lisp_new(rt, type_hashmap);
+    ht_insert(memo, PTR(v), PTR(map));
+    smb_iter it = ht_get_iter(&from->table);
+    while (it.has_next(&it)) {
+      lisp_value *key = it.next(&it, &status).data_ptr;
+      lisp_value *value = ht_get(&from->table, PTR(key), &status).data_ptr;
+      // Insert the key after copying the value, since the value may contain
+      // the map itself.
+      lisp_value *keycopy = clone(rt, memo, key);
+      ht_insert(&map->table, PTR(keycopy), PTR(clone(rt, memo, value)));
+    }
+    it.destroy(&it);
+    return (lisp_value*) map;
+  }
+
+  // Lambdas made by compiled code keep their arguments in envs, and other
+  // types may hold anything.
+  copy = (lisp_value*) lisp_error_new(rt, "value can't be cloned");
+  ht_insert(memo, PTR(v), PTR(copy));
+  return copy;
+}
+
+lisp_scope *lisp_scope_clone(lisp_runtime *rt, lisp_scope *scope)
+{
+  smb_ht memo;
+  ht_init(&memo, pointer_hash, data_compare_pointer);
+  lisp_scope *copy = (lisp_scope*) clone(rt, &memo, (lisp_value*)scope);
+  ht_destroy(&memo);
+  return copy;
 }
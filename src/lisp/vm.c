@@ -0,0 +1,246 @@
+/*
+  The bytecode VM.
+
+  Values are kept on a stack in the runtime.  A call to a compiled lambda
+  pushes a frame and continues in the same loop, so Lisp calls between compiled
+  lambdas don't use the C stack.  Its arguments stay where the caller pushed
+  them, just above the lambda itself, and the frame's base points at the first
+  one.  When it returns, the lambda and its arguments are replaced by the
+  result.  A call in tail position replaces the caller's frame instead, so
+  loops written as tail recursion run in constant space.
+
+  Native builtins are called with their arguments where they are on the stack.
+  Anything else (other builtins, and lambdas which couldn't be compiled) is
+  called with a list of the argument values, leaving the stack alone.
+
+  Each GLOBAL op caches what it found.  A symbol's epoch changes whenever it's
+  bound in any scope, so the cached value is used for as long as the epoch and
+  the scope it was looked up from are the same, and hot calls to builtins skip
+  the walk through the scopes' hash tables.  Errors (for symbols not found)
+  aren't cached.
+
+  Lambdas made by a call may outlive it, along with the arguments they refer
+  to.  So when a body makes lambdas, its frame copies the arguments into an env
+  on entry, and the lambdas it makes keep a reference to that.
+
+  Calls are safe points for the collector.  The stack and the frames' envs are
+  roots, so everything a call is using is reachable then.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/lisp.h"
+
+static void push(lisp_runtime *rt, lisp_value *v)
+{
+  if (rt->nstack == rt->stackalloc) {
+    rt->stackalloc = rt->stackalloc ? 2 * rt->stackalloc : 64;
+    rt->stack = realloc(rt->stack, rt->stackalloc * sizeof(lisp_value*));
+  }
+  rt->stack[rt->nstack++] = v;
+}
+
+/*
+  Get the bytecode of a lambda, compiling it if this is the first call.
+ */
+static lisp_bytecode *bytecode(lisp_runtime *rt, lisp_lambda *lambda)
+{
+  if (!lambda->bytecode && !lambda->interpret) {
+    lambda->bytecode = lisp_compile(rt, lambda);
+    lambda->interpret = (lambda->bytecode == NULL);
+  }
+  return lambda->bytecode;
+}
+
+/*
+  Push a frame for a compiled lambda with argc arguments on top of the stack.
+  Returns an error if the number of arguments is wrong.
+ */
+static lisp_value *enter(lisp_runtime *rt, lisp_lambda *lambda, int argc)
+{
+  if (argc < lambda->bytecode->nargs) {
+    return (lisp_value*) lisp_error_new(rt, "not enough arguments");
+  } else if (argc > lambda->bytecode->nargs) {
+    return (lisp_value*) lisp_error_new(rt, "too many arguments");
+  }
+
+  if (rt->nframes == rt->framealloc) {
+    rt->framealloc = rt->framealloc ? 2 * rt->framealloc : 16;
+    rt->frames = realloc(rt->frames, rt->framealloc * sizeof(lisp_frame));
+  }
+  lisp_env *env = NULL;
+  if (lambda->bytecode->nlambdas > 0) {
+    env = (lisp_env*) lisp_new(rt, type_env);
+    env->lambda = lambda;
+    env->up = lambda->env;
+    env->nslots = argc;
+    env->slots = malloc(argc * sizeof(lisp_value*));
+    for (int i = 0; i < argc; i++) {
+      env->slots[i] = rt->stack[rt->nstack - argc + i];
+    }
+  }
+  rt->frames[rt->nframes++] = (lisp_frame){
+    .lambda=lambda, .env=env, .pc=0, .base=rt->nstack - argc
+  };
+  if (rt->profile) {
+    lisp_profile_enter(rt, (lisp_value*)lambda);
+  }
+  return NULL;
+}
+
+/*
+  Run a compiled lambda, which has been pushed along with its argc arguments.
+ */
+static lisp_value *run(lisp_runtime *rt, lisp_lambda *lambda, int argc)
+{
+  size_t entry = rt->nframes;
+  lisp_value *error = enter(rt, lambda, argc);
+  if (error) {
+    rt->nstack -= argc + 1;
+    return error;
+  }
+
+  while (true) {
+    lisp_frame *f = &rt->frames[rt->nframes - 1];
+    lisp_bytecode *code = f->lambda->bytecode;
+    int op = code->ops[f->pc++];
+    int arg = (op == LISP_RETURN) ? 0 : code->ops[f->pc++];
+
+    switch (op) {
+    case LISP_CONST:
+      push(rt, code->consts[arg]);
+      break;
+    case LISP_ARG:
+      push(rt, rt->stack[f->base + arg]);
+      break;
+    case LISP_GLOBAL: {
+      lisp_symbol *symbol = (lisp_symbol*) code->consts[arg];
+      lisp_global_cache *cache = &code->globals[arg];
+      if (cache->closure != f->lambda->closure ||
+          cache->epoch != symbol->epoch) {
+        lisp_value *v = lisp_scope_lookup(rt, f->lambda->closure, symbol);
+        if (v->type == type_error) {
+          push(rt, v);
+          break;
+        }
+        *cache = (lisp_global_cache){
+          .closure=f->lambda->closure, .value=v, .epoch=symbol->epoch
+        };
+      }
+      push(rt, cache->value);
+      break;
+    }
+    case LISP_OUTER: {
+      lisp_env *env = f->lambda->env;
+      for (int depth = 1; depth < arg; depth++) {
+        env = env->up;
+      }
+      push(rt, env->slots[code->ops[f->pc++]]);
+      break;
+    }
+    case LISP_LAMBDA: {
+      lisp_list *form = (lisp_list*) code->consts[arg];
+      lisp_lambda *l = (lisp_lambda*) lisp_new(rt, type_lambda);
+      l->args = (lisp_list*) form->left;
+      l->code = ((lisp_list*)form->right)->left;
+      l->closure = f->lambda->closure;
+      l->bytecode = code->lambdas[code->ops[f->pc++]];
+      l->env = f->env;
+      push(rt, (lisp_value*)l);
+      break;
+    }
+    case LISP_JUMP:
+      f->pc = arg;
+      break;
+    case LISP_JUMPF: {
+      lisp_value *v = rt->stack[--rt->nstack];
+      if (v->type != type_integer || ((lisp_integer*)v)->x == 0) {
+        f->pc = arg;
+      }
+      break;
+    }
+    case LISP_TAILCALL: {
+      lisp_safepoint(rt);
+      lisp_value *callee = rt->stack[rt->nstack - arg - 1];
+      if (callee->type == type_lambda && bytecode(rt, (lisp_lambda*)callee) &&
+          ((lisp_lambda*)callee)->bytecode->nargs == arg) {
+        // Move the callee and its arguments over the current frame's.
+        size_t dst = f->base - 1;
+        memmove(&rt->stack[dst], &rt->stack[rt->nstack - arg - 1],
+                (arg + 1) * sizeof(lisp_value*));
+        rt->nstack = dst + arg + 1;
+        if (rt->profile) {
+          lisp_profile_exit(rt, (lisp_value*)f->lambda);
+        }
+        rt->nframes--;
+        enter(rt, (lisp_lambda*)callee, arg);
+        break;
+      }
+    }
+    // fall through - the frame can't be replaced
+    case LISP_CALL: {
+      lisp_safepoint(rt);
+      lisp_value *callee = rt->stack[rt->nstack - arg - 1];
+      if (callee->type == type_lambda &&
+          bytecode(rt, (lisp_lambda*)callee)) {
+        error = enter(rt, (lisp_lambda*)callee, arg);
+        if (!error) {
+          break; // continue in the new frame
+        }
+        rt->nstack -= arg;
+        rt->stack[rt->nstack - 1] = error;
+      } else if (callee->type == type_builtin &&
+                 ((lisp_builtin*)callee)->native) {
+        lisp_value *result = lisp_native_call(rt, (lisp_builtin*)callee, arg,
+                                              &rt->stack[rt->nstack - arg]);
+        rt->nstack -= arg;
+        rt->stack[rt->nstack - 1] = result;
+      } else {
+        // The arguments are made into a list before anything else is
+        // pushed, since callee isn't a compiled lambda.
+        lisp_value *result = lisp_apply(rt, callee, arg,
+                                        &rt->stack[rt->nstack - arg]);
+        rt->nstack -= arg;
+        rt->stack[rt->nstack - 1] = result;
+      }
+      break;
+    }
+    case LISP_RETURN: {
+      lisp_value *result = rt->stack[rt->nstack - 1];
+      if (rt->profile) {
+        lisp_profile_exit(rt, (lisp_value*)f->lambda);
+      }
+      rt->nstack = f->base - 1;
+      rt->nframes--;
+      if (rt->nframes == entry) {
+        return result;
+      }
+      push(rt, result);
+      break;
+    }
+    }
+  }
+}
+
+lisp_value *lisp_vm_run(lisp_runtime *rt, lisp_lambda *lambda, lisp_list *args)
+{
+  int argc = 0;
+  push(rt, (lisp_value*)lambda);
+  while (!lisp_nil_p((lisp_value*)args)) {
+    push(rt, args->left);
+    args = (lisp_list*) args->right;
+    argc++;
+  }
+  return run(rt, lambda, argc);
+}
+
+lisp_value *lisp_vm_call(lisp_runtime *rt, lisp_lambda *lambda, int argc,
+                         lisp_value **argv)
+{
+  push(rt, (lisp_value*)lambda);
+  for (int i = 0; i < argc; i++) {
+    push(rt, argv[i]);
+  }
+  return run(rt, lambda, argc);
+}
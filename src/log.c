@@ -13,11 +13,57 @@
 
 *******************************************************************************/
 
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "libstephen/cb.h"
 #include "libstephen/log.h"
+#include "libstephen/rb.h"
+
+/**
+   @brief The most messages written in one batch (and one writev()).
+ */
+#define SL_ASYNC_BATCH 64
+
+/**
+   @brief A formatted message waiting in an asynchronous logger's queue.
+ */
+typedef struct {
+  int level;
+  int length;
+  char *text;
+} sl_record;
+
+/*
+  The state of an asynchronous logger.  Messages go through a lock-free queue,
+  so logging threads never wait for each other, or for the writer.  The lock
+  and condition variables are only for sleeping: the writer sleeps when the
+  queue is empty (setting `sleeping` so that loggers know to wake it), and
+  sl_flush() sleeps until `written` catches up.
+ */
+struct sl_async {
+  smb_rb_mpmc queue;
+  smb_logasync config;
+  smb_logger *logger;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  atomic_bool sleeping;
+  atomic_bool stopping;
+  atomic_ulong queued;
+  atomic_ulong flush_target;
+  atomic_ulong dropped;
+  unsigned long written;
+};
 
 /*
   This is the "permanent" default logger.  Even when you set your own default
@@ -26,21 +72,18 @@
   should go to standard out.  Unfortunately, you can't statically declare an
   instance of a struct that uses the variable stdout, so this is declared
   without any handlers, and the first time the default logger is referenced, the
-  default log handler is added.
+  default log handler is added (exactly once, even if threads race to it).  Its
+  min_level already matches that handler, so sl_enabled() is right before then.
  */
 static smb_logger default_logger = {
   .format = SMB_DEFAULT_LOGFORMAT,
-  .num = 0
+  .num = 0,
+  .min_level = SMB_DEFAULT_LOGLEVEL
 };
 
-/*
-  The only reason this pointer exists is so that reference_logger() knows
-  whether or not the default logger has been set up yet.  This variable remains
-  NULL until the first time the default logger is used, at which point the
-  default handler is added to it, and then pdefault_logger is set to
-  &default_logger.
- */
-static smb_logger *pdefault_logger = NULL;
+static pthread_once_t default_once = PTHREAD_ONCE_INIT;
+
+smb_logger *sl_default_logger = &default_logger;
 
 static char *level_names[] = {"NOTSET", "DEBUG", "INFO",
                               "WARNING", "ERROR", "CRITICAL"};
@@ -50,18 +93,32 @@ static char *level_names[] = {"NOTSET", "DEBUG", "INFO",
   Essentially, if obj=NULL, it replaces obj with a pointer to the default
   logger.  If the default logger hasn't been set up, it sets it up.
  */
+static void add_default_handler(void)
+{
+  default_logger.handlers[0] = (smb_loghandler){.level = SMB_DEFAULT_LOGLEVEL,
+                                                .dst   = SMB_DEFAULT_LOGDEST};
+  default_logger.num = 1;
+}
+
 static void reference_logger(smb_logger **obj)
 {
-  smb_status status = SMB_SUCCESS;
   if (*obj == NULL) {
-    if (pdefault_logger == NULL) {
-      sl_add_handler(&default_logger,
-                     (smb_loghandler){.level = SMB_DEFAULT_LOGLEVEL,
-                                      .dst   = SMB_DEFAULT_LOGDEST},
-                     &status);
-      pdefault_logger = &default_logger;
+    pthread_once(&default_once, add_default_handler);
+    *obj = sl_default_logger;
+  }
+}
+
+/*
+  Recompute the lowest level of any handler, after the handlers change.
+ */
+static void update_min_level(smb_logger *obj)
+{
+  int i;
+  obj->min_level = INT_MAX;
+  for (i = 0; i < obj->num; i++) {
+    if (obj->handlers[i].level < obj->min_level) {
+      obj->min_level = obj->handlers[i].level;
     }
-    *obj = pdefault_logger;
   }
 }
 
@@ -69,6 +126,8 @@ void sl_init(smb_logger *obj)
 {
   obj->format = SMB_DEFAULT_LOGFORMAT;
   obj->num = 0;
+  obj->min_level = INT_MAX;
+  obj->async = NULL;
 }
 
 smb_logger *sl_create(void)
@@ -79,8 +138,7 @@ smb_logger *sl_create(void)
 }
 
 void sl_destroy(smb_logger *obj) {
-  (void)obj; // unused
-  // nothing to delete
+  sl_stop_async(obj);
 }
 
 void sl_delete(smb_logger *obj) {
@@ -95,6 +153,7 @@ void sl_set_level(smb_logger *obj, int level)
   for (i = 0; i < obj->num; i++) {
     obj->handlers[i].level = level;
   }
+  update_min_level(obj);
 }
 
 void sl_add_handler(smb_logger *obj, smb_loghandler h, smb_status *status)
@@ -102,6 +161,7 @@ void sl_add_handler(smb_logger *obj, smb_loghandler h, smb_status *status)
   reference_logger(&obj);
   if (obj->num < SMB_MAX_LOGHANDLERS) {
     obj->handlers[obj->num++] = h;
+    update_min_level(obj);
   } else {
     *status = SMB_INDEX_ERROR;
   }
@@ -111,42 +171,316 @@ void sl_clear_handlers(smb_logger *obj)
 {
   reference_logger(&obj);
   obj->num = 0;
+  update_min_level(obj);
 }
 
 void sl_set_default_logger(smb_logger *obj)
 {
   if (obj == NULL)
     obj = &default_logger;
-  pdefault_logger = obj;
+  sl_default_logger = obj;
 }
 
-/*
-  Returns a string representing a log level.  Very much not thread safe (but in
-  reality, I don't think anything about this logger library is thread safe, so
-  whatever ¯\_(ツ)_/¯ ).
- */
-static char *sl_level_string(int level) {
-  static char buf[20]; // plenty of space, to be safe.
+char *sl_level_string(int level, char buf[SL_LEVEL_BUF]) {
   if (level % 10 == 0 && level >= LEVEL_NOTSET && level <= LEVEL_CRITICAL) {
     return level_names[level / 10];
   } else {
-    snprintf(buf, 20, "%d", level);
+    snprintf(buf, SL_LEVEL_BUF, "%d", level);
     return buf;
   }
 }
 
 bool sl_will_log(smb_logger *obj, int level)
 {
-  for (int i = 0; i < obj->num; i++) {
-    if (obj->handlers[i].level <= level) {
-      return true;
+  return level >= obj->min_level;
+}
+
+/*
+  Milliseconds on the monotonic clock, for timing batches.
+ */
+static long long sl_now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+  Write every byte described by an iovec array, resuming after short writes.
+ */
+static void sl_writev_all(int fd, struct iovec *iov, int count)
+{
+  while (count > 0) {
+    ssize_t n = writev(fd, iov, count);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return; // nowhere left to report it
+    }
+    while (count > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char*)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+}
+
+/*
+  Write a batch of records to every handler that accepts them, and free them.
+ */
+static void sl_write_batch(struct sl_async *a, sl_record *batch, int n)
+{
+  struct iovec iov[SL_ASYNC_BATCH];
+  int h, i, count;
+  smb_logger *obj = a->logger;
+
+  for (h = 0; h < obj->num; h++) {
+    count = 0;
+    for (i = 0; i < n; i++) {
+      if (obj->handlers[h].level <= batch[i].level) {
+        iov[count].iov_base = batch[i].text;
+        iov[count].iov_len = batch[i].length;
+        count++;
+      }
+    }
+    if (count > 0) {
+      // Anything written through the FILE itself goes first.
+      fflush(obj->handlers[h].dst);
+      sl_writev_all(fileno(obj->handlers[h].dst), iov, count);
+    }
+  }
+  for (i = 0; i < n; i++) {
+    smb_free(batch[i].text);
+  }
+
+  pthread_mutex_lock(&a->lock);
+  a->written += n;
+  pthread_cond_broadcast(&a->done);
+  pthread_mutex_unlock(&a->lock);
+}
+
+/*
+  Whether sl_flush() is waiting for records which haven't been written.
+ */
+static bool sl_flush_wanted(struct sl_async *a)
+{
+  return atomic_load(&a->flush_target) > a->written + atomic_load(&a->dropped);
+}
+
+/*
+  Sleep until a logger wakes us, or until the deadline (if there is one).
+  Returns true if a record was popped into *rec instead.
+ */
+static bool sl_writer_sleep(struct sl_async *a, sl_record *rec, long long deadline)
+{
+  bool popped;
+  pthread_mutex_lock(&a->lock);
+  atomic_store(&a->sleeping, true);
+  // Check again now that loggers will wake us, so no push is missed.  The
+  // fence pairs with the one in sl_async_log(): either we see the record, or
+  // the logger sees that we're sleeping.
+  atomic_thread_fence(memory_order_seq_cst);
+  popped = rb_mpmc_try_pop(&a->queue, rec);
+  if (!popped && !atomic_load(&a->stopping) && !sl_flush_wanted(a)) {
+    if (deadline < 0) {
+      pthread_cond_wait(&a->wake, &a->lock);
+    } else {
+      struct timespec ts = {deadline / 1000, (deadline % 1000) * 1000000};
+      pthread_cond_timedwait(&a->wake, &a->lock, &ts);
     }
   }
-  return false;
+  atomic_store(&a->sleeping, false);
+  pthread_mutex_unlock(&a->lock);
+  return popped;
+}
+
+/*
+  The writer thread.  It gathers records into a batch, and writes the batch
+  when it's full, large enough, old enough, or somebody is waiting for it.
+ */
+static void *sl_writer(void *arg)
+{
+  struct sl_async *a = arg;
+  sl_record batch[SL_ASYNC_BATCH];
+  size_t bytes = 0;
+  long long first = 0;
+  int n = 0;
+
+  while (true) {
+    bool got = rb_mpmc_try_pop(&a->queue, &batch[n]);
+    if (!got) {
+      bool urgent = atomic_load(&a->stopping) || sl_flush_wanted(a);
+      if (n > 0 && (urgent || sl_now_ms() - first >= a->config.flush_ms)) {
+        sl_write_batch(a, batch, n);
+        n = 0;
+        bytes = 0;
+        continue;
+      }
+      if (n == 0 && atomic_load(&a->stopping)) {
+        break;
+      }
+      got = sl_writer_sleep(a, &batch[n],
+                            n > 0 ? first + a->config.flush_ms : -1);
+    }
+    if (got) {
+      if (n == 0) {
+        first = sl_now_ms();
+      }
+      bytes += batch[n].length;
+      n++;
+      if (n == SL_ASYNC_BATCH || bytes >= a->config.flush_bytes) {
+        sl_write_batch(a, batch, n);
+        n = 0;
+        bytes = 0;
+      }
+    }
+  }
+  return NULL;
+}
+
+/*
+  Queue a formatted message, which the writer thread will free.
+ */
+static void sl_async_log(struct sl_async *a, int level, char *text, int length)
+{
+  sl_record rec = {level, length, text};
+
+  // Count the message before it's visible, so that sl_flush() waits for it.
+  atomic_fetch_add(&a->queued, 1);
+  if (a->config.policy == SL_ASYNC_DROP) {
+    if (!rb_mpmc_try_push(&a->queue, &rec)) {
+      smb_free(text);
+      pthread_mutex_lock(&a->lock);
+      atomic_fetch_add(&a->dropped, 1);
+      pthread_cond_broadcast(&a->done);
+      pthread_mutex_unlock(&a->lock);
+      return;
+    }
+  } else {
+    rb_mpmc_push(&a->queue, &rec);
+  }
+
+  // The push only releases the record, so without a full fence the load of
+  // sleeping could be ordered before it, and miss a writer going to sleep.
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load(&a->sleeping)) {
+    pthread_mutex_lock(&a->lock);
+    pthread_cond_signal(&a->wake);
+    pthread_mutex_unlock(&a->lock);
+  }
+}
+
+void sl_start_async(smb_logger *obj, smb_logasync config, smb_status *status)
+{
+  struct sl_async *a;
+  pthread_condattr_t attr;
+
+  reference_logger(&obj);
+  if (obj->async) {
+    return;
+  }
+
+  // The queue's counters are aligned to cache lines, which malloc() doesn't
+  // promise, so the state is allocated aligned (and freed with free()).
+  a = aligned_alloc(_Alignof(struct sl_async), sizeof(struct sl_async));
+  if (!a) {
+    *status = SMB_IO_ERROR;
+    return;
+  }
+  rb_mpmc_init(&a->queue, sizeof(sl_record), config.capacity);
+  a->config = config;
+  a->logger = obj;
+  pthread_mutex_init(&a->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&a->wake, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_cond_init(&a->done, NULL);
+  atomic_init(&a->sleeping, false);
+  atomic_init(&a->stopping, false);
+  atomic_init(&a->queued, 0);
+  atomic_init(&a->flush_target, 0);
+  atomic_init(&a->dropped, 0);
+  a->written = 0;
+
+  if (pthread_create(&a->thread, NULL, sl_writer, a) != 0) {
+    pthread_cond_destroy(&a->done);
+    pthread_cond_destroy(&a->wake);
+    pthread_mutex_destroy(&a->lock);
+    rb_mpmc_destroy(&a->queue);
+    free(a);
+    *status = SMB_IO_ERROR;
+    return;
+  }
+  obj->async = a;
+}
+
+void sl_stop_async(smb_logger *obj)
+{
+  struct sl_async *a;
+
+  reference_logger(&obj);
+  a = obj->async;
+  if (!a) {
+    return;
+  }
+
+  pthread_mutex_lock(&a->lock);
+  atomic_store(&a->stopping, true);
+  pthread_cond_signal(&a->wake);
+  pthread_mutex_unlock(&a->lock);
+  pthread_join(a->thread, NULL);
+
+  obj->async = NULL;
+  pthread_cond_destroy(&a->done);
+  pthread_cond_destroy(&a->wake);
+  pthread_mutex_destroy(&a->lock);
+  rb_mpmc_destroy(&a->queue);
+  free(a);
+}
+
+void sl_flush(smb_logger *obj)
+{
+  struct sl_async *a;
+  unsigned long target, current;
+  int i;
+
+  reference_logger(&obj);
+  a = obj->async;
+  if (!a) {
+    for (i = 0; i < obj->num; i++) {
+      fflush(obj->handlers[i].dst);
+    }
+    return;
+  }
+
+  target = atomic_load(&a->queued);
+  pthread_mutex_lock(&a->lock);
+  current = atomic_load(&a->flush_target);
+  while (current < target &&
+         !atomic_compare_exchange_weak(&a->flush_target, &current, target)) {
+  }
+  pthread_cond_signal(&a->wake);
+  while (a->written + atomic_load(&a->dropped) < target) {
+    pthread_cond_wait(&a->done, &a->lock);
+  }
+  pthread_mutex_unlock(&a->lock);
+}
+
+unsigned long sl_dropped(smb_logger *obj)
+{
+  reference_logger(&obj);
+  return obj->async ? atomic_load(&obj->async->dropped) : 0;
 }
 
 void sl_log(smb_logger *obj, char *file, int line, const char *function, int level, ...) {
   cbuf file_line_buf, message_buf;
+  char file_line_local[256], message_local[1024], level_buf[SL_LEVEL_BUF];
   char *level_string, *format;
   va_list va;
   int i;
@@ -157,16 +491,29 @@ void sl_log(smb_logger *obj, char *file, int line, const char *function, int lev
     return; // early termination to prevent formatting if we can avoid it
   }
 
-  cb_init(&file_line_buf, 256);
-  cb_printf(&file_line_buf, "%s:%d", file, line);
+  cb_init_local(&file_line_buf, file_line_local, sizeof(file_line_local));
+  cb_concat(&file_line_buf, file);
+  cb_append(&file_line_buf, ':');
+  cb_append_int(&file_line_buf, line);
 
   va_start(va, level);
   format = va_arg(va, char*);
-  cb_init(&message_buf, 1024);
+  cb_init_local(&message_buf, message_local, sizeof(message_local));
   cb_vprintf(&message_buf, format, va);
   va_end(va);
 
-  level_string = sl_level_string(level);
+  level_string = sl_level_string(level, level_buf);
+  if (obj->async) {
+    cbuf out;
+    cb_init(&out, file_line_buf.length + message_buf.length + 64);
+    cb_printf(&out, obj->format, file_line_buf.buf, function, level_string,
+              message_buf.buf);
+    i = out.length;
+    sl_async_log(obj->async, level, cb_steal(&out), i);
+    cb_destroy(&file_line_buf);
+    cb_destroy(&message_buf);
+    return;
+  }
   for (i = 0; i < obj->num; i++) {
     if (obj->handlers[i].level <= level) {
       fprintf(obj->handlers[i].dst, obj->format, file_line_buf.buf, function,
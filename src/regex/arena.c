@@ -0,0 +1,91 @@
+/***************************************************************************//**
+
+  @file         arena.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Bump allocation for the temporary data of a compile.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on the arena:
+
+  Compiling a regex makes a parse tree node for nearly every character of the
+  pattern, and a fragment for every instruction, all of which are thrown away
+  once the program is assembled.  Allocating them one at a time made compiling
+  many patterns spend most of its time in malloc() and free().
+
+  An arena hands out memory by bumping a pointer through a block, and frees all
+  of its blocks at once.  The first block is inside the Arena itself (usually
+  on the stack), which is enough for most patterns.  After that, each block is
+  twice as large as the one before it, so even a huge pattern needs only a few
+  allocations.
+
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/re_internals.h"
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+struct ArenaBlock {
+  ArenaBlock *next;
+  max_align_t data[];
+};
+
+void arenainit(Arena *a)
+{
+  a->blocks = NULL;
+  a->next = (char *) a->local;
+  a->end = (char *) a->local + sizeof(a->local);
+  a->blocksize = sizeof(a->local);
+}
+
+void *arenaalloc(Arena *a, size_t size)
+{
+  if (a == NULL) {
+    return calloc(1, size);
+  }
+
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if ((size_t)(a->end - a->next) < size) {
+    a->blocksize *= 2;
+    while (a->blocksize < size) {
+      a->blocksize *= 2;
+    }
+    ArenaBlock *b = malloc(sizeof(ArenaBlock) + a->blocksize);
+    b->next = a->blocks;
+    a->blocks = b;
+    a->next = (char *) b->data;
+    a->end = (char *) b->data + a->blocksize;
+  }
+
+  void *p = a->next;
+  a->next += size;
+  memset(p, 0, size);
+  return p;
+}
+
+void arenarelease(Arena *a, void *p)
+{
+  if (a == NULL) {
+    free(p);
+  }
+}
+
+void arenafree(Arena *a)
+{
+  ArenaBlock *b = a->blocks, *next;
+  while (b) {
+    next = b->next;
+    free(b);
+    b = next;
+  }
+  arenainit(a);
+}
@@ -0,0 +1,168 @@
+/***************************************************************************//**
+
+  @file         backtrack.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Bounded backtracking regex execution for small problems.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on the backtracker:
+
+  Setting up the Pike VM (thread lists, marks, a capture pool) costs more than
+  the matching itself when both the program and the input are short.  For those
+  cases, a backtracker is faster: it follows one thread at a time, depth first,
+  trying the x branch of each Split before the y branch.  This is the same
+  order as the Pike VM's thread priority, so the first Match it reaches is the
+  one the Pike VM would report, captures included.
+
+  Backtracking can take exponential time, unless it remembers which (pc, sp)
+  pairs it has already tried.  Whatever happens after reaching an instruction
+  at an input index doesn't depend on how it got there, so if the first visit
+  failed, every later visit fails too.  The visited set holds one bit per pair,
+  which is what limits the size of the problems this is used for.  All of its
+  memory is on the stack, so an execution allocates nothing but its result.
+
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/re.h"
+#include "libstephen/re_internals.h"
+
+#define BT_MAXBITS (BT_BUDGET * 8)
+#define BT_WORDS (BT_MAXBITS / 64)
+#define BT_STACK 256
+
+/*
+  A job either resumes a thread at (pc, sp), or (when pc is SIZE_MAX) restores
+  capture s to the value it had before a Save.
+ */
+typedef struct job job;
+struct job {
+  size_t pc;
+  size_t sp;
+  size_t s;
+  size_t old;
+};
+
+typedef struct jobstack jobstack;
+struct jobstack {
+  job *jobs;
+  size_t n, alloc;
+  job local[BT_STACK];
+};
+
+/**
+   @brief Push a job, moving the stack to the heap if it overflows.
+ */
+static void push(jobstack *st, job j)
+{
+  if (st->n == st->alloc) {
+    st->alloc *= 2;
+    if (st->jobs == st->local) {
+      st->jobs = calloc(st->alloc, sizeof(job));
+      memcpy(st->jobs, st->local, sizeof(st->local));
+    } else {
+      st->jobs = realloc(st->jobs, st->alloc * sizeof(job));
+    }
+  }
+  st->jobs[st->n++] = j;
+}
+
+ssize_t rebacktrack(Regex r, const char *input, size_t **saved)
+{
+  // Only look as far into the input as the visited bits could cover, so a
+  // short match in a long input stays cheap.
+  size_t limit = BT_MAXBITS / (r.n ? r.n : 1);
+  size_t len = strnlen(input, limit);
+  if (len >= limit) {
+    return BT_GAVEUP;
+  }
+
+  uint64_t visited[BT_WORDS];
+  size_t nsave = renumsaves(r);
+  size_t caps[nsave];
+  jobstack st;
+  ssize_t match = -1;
+
+  memset(visited, 0, ((r.n * (len + 1) + 63) / 64) * sizeof(uint64_t));
+  memset(caps, 0, sizeof(caps));
+  st.jobs = st.local;
+  st.n = 0;
+  st.alloc = BT_STACK;
+
+  push(&st, (job){.pc=0, .sp=0, .s=0, .old=0});
+  while (st.n > 0 && match == -1) {
+    job j = st.jobs[--st.n];
+    if (j.pc == SIZE_MAX) {
+      caps[j.s] = j.old;
+      continue;
+    }
+
+    // Follow this thread until it fails or matches.
+    size_t pc = j.pc, sp = j.sp;
+    for (;;) {
+      size_t bit = pc * (len + 1) + sp;
+      if (visited[bit / 64] & (1ULL << (bit % 64))) {
+        break;
+      }
+      visited[bit / 64] |= 1ULL << (bit % 64);
+
+      Instr *in = &r.i[pc];
+      wchar_t c = (wchar_t)input[sp];
+      if (in->code == Char) {
+        if (c != in->c) {
+          break;
+        }
+        pc++;
+        sp++;
+      } else if (in->code == Any) {
+        if (c == L'\0') {
+          break;
+        }
+        pc++;
+        sp++;
+      } else if (in->code == Range || in->code == NRange) {
+        if (!range(in, c)) {
+          break;
+        }
+        pc++;
+        sp++;
+      } else if (in->code == Jump) {
+        pc = in->x - r.i;
+      } else if (in->code == Split) {
+        push(&st, (job){.pc=in->y - r.i, .sp=sp, .s=0, .old=0});
+        pc = in->x - r.i;
+      } else if (in->code == Save) {
+        push(&st, (job){.pc=SIZE_MAX, .sp=0, .s=in->s, .old=caps[in->s]});
+        caps[in->s] = sp;
+        pc++;
+      } else {
+        // Match.
+        match = sp;
+        break;
+      }
+    }
+  }
+
+  if (st.jobs != st.local) {
+    free(st.jobs);
+  }
+  if (saved) {
+    if (match != -1) {
+      *saved = calloc(nsave, sizeof(size_t));
+      memcpy(*saved, caps, sizeof(caps));
+    } else {
+      *saved = NULL;
+    }
+  }
+  return match;
+}
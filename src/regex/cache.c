@@ -0,0 +1,185 @@
+/***************************************************************************//**
+
+  @file         cache.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Cache of compiled regexes, keyed by pattern.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on the cache:
+
+  Entries are found by pattern in an smb_hta, and they are also kept in a list
+  ordered by most recent use.  When the cache uses more memory than its budget,
+  entries are evicted from the least recently used end of the list.
+
+  Callers hold on to the Regex inside an entry, so each entry has a reference
+  count, and entries that are in use are never evicted (the cache may exceed
+  its budget until they are released).  The memory of an entry includes its
+  DFA, which grows as it is used, so an entry's cost is measured again each time
+  it is released.
+
+*******************************************************************************/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/hta.h"
+#include "libstephen/re.h"
+#include "libstephen/re_internals.h"
+
+typedef struct entry entry;
+struct entry {
+  Regex r;       // first, so a Regex pointer can be turned back into its entry
+  char *pattern;
+  size_t refs;
+  size_t cost;
+  entry *prev, *next;
+};
+
+struct RegexCache {
+  smb_hta table; // pattern (char*) -> entry*
+  entry *head;   // most recently used
+  entry *tail;   // least recently used
+  size_t budget;
+  size_t used;
+};
+
+/**
+   @brief Return the number of bytes an entry uses.
+ */
+static size_t entrycost(entry *e)
+{
+  size_t cost = sizeof(entry) + strlen(e->pattern) + 1 + e->r.n * sizeof(Instr);
+  for (size_t i = 0; i < e->r.n; i++) {
+    if (e->r.i[i].code == Range || e->r.i[i].code == NRange) {
+      ClassTable *t = (ClassTable *) e->r.i[i].y;
+      cost += 2 * e->r.i[i].s + sizeof(ClassTable) + 2 * t->n * sizeof(wchar_t);
+    }
+  }
+  return cost + redfasize(e->r.dfa);
+}
+
+static void unlink_entry(RegexCache *c, entry *e)
+{
+  if (e->prev) {
+    e->prev->next = e->next;
+  } else {
+    c->head = e->next;
+  }
+  if (e->next) {
+    e->next->prev = e->prev;
+  } else {
+    c->tail = e->prev;
+  }
+  e->prev = e->next = NULL;
+}
+
+static void push_front(RegexCache *c, entry *e)
+{
+  e->prev = NULL;
+  e->next = c->head;
+  if (c->head) {
+    c->head->prev = e;
+  } else {
+    c->tail = e;
+  }
+  c->head = e;
+}
+
+static void free_entry(entry *e)
+{
+  refree(e->r);
+  free(e->pattern);
+  free(e);
+}
+
+/**
+   @brief Evict unused entries, least recently used first, to fit the budget.
+ */
+static void evict(RegexCache *c)
+{
+  smb_status status = SMB_SUCCESS;
+  entry *e = c->tail;
+  while (c->used > c->budget && e) {
+    entry *prev = e->prev;
+    if (e->refs == 0) {
+      hta_remove(&c->table, &e->pattern, &status);
+      unlink_entry(c, e);
+      c->used -= e->cost;
+      free_entry(e);
+    }
+    e = prev;
+  }
+}
+
+RegexCache *recachenew(size_t budget)
+{
+  RegexCache *c = calloc(1, sizeof(RegexCache));
+  hta_init(&c->table, hta_string_hash, hta_string_comp, sizeof(char *),
+           sizeof(entry *));
+  c->budget = budget;
+  return c;
+}
+
+void recachefree(RegexCache *c)
+{
+  entry *e = c->head, *next;
+  while (e) {
+    next = e->next;
+    free_entry(e);
+    e = next;
+  }
+  hta_destroy(&c->table);
+  free(c);
+}
+
+const Regex *recacheget(RegexCache *c, const char *regex)
+{
+  smb_status status = SMB_SUCCESS;
+  entry **found = hta_get(&c->table, &regex, &status);
+  entry *e;
+
+  if (status == SMB_SUCCESS) {
+    e = *found;
+    unlink_entry(c, e);
+  } else {
+    e = calloc(1, sizeof(entry));
+    e->pattern = calloc(strlen(regex) + 1, sizeof(char));
+    strcpy(e->pattern, regex);
+    e->r = recomp(regex);
+    e->cost = entrycost(e);
+    c->used += e->cost;
+    hta_insert(&c->table, &e->pattern, &e);
+  }
+
+  push_front(c, e);
+  e->refs++;
+  evict(c);
+  return &e->r;
+}
+
+void recacherelease(RegexCache *c, const Regex *r)
+{
+  entry *e = (entry *) r;
+  // An extra release would wrap refs around and pin the entry forever.
+  assert(e->refs > 0);
+  if (e->refs == 0) {
+    return;
+  }
+  e->refs--;
+  c->used -= e->cost;
+  e->cost = entrycost(e);
+  c->used += e->cost;
+  evict(c);
+}
+
+size_t recacheused(const RegexCache *c)
+{
+  return c->used;
+}
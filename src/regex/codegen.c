@@ -26,6 +26,10 @@
   code, it will be turned into an array, and all the IDs will be resolved
   efficiently to locations in the final array using a table.
 
+  Fragments are only needed until the program is assembled, so they are
+  allocated from an Arena, and a Fragment which is removed from a list is simply
+  forgotten.
+
 *******************************************************************************/
 
 #include <stdio.h>
@@ -48,6 +52,7 @@ typedef struct State State;
 struct State {
   intptr_t id; // "global" id counter
   size_t capture; // capture parentheses counter
+  Arena *arena; // where fragments are allocated
 };
 
 static Fragment *last(Fragment *f)
@@ -100,7 +105,6 @@ static void join(Fragment *a, Fragment *b)
 
   // If the last Instruction is a Match, delete it.
   if (prev != NULL && a->in.code == Match) {
-    free(a);
     prev->next = b;
   }
 }
@@ -117,22 +121,12 @@ static size_t fraglen(Fragment *f)
 
 static Fragment *newfrag(enum code code, State *s)
 {
-  Fragment *new = calloc(1, sizeof(Fragment));
+  Fragment *new = arenaalloc(s->arena, sizeof(Fragment));
   new->in.code = code;
   new->id = s->id++;
   return new;
 }
 
-static void freefraglist(Fragment *f)
-{
-  Fragment *next;
-  while (f) {
-    next = f->next;
-    free(f);
-    f = next;
-  }
-}
-
 static Fragment *regex(PTree *t, State *s);
 static Fragment *term(PTree *t, State *s);
 static Fragment *expr(PTree *t, State *s);
@@ -175,6 +169,7 @@ static Fragment *special(char type, State *s)
     break;
   }
 
+  classfromblock(&f->in);
   f->next = newfrag(Match, s);
   return f;
 }
@@ -373,32 +368,37 @@ static Fragment *class(PTree *tree, State *state, bool is_negative)
   f->in.s = nranges;
   f->in.x = calloc(nranges*2, sizeof(char));
   char *block = (char*)f->in.x;
+  // The lookup table is built from the full width characters.
+  wchar_t *pairs = arenaalloc(state->arena, nranges*2*sizeof(wchar_t));
 
   curr = tree;
   nranges = 0;
   while (curr->nt == CLASSnt) {
     if (curr->production == 1 || curr->production == 2) {
       // Range
-      block[2*nranges] = curr->children[0]->tok.c;
-      block[2*nranges+1] = curr->children[1]->tok.c;
+      pairs[2*nranges] = curr->children[0]->tok.c;
+      pairs[2*nranges+1] = curr->children[1]->tok.c;
     } else {
       // Single
-      block[2*nranges] = curr->children[0]->tok.c;
-      block[2*nranges+1] = curr->children[0]->tok.c;
+      pairs[2*nranges] = curr->children[0]->tok.c;
+      pairs[2*nranges+1] = curr->children[0]->tok.c;
     }
+    block[2*nranges] = pairs[2*nranges];
+    block[2*nranges+1] = pairs[2*nranges+1];
     curr = curr->children[curr->nchildren-1];
     nranges++;
   }
 
+  f->in.y = (Instr*) newclass(pairs, nranges, is_negative);
   f->next = newfrag(Match, state);
   return f;
 }
 
-Regex codegen(PTree *tree)
+/**
+   @brief Turn a Fragment list into a program, resolving jump targets.
+ */
+static Regex assemble(Fragment *f, State *s)
 {
-  // Generate code.
-  State s = {0, 0};
-  Fragment *f = regex(tree, &s);
   size_t n;
 
   // Get the length of the code
@@ -406,7 +406,7 @@ Regex codegen(PTree *tree)
 
   // Allocate buffers for the code, and for a lookup table of targets for jumps.
   Instr *code = calloc(n, sizeof(Instr));
-  size_t *targets = calloc(s.id, sizeof(size_t));
+  size_t *targets = calloc(s->id, sizeof(size_t));
 
   // Fill up the lookup table.
   size_t i = 0;
@@ -427,6 +427,65 @@ Regex codegen(PTree *tree)
   }
 
   free(targets);
-  freefraglist(f);
-  return (Regex){.n=n, .i=code};
+  Regex r = {.n=n, .i=code, .dfa=NULL};
+  return r;
+}
+
+Regex codegenin(PTree *tree, Arena *a)
+{
+  // Generate code.
+  State s = {0, 0, a};
+  Fragment *f = regex(tree, &s);
+  Regex r = assemble(f, &s);
+  r.dfa = redfanew(r, DFA_BUDGET);
+  return r;
+}
+
+Regex codegen(PTree *tree)
+{
+  Arena a;
+  arenainit(&a);
+  Regex r = codegenin(tree, &a);
+  arenafree(&a);
+  return r;
+}
+
+Regex codegenset(PTree **trees, size_t n, Arena *a)
+{
+  State s = {0, 0, a};
+  Fragment *f = NULL;
+
+  assert(n > 0);
+
+  /*
+    Each pattern is tried in turn, like an alternation of all of them:
+        split P0 S1
+    P0:
+        BLOCK from pattern 0, with "match 0"
+    S1:
+        split P1 S2
+    ...
+    Pn-1:
+        BLOCK from pattern n-1, with "match n-1"
+   */
+  for (size_t k = n; k-- > 0; ) {
+    Fragment *p = regex(trees[k], &s);
+    for (Fragment *curr = p; curr; curr = curr->next) {
+      if (curr->in.code == Match) {
+        curr->in.s = k;
+      }
+    }
+    if (f) {
+      Fragment *split = newfrag(Split, &s);
+      split->in.x = (Instr*) p->id;
+      split->in.y = (Instr*) f->id;
+      split->next = p;
+      last(p)->next = f;
+      p = split;
+    }
+    f = p;
+  }
+
+  // The DFA stops at the first match, so it isn't useful for a set.
+  return assemble(f, &s);
 }
@@ -0,0 +1,293 @@
+/***************************************************************************//**
+
+  @file         dfa.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Lazily constructed DFA for capture-free regex execution.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on how the DFA works:
+
+  The Pike VM keeps an ordered list of threads, and on every input character it
+  steps each of them.  When no captures are requested, a thread is nothing but
+  a program counter, so the whole list is determined by the set of program
+  counters in it (and their order, which encodes priority).  A DFA state is
+  exactly such an ordered list.  Stepping a state on a character always gives
+  the same next state, so we can compute it once and memoize it in a 256 entry
+  transition table.  After that, the cost of a character is one table lookup.
+
+  States are only built when the input actually reaches them, and they are kept
+  in a small hash table so that identical thread lists share a state.  The
+  memory used by states is bounded by the DFA's budget.  When the budget runs
+  out, the cache is flushed and the caller falls back to the Pike VM for that
+  execution.
+
+  To give the same match length as the Pike VM, a state's list is truncated
+  after the first Match instruction, since the Pike VM kills every lower
+  priority thread once a Match is reached.
+
+*******************************************************************************/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/re.h"
+#include "libstephen/re_internals.h"
+
+#define DFA_NBUCKETS 256
+
+typedef struct DState DState;
+struct DState {
+  DState *next[256]; // transitions, NULL until they are computed
+  DState *chain;     // next state in the same hash bucket
+  size_t hash;
+  bool match;        // does this list contain a Match?
+  size_t n;          // number of (non-Match) instructions in the list
+  size_t pc[];       // instruction indices, in priority order
+};
+
+struct DFA {
+  size_t n;          // length of the program
+  size_t budget;     // maximum bytes to spend on states
+  size_t used;       // bytes currently spent on states
+  DState *start;
+  DState *buckets[DFA_NBUCKETS];
+  size_t *list;      // scratch list for the state being built
+  size_t nlist;
+  bool listmatch;
+  size_t *mark;      // per-instruction generation marks for the closure
+  size_t gen;
+  size_t *stack;     // pending Split branches for the closure
+};
+
+DFA *redfanew(Regex r, size_t budget)
+{
+  DFA *d = calloc(1, sizeof(DFA));
+  d->n = r.n;
+  d->budget = budget;
+  d->list = calloc(r.n, sizeof(size_t));
+  d->mark = calloc(r.n, sizeof(size_t));
+  d->stack = calloc(r.n, sizeof(size_t));
+  return d;
+}
+
+/**
+   @brief Free every state in the cache, leaving an empty DFA.
+ */
+static void flush(DFA *d)
+{
+  DState *s, *next;
+  for (size_t i = 0; i < DFA_NBUCKETS; i++) {
+    for (s = d->buckets[i]; s; s = next) {
+      next = s->chain;
+      free(s);
+    }
+    d->buckets[i] = NULL;
+  }
+  d->start = NULL;
+  d->used = 0;
+}
+
+void redfafree(DFA *d)
+{
+  if (!d) {
+    return;
+  }
+  flush(d);
+  free(d->list);
+  free(d->mark);
+  free(d->stack);
+  free(d);
+}
+
+size_t redfasize(DFA *d)
+{
+  if (!d) {
+    return 0;
+  }
+  // The scratch list, marks and stack are one size_t per instruction each.
+  return sizeof(DFA) + d->used + 3 * d->n * sizeof(size_t);
+}
+
+/**
+   @brief Add an instruction (and everything reachable from it without
+   consuming input) to the scratch list.
+
+   This mirrors addthread() in the Pike VM, minus the capture bookkeeping.
+   Like addthread(), it keeps the pending y branches of Splits on a stack
+   instead of recursing.
+ */
+static void closure(DFA *d, Regex r, size_t pc)
+{
+  size_t top = 0;
+
+  for (;;) {
+    if (d->mark[pc] != d->gen) {
+      d->mark[pc] = d->gen;
+
+      switch (r.i[pc].code) {
+      case Jump:
+        pc = r.i[pc].x - r.i;
+        continue;
+      case Split:
+        d->stack[top++] = r.i[pc].y - r.i;
+        pc = r.i[pc].x - r.i;
+        continue;
+      case Save:
+        pc = pc + 1;
+        continue;
+      case Match:
+        // Threads after a Match are killed by the VM, so they don't matter.
+        d->listmatch = true;
+        break;
+      default:
+        if (!d->listmatch) {
+          d->list[d->nlist++] = pc;
+        }
+        break;
+      }
+    }
+
+    if (top == 0) {
+      break;
+    }
+    pc = d->stack[--top];
+  }
+}
+
+/**
+   @brief Begin building a new scratch list.
+ */
+static void startlist(DFA *d)
+{
+  d->gen++;
+  d->nlist = 0;
+  d->listmatch = false;
+}
+
+static size_t hashlist(const size_t *list, size_t n, bool match)
+{
+  size_t hash = match ? 1 : 0;
+  for (size_t i = 0; i < n; i++) {
+    hash = hash * 31 + list[i] + 1;
+  }
+  return hash;
+}
+
+/**
+   @brief Find the cached state for the scratch list, or create one.
+   @returns The state, or NULL if the budget does not allow a new state.
+ */
+static DState *getstate(DFA *d)
+{
+  size_t hash = hashlist(d->list, d->nlist, d->listmatch);
+  DState **bucket = &d->buckets[hash % DFA_NBUCKETS];
+  DState *s;
+
+  for (s = *bucket; s; s = s->chain) {
+    if (s->hash == hash && s->match == d->listmatch && s->n == d->nlist &&
+        memcmp(s->pc, d->list, d->nlist * sizeof(size_t)) == 0) {
+      return s;
+    }
+  }
+
+  size_t size = sizeof(DState) + d->nlist * sizeof(size_t);
+  if (d->used + size > d->budget) {
+    return NULL;
+  }
+  d->used += size;
+
+  s = calloc(1, size);
+  s->hash = hash;
+  s->match = d->listmatch;
+  s->n = d->nlist;
+  memcpy(s->pc, d->list, d->nlist * sizeof(size_t));
+  s->chain = *bucket;
+  *bucket = s;
+  return s;
+}
+
+/**
+   @brief Return true if a consuming instruction accepts a character.
+ */
+static bool accepts(Instr *pc, wchar_t c)
+{
+  switch (pc->code) {
+  case Char:
+    return c == pc->c;
+  case Any:
+    return c != L'\0';
+  case Range:
+  case NRange:
+    return range(pc, c);
+  default:
+    assert(false);
+    return false;
+  }
+}
+
+/**
+   @brief Compute (and memoize) the transition from a state on a byte.
+   @returns The next state, or NULL if the budget is exhausted.
+ */
+static DState *step(DFA *d, Regex r, DState *s, unsigned char c)
+{
+  // The Pike VM reads narrow input as a (possibly signed) char.
+  wchar_t wc = (wchar_t)(char)c;
+
+  startlist(d);
+  for (size_t i = 0; i < s->n; i++) {
+    if (accepts(&r.i[s->pc[i]], wc)) {
+      closure(d, r, s->pc[i] + 1);
+    }
+  }
+
+  DState *next = getstate(d);
+  s->next[c] = next;
+  return next;
+}
+
+ssize_t redfaexec(DFA *d, Regex r, const char *input)
+{
+  DState *s = d->start;
+  ssize_t match = -1;
+
+  if (!s) {
+    startlist(d);
+    closure(d, r, 0);
+    s = d->start = getstate(d);
+    if (!s) {
+      return DFA_GAVEUP;
+    }
+  }
+
+  for (size_t sp = 0; ; sp++) {
+    if (s->match) {
+      match = sp;
+    }
+    if (s->n == 0) {
+      break;
+    }
+
+    unsigned char c = (unsigned char)input[sp];
+    DState *next = s->next[c];
+    if (!next) {
+      next = step(d, r, s, c);
+      if (!next) {
+        flush(d);
+        return DFA_GAVEUP;
+      }
+    }
+    s = next;
+  }
+
+  return match;
+}
@@ -0,0 +1,145 @@
+/***************************************************************************//**
+
+  @file         grep.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Searching the lines of a buffer on several threads.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on the parallel grep:
+
+  The buffer is cut into one chunk per thread, with every cut placed just after
+  a newline, so that each line belongs to exactly one chunk.  Each thread has
+  its own RegexContext, and since execution with a context never modifies the
+  Regex, no locking is needed.  Lines aren't NUL terminated in the buffer, so
+  each one is searched as a stream of a single chunk, in place.
+
+  Each thread collects its matches in order, with line numbers relative to its
+  chunk.  Once they are all done, the lists are joined in chunk order, and the
+  line numbers are offset by the number of lines in the chunks before.
+
+*******************************************************************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/re.h"
+
+typedef struct grepjob grepjob;
+struct grepjob {
+  Regex r;
+  const char *buf;
+  size_t begin, end;    // the chunk of buf to search
+  RegexMatch *matches;
+  size_t nmatches, alloc;
+  size_t nlines;
+};
+
+static void addmatch(grepjob *job, RegexMatch m)
+{
+  if (job->nmatches == job->alloc) {
+    job->alloc = job->alloc ? 2 * job->alloc : 16;
+    job->matches = realloc(job->matches, job->alloc * sizeof(RegexMatch));
+  }
+  job->matches[job->nmatches++] = m;
+}
+
+static void *grepworker(void *arg)
+{
+  grepjob *job = arg;
+  RegexContext *ctx = recontext(job->r);
+  size_t i = job->begin;
+
+  while (i < job->end) {
+    const char *newline = memchr(job->buf + i, '\n', job->end - i);
+    size_t eol = newline ? (size_t)(newline - job->buf) : job->end;
+    size_t start;
+
+    restreamstart(ctx, true, false);
+    restreamfeed(ctx, job->buf + i, eol - i);
+    ssize_t length = restreamfinish(ctx, &start, NULL);
+    if (length != -1) {
+      RegexMatch m = {.line=job->nlines, .start=i + start, .length=length};
+      addmatch(job, m);
+    }
+
+    job->nlines++;
+    i = eol + 1;
+  }
+
+  recontextfree(ctx);
+  return NULL;
+}
+
+RegexMatch *regrep(Regex r, const char *buf, size_t len, size_t nthreads,
+                   size_t *nmatches)
+{
+  if (nthreads == 0) {
+    nthreads = 1;
+  }
+  grepjob *jobs = calloc(nthreads, sizeof(grepjob));
+  pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+  bool *started = calloc(nthreads, sizeof(bool));
+
+  // Cut the buffer into chunks which begin just after a newline.
+  size_t begin = 0;
+  for (size_t t = 0; t < nthreads; t++) {
+    size_t end = len;
+    if (t + 1 < nthreads) {
+      end = len / nthreads * (t + 1);
+      if (end < begin) {
+        end = begin;
+      }
+      if (end > 0 && end < len && buf[end - 1] != '\n') {
+        const char *newline = memchr(buf + end, '\n', len - end);
+        end = newline ? (size_t)(newline - buf) + 1 : len;
+      }
+    }
+    jobs[t] = (grepjob){.r=r, .buf=buf, .begin=begin, .end=end};
+    begin = end;
+  }
+
+  // The calling thread takes the first chunk itself, and any chunk whose
+  // thread couldn't be started.
+  for (size_t t = 1; t < nthreads; t++) {
+    started[t] = pthread_create(&threads[t], NULL, grepworker, &jobs[t]) == 0;
+  }
+  grepworker(&jobs[0]);
+  for (size_t t = 1; t < nthreads; t++) {
+    if (started[t]) {
+      pthread_join(threads[t], NULL);
+    } else {
+      grepworker(&jobs[t]);
+    }
+  }
+
+  // Join the results in order.
+  size_t total = 0, line = 0;
+  for (size_t t = 0; t < nthreads; t++) {
+    total += jobs[t].nmatches;
+  }
+  RegexMatch *matches = calloc(total ? total : 1, sizeof(RegexMatch));
+  size_t n = 0;
+  for (size_t t = 0; t < nthreads; t++) {
+    for (size_t m = 0; m < jobs[t].nmatches; m++) {
+      matches[n] = jobs[t].matches[m];
+      matches[n].line += line;
+      n++;
+    }
+    line += jobs[t].nlines;
+    free(jobs[t].matches);
+  }
+
+  free(jobs);
+  free(threads);
+  free(started);
+  *nmatches = total;
+  return matches;
+}
@@ -182,7 +182,7 @@ static Instr read_instr(char *line, int lineno)
   // buffer.  We know we don't need more than like TODO
   size_t ntok;
   char **tokens = tokenize(line, &ntok);
-  Instr inst = {.code=0, .c=0, .s=0, .x=NULL, .y=NULL, .lastidx=0};
+  Instr inst = {.code=0, .c=0, .s=0, .x=NULL, .y=NULL};
 
   if (strcmp(tokens[0], Opcodes[Char]) == 0) {
     if (ntok != 2) {
@@ -239,6 +239,7 @@ static Instr read_instr(char *line, int lineno)
     for (size_t i = 0; i < ntok - 1; i++) {
       block[i] = string_to_char(tokens[i+1]);
     }
+    classfromblock(&inst);
   } else {
     fprintf(stderr, "line %d: unknown opcode \"%s\"\n", lineno, tokens[0]);
   }
@@ -353,7 +354,9 @@ Regex reread(char *str)
   free(lines);
   free(labels);
   free(labelindices);
-  return (Regex){.n=codeidx, .i=rv};
+  Regex r = {.n=codeidx, .i=rv, .dfa=NULL};
+  r.dfa = redfanew(r, DFA_BUDGET);
+  return r;
 }
 
 /**
@@ -449,12 +452,225 @@ void rewrite(Regex r, FILE *f)
   free(labels);
 }
 
+/*
+  Binary format.
+
+  A program is written as a header, one fixed size record per instruction, and
+  a data section holding the character classes.  Every field has a fixed width
+  (in native byte order), and nothing in the format is a pointer: Jump and Split
+  targets are instruction indices, and class data is found by offset into the
+  data section.  So the bytes mean the same thing wherever they are loaded (or
+  mapped), and reading them back is a single pass with no parsing.  The total
+  size is padded to a multiple of 8 bytes, so programs may be concatenated into
+  a bundle and read back one after another.
+
+  For Range and NRange, s is the number of pairs in the char block and c is
+  the number of ranges in the ClassTable.  x and y are the offsets of the block
+  (2s bytes) and of the table's ranges (2c int32_t's, aligned to 4 bytes).
+ */
+
+#define BIN_MAGIC 0x45524253 // "SBRE", read backwards on the wrong endianness
+#define BIN_VERSION 1
+
+struct binheader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t ninstr;
+  uint64_t ndata;   // bytes in the data section, before padding
+};
+
+struct binstr {
+  uint32_t code;
+  int32_t c;
+  uint64_t s;
+  uint64_t x;
+  uint64_t y;
+};
+
+static size_t align(size_t n, size_t to)
+{
+  return (n + to - 1) / to * to;
+}
+
+void *rebinwrite(Regex r, size_t *len)
+{
+  // Size the data section before laying anything out.
+  size_t ndata = 0;
+  for (size_t i = 0; i < r.n; i++) {
+    if (r.i[i].code == Range || r.i[i].code == NRange) {
+      ClassTable *t = (ClassTable *) r.i[i].y;
+      ndata = align(ndata + 2 * r.i[i].s, 4) + 2 * t->n * sizeof(int32_t);
+    }
+  }
+
+  size_t size = sizeof(struct binheader) + r.n * sizeof(struct binstr) +
+    align(ndata, 8);
+  unsigned char *buf = calloc(size, 1);
+  struct binheader h = {.magic=BIN_MAGIC, .version=BIN_VERSION, .ninstr=r.n,
+                        .ndata=ndata};
+  memcpy(buf, &h, sizeof(h));
+  unsigned char *records = buf + sizeof(h);
+  unsigned char *data = records + r.n * sizeof(struct binstr);
+
+  size_t offset = 0;
+  for (size_t i = 0; i < r.n; i++) {
+    struct binstr b = {.code=r.i[i].code, .c=r.i[i].c, .s=r.i[i].s, .x=0, .y=0};
+    switch (r.i[i].code) {
+    case Split:
+      b.y = r.i[i].y - r.i;
+      // fall through
+    case Jump:
+      b.x = r.i[i].x - r.i;
+      break;
+    case Range:
+    case NRange: {
+      ClassTable *t = (ClassTable *) r.i[i].y;
+      memcpy(data + offset, r.i[i].x, 2 * r.i[i].s);
+      b.x = offset;
+      offset = align(offset + 2 * r.i[i].s, 4);
+      b.c = t->n;
+      b.y = offset;
+      for (size_t j = 0; j < 2 * t->n; j++) {
+        int32_t value = t->ranges[j];
+        memcpy(data + offset, &value, sizeof(value));
+        offset += sizeof(value);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+    memcpy(records + i * sizeof(b), &b, sizeof(b));
+  }
+
+  *len = size;
+  return buf;
+}
+
+void rebinfwrite(Regex r, FILE *f)
+{
+  size_t len;
+  void *buf = rebinwrite(r, &len);
+  fwrite(buf, 1, len, f);
+  free(buf);
+}
+
+/**
+   @brief Read a Range or NRange's class data from the data section.
+   @returns False if the record points outside of the data section.
+ */
+static bool read_class(Instr *in, const struct binstr *b,
+                       const unsigned char *data, size_t ndata)
+{
+  if (b->s > ndata / 2 || b->x > ndata - 2 * b->s ||
+      b->c > ndata / (2 * sizeof(int32_t)) ||
+      b->y > ndata - 2 * b->c * sizeof(int32_t)) {
+    return false;
+  }
+
+  in->x = calloc(2 * b->s, sizeof(char));
+  memcpy(in->x, data + b->x, 2 * b->s);
+
+  wchar_t *pairs = calloc(2 * b->c, sizeof(wchar_t));
+  for (size_t j = 0; j < 2 * b->c; j++) {
+    int32_t value;
+    memcpy(&value, data + b->y + j * sizeof(value), sizeof(value));
+    pairs[j] = value;
+  }
+  in->y = (Instr *) newclass(pairs, b->c, in->code == NRange);
+  free(pairs);
+  return true;
+}
+
+Regex rebinread(const void *data, size_t len, size_t *used)
+{
+  const unsigned char *buf = data;
+  Regex r = {.n=0, .i=NULL, .dfa=NULL};
+  struct binheader h;
+
+  if (len < sizeof(h)) {
+    return r;
+  }
+  memcpy(&h, buf, sizeof(h));
+  len -= sizeof(h);
+  if (h.magic != BIN_MAGIC || h.version != BIN_VERSION || h.ninstr == 0 ||
+      h.ninstr > len / sizeof(struct binstr) ||
+      h.ndata > len - h.ninstr * sizeof(struct binstr)) {
+    return r;
+  }
+
+  const unsigned char *records = buf + sizeof(h);
+  const unsigned char *classes = records + h.ninstr * sizeof(struct binstr);
+  Instr *code = calloc(h.ninstr, sizeof(Instr));
+
+  for (size_t i = 0; i < h.ninstr; i++) {
+    struct binstr b;
+    memcpy(&b, records + i * sizeof(b), sizeof(b));
+    code[i].code = b.code;
+    code[i].c = b.c;
+    code[i].s = b.s;
+
+    // Only a match or a jump may end the program; anything else would run off
+    // the end of the instruction array.  This is checked first, so that a
+    // rejected record hasn't allocated a class.
+    bool ok = i < h.ninstr - 1 || b.code == Match || b.code == Jump ||
+      b.code == Split;
+
+    switch (ok ? b.code : Match) {
+    case Split:
+      ok = b.y < h.ninstr;
+      code[i].y = code + b.y;
+      // fall through
+    case Jump:
+      ok = ok && b.x < h.ninstr;
+      code[i].x = code + b.x;
+      break;
+    case Range:
+    case NRange:
+      ok = read_class(&code[i], &b, classes, h.ndata);
+      break;
+    case Save:
+      // The engines allocate one slot past the highest save, and a compiled
+      // program never has more slots than instructions.
+      ok = b.s < h.ninstr;
+      break;
+    case Char:
+    case Match:
+    case Any:
+      break;
+    default:
+      ok = false;
+      break;
+    }
+
+    if (!ok) {
+      // Free the instructions read so far (this one owns nothing).
+      code[i].code = Match;
+      Regex partial = {.n=i, .i=code, .dfa=NULL};
+      refree(partial);
+      return r;
+    }
+  }
+
+  if (used) {
+    size_t total = sizeof(h) + h.ninstr * sizeof(struct binstr) +
+      align(h.ndata, 8);
+    *used = total < sizeof(h) + len ? total : sizeof(h) + len;
+  }
+  r.n = h.ninstr;
+  r.i = code;
+  r.dfa = redfanew(r, DFA_BUDGET);
+  return r;
+}
+
 void refree(Regex r)
 {
   for (size_t i = 0; i < r.n; i++) {
     if (r.i[i].code == Range || r.i[i].code == NRange) {
       free(r.i[i].x);
+      free(r.i[i].y);
     }
   }
   free(r.i);
+  redfafree(r.dfa);
 }
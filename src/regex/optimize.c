@@ -0,0 +1,184 @@
+/***************************************************************************//**
+
+  @file         optimize.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Peephole optimization of regex bytecode.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+  Notes on the optimizations:
+
+  Code generation joins fragments without looking at what they contain, so
+  programs often have jumps that lead to other jumps, and jumps to the very
+  next instruction.  Each of these costs an extra addthread() call every time a
+  thread passes through it.  This pass cleans them up:
+
+  - A class containing a single character becomes a Char instruction.
+  - Jump and Split targets which are Jumps are redirected to the end of the
+    jump chain ("jump threading").
+  - A Split whose targets are the same becomes a Jump.
+  - Instructions which can't be reached from the start are removed, as are
+    Jumps to the instruction that would come next anyway.
+
+  None of these change the order in which threads are added, so priorities
+  (and therefore matches and captures) are unchanged.
+
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "libstephen/re.h"
+#include "libstephen/re_internals.h"
+
+/**
+   @brief Turn a Range matching exactly one character into a Char.
+ */
+static void singleclass(Instr *in)
+{
+  ClassTable *t = (ClassTable *) in->y;
+  if (in->code != Range || t->n != 1 || t->ranges[0] != t->ranges[1] ||
+      t->ranges[0] == L'\0') {
+    return;
+  }
+  in->code = Char;
+  in->c = t->ranges[0];
+  in->s = 0;
+  free(in->x);
+  free(in->y);
+  in->x = NULL;
+  in->y = NULL;
+}
+
+/**
+   @brief Follow a chain of Jumps to the first instruction that isn't one.
+
+   A chain may loop back on itself (which no thread can escape anyway), so
+   give up after visiting every instruction once.
+ */
+static Instr *jumpend(Regex r, Instr *target)
+{
+  for (size_t hops = 0; target->code == Jump && hops < r.n; hops++) {
+    target = target->x;
+  }
+  return target;
+}
+
+/**
+   @brief Mark every instruction reachable from the start of the program.
+ */
+static bool *reachable(Regex r)
+{
+  bool *seen = calloc(r.n, sizeof(bool));
+  size_t *stack = calloc(2 * r.n + 1, sizeof(size_t));
+  size_t top = 0;
+
+  stack[top++] = 0;
+  while (top > 0) {
+    size_t i = stack[--top];
+    if (seen[i]) {
+      continue;
+    }
+    seen[i] = true;
+    switch (r.i[i].code) {
+    case Match:
+      break;
+    case Jump:
+      stack[top++] = r.i[i].x - r.i;
+      break;
+    case Split:
+      stack[top++] = r.i[i].x - r.i;
+      stack[top++] = r.i[i].y - r.i;
+      break;
+    default:
+      stack[top++] = i + 1;
+      break;
+    }
+  }
+
+  free(stack);
+  return seen;
+}
+
+Regex reoptimize(Regex r)
+{
+  for (size_t i = 0; i < r.n; i++) {
+    if (r.i[i].code == Range) {
+      singleclass(&r.i[i]);
+    }
+  }
+
+  for (size_t i = 0; i < r.n; i++) {
+    if (r.i[i].code == Jump || r.i[i].code == Split) {
+      r.i[i].x = jumpend(r, r.i[i].x);
+    }
+    if (r.i[i].code == Split) {
+      r.i[i].y = jumpend(r, r.i[i].y);
+      if (r.i[i].x == r.i[i].y) {
+        r.i[i].code = Jump;
+        r.i[i].y = NULL;
+      }
+    }
+  }
+
+  bool *keep = reachable(r);
+
+  // A Jump to the next instruction that is kept does nothing.
+  size_t next = r.n;
+  for (size_t i = r.n; i-- > 0; ) {
+    if (keep[i] && r.i[i].code == Jump && (size_t)(r.i[i].x - r.i) == next) {
+      keep[i] = false;
+    }
+    if (keep[i]) {
+      next = i;
+    }
+  }
+
+  // Instruction i moves to index[i].  For an instruction which is removed,
+  // that is the index of the next one kept, which is where control would go.
+  size_t *index = calloc(r.n + 1, sizeof(size_t));
+  size_t n = 0;
+  for (size_t i = 0; i < r.n; i++) {
+    index[i] = n;
+    if (keep[i]) {
+      n++;
+    }
+  }
+  index[r.n] = n;
+
+  Instr *code = calloc(n, sizeof(Instr));
+  for (size_t i = 0; i < r.n; i++) {
+    if (!keep[i]) {
+      if (r.i[i].code == Range || r.i[i].code == NRange) {
+        free(r.i[i].x);
+        free(r.i[i].y);
+      }
+      continue;
+    }
+    Instr *in = &code[index[i]];
+    *in = r.i[i];
+    if (in->code == Jump || in->code == Split) {
+      in->x = code + index[r.i[i].x - r.i];
+    }
+    if (in->code == Split) {
+      in->y = code + index[r.i[i].y - r.i];
+    }
+  }
+
+  free(keep);
+  free(index);
+  free(r.i);
+
+  Regex opt = {.n=n, .i=code, .dfa=NULL};
+  if (r.dfa) {
+    // The DFA's scratch space is sized for the old program.
+    redfafree(r.dfa);
+    opt.dfa = redfanew(opt, DFA_BUDGET);
+  }
+  return opt;
+}
@@ -34,18 +34,18 @@ char *ntnames[] = {
   Convenience functions for parse trees.
  */
 
-static PTree *terminal_tree(Token tok)
+static PTree *terminal_tree(Lexer *l, Token tok)
 {
-  PTree *tree = calloc(1, sizeof(PTree));
+  PTree *tree = arenaalloc(l->arena, sizeof(PTree));
   tree->nchildren = 0;
   tree->production = 0; // marks this as terminal
   tree->tok = tok;
   return tree;
 }
 
-static PTree *nonterminal_tree(NTSym nt, size_t nchildren)
+static PTree *nonterminal_tree(Lexer *l, NTSym nt, size_t nchildren)
 {
-  PTree *tree = calloc(1, sizeof(PTree));
+  PTree *tree = arenaalloc(l->arena, sizeof(PTree));
   tree->nchildren = nchildren;
   tree->production = 1; // update this on return.
   tree->nt = nt;
@@ -87,33 +87,33 @@ PTree *TERM(Lexer *l)
 {
   if (accept(CharSym, l) || accept(Dot, l) || accept(Special, l) ||
       accept(Caret, l) || accept(Minus, l)) {
-    PTree *result = nonterminal_tree(TERMnt, 1);
-    result->children[0] = terminal_tree(l->prev);
+    PTree *result = nonterminal_tree(l, TERMnt, 1);
+    result->children[0] = terminal_tree(l, l->prev);
     result->production = 1;
     return result;
   } else if (accept(LParen, l)) {
-    PTree *result = nonterminal_tree(TERMnt, 3);
-    result->children[0] = terminal_tree(l->prev);
+    PTree *result = nonterminal_tree(l, TERMnt, 3);
+    result->children[0] = terminal_tree(l, l->prev);
     result->children[1] = REGEX(l);
     expect(RParen, l);
-    result->children[2] = terminal_tree(l->prev);
+    result->children[2] = terminal_tree(l, l->prev);
     result->production = 2;
     return result;
   } else if (accept(LBracket, l)) {
     PTree *result;
     if (accept(Caret, l)) {
-      result = nonterminal_tree(TERMnt, 3);
-      result->children[0] = terminal_tree((Token){LBracket, '['});
+      result = nonterminal_tree(l, TERMnt, 3);
+      result->children[0] = terminal_tree(l, (Token){LBracket, '['});
       result->children[1] = CLASS(l);
       expect(RBracket, l);
-      result->children[2] = terminal_tree(l->prev);
+      result->children[2] = terminal_tree(l, l->prev);
       result->production = 4;
     } else {
-      result = nonterminal_tree(TERMnt, 3);
-      result->children[0] = terminal_tree((Token){LBracket, '['});
+      result = nonterminal_tree(l, TERMnt, 3);
+      result->children[0] = terminal_tree(l, (Token){LBracket, '['});
       result->children[1] = CLASS(l);
       expect(RBracket, l);
-      result->children[2] = terminal_tree(l->prev);
+      result->children[2] = terminal_tree(l, l->prev);
       result->production = 3;
     }
     return result;
@@ -125,14 +125,14 @@ PTree *TERM(Lexer *l)
 
 PTree *EXPR(Lexer *l)
 {
-  PTree *result = nonterminal_tree(EXPRnt, 1);
+  PTree *result = nonterminal_tree(l, EXPRnt, 1);
   result->children[0] = TERM(l);
   if (accept(Plus, l) || accept(Star, l) || accept(Question, l)) {
     result->nchildren++;
-    result->children[1] = terminal_tree(l->prev);
+    result->children[1] = terminal_tree(l, l->prev);
     if (accept(Question, l)) {
       result->nchildren++;
-      result->children[2] = terminal_tree((Token){Question, '?'});
+      result->children[2] = terminal_tree(l, (Token){Question, '?'});
     }
   }
   return result;
@@ -140,12 +140,12 @@ PTree *EXPR(Lexer *l)
 
 PTree *SUB(Lexer *l)
 {
-  PTree *result = nonterminal_tree(SUBnt, 1);
+  PTree *result = nonterminal_tree(l, SUBnt, 1);
   PTree *orig = result, *prev = result;
 
   while (l->tok.sym != Eof && l->tok.sym != RParen && l->tok.sym != Pipe) { // seems like a bit of a hack
     result->children[0] = EXPR(l);
-    result->children[1] = nonterminal_tree(SUBnt, 0);
+    result->children[1] = nonterminal_tree(l, SUBnt, 0);
     result->nchildren = 2;
     prev = result;
     result = result->children[1];
@@ -154,19 +154,19 @@ PTree *SUB(Lexer *l)
   // This prevents SUB nonterminals with no children in the final parse tree.
   if (prev != result) {
     prev->nchildren = 1;
-    free(result);
+    arenarelease(l->arena, result);
   }
   return orig;
 }
 
 PTree *REGEX(Lexer *l)
 {
-  PTree *result = nonterminal_tree(REGEXnt, 1);
+  PTree *result = nonterminal_tree(l, REGEXnt, 1);
   result->children[0] = SUB(l);
 
   if (accept(Pipe, l)) {
     result->nchildren = 3;
-    result->children[1] = terminal_tree(l->prev);
+    result->children[1] = terminal_tree(l, l->prev);
     result->children[2] = REGEX(l);
   }
   return result;
@@ -186,7 +186,7 @@ bool CCHAR(Lexer *l)
 
 PTree *CLASS(Lexer *l)
 {
-  PTree *result = nonterminal_tree(CLASSnt, 0), *curr, *prev;
+  PTree *result = nonterminal_tree(l, CLASSnt, 0), *curr, *prev;
   Token t1, t2, t3;
   curr = result;
 
@@ -199,25 +199,25 @@ PTree *CLASS(Lexer *l)
         if (CCHAR(l)) {
           t3 = l->prev;
           // We have ourselves a range!  Parse it.
-          curr->children[0] = terminal_tree(t1);
-          curr->children[1] = terminal_tree(t3);
-          curr->children[2] = nonterminal_tree(CLASSnt, 0);
+          curr->children[0] = terminal_tree(l, t1);
+          curr->children[1] = terminal_tree(l, t3);
+          curr->children[2] = nonterminal_tree(l, CLASSnt, 0);
           curr->nchildren = 3;
           curr->production = 1;
           curr = curr->children[2];
         } else {
           // character followed by minus, but not range.
           unget(t2, l);
-          curr->children[0] = terminal_tree(t1);
-          curr->children[1] = nonterminal_tree(CLASSnt, 0);
+          curr->children[0] = terminal_tree(l, t1);
+          curr->children[1] = nonterminal_tree(l, CLASSnt, 0);
           curr->nchildren = 2;
           curr->production = 3;
           curr = curr->children[1];
         }
       } else {
         // just a character
-        curr->children[0] = terminal_tree(t1);
-        curr->children[1] = nonterminal_tree(CLASSnt, 0);
+        curr->children[0] = terminal_tree(l, t1);
+        curr->children[1] = nonterminal_tree(l, CLASSnt, 0);
         curr->nchildren = 2;
         curr->production = 3;
         curr = curr->children[1];
@@ -225,12 +225,12 @@ PTree *CLASS(Lexer *l)
     } else if (accept(Minus, l)) {
       // just a minus
       prev = curr;
-      curr->children[0] = terminal_tree(l->prev);
+      curr->children[0] = terminal_tree(l, l->prev);
       curr->nchildren = 1;
       curr->production = 5;
       break;
     } else {
-      free(curr);
+      arenarelease(l->arena, curr);
       prev->nchildren--;
       prev->production++;
       break;
@@ -239,7 +239,7 @@ PTree *CLASS(Lexer *l)
   return result;
 }
 
-static PTree *reparse_internal(struct Input input)
+PTree *reparsein(struct Input input, Arena *a)
 {
   Lexer l;
 
@@ -247,6 +247,7 @@ static PTree *reparse_internal(struct Input input)
   l.input = input;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = a;
   l.tok = (Token){.sym=0, .c=0};
 
   // Create a parse tree!
@@ -261,27 +262,33 @@ static PTree *reparse_internal(struct Input input)
 PTree *reparse(const char *input)
 {
   struct Input in = {.str=input, .wstr=NULL};
-  return reparse_internal(in);
+  return reparsein(in, NULL);
 }
 
 PTree *reparsew(const wchar_t *winput)
 {
   struct Input in = {.str=NULL, .wstr=winput};
-  return reparse_internal(in);
+  return reparsein(in, NULL);
 }
 
-Regex recomp(const char *regex)
+static Regex recomp_internal(struct Input input)
 {
-  PTree *tree = reparse(regex);
-  Regex code = codegen(tree);
-  free_tree(tree);
+  Arena a;
+  arenainit(&a);
+  PTree *tree = reparsein(input, &a);
+  Regex code = reoptimize(codegenin(tree, &a));
+  arenafree(&a);
   return code;
 }
 
+Regex recomp(const char *regex)
+{
+  struct Input in = {.str=regex, .wstr=NULL};
+  return recomp_internal(in);
+}
+
 Regex recompw(const wchar_t *regex)
 {
-  PTree *tree = reparsew(regex);
-  Regex code = codegen(tree);
-  free_tree(tree);
-  return code;
+  struct Input in = {.str=NULL, .wstr=regex};
+  return recomp_internal(in);
 }
@@ -31,10 +31,26 @@
 
 // Declarations:
 
+/*
+  Capture lists are kept in a pool allocated once per execution.  Each list in
+  the pool has a reference count, so a Split can share its list between both
+  branches, and a Save copies the list only when it is shared (copy on write).
+  A thread refers to its list by slot number.
+ */
+typedef struct capture_pool capture_pool;
+struct capture_pool {
+  size_t nsave;  // number of indices in each capture list
+  size_t ncap;   // number of those indices which Save instructions may set
+  size_t *lists; // nslots capture lists, nsave indices each
+  size_t *refs;  // reference count for each slot
+  size_t *free;  // stack of free slot numbers
+  size_t nfree;
+};
+
 typedef struct thread thread;
 struct thread {
   Instr *pc;
-  size_t *saved;
+  size_t slot;
 };
 
 typedef struct thread_list thread_list;
@@ -43,13 +59,129 @@ struct thread_list {
   size_t n;
 };
 
+/*
+  Everything the VM modifies during an execution lives here, rather than in the
+  program, so that one program may be executed by several contexts at once.
+  Instruction i has been visited during the current step iff mark[i] == gen.
+  Since gen only ever increases, nothing needs to be reset between executions.
+ */
+struct RegexContext {
+  Regex r;
+  thread_list curr, next;
+  thread *stack;    // branches waiting to be added by addthread()
+  size_t *mark;
+  size_t gen;
+  size_t nsave;
+  capture_pool pool;
+  DFA *dfa;
+  char *prefix;     // literal prefix of every match, for narrow input
+  wchar_t *wprefix; // literal prefix of every match, for wide input
+
+  // State of the execution in progress, kept here so it can span several
+  // chunks of input when streaming.
+  size_t sp;        // index of the next character, from the start of input
+  ssize_t match;    // end of the best match so far, or -1
+  size_t matchslot; // captures of the best match so far
+  bool search;      // start threads at every index until there is a match
+  bool done;        // no further input can change the result
+  bool running;     // the context holds threads and a match
+  wchar_t first;    // first character of every match (if not NUL)
+  size_t fed;       // number of characters fed to the stream so far
+
+  // When executing a RegexSet, which patterns have matched.
+  bool *matched;
+  size_t nmatched;
+};
+
+struct RegexSet {
+  Regex r;
+  size_t n;
+  RegexContext *ctx;
+};
+
+// Capture pool functions:
+
+/**
+   @brief Return the number of capture lists needed to execute a program.
+
+   There can be at most n threads in each of the current and next lists, and
+   each Save executed during one step can create at most one unplaced list.
+   Add one for the best match so far and one for the initial thread.
+ */
+static size_t pool_slots(Regex r)
+{
+  return 3 * r.n + 2;
+}
+
+static capture_pool newcapture_pool(size_t nslots, size_t nsave)
+{
+  capture_pool p;
+  p.nsave = nsave;
+  p.ncap = nsave;
+  p.lists = calloc(nslots * nsave, sizeof(size_t));
+  p.refs = calloc(nslots, sizeof(size_t));
+  p.free = calloc(nslots, sizeof(size_t));
+  p.nfree = nslots;
+  for (size_t i = 0; i < nslots; i++) {
+    p.free[i] = nslots - i - 1;
+  }
+  return p;
+}
+
+static void freecapture_pool(capture_pool *p)
+{
+  free(p->lists);
+  free(p->refs);
+  free(p->free);
+}
+
+static size_t *slot_list(capture_pool *p, size_t slot)
+{
+  return p->lists + slot * p->nsave;
+}
+
+/**
+   @brief Take a new capture list (with reference count one) from the pool.
+ */
+static size_t slot_new(capture_pool *p)
+{
+  assert(p->nfree > 0);
+  size_t slot = p->free[--p->nfree];
+  p->refs[slot] = 1;
+  return slot;
+}
+
+static void slot_release(capture_pool *p, size_t slot)
+{
+  assert(p->refs[slot] > 0);
+  if (--p->refs[slot] == 0) {
+    p->free[p->nfree++] = slot;
+  }
+}
+
+/**
+   @brief Set a capture index, copying the list first if it is shared.
+   @returns The slot which now holds the modified list.
+ */
+static size_t slot_set(capture_pool *p, size_t slot, size_t idx, size_t value)
+{
+  if (p->refs[slot] > 1) {
+    size_t copy = slot_new(p);
+    memcpy(slot_list(p, copy), slot_list(p, slot), p->nsave * sizeof(size_t));
+    slot_release(p, slot);
+    slot = copy;
+  }
+  slot_list(p, slot)[idx] = value;
+  return slot;
+}
+
 // Printing, for diagnostics
 
-void printthreads(thread_list *tl, Instr *prog, size_t nsave) {
+void printthreads(thread_list *tl, Instr *prog, capture_pool *p) {
   for (size_t i = 0; i < tl->n; i++) {
     printf("T%zu@pc=%lu{", i, (intptr_t) (tl->t[i].pc - prog));
-    for (size_t j = 0; j < nsave; j++) {
-      printf("%lu,", tl->t[i].saved[j]);
+    for (size_t j = 0; j < p->nsave; j++) {
+      printf("%lu,", slot_list(p, tl->t[i].slot)[j]);
     }
     printf("} ");
   }
@@ -58,23 +190,91 @@ void printthreads(thread_list *tl, Instr *prog, size_t nsave) {
 
 // Helper evaluation functions for instructions
 
-bool range(Instr in, wchar_t test) {
-  if (test == L'\0') {
-    return false;
+static int compareranges(const void *a, const void *b)
+{
+  const wchar_t *l = a, *r = b;
+  return (l[0] > r[0]) - (l[0] < r[0]);
+}
+
+ClassTable *newclass(const wchar_t *pairs, size_t n, bool negate)
+{
+  ClassTable *t = calloc(1, sizeof(ClassTable) + 2 * n * sizeof(wchar_t));
+
+  // Sort the ranges, and merge the ones that overlap or touch.
+  for (size_t i = 0; i < n; i++) {
+    if (pairs[2*i] <= pairs[2*i + 1]) {
+      t->ranges[2*t->n] = pairs[2*i];
+      t->ranges[2*t->n + 1] = pairs[2*i + 1];
+      t->n++;
+    }
   }
-  bool result = false;
-  char *block = (char *) in.x;
+  qsort(t->ranges, t->n, 2 * sizeof(wchar_t), compareranges);
+  size_t merged = 0;
+  for (size_t i = 0; i < t->n; i++) {
+    if (merged > 0 && t->ranges[2*i] <= t->ranges[2*merged - 1] + 1) {
+      if (t->ranges[2*i + 1] > t->ranges[2*merged - 1]) {
+        t->ranges[2*merged - 1] = t->ranges[2*i + 1];
+      }
+    } else {
+      t->ranges[2*merged] = t->ranges[2*i];
+      t->ranges[2*merged + 1] = t->ranges[2*i + 1];
+      merged++;
+    }
+  }
+  t->n = merged;
+
+  // Fill in the bitmap.  NUL never matches a class, negated or not.
+  for (size_t i = 0; i < t->n; i++) {
+    wchar_t lo = t->ranges[2*i] < 1 ? 1 : t->ranges[2*i];
+    wchar_t hi = t->ranges[2*i + 1] > 255 ? 255 : t->ranges[2*i + 1];
+    for (wchar_t c = lo; c <= hi; c++) {
+      t->bits[c >> 6] |= 1ULL << (c & 63);
+    }
+  }
+  if (negate) {
+    for (size_t i = 0; i < nelem(t->bits); i++) {
+      t->bits[i] = ~t->bits[i];
+    }
+    t->bits[0] &= ~1ULL;
+  }
+  return t;
+}
+
+void classfromblock(Instr *in)
+{
+  char *block = (char *) in->x;
+  wchar_t *pairs = calloc(2 * in->s, sizeof(wchar_t));
+  for (size_t i = 0; i < 2 * in->s; i++) {
+    pairs[i] = block[i];
+  }
+  in->y = (Instr *) newclass(pairs, in->s, in->code == NRange);
+  free(pairs);
+}
 
-  // use in.s for number of ranges, in.x as char* for ranges.
-  for (size_t i = 0; i < in.s; i++) {
-    if (block[i*2] <= test && test <= block [i*2 + 1]) {
+bool range(const Instr *in, wchar_t test) {
+  const ClassTable *t = (const ClassTable *) in->y;
+
+  if ((unsigned long) test < 256) {
+    return (t->bits[test >> 6] >> (test & 63)) & 1;
+  }
+
+  // Binary search for a range containing the character.
+  bool result = false;
+  size_t lo = 0, hi = t->n;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (test < t->ranges[2*mid]) {
+      hi = mid;
+    } else if (test > t->ranges[2*mid + 1]) {
+      lo = mid + 1;
+    } else {
       result = true;
-      break; // short circuit yo!
+      break;
     }
   }
 
   // negate result for negative ranges
-  if (in.code == Range) {
+  if (in->code == Range) {
     return result;
   } else {
     return !result;
@@ -91,161 +291,681 @@ thread_list newthread_list(size_t n)
   return tl;
 }
 
-void addthread(thread_list *threads, Instr *pc, size_t *saved, size_t nsave,
+void addthread(RegexContext *ctx, thread_list *threads, Instr *pc, size_t slot,
                size_t sp)
 {
-  //printf("addthread(): pc=%d, saved={%u, %u}, sp=%u, lastidx=%u\n", pc - extprog,
-  //       saved[0], saved[1], sp, pc->lastidx);
-  if (pc->lastidx == sp) {
-    // we've executed this instruction on this string index already
-    free(saved);
-    return;
-  }
-  pc->lastidx = sp;
-
-  size_t *newsaved;
-  switch (pc->code) {
-  case Jump:
-    addthread(threads, pc->x, saved, nsave, sp);
-    break;
-  case Split:
-    newsaved = calloc(nsave, sizeof(size_t));
-    memcpy(newsaved, saved, nsave * sizeof(size_t));
-    addthread(threads, pc->x, saved, nsave, sp);
-    addthread(threads, pc->y, newsaved, nsave, sp);
-    break;
-  case Save:
-    saved[pc->s] = sp;
-    addthread(threads, pc + 1, saved, nsave, sp);
-    break;
-  default:
-    threads->t[threads->n].pc = pc;
-    threads->t[threads->n].saved = saved;
-    threads->n++;
-    break;
+  capture_pool *p = &ctx->pool;
+  thread *stack = ctx->stack;
+  size_t top = 0;
+
+  // Instead of recursing on a Split, the y branch waits on the stack until
+  // everything reachable from the x branch is added.  Each Split can only be
+  // visited once per generation, so the stack never holds more than r.n.
+  for (;;) {
+    size_t idx = pc - ctx->r.i;
+    if (ctx->mark[idx] == ctx->gen) {
+      // we've executed this instruction on this string index already
+      slot_release(p, slot);
+    } else {
+      ctx->mark[idx] = ctx->gen;
+
+      switch (pc->code) {
+      case Jump:
+        pc = pc->x;
+        continue;
+      case Split:
+        // Both branches share the capture list until one of them modifies it.
+        p->refs[slot]++;
+        stack[top].pc = pc->y;
+        stack[top].slot = slot;
+        top++;
+        pc = pc->x;
+        continue;
+      case Save:
+        if (pc->s < p->ncap) {
+          slot = slot_set(p, slot, pc->s, sp);
+        }
+        pc = pc + 1;
+        continue;
+      default:
+        threads->t[threads->n].pc = pc;
+        threads->t[threads->n].slot = slot;
+        threads->n++;
+        break;
+      }
+    }
+
+    if (top == 0) {
+      break;
+    }
+    top--;
+    pc = stack[top].pc;
+    slot = stack[top].slot;
   }
 }
 
 /**
-   @brief "Stash" a list of captures into the "out" pointer.
-   @param new The new list of captures encountered by the Match instruction.
-   @param destination The out pointer where the caller wants the captures.
+   @brief Find the literal string that every match of a program begins with.
+
+   This follows the program from its first instruction, collecting Char
+   instructions, until it reaches an instruction that could branch or match
+   more than one character.  Save instructions don't consume input, so they are
+   skipped.
+   @param r The program.
+   @param narrow True if the prefix is for narrow input.  In that case, the
+   prefix stops at a character that can't be represented as a char.
+   @returns A new NUL terminated wide string (possibly empty).
  */
-void stash(size_t *new, size_t **destination)
+static wchar_t *literalprefix(Regex r, bool narrow)
 {
-  if (!destination) {
-    /* If the user wants to discard the captures, they'll pass NULL.  This means
-       we need to get rid of the capture list, or we'll leak the memory. */
-    free(new);
-    return;
-  }
-  if (*destination) {
-    /* If we have already stored a capture list, we should free that. */
-    free(*destination);
+  size_t n = 0;
+  wchar_t *prefix = calloc(r.n + 1, sizeof(wchar_t));
+  for (size_t i = 0; i < r.n; i++) {
+    if (r.i[i].code == Save) {
+      continue;
+    }
+    if (r.i[i].code != Char || r.i[i].c == L'\0' ||
+        (narrow && (wchar_t)(char)r.i[i].c != r.i[i].c)) {
+      break;
+    }
+    prefix[n++] = r.i[i].c;
   }
-  /* Finally, stash the pointer away. */
-  *destination = new;
+  return prefix;
 }
 
-static ssize_t reexec_internal(Regex r, const struct Input input, size_t **saved)
+static RegexContext *newcontext(Regex r, bool dfa)
 {
+  RegexContext *ctx = calloc(1, sizeof(RegexContext));
+  ctx->r = r;
   // Can have at most n threads, where n is the length of the program.  This is
   // because (as it is now) the thread state is simply a program counter.
-  thread_list curr = newthread_list(r.n);
-  thread_list next = newthread_list(r.n);
-  thread_list temp;
-  size_t nsave = 0;
-  ssize_t match = -1;
+  ctx->curr = newthread_list(r.n);
+  ctx->next = newthread_list(r.n);
+  ctx->stack = calloc(r.n, sizeof(thread));
+  ctx->mark = calloc(r.n, sizeof(size_t));
+  ctx->gen = 0;
+  ctx->match = -1;
+  ctx->nsave = renumsaves(r);
+  // Each capture list has room for the start index of a search.
+  ctx->pool = newcapture_pool(pool_slots(r), ctx->nsave + 1);
+  ctx->dfa = dfa ? redfanew(r, DFA_BUDGET) : NULL;
+
+  wchar_t *narrow = literalprefix(r, true);
+  ctx->prefix = calloc(wcslen(narrow) + 1, sizeof(char));
+  for (size_t i = 0; narrow[i]; i++) {
+    ctx->prefix[i] = (char)narrow[i];
+  }
+  free(narrow);
+  ctx->wprefix = literalprefix(r, false);
+  return ctx;
+}
 
-  // Set the out pointer to NULL so that stash() knows whether we've already
-  // stashed away a capture list.
-  if (saved) {
-    *saved = NULL;
+RegexContext *recontext(Regex r)
+{
+  return newcontext(r, true);
+}
+
+void recontextfree(RegexContext *ctx)
+{
+  free(ctx->curr.t);
+  free(ctx->next.t);
+  free(ctx->stack);
+  free(ctx->mark);
+  freecapture_pool(&ctx->pool);
+  redfafree(ctx->dfa);
+  free(ctx->prefix);
+  free(ctx->wprefix);
+  free(ctx);
+}
+
+/**
+   @brief Discard the threads and match of the execution in progress, if any.
+ */
+static void pikeabandon(RegexContext *ctx)
+{
+  if (!ctx->running) {
+    return;
+  }
+  for (size_t t = 0; t < ctx->curr.n; t++) {
+    slot_release(&ctx->pool, ctx->curr.t[t].slot);
   }
+  ctx->curr.n = 0;
+  if (ctx->match != -1) {
+    slot_release(&ctx->pool, ctx->matchslot);
+  }
+  ctx->match = -1;
+  ctx->running = false;
+}
 
-  // Need to initialize lastidx to something that will never be used.
-  for (size_t i = 0; i < r.n; i++) {
-    r.i[i].lastidx = (size_t)-1;
-    if (r.i[i].code == Save) {
-      nsave++;
+/**
+   @brief Begin an execution of the Pike VM.
+
+   In a search, a new thread is started at every index (at the lowest
+   priority) until a match is found, which is equivalent to prefixing the
+   program with a non-greedy ".*", except that each thread records where it
+   started in the extra index at the end of its capture list.
+   @param ctx Context to execute with.
+   @param ncap Number of capture indices to track (more than the program has is
+   fine).
+   @param search Whether to search for the leftmost match, rather than only
+   matching at index 0.
+ */
+static void pikestart(RegexContext *ctx, size_t ncap, bool search)
+{
+  capture_pool *p = &ctx->pool;
+
+  pikeabandon(ctx);
+  // Captures the caller discards don't need to be tracked.  Every slot is free
+  // between executions, so the pool can be re-strided.
+  assert(p->nfree == pool_slots(ctx->r));
+  p->ncap = ncap < ctx->nsave ? ncap : ctx->nsave;
+  p->nsave = p->ncap + (search ? 1 : 0);
+  ctx->curr.n = 0;
+  ctx->next.n = 0;
+  ctx->gen++;
+
+  ctx->sp = 0;
+  ctx->match = -1;
+  ctx->matchslot = 0;
+  ctx->search = search;
+  ctx->first = L'\0';
+  ctx->done = false;
+  ctx->running = true;
+}
+
+/**
+   @brief Return true if a search has no threads, so it may skip input.
+ */
+static bool pikeidle(RegexContext *ctx)
+{
+  return ctx->search && ctx->match == -1 && ctx->curr.n == 0;
+}
+
+/**
+   @brief Step every thread over the character at index ctx->sp.
+
+   This is the whole VM: the drivers below only decide where the characters
+   come from.  A NUL character ends the input.
+   @param ctx Context of a running execution.
+   @param c The character at index ctx->sp.
+   @returns False once no further input can change the result.
+ */
+static bool pikestep(RegexContext *ctx, wchar_t c)
+{
+  Regex r = ctx->r;
+  capture_pool *p = &ctx->pool;
+  thread_list *curr = &ctx->curr;
+  thread_list *next = &ctx->next;
+  thread_list temp;
+  size_t sp = ctx->sp;
+
+  // Start a new thread here (the first one, or a search from this index).
+  // Note that addthread() will execute instructions that don't consume input
+  // (i.e. epsilon closure).
+  if (sp == 0 || (ctx->search && ctx->match == -1)) {
+    if (!ctx->search || ctx->first == L'\0' || c == ctx->first) {
+      size_t slot = slot_new(p);
+      memset(slot_list(p, slot), 0, p->nsave * sizeof(size_t));
+      if (ctx->search) {
+        slot_list(p, slot)[p->nsave - 1] = sp;
+      }
+      addthread(ctx, curr, r.i, slot, sp);
     }
   }
 
-  // Start with a single thread and add more as we need.  Note that addthread()
-  // will execute instructions that don't consume input (i.e. epsilon closure).
-  addthread(&curr, r.i, calloc(nsave, sizeof(size_t)), nsave, 0);
+  if (curr->n == 0) {
+    if (pikeidle(ctx) && c != L'\0') {
+      ctx->gen++;
+      ctx->sp++;
+      return true;
+    }
+    ctx->done = true;
+    return false;
+  }
 
-  size_t sp;
-  for (sp = 0; curr.n > 0; sp++) {
+  //printf("consider input %c\nthreads: ", c);
+  //printthreads(curr, r.i, p);
 
-    //printf("consider input %c\nthreads: ", input[sp]);
-    //printthreads(&curr, r.i, nsave);
+  // Every thread reaching the next list this step starts a new generation.
+  ctx->gen++;
 
-    // Execute each thread (this will only ever reach instructions that consume
-    // input, since addthread() stops with those).
-    for (size_t t = 0; t < curr.n; t++) {
-      Instr *pc = curr.t[t].pc;
+  // Execute each thread (this will only ever reach instructions that consume
+  // input, since addthread() stops with those).
+  for (size_t t = 0; t < curr->n; t++) {
+    Instr *pc = curr->t[t].pc;
 
-      switch (pc->code) {
-      case Char:
-        if (InputIdx(input, sp) != pc->c) {
-          free(curr.t[t].saved);
-          break; // fail, don't continue executing this thread
-        }
-        // add thread containing the next instruction to the next thread list.
-        addthread(&next, pc+1, curr.t[t].saved, nsave, sp+1);
-        break;
-      case Any:
-        if (InputIdx(input, sp) == '\0') {
-          free(curr.t[t].saved);
-          break; // dot can't match end of string!
-        }
-        // add thread containing the next instruction to the next thread list.
-        addthread(&next, pc+1, curr.t[t].saved, nsave, sp+1);
+    switch (pc->code) {
+    case Char:
+      if (c != pc->c) {
+        slot_release(p, curr->t[t].slot);
+        break; // fail, don't continue executing this thread
+      }
+      // add thread containing the next instruction to the next thread list.
+      addthread(ctx, next, pc+1, curr->t[t].slot, sp+1);
+      break;
+    case Any:
+      if (c == L'\0') {
+        slot_release(p, curr->t[t].slot);
+        break; // dot can't match end of string!
+      }
+      // add thread containing the next instruction to the next thread list.
+      addthread(ctx, next, pc+1, curr->t[t].slot, sp+1);
+      break;
+    case Range:
+    case NRange:
+      if (!range(pc, c)) {
+        slot_release(p, curr->t[t].slot);
         break;
-      case Range:
-      case NRange:
-        if (!range(*pc, InputIdx(input, sp))) {
-          free(curr.t[t].saved);
-          break;
+      }
+      addthread(ctx, next, pc+1, curr->t[t].slot, sp+1);
+      break;
+    case Match:
+      if (ctx->matched) {
+        // In a set, a Match only records that its pattern matched.  The other
+        // patterns' threads must keep running, so nothing is discarded.
+        if (!ctx->matched[pc->s]) {
+          ctx->matched[pc->s] = true;
+          ctx->nmatched++;
         }
-        addthread(&next, pc+1, curr.t[t].saved, nsave, sp+1);
-        break;
-      case Match:
-        stash(curr.t[t].saved, saved);
-        match = sp;
-        goto cont;
-      default:
-        assert(false);
+        slot_release(p, curr->t[t].slot);
         break;
       }
+      // Keep this thread's captures in place of any previous match.
+      if (ctx->match != -1) {
+        slot_release(p, ctx->matchslot);
+      }
+      ctx->matchslot = curr->t[t].slot;
+      ctx->match = sp;
+      // Lower priority threads are discarded, along with their captures.
+      for (size_t u = t + 1; u < curr->n; u++) {
+        slot_release(p, curr->t[u].slot);
+      }
+      goto cont;
+    default:
+      assert(false);
+      break;
     }
+  }
+
+ cont:
+  // Swap the curr and next lists.
+  temp = *curr;
+  *curr = *next;
+  *next = temp;
+
+  // Reset our new next list.
+  next->n = 0;
+  ctx->sp++;
+
+  if (c == L'\0' || (curr->n == 0 && !pikeidle(ctx))) {
+    ctx->done = true;
+    return false;
+  }
+  return true;
+}
+
+/**
+   @brief Finish an execution, releasing its state and returning its result.
+   @param ctx Context of a running execution.
+   @param start Out pointer for the start of the match (searches only).
+   @param caps Where to copy the tracked captures of a match.
+   @returns The index of the end of the match, or -1 if there is none.
+ */
+static ssize_t pikefinish(RegexContext *ctx, size_t *start, size_t *caps)
+{
+  capture_pool *p = &ctx->pool;
+  ssize_t match = ctx->match;
 
-  cont:
-    // Swap the curr and next lists.
-    temp = curr;
-    curr = next;
-    next = temp;
+  // Any threads left when the input ends are discarded.
+  for (size_t t = 0; t < ctx->curr.n; t++) {
+    slot_release(p, ctx->curr.t[t].slot);
+  }
+  ctx->curr.n = 0;
 
-    // Reset our new next list.
-    next.n = 0;
+  if (match != -1) {
+    size_t *list = slot_list(p, ctx->matchslot);
+    if (ctx->search) {
+      *start = list[p->nsave - 1];
+    }
+    memcpy(caps, list, p->ncap * sizeof(size_t));
+    slot_release(p, ctx->matchslot);
   }
 
-  free(curr.t);
-  free(next.t);
+  ctx->match = -1;
+  ctx->running = false;
   return match;
 }
 
+/**
+   @brief Return the captures of a match in a new array, for callers which
+   asked for them with a saved pointer.
+   @param match Result of the execution.
+   @param caps The captures the execution tracked.
+   @param ncap How many captures were tracked.
+   @param saved Out pointer for the new array (may be NULL).  Set to NULL when
+   there is no match, or when captures were not tracked.
+ */
+static void savecopy(ssize_t match, const size_t *caps, size_t ncap,
+                     size_t **saved)
+{
+  if (!saved) {
+    return;
+  }
+  if (match == -1 || ncap == 0) {
+    *saved = NULL;
+    return;
+  }
+  *saved = calloc(ncap, sizeof(size_t));
+  memcpy(*saved, caps, ncap * sizeof(size_t));
+}
+
+/*
+  The drivers feed characters to pikestep().  The narrow and wide versions only
+  differ in their character type and the functions they use to skip ahead, so
+  they are generated by this macro.  Neither one has to check the type of its
+  input for every character, which InputIdx() would.
+
+  pike_SUFFIX() runs the VM over a whole string, tracking the first ncap
+  capture indices into caps.  If start is non-NULL, it searches for the
+  leftmost match and stores its start index there.  Otherwise it only matches
+  at the beginning of the input.  It returns the index of the end of the match,
+  or -1.  When a search has no threads left, it skips ahead
+  to the next occurrence of the literal prefix (strstr() and wcsstr() are
+  fast).
+
+  saved_SUFFIX() is pike_SUFFIX() for the public functions, which return the
+  captures in a new array.  They are tracked in an array on the stack first, so
+  nothing is allocated when there is no match.
+
+  feed_SUFFIX() runs the VM over the next chunk of a stream, and returns false
+  once the result is decided.  The rest of the literal prefix may lie in the
+  next chunk, so it only skips to the next occurrence of the prefix's first
+  character.
+*/
+#define PIKE_DRIVERS(SUFFIX, CHAR, PREFIX, STRSTR, MEMCHR)                    \
+  static ssize_t pike_##SUFFIX(RegexContext *ctx, const CHAR *input,         \
+                               size_t *caps, size_t ncap, size_t *start)     \
+  {                                                                          \
+    pikestart(ctx, ncap, start != NULL);                                     \
+    ctx->first = (wchar_t)ctx->PREFIX[0];                                    \
+                                                                             \
+    for (;;) {                                                               \
+      if (ctx->first != L'\0' && pikeidle(ctx)) {                            \
+        const CHAR *found = STRSTR(input + ctx->sp, ctx->PREFIX);            \
+        if (!found) {                                                        \
+          break;                                                             \
+        }                                                                    \
+        ctx->sp = found - input;                                             \
+        ctx->gen++;                                                          \
+      }                                                                      \
+      if (!pikestep(ctx, (wchar_t)input[ctx->sp])) {                         \
+        break;                                                               \
+      }                                                                      \
+    }                                                                        \
+                                                                             \
+    return pikefinish(ctx, start, caps);                                     \
+  }                                                                          \
+                                                                             \
+  static ssize_t saved_##SUFFIX(RegexContext *ctx, const CHAR *input,        \
+                                size_t **saved, size_t *start)               \
+  {                                                                          \
+    size_t ncap = saved ? ctx->nsave : 0;                                    \
+    size_t caps[ncap + 1];                                                   \
+    ssize_t end = pike_##SUFFIX(ctx, input, caps, ncap, start);              \
+    savecopy(end, caps, ncap, saved);                                        \
+    return end;                                                              \
+  }                                                                          \
+                                                                             \
+  static bool feed_##SUFFIX(RegexContext *ctx, const CHAR *chunk, size_t len) \
+  {                                                                          \
+    size_t base = ctx->fed; /* index of chunk[0] in the whole input */       \
+    ctx->fed += len;                                                         \
+    ctx->first = (wchar_t)ctx->PREFIX[0];                                    \
+                                                                             \
+    while (!ctx->done && ctx->sp < ctx->fed) {                               \
+      size_t i = ctx->sp - base;                                             \
+      if (ctx->first != L'\0' && pikeidle(ctx)) {                            \
+        /* Skip no further than a NUL, which ends the input. */             \
+        const CHAR *nul = MEMCHR(chunk + i, 0, len - i);                     \
+        size_t n = nul ? (size_t)(nul - chunk) - i : len - i;                \
+        const CHAR *found = MEMCHR(chunk + i, ctx->PREFIX[0], n);            \
+        ctx->gen++;                                                          \
+        if (!found && !nul) {                                                \
+          ctx->sp = ctx->fed;                                                \
+          break;                                                             \
+        }                                                                    \
+        i = (found ? found : nul) - chunk;                                   \
+        ctx->sp = base + i;                                                  \
+      }                                                                      \
+      pikestep(ctx, (wchar_t)chunk[i]);                                      \
+    }                                                                        \
+    return !ctx->done;                                                       \
+  }
+
+PIKE_DRIVERS(str, char, prefix, strstr, memchr)
+PIKE_DRIVERS(wstr, wchar_t, wprefix, wcsstr, wmemchr)
+
+/**
+   @brief Return the length of a search's match, given where it ends.
+ */
+static ssize_t searchlength(ssize_t end, size_t begin, size_t *start)
+{
+  if (end == -1) {
+    return -1;
+  }
+  if (start) {
+    *start = begin;
+  }
+  return end - begin;
+}
+
+ssize_t reexecctx(RegexContext *ctx, const char *input, size_t **saved)
+{
+  if (!saved && ctx->dfa) {
+    ssize_t match = redfaexec(ctx->dfa, ctx->r, input);
+    if (match != DFA_GAVEUP) {
+      return match;
+    }
+  }
+  return saved_str(ctx, input, saved, NULL);
+}
+
+ssize_t reexecwctx(RegexContext *ctx, const wchar_t *input, size_t **saved)
+{
+  return saved_wstr(ctx, input, saved, NULL);
+}
+
+ssize_t reexecinto(RegexContext *ctx, const char *input, size_t *saved,
+                   size_t n)
+{
+  if (n == 0) {
+    return reexecctx(ctx, input, NULL);
+  }
+  return pike_str(ctx, input, saved, n, NULL);
+}
+
+ssize_t reexecwinto(RegexContext *ctx, const wchar_t *input, size_t *saved,
+                    size_t n)
+{
+  return pike_wstr(ctx, input, saved, n, NULL);
+}
+
 ssize_t reexec(Regex r, const char *input, size_t **saved)
 {
-  struct Input in = {.str=input, .wstr=NULL};
-  return reexec_internal(r, in, saved);
+  if (!saved && r.dfa) {
+    ssize_t match = redfaexec(r.dfa, r, input);
+    if (match != DFA_GAVEUP) {
+      return match;
+    }
+  }
+  // Small problems are faster to backtrack than to set up a context for.
+  ssize_t match = rebacktrack(r, input, saved);
+  if (match != BT_GAVEUP) {
+    return match;
+  }
+  RegexContext *ctx = newcontext(r, false);
+  match = saved_str(ctx, input, saved, NULL);
+  recontextfree(ctx);
+  return match;
 }
 
 ssize_t reexecw(Regex r, const wchar_t *input, size_t **saved)
 {
-  struct Input in = {.str=NULL, .wstr=input};
-  return reexec_internal(r, in, saved);
+  RegexContext *ctx = newcontext(r, false);
+  ssize_t match = saved_wstr(ctx, input, saved, NULL);
+  recontextfree(ctx);
+  return match;
+}
+
+ssize_t researchctx(RegexContext *ctx, const char *input, size_t *start,
+                    size_t **saved)
+{
+  size_t begin = 0;
+  ssize_t end = saved_str(ctx, input, saved, &begin);
+  return searchlength(end, begin, start);
+}
+
+ssize_t researchwctx(RegexContext *ctx, const wchar_t *input, size_t *start,
+                     size_t **saved)
+{
+  size_t begin = 0;
+  ssize_t end = saved_wstr(ctx, input, saved, &begin);
+  return searchlength(end, begin, start);
+}
+
+ssize_t researchinto(RegexContext *ctx, const char *input, size_t *start,
+                     size_t *saved, size_t n)
+{
+  size_t begin = 0;
+  ssize_t end = pike_str(ctx, input, saved, n, &begin);
+  return searchlength(end, begin, start);
+}
+
+ssize_t researchwinto(RegexContext *ctx, const wchar_t *input, size_t *start,
+                      size_t *saved, size_t n)
+{
+  size_t begin = 0;
+  ssize_t end = pike_wstr(ctx, input, saved, n, &begin);
+  return searchlength(end, begin, start);
+}
+
+ssize_t research(Regex r, const char *input, size_t *start, size_t **saved)
+{
+  RegexContext *ctx = newcontext(r, false);
+  ssize_t length = researchctx(ctx, input, start, saved);
+  recontextfree(ctx);
+  return length;
+}
+
+ssize_t researchw(Regex r, const wchar_t *input, size_t *start, size_t **saved)
+{
+  RegexContext *ctx = newcontext(r, false);
+  ssize_t length = researchwctx(ctx, input, start, saved);
+  recontextfree(ctx);
+  return length;
+}
+
+void restreamstart(RegexContext *ctx, bool search, bool captures)
+{
+  pikestart(ctx, captures ? ctx->nsave : 0, search);
+  ctx->fed = 0;
+}
+
+bool restreamfeed(RegexContext *ctx, const char *chunk, size_t len)
+{
+  return feed_str(ctx, chunk, len);
+}
+
+bool restreamfeedw(RegexContext *ctx, const wchar_t *chunk, size_t len)
+{
+  return feed_wstr(ctx, chunk, len);
+}
+
+ssize_t restreamfinish(RegexContext *ctx, size_t *start, size_t **saved)
+{
+  size_t begin = 0, ncap = ctx->pool.ncap;
+  size_t caps[ncap + 1];
+  if (!ctx->done) {
+    pikestep(ctx, L'\0');
+  }
+  ssize_t end = pikefinish(ctx, &begin, caps);
+  savecopy(end, caps, ncap, saved);
+  return searchlength(end, begin, start);
+}
+
+ssize_t restreamfile(RegexContext *ctx, FILE *f, bool search, size_t *start,
+                     size_t **saved)
+{
+  char buffer[4096];
+  size_t n;
+
+  restreamstart(ctx, search, saved != NULL);
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0 &&
+         restreamfeed(ctx, buffer, n)) {
+    // keep feeding until the file ends or the result is decided
+  }
+  return restreamfinish(ctx, start, saved);
+}
+
+static RegexSet *newset(PTree **trees, size_t n, Arena *a)
+{
+  RegexSet *set = calloc(1, sizeof(RegexSet));
+  set->r = reoptimize(codegenset(trees, n, a));
+  set->n = n;
+  set->ctx = newcontext(set->r, false);
+  arenafree(a);
+  return set;
+}
+
+RegexSet *recompset(const char **regexes, size_t n)
+{
+  Arena a;
+  arenainit(&a);
+  PTree **trees = arenaalloc(&a, n * sizeof(PTree*));
+  for (size_t i = 0; i < n; i++) {
+    struct Input in = {.str=regexes[i], .wstr=NULL};
+    trees[i] = reparsein(in, &a);
+  }
+  return newset(trees, n, &a);
+}
+
+RegexSet *recompsetw(const wchar_t **regexes, size_t n)
+{
+  Arena a;
+  arenainit(&a);
+  PTree **trees = arenaalloc(&a, n * sizeof(PTree*));
+  for (size_t i = 0; i < n; i++) {
+    struct Input in = {.str=NULL, .wstr=regexes[i]};
+    trees[i] = reparsein(in, &a);
+  }
+  return newset(trees, n, &a);
+}
+
+size_t reexecset(RegexSet *set, const char *input, bool *matched)
+{
+  memset(matched, 0, set->n * sizeof(bool));
+  set->ctx->matched = matched;
+  set->ctx->nmatched = 0;
+  pike_str(set->ctx, input, NULL, 0, NULL);
+  set->ctx->matched = NULL;
+  return set->ctx->nmatched;
+}
+
+size_t reexecsetw(RegexSet *set, const wchar_t *input, bool *matched)
+{
+  memset(matched, 0, set->n * sizeof(bool));
+  set->ctx->matched = matched;
+  set->ctx->nmatched = 0;
+  pike_wstr(set->ctx, input, NULL, 0, NULL);
+  set->ctx->matched = NULL;
+  return set->ctx->nmatched;
+}
+
+void refreeset(RegexSet *set)
+{
+  recontextfree(set->ctx);
+  refree(set->r);
+  free(set);
 }
 
 size_t renumsaves(Regex r)
@@ -66,6 +66,22 @@ void recapwfree(WCaptures c)
   free(c.cap);
 }
 
+void recapspan(const char *s, const size_t *l, size_t n, Span *spans)
+{
+  for (size_t i = 0; i < n / 2; i++) {
+    spans[i].str = s + l[i*2];
+    spans[i].len = l[i*2 + 1] - l[i*2];
+  }
+}
+
+void recapwspan(const wchar_t *s, const size_t *l, size_t n, WSpan *spans)
+{
+  for (size_t i = 0; i < n / 2; i++) {
+    spans[i].str = s + l[i*2];
+    spans[i].len = l[i*2 + 1] - l[i*2];
+  }
+}
+
 wchar_t InputIdx(struct Input in, size_t idx)
 {
   if (in.str) {
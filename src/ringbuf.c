@@ -1,35 +1,66 @@
+#include "libstephen/base.h"
 #include "libstephen/rb.h"
 
+#include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+   @brief How many times a blocking MPMC push or pop retries before it starts
+   yielding between tries.
+ */
+#define RB_MPMC_SPINS 64
+
 void rb_init(smb_rb *rb, int dsize, int init)
+{
+  rb_init_alloc(rb, dsize, init, NULL);
+}
+
+void rb_init_alloc(smb_rb *rb, int dsize, int init,
+                   const smb_allocator *allocator)
 {
   rb->dsize = dsize;
   rb->nalloc = init;
   rb->start = 0;
   rb->count = 0;
-  rb->data = calloc(dsize, init);
+  rb->alloc = allocator;
+  rb->data = smb_alloc(allocator, char, (size_t)dsize * init);
+  memset(rb->data, 0, (size_t)dsize * init);
 }
 
 void rb_destroy(smb_rb *rb)
 {
-  free(rb->data);
+  smb_dealloc(rb->alloc, char, rb->data, (size_t)rb->nalloc * rb->dsize);
+}
+
+/*
+  Return index mod nalloc, for an index less than twice nalloc.  The capacity
+  isn't always a power of two, but this avoids a division.
+ */
+static int rb_wrap(const smb_rb *rb, int index)
+{
+  return index >= rb->nalloc ? index - rb->nalloc : index;
+}
+
+static char *rb_item(const smb_rb *rb, int index)
+{
+  return (char*)rb->data + index * rb->dsize;
 }
 
 void rb_grow(smb_rb *rb)
 {
   int oldalloc = rb->nalloc;
   rb->nalloc *= 2;
-  rb->data = realloc(rb->data, rb->nalloc * rb->dsize);
-
-  for (int i = 0; i < rb->count; i++) {
-    int oldindex = (rb->start + i) % oldalloc;
-    int newindex = (rb->start + i) % rb->nalloc;
-    if (oldindex != newindex) {
-      memcpy(rb->data + newindex * rb->dsize,
-             rb->data + oldindex * rb->dsize, rb->nalloc);
-    }
+  rb->data = smb_realloc(rb->alloc, char, rb->data,
+                         (size_t)oldalloc * rb->dsize,
+                         (size_t)rb->nalloc * rb->dsize);
+
+  // Items before the end of the old space stay where they are.  Any which had
+  // wrapped around to the start now go right after them.
+  int wrapped = rb->start + rb->count - oldalloc;
+  if (wrapped > 0) {
+    memcpy(rb_item(rb, oldalloc), rb_item(rb, 0), wrapped * rb->dsize);
   }
 }
 
@@ -40,17 +71,15 @@ void rb_push_front(smb_rb *rb, void *src)
   }
 
   // ensure the new start index is still positive
-  int newstart = (rb->start + rb->nalloc - 1) % rb->nalloc;
-  rb->start = newstart;
-  memcpy(rb->data + rb->start * rb->dsize, src, rb->dsize);
+  rb->start = rb->start == 0 ? rb->nalloc - 1 : rb->start - 1;
+  memcpy(rb_item(rb, rb->start), src, rb->dsize);
   rb->count++;
 }
 
 void rb_pop_front(smb_rb *rb, void *dst)
 {
-  int newstart = (rb->start + 1) % rb->nalloc;
-  memcpy(dst, rb->data + rb->start * rb->dsize, rb->dsize);
-  rb->start = newstart;
+  memcpy(dst, rb_item(rb, rb->start), rb->dsize);
+  rb->start = rb_wrap(rb, rb->start + 1);
   rb->count--;
 }
 
@@ -60,14 +89,295 @@ void rb_push_back(smb_rb *rb, void *src)
     rb_grow(rb);
   }
 
-  int index = (rb->start + rb->count) % rb->nalloc;
-  memcpy(rb->data + index * rb->dsize, src, rb->dsize);
+  int index = rb_wrap(rb, rb->start + rb->count);
+  memcpy(rb_item(rb, index), src, rb->dsize);
   rb->count++;
 }
 
 void rb_pop_back(smb_rb *rb, void *dst)
 {
-  int index = (rb->start + rb->count - 1) % rb->nalloc;
-  memcpy(dst, rb->data + index * rb->dsize, rb->dsize);
+  int index = rb_wrap(rb, rb->start + rb->count - 1);
+  memcpy(dst, rb_item(rb, index), rb->dsize);
   rb->count--;
 }
+
+void rb_push_back_n(smb_rb *rb, const void *src, int n)
+{
+  int written = 0, span;
+  while (written < n) {
+    char *dst = rb_writable_span(rb, n - written, &span);
+    if (span > n - written) {
+      span = n - written;
+    }
+    memcpy(dst, (const char*)src + written * rb->dsize, span * rb->dsize);
+    rb_commit(rb, span);
+    written += span;
+  }
+}
+
+int rb_pop_front_n(smb_rb *rb, void *dst, int n)
+{
+  int read = 0, span;
+  if (n > rb->count) {
+    n = rb->count;
+  }
+  while (read < n) {
+    char *src = rb_readable_span(rb, &span);
+    if (span > n - read) {
+      span = n - read;
+    }
+    memcpy((char*)dst + read * rb->dsize, src, span * rb->dsize);
+    rb_consume(rb, span);
+    read += span;
+  }
+  return n;
+}
+
+void *rb_readable_span(smb_rb *rb, int *n)
+{
+  int end = rb->nalloc - rb->start;
+  *n = rb->count < end ? rb->count : end;
+  return rb_item(rb, rb->start);
+}
+
+void rb_consume(smb_rb *rb, int n)
+{
+  rb->start = rb_wrap(rb, rb->start + n);
+  rb->count -= n;
+  if (rb->count == 0) {
+    // With nothing left, start over at the beginning, so that the next spans
+    // are as long as possible.
+    rb->start = 0;
+  }
+}
+
+void *rb_writable_span(smb_rb *rb, int want, int *n)
+{
+  while (rb->nalloc - rb->count < want) {
+    rb_grow(rb);
+  }
+  int back = rb_wrap(rb, rb->start + rb->count);
+  // The free space runs from the back to either the end of the buffer, or (if
+  // the items have wrapped) the start of the items.
+  *n = back >= rb->start ? rb->nalloc - back : rb->start - back;
+  if (*n > rb->nalloc - rb->count) {
+    *n = rb->nalloc - rb->count;
+  }
+  return rb_item(rb, back);
+}
+
+void rb_commit(smb_rb *rb, int n)
+{
+  rb->count += n;
+}
+
+void rb_spsc_init(smb_rb_spsc *rb, int dsize, size_t capacity)
+{
+  size_t alloc = 1;
+  while (alloc < capacity) {
+    alloc *= 2;
+  }
+  atomic_init(&rb->head, 0);
+  atomic_init(&rb->tail, 0);
+  rb->tail_cache = 0;
+  rb->head_cache = 0;
+  rb->data = calloc(alloc, dsize);
+  rb->dsize = dsize;
+  rb->mask = alloc - 1;
+}
+
+void rb_spsc_destroy(smb_rb_spsc *rb)
+{
+  free(rb->data);
+}
+
+/*
+  Copy n items into the buffer starting at counter index, in two parts if they
+  wrap around the end.
+ */
+static void rb_spsc_write(smb_rb_spsc *rb, size_t index, const char *src,
+                          size_t n)
+{
+  size_t slot = index & rb->mask;
+  size_t first = rb->mask + 1 - slot < n ? rb->mask + 1 - slot : n;
+  memcpy(rb->data + slot * rb->dsize, src, first * rb->dsize);
+  memcpy(rb->data, src + first * rb->dsize, (n - first) * rb->dsize);
+}
+
+static void rb_spsc_read(smb_rb_spsc *rb, size_t index, char *dst, size_t n)
+{
+  size_t slot = index & rb->mask;
+  size_t first = rb->mask + 1 - slot < n ? rb->mask + 1 - slot : n;
+  memcpy(dst, rb->data + slot * rb->dsize, first * rb->dsize);
+  memcpy(dst + first * rb->dsize, rb->data, (n - first) * rb->dsize);
+}
+
+size_t rb_spsc_push_n(smb_rb_spsc *rb, const void *src, size_t n)
+{
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  size_t capacity = rb->mask + 1;
+
+  // The head only goes up, so the cached copy can only make the buffer look
+  // fuller than it is.  Look at the real one when that might matter.
+  if (capacity - (tail - rb->head_cache) < n) {
+    rb->head_cache = atomic_load_explicit(&rb->head, memory_order_acquire);
+  }
+  size_t room = capacity - (tail - rb->head_cache);
+  if (n > room) {
+    n = room;
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  rb_spsc_write(rb, tail, src, n);
+  atomic_store_explicit(&rb->tail, tail + n, memory_order_release);
+  return n;
+}
+
+size_t rb_spsc_pop_n(smb_rb_spsc *rb, void *dst, size_t n)
+{
+  size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+
+  if (rb->tail_cache - head < n) {
+    rb->tail_cache = atomic_load_explicit(&rb->tail, memory_order_acquire);
+  }
+  size_t count = rb->tail_cache - head;
+  if (n > count) {
+    n = count;
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  rb_spsc_read(rb, head, dst, n);
+  atomic_store_explicit(&rb->head, head + n, memory_order_release);
+  return n;
+}
+
+bool rb_spsc_push(smb_rb_spsc *rb, const void *src)
+{
+  return rb_spsc_push_n(rb, src, 1) == 1;
+}
+
+bool rb_spsc_pop(smb_rb_spsc *rb, void *dst)
+{
+  return rb_spsc_pop_n(rb, dst, 1) == 1;
+}
+
+size_t rb_spsc_count(smb_rb_spsc *rb)
+{
+  size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+  return tail - head;
+}
+
+/*
+  Return the sequence number of the slot for a position.  The item follows it.
+ */
+static atomic_size_t *rb_mpmc_seq(smb_rb_mpmc *rb, size_t pos)
+{
+  return (atomic_size_t*) (rb->slots + (pos & rb->mask) * rb->stride);
+}
+
+void rb_mpmc_init(smb_rb_mpmc *rb, int dsize, size_t capacity)
+{
+  size_t alloc = 2, i;
+  size_t align = _Alignof(atomic_size_t);
+  while (alloc < capacity) {
+    alloc *= 2;
+  }
+  rb->dsize = dsize;
+  rb->mask = alloc - 1;
+  rb->stride = (sizeof(atomic_size_t) + dsize + align - 1) & ~(align - 1);
+  rb->slots = calloc(alloc, rb->stride);
+  for (i = 0; i < alloc; i++) {
+    atomic_init(rb_mpmc_seq(rb, i), i);
+  }
+  atomic_init(&rb->head, 0);
+  atomic_init(&rb->tail, 0);
+}
+
+void rb_mpmc_destroy(smb_rb_mpmc *rb)
+{
+  free(rb->slots);
+}
+
+bool rb_mpmc_try_push(smb_rb_mpmc *rb, const void *src)
+{
+  size_t pos = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  atomic_size_t *seq;
+
+  // A slot is ready for the push at pos when its sequence number is pos.  If
+  // it's behind, the pop from the previous lap hasn't happened, so the buffer
+  // is full.  If it's ahead, another thread already pushed at pos.
+  while (true) {
+    seq = rb_mpmc_seq(rb, pos);
+    size_t s = atomic_load_explicit(seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)s - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&rb->tail, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    }
+  }
+
+  memcpy((char*)seq + sizeof(atomic_size_t), src, rb->dsize);
+  atomic_store_explicit(seq, pos + 1, memory_order_release);
+  return true;
+}
+
+bool rb_mpmc_try_pop(smb_rb_mpmc *rb, void *dst)
+{
+  size_t pos = atomic_load_explicit(&rb->head, memory_order_relaxed);
+  atomic_size_t *seq;
+
+  // Likewise, a slot is ready for the pop at pos when its sequence number is
+  // pos + 1, and behind that it's still empty.
+  while (true) {
+    seq = rb_mpmc_seq(rb, pos);
+    size_t s = atomic_load_explicit(seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)s - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&rb->head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    }
+  }
+
+  memcpy(dst, (char*)seq + sizeof(atomic_size_t), rb->dsize);
+  atomic_store_explicit(seq, pos + rb->mask + 1, memory_order_release);
+  return true;
+}
+
+void rb_mpmc_push(smb_rb_mpmc *rb, const void *src)
+{
+  int tries = 0;
+  while (!rb_mpmc_try_push(rb, src)) {
+    if (++tries > RB_MPMC_SPINS) {
+      sched_yield();
+    }
+  }
+}
+
+void rb_mpmc_pop(smb_rb_mpmc *rb, void *dst)
+{
+  int tries = 0;
+  while (!rb_mpmc_try_pop(rb, dst)) {
+    if (++tries > RB_MPMC_SPINS) {
+      sched_yield();
+    }
+  }
+}
@@ -0,0 +1,846 @@
+/***************************************************************************//**
+
+  @file         roar.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Implementation of "libstephen/roar.h".
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  Set operations on a pair of containers take one of two paths.  When an array
+  is involved in an intersection, or two arrays are small enough to merge, the
+  work is proportional to their lengths.  Otherwise both containers are laid
+  out as bitsets and combined with the word-level operations of bf.h, which is
+  at most 8K of memory either way.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "libstephen/bf.h"
+#include "libstephen/roar.h"
+
+/**
+   @brief The size of a bitset container, in bytes.
+ */
+#define ROAR_BITSET_BYTES SMB_BITFIELD_SIZE(ROAR_CHUNK)
+
+/*******************************************************************************
+
+                              Container Functions
+
+*******************************************************************************/
+
+static void c_free(smb_roar_container *c)
+{
+  if (c->type == ROAR_BITSET) {
+    bf_delete(c->bits, ROAR_CHUNK);
+  } else if (c->type == ROAR_RUN) {
+    smb_free(c->runs);
+  } else {
+    smb_free(c->array);
+  }
+}
+
+static void c_init_array(smb_roar_container *c, uint16_t key, int capacity)
+{
+  c->key = key;
+  c->type = ROAR_ARRAY;
+  c->cardinality = 0;
+  c->length = 0;
+  c->capacity = capacity;
+  c->array = smb_new(uint16_t, capacity);
+}
+
+/**
+   @brief Return the index of the first array value not less than low.
+ */
+static int array_lower_bound(const uint16_t *array, int length, uint16_t low)
+{
+  int lo = 0, hi = length;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (array[mid] < low) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/**
+   @brief Return the index of the first run which doesn't end before low.
+ */
+static int run_lower_bound(const smb_roar_run *runs, int length, uint16_t low)
+{
+  int lo = 0, hi = length;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (runs[mid].start + runs[mid].length < low) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static bool c_contains(const smb_roar_container *c, uint16_t low)
+{
+  int i;
+  if (c->type == ROAR_BITSET) {
+    return bf_check(c->bits, low);
+  } else if (c->type == ROAR_RUN) {
+    i = run_lower_bound(c->runs, c->length, low);
+    return i < c->length && c->runs[i].start <= low;
+  } else {
+    i = array_lower_bound(c->array, c->length, low);
+    return i < c->length && c->array[i] == low;
+  }
+}
+
+/**
+   @brief Return the least member not less than low, or -1.
+ */
+static int c_next(const smb_roar_container *c, int low)
+{
+  int i;
+  if (c->type == ROAR_BITSET) {
+    return bf_next_set(c->bits, ROAR_CHUNK, low);
+  } else if (c->type == ROAR_RUN) {
+    i = run_lower_bound(c->runs, c->length, low);
+    if (i == c->length) {
+      return -1;
+    }
+    return c->runs[i].start > low ? c->runs[i].start : low;
+  } else {
+    i = array_lower_bound(c->array, c->length, low);
+    return i < c->length ? c->array[i] : -1;
+  }
+}
+
+/**
+   @brief Set bits start through end (inclusive), a byte at a time where
+   possible.
+ */
+static void bits_set_range(unsigned char *bits, int start, int end)
+{
+  int bytes;
+  while (start <= end && start % BIT_PER_CHAR) {
+    bf_set(bits, start++);
+  }
+  bytes = (end - start + 1) / BIT_PER_CHAR;
+  if (bytes > 0) {
+    memset(bits + start / BIT_PER_CHAR, 0xff, bytes);
+    start += bytes * BIT_PER_CHAR;
+  }
+  while (start <= end) {
+    bf_set(bits, start++);
+  }
+}
+
+/**
+   @brief Set the bits of a container's members in a bitset.
+ */
+static void c_set_bits(const smb_roar_container *c, unsigned char *bits)
+{
+  int i;
+  if (c->type == ROAR_BITSET) {
+    bf_or(bits, bits, c->bits, ROAR_CHUNK);
+  } else if (c->type == ROAR_RUN) {
+    for (i = 0; i < c->length; i++) {
+      bits_set_range(bits, c->runs[i].start,
+                     c->runs[i].start + c->runs[i].length);
+    }
+  } else {
+    for (i = 0; i < c->length; i++) {
+      bf_set(bits, c->array[i]);
+    }
+  }
+}
+
+/**
+   @brief Return a new bitset of a container's members.
+ */
+static unsigned char *c_to_bits(const smb_roar_container *c)
+{
+  unsigned char *bits;
+  if (c->type == ROAR_BITSET) {
+    bits = smb_new(unsigned char, ROAR_BITSET_BYTES);
+    memcpy(bits, c->bits, ROAR_BITSET_BYTES);
+  } else {
+    bits = bf_create(ROAR_CHUNK);
+    c_set_bits(c, bits);
+  }
+  return bits;
+}
+
+/**
+   @brief Make a container from a bitset, which it takes.  Small ones become
+   arrays.
+ */
+static void c_from_bits(smb_roar_container *c, uint16_t key,
+                        unsigned char *bits, int cardinality)
+{
+  int v;
+  if (cardinality > ROAR_ARRAY_MAX) {
+    c->key = key;
+    c->type = ROAR_BITSET;
+    c->cardinality = cardinality;
+    c->length = 0;
+    c->capacity = 0;
+    c->bits = bits;
+    return;
+  }
+  c_init_array(c, key, cardinality > 0 ? cardinality : 1);
+  for (v = bf_next_set(bits, ROAR_CHUNK, 0); v >= 0;
+       v = v + 1 < ROAR_CHUNK ? bf_next_set(bits, ROAR_CHUNK, v + 1) : -1) {
+    c->array[c->length++] = v;
+  }
+  c->cardinality = c->length;
+  bf_delete(bits, ROAR_CHUNK);
+}
+
+/**
+   @brief Turn a run container back into an array or bitset, before changing
+   it.
+ */
+static void c_unrun(smb_roar_container *c)
+{
+  smb_roar_container old = *c;
+  c_from_bits(c, old.key, c_to_bits(&old), old.cardinality);
+  c_free(&old);
+}
+
+static void c_copy(smb_roar_container *dst, const smb_roar_container *src)
+{
+  size_t size;
+  *dst = *src;
+  if (src->type == ROAR_BITSET) {
+    size = ROAR_BITSET_BYTES;
+  } else if (src->type == ROAR_RUN) {
+    dst->capacity = src->length;
+    size = src->length * sizeof(smb_roar_run);
+  } else {
+    dst->capacity = src->length;
+    size = src->length * sizeof(uint16_t);
+  }
+  dst->array = (void*)smb_new(char, size);
+  memcpy(dst->array, src->array, size);
+}
+
+/**
+   @brief Set c to the union of a and b (which share a key).
+ */
+static void c_or(smb_roar_container *c, const smb_roar_container *a,
+                 const smb_roar_container *b)
+{
+  int i = 0, j = 0;
+  unsigned char *bits;
+
+  if (a->type == ROAR_ARRAY && b->type == ROAR_ARRAY &&
+      a->length + b->length <= ROAR_ARRAY_MAX) {
+    c_init_array(c, a->key, a->length + b->length);
+    while (i < a->length && j < b->length) {
+      if (a->array[i] < b->array[j]) {
+        c->array[c->length++] = a->array[i++];
+      } else if (a->array[i] > b->array[j]) {
+        c->array[c->length++] = b->array[j++];
+      } else {
+        c->array[c->length++] = a->array[i++];
+        j++;
+      }
+    }
+    while (i < a->length) {
+      c->array[c->length++] = a->array[i++];
+    }
+    while (j < b->length) {
+      c->array[c->length++] = b->array[j++];
+    }
+    c->cardinality = c->length;
+    return;
+  }
+
+  bits = c_to_bits(a);
+  c_set_bits(b, bits);
+  c_from_bits(c, a->key, bits, bf_count(bits, ROAR_CHUNK));
+}
+
+/**
+   @brief Set c to the intersection of a and b (which share a key).
+   @returns Whether the intersection has any members.
+ */
+static bool c_and(smb_roar_container *c, const smb_roar_container *a,
+                  const smb_roar_container *b)
+{
+  const smb_roar_container *tmp;
+  unsigned char *bits, *other;
+  int i;
+
+  // An array is filtered by the other container.
+  if (b->type == ROAR_ARRAY && a->type != ROAR_ARRAY) {
+    tmp = a;
+    a = b;
+    b = tmp;
+  }
+  if (a->type == ROAR_ARRAY) {
+    c_init_array(c, a->key, a->length);
+    for (i = 0; i < a->length; i++) {
+      if (c_contains(b, a->array[i])) {
+        c->array[c->length++] = a->array[i];
+      }
+    }
+    c->cardinality = c->length;
+  } else {
+    bits = c_to_bits(a);
+    other = b->type == ROAR_BITSET ? b->bits : c_to_bits(b);
+    bf_and(bits, bits, other, ROAR_CHUNK);
+    if (other != b->bits) {
+      bf_delete(other, ROAR_CHUNK);
+    }
+    c_from_bits(c, a->key, bits, bf_count(bits, ROAR_CHUNK));
+  }
+
+  if (c->cardinality == 0) {
+    c_free(c);
+    return false;
+  }
+  return true;
+}
+
+/**
+   @brief Count a container's runs, and store them if runs is non-NULL.
+ */
+static int c_runs(const smb_roar_container *c, smb_roar_run *runs)
+{
+  int i, n = 0, start, end;
+
+  if (c->type == ROAR_RUN) {
+    if (runs) {
+      memcpy(runs, c->runs, c->length * sizeof(smb_roar_run));
+    }
+    return c->length;
+  }
+
+  if (c->type == ROAR_ARRAY) {
+    for (i = 0; i < c->length; i = end + 1) {
+      for (end = i; end + 1 < c->length && c->array[end + 1] == c->array[end] + 1;
+           end++) {
+      }
+      if (runs) {
+        runs[n] = (smb_roar_run){c->array[i], c->array[end] - c->array[i]};
+      }
+      n++;
+    }
+    return n;
+  }
+
+  for (start = bf_next_set(c->bits, ROAR_CHUNK, 0); start >= 0; n++) {
+    end = bf_next_clear(c->bits, ROAR_CHUNK, start);
+    if (end < 0) {
+      end = ROAR_CHUNK;
+    }
+    if (runs) {
+      runs[n] = (smb_roar_run){start, end - 1 - start};
+    }
+    start = end < ROAR_CHUNK ? bf_next_set(c->bits, ROAR_CHUNK, end) : -1;
+  }
+  return n;
+}
+
+/**
+   @brief Store a container in its smallest form, with no extra capacity.
+ */
+static void c_optimize(smb_roar_container *c)
+{
+  smb_roar_container old = *c;
+  int nruns = c_runs(c, NULL);
+  size_t run_size = nruns * sizeof(smb_roar_run);
+  size_t other_size = c->cardinality <= ROAR_ARRAY_MAX
+    ? c->cardinality * sizeof(uint16_t) : ROAR_BITSET_BYTES;
+
+  if (run_size < other_size) {
+    if (c->type != ROAR_RUN) {
+      smb_roar_run *runs = smb_new(smb_roar_run, nruns);
+      c_runs(c, runs);
+      c->type = ROAR_RUN;
+      c->runs = runs;
+      c->length = c->capacity = nruns;
+      c_free(&old);
+    }
+  } else if (c->type == ROAR_RUN) {
+    c_unrun(c);
+  } else if (c->type == ROAR_ARRAY && c->capacity > c->length) {
+    c->array = smb_renew(uint16_t, c->array, c->length);
+    c->capacity = c->length;
+  }
+}
+
+/*******************************************************************************
+
+                               Private Functions
+
+*******************************************************************************/
+
+/**
+   @brief Find the container with a key.
+   @returns Its index, or if it isn't there, -1 - the index it would go at.
+ */
+static int roar_find(const smb_roar *r, uint16_t key)
+{
+  int lo = 0, hi = r->length;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (r->containers[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < r->length && r->containers[lo].key == key ? lo : -1 - lo;
+}
+
+/**
+   @brief Make room for a container at an index, and return it.
+ */
+static smb_roar_container *roar_insert_at(smb_roar *r, int index)
+{
+  if (r->length == r->capacity) {
+    r->capacity = r->capacity ? r->capacity * 2 : 4;
+    r->containers = smb_renew(smb_roar_container, r->containers, r->capacity);
+  }
+  memmove(r->containers + index + 1, r->containers + index,
+          (r->length - index) * sizeof(smb_roar_container));
+  r->length++;
+  return &r->containers[index];
+}
+
+/**
+   @brief Add a finished container to the end of a bitmap being built.
+ */
+static void roar_push(smb_roar *r, const smb_roar_container *c)
+{
+  *roar_insert_at(r, r->length) = *c;
+}
+
+static void put_u16(FILE *f, uint16_t v, bool *ok)
+{
+  unsigned char b[2] = {v & 0xff, v >> 8};
+  *ok = *ok && fwrite(b, 1, 2, f) == 2;
+}
+
+static void put_u32(FILE *f, uint32_t v, bool *ok)
+{
+  unsigned char b[4] = {v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24};
+  *ok = *ok && fwrite(b, 1, 4, f) == 4;
+}
+
+static uint16_t get_u16(FILE *f, bool *ok)
+{
+  unsigned char b[2] = {0};
+  *ok = *ok && fread(b, 1, 2, f) == 2;
+  return b[0] | (b[1] << 8);
+}
+
+static uint32_t get_u32(FILE *f, bool *ok)
+{
+  unsigned char b[4] = {0};
+  *ok = *ok && fread(b, 1, 4, f) == 4;
+  return b[0] | (b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+/**
+   @brief Read the body of a container whose key, type and length are known,
+   and check that it's well formed.
+ */
+static bool c_read(smb_roar_container *c, FILE *f)
+{
+  bool ok = true;
+  int i;
+
+  if (c->type == ROAR_BITSET) {
+    c->bits = smb_new(unsigned char, ROAR_BITSET_BYTES);
+    ok = fread(c->bits, 1, ROAR_BITSET_BYTES, f) == ROAR_BITSET_BYTES;
+    c->cardinality = bf_count(c->bits, ROAR_CHUNK);
+    return ok && c->cardinality > ROAR_ARRAY_MAX;
+  } else if (c->type == ROAR_RUN) {
+    c->runs = smb_new(smb_roar_run, c->length);
+    c->cardinality = 0;
+    for (i = 0; i < c->length; i++) {
+      c->runs[i].start = get_u16(f, &ok);
+      c->runs[i].length = get_u16(f, &ok);
+      ok = ok && c->runs[i].start + c->runs[i].length < ROAR_CHUNK &&
+        (i == 0 || c->runs[i].start >
+         c->runs[i-1].start + c->runs[i-1].length + 1);
+      c->cardinality += c->runs[i].length + 1;
+    }
+    return ok;
+  } else {
+    c->array = smb_new(uint16_t, c->length);
+    for (i = 0; i < c->length; i++) {
+      c->array[i] = get_u16(f, &ok);
+      ok = ok && (i == 0 || c->array[i] > c->array[i-1]);
+    }
+    c->cardinality = c->length;
+    return ok;
+  }
+}
+
+/*******************************************************************************
+
+                                   Iterator
+
+  The state is the position of the next member: its container's index times
+  ROAR_CHUNK, plus its low bits.  It's -1 at the end.
+
+*******************************************************************************/
+
+static long long roar_iter_from(const smb_roar *r, int index, int low)
+{
+  for (; index < r->length; index++, low = 0) {
+    int next = low < ROAR_CHUNK ? c_next(&r->containers[index], low) : -1;
+    if (next >= 0) {
+      return (long long)index * ROAR_CHUNK + next;
+    }
+  }
+  return -1;
+}
+
+static DATA roar_iter_next(smb_iter *iter, smb_status *status)
+{
+  const smb_roar *r = iter->ds;
+  long long pos = iter->state.data_llint;
+  DATA d;
+
+  if (pos < 0) {
+    *status = SMB_STOP_ITERATION;
+    d.data_llint = -1;
+    return d;
+  }
+  int index = pos / ROAR_CHUNK, low = pos % ROAR_CHUNK;
+  d.data_llint = ((long long)r->containers[index].key << 16) | low;
+  iter->state.data_llint = roar_iter_from(r, index, low + 1);
+  iter->index++;
+  return d;
+}
+
+static bool roar_iter_has_next(smb_iter *iter)
+{
+  return iter->state.data_llint >= 0;
+}
+
+static void roar_iter_destroy(smb_iter *iter)
+{
+  (void)iter; // unused
+}
+
+static void roar_iter_delete(smb_iter *iter)
+{
+  iter->destroy(iter);
+  smb_free(iter);
+}
+
+/*******************************************************************************
+
+                           Public Interface Functions
+
+*******************************************************************************/
+
+void roar_init(smb_roar *r)
+{
+  r->containers = NULL;
+  r->length = 0;
+  r->capacity = 0;
+}
+
+smb_roar *roar_create(void)
+{
+  smb_roar *r = smb_new(smb_roar, 1);
+  roar_init(r);
+  return r;
+}
+
+void roar_destroy(smb_roar *r)
+{
+  int i;
+  for (i = 0; i < r->length; i++) {
+    c_free(&r->containers[i]);
+  }
+  smb_free(r->containers);
+  r->containers = NULL;
+  r->length = r->capacity = 0;
+}
+
+void roar_delete(smb_roar *r)
+{
+  roar_destroy(r);
+  smb_free(r);
+}
+
+void roar_add(smb_roar *r, uint32_t value)
+{
+  uint16_t key = value >> 16, low = value & 0xffff;
+  int index = roar_find(r, key), pos;
+  smb_roar_container *c;
+
+  if (index < 0) {
+    c = roar_insert_at(r, -1 - index);
+    c_init_array(c, key, 4);
+  } else {
+    c = &r->containers[index];
+  }
+  if (c->type == ROAR_RUN) {
+    if (c_contains(c, low)) {
+      return;
+    }
+    c_unrun(c);
+  }
+
+  if (c->type == ROAR_ARRAY) {
+    pos = array_lower_bound(c->array, c->length, low);
+    if (pos < c->length && c->array[pos] == low) {
+      return;
+    }
+    if (c->length < ROAR_ARRAY_MAX) {
+      if (c->length == c->capacity) {
+        c->capacity = c->capacity * 2 < ROAR_ARRAY_MAX
+          ? c->capacity * 2 : ROAR_ARRAY_MAX;
+        c->array = smb_renew(uint16_t, c->array, c->capacity);
+      }
+      memmove(c->array + pos + 1, c->array + pos,
+              (c->length - pos) * sizeof(uint16_t));
+      c->array[pos] = low;
+      c->length++;
+      c->cardinality++;
+      return;
+    }
+    // A full array becomes a bitset.
+    unsigned char *bits = c_to_bits(c);
+    c_free(c);
+    c->type = ROAR_BITSET;
+    c->bits = bits;
+    c->length = c->capacity = 0;
+  }
+
+  if (!bf_check(c->bits, low)) {
+    bf_set(c->bits, low);
+    c->cardinality++;
+  }
+}
+
+void roar_remove(smb_roar *r, uint32_t value)
+{
+  uint16_t key = value >> 16, low = value & 0xffff;
+  int index = roar_find(r, key), pos;
+  smb_roar_container *c;
+
+  if (index < 0 || !c_contains(&r->containers[index], low)) {
+    return;
+  }
+  c = &r->containers[index];
+  if (c->type == ROAR_RUN) {
+    c_unrun(c);
+  }
+
+  if (c->type == ROAR_ARRAY) {
+    pos = array_lower_bound(c->array, c->length, low);
+    memmove(c->array + pos, c->array + pos + 1,
+            (c->length - pos - 1) * sizeof(uint16_t));
+    c->length--;
+    c->cardinality--;
+  } else {
+    bf_clear(c->bits, low);
+    c->cardinality--;
+    if (c->cardinality <= ROAR_ARRAY_MAX) {
+      c_from_bits(c, key, c->bits, c->cardinality);
+    }
+  }
+
+  if (c->cardinality == 0) {
+    c_free(c);
+    memmove(r->containers + index, r->containers + index + 1,
+            (r->length - index - 1) * sizeof(smb_roar_container));
+    r->length--;
+  }
+}
+
+bool roar_contains(const smb_roar *r, uint32_t value)
+{
+  int index = roar_find(r, value >> 16);
+  return index >= 0 && c_contains(&r->containers[index], value & 0xffff);
+}
+
+uint64_t roar_length(const smb_roar *r)
+{
+  uint64_t length = 0;
+  int i;
+  for (i = 0; i < r->length; i++) {
+    length += r->containers[i].cardinality;
+  }
+  return length;
+}
+
+size_t roar_memory(const smb_roar *r)
+{
+  size_t size = sizeof(smb_roar) + r->capacity * sizeof(smb_roar_container);
+  int i;
+  for (i = 0; i < r->length; i++) {
+    const smb_roar_container *c = &r->containers[i];
+    if (c->type == ROAR_BITSET) {
+      size += ROAR_BITSET_BYTES;
+    } else if (c->type == ROAR_RUN) {
+      size += c->capacity * sizeof(smb_roar_run);
+    } else {
+      size += c->capacity * sizeof(uint16_t);
+    }
+  }
+  return size;
+}
+
+void roar_or(smb_roar *dst, const smb_roar *a, const smb_roar *b)
+{
+  smb_roar result;
+  smb_roar_container c;
+  int i = 0, j = 0;
+
+  roar_init(&result);
+  while (i < a->length || j < b->length) {
+    if (j == b->length ||
+        (i < a->length && a->containers[i].key < b->containers[j].key)) {
+      c_copy(&c, &a->containers[i++]);
+    } else if (i == a->length ||
+               b->containers[j].key < a->containers[i].key) {
+      c_copy(&c, &b->containers[j++]);
+    } else {
+      c_or(&c, &a->containers[i++], &b->containers[j++]);
+    }
+    roar_push(&result, &c);
+  }
+  roar_destroy(dst);
+  *dst = result;
+}
+
+void roar_and(smb_roar *dst, const smb_roar *a, const smb_roar *b)
+{
+  smb_roar result;
+  smb_roar_container c;
+  int i = 0, j = 0;
+
+  roar_init(&result);
+  while (i < a->length && j < b->length) {
+    if (a->containers[i].key < b->containers[j].key) {
+      i++;
+    } else if (b->containers[j].key < a->containers[i].key) {
+      j++;
+    } else if (c_and(&c, &a->containers[i++], &b->containers[j++])) {
+      roar_push(&result, &c);
+    }
+  }
+  roar_destroy(dst);
+  *dst = result;
+}
+
+void roar_optimize(smb_roar *r)
+{
+  int i;
+  for (i = 0; i < r->length; i++) {
+    c_optimize(&r->containers[i]);
+  }
+  if (r->capacity > r->length) {
+    r->containers = smb_renew(smb_roar_container, r->containers,
+                              r->length ? r->length : 1);
+    r->capacity = r->length ? r->length : 1;
+  }
+}
+
+/*
+  The file format is a u32 count of containers, and then for each container a
+  u16 key, a u16 type, a u32 length (values in an array, runs in a run
+  container, and 0 for a bitset), and its body.
+ */
+void roar_write(const smb_roar *r, FILE *f, smb_status *status)
+{
+  bool ok = true;
+  int i, j;
+
+  *status = SMB_SUCCESS;
+  put_u32(f, r->length, &ok);
+  for (i = 0; i < r->length && ok; i++) {
+    const smb_roar_container *c = &r->containers[i];
+    put_u16(f, c->key, &ok);
+    put_u16(f, c->type, &ok);
+    put_u32(f, c->length, &ok);
+    if (c->type == ROAR_BITSET) {
+      ok = ok && fwrite(c->bits, 1, ROAR_BITSET_BYTES, f) == ROAR_BITSET_BYTES;
+    } else if (c->type == ROAR_RUN) {
+      for (j = 0; j < c->length; j++) {
+        put_u16(f, c->runs[j].start, &ok);
+        put_u16(f, c->runs[j].length, &ok);
+      }
+    } else {
+      for (j = 0; j < c->length; j++) {
+        put_u16(f, c->array[j], &ok);
+      }
+    }
+  }
+  if (!ok) {
+    *status = SMB_IO_ERROR;
+  }
+}
+
+void roar_read(smb_roar *r, FILE *f, smb_status *status)
+{
+  bool ok = true;
+  uint32_t count, i;
+  smb_roar_container c;
+
+  *status = SMB_SUCCESS;
+  roar_init(r);
+  count = get_u32(f, &ok);
+  ok = ok && count <= ROAR_CHUNK;
+  for (i = 0; i < count && ok; i++) {
+    c.key = get_u16(f, &ok);
+    c.type = get_u16(f, &ok);
+    c.length = get_u32(f, &ok);
+    c.capacity = c.length;
+    ok = ok && (r->length == 0 || c.key > r->containers[r->length - 1].key);
+    if (ok && c.type == ROAR_ARRAY) {
+      ok = c.length > 0 && c.length <= ROAR_ARRAY_MAX;
+    } else if (ok && c.type == ROAR_RUN) {
+      ok = c.length > 0 && c.length <= ROAR_CHUNK / 2;
+    } else if (ok) {
+      ok = c.type == ROAR_BITSET && c.length == 0;
+    }
+    if (ok) {
+      ok = c_read(&c, f);
+      roar_push(r, &c);
+    }
+  }
+  if (!ok) {
+    roar_destroy(r);
+    *status = SMB_IO_ERROR;
+  }
+}
+
+smb_iter roar_get_iter(const smb_roar *r)
+{
+  smb_iter iter = {
+    // Data values
+    .ds = r,
+    .state = (DATA) { .data_llint = roar_iter_from(r, 0, 0) },
+    .index = 0,
+
+    // Functions
+    .next = &roar_iter_next,
+    .has_next = &roar_iter_has_next,
+    .destroy = &roar_iter_destroy,
+    .delete = &roar_iter_delete,
+    .next_n = NULL
+  };
+  return iter;
+}
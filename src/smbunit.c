@@ -14,12 +14,25 @@
 
 *******************************************************************************/
 
+#include <limits.h>           /* LONG_MAX */
+#include <signal.h>           /* strsignal */
 #include <stdio.h>            /* printf */
+#include <stdlib.h>           /* qsort */
 #include <string.h>           /* strncpy */
+#include <sys/wait.h>         /* waitpid */
+#include <time.h>             /* clock_gettime */
+#include <unistd.h>           /* fork */
 
 #include "libstephen/base.h"
 #include "libstephen/ut.h"    /* functions we're defining */
 
+static double su_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 smb_ut_test *su_create_test(char *description, int (*run)())
 {
   smb_ut_test *test = smb_new(smb_ut_test, 1);
@@ -36,6 +49,7 @@ smb_ut_group *su_create_test_group(char *description)
   group->description[SMB_UNIT_DESCRIPTION_SIZE - 1] = 0;
 
   group->num_tests = 0;
+  group->num_benches = 0;
   return group;
 }
 
@@ -48,20 +62,24 @@ void su_add_test(smb_ut_group *group, smb_ut_test *test)
 
 int su_run_test(smb_ut_test *test, char *file)
 {
+  double start = su_now();
   int result = test->run();
+  double elapsed = su_now() - start;
 
   if (result) {
     printf ("%s:%d: assertion failed in %s\n", file, result, test->description);
     return 1;
   }
 
-  printf ("TEST \"%s\" passed!\n",test->description);
+  printf ("TEST \"%s\" passed! (%.3f ms)\n", test->description,
+          elapsed * 1e3);
   return 0;
 }
 
 int su_run_group(smb_ut_group *group)
 {
   int result = 0;
+  double start = su_now();
   printf ("## GROUP \"%s\" running...\n",group->description);
   for (int i = 0; i < group->num_tests; i++) {
     result = su_run_test(group->tests[i], group->description);
@@ -70,7 +88,8 @@ int su_run_group(smb_ut_group *group)
       exit(result);
     }
   }
-  printf ("## GROUP \"%s\" passed!\n\n", group->description);
+  printf ("## GROUP \"%s\" passed! (%.3f s)\n\n", group->description,
+          su_now() - start);
   return 0;
 }
 
@@ -85,5 +104,295 @@ void su_delete_group(smb_ut_group *group)
     if (group->tests[i]) // don't delete if already deleted
       su_delete_test(group->tests[i]);
   }
+  for (int i = 0; i < group->num_benches; i++) {
+    su_delete_bench(group->benches[i]);
+  }
   smb_free(group);
 }
+
+/*******************************************************************************
+
+                                Parallel Runner
+
+*******************************************************************************/
+
+/**
+   @brief A suite being run by su_run_parallel().
+ */
+typedef struct {
+  pid_t pid;
+  FILE *out;
+  int status;
+  double start;
+  double elapsed;
+  bool done;
+} su_worker;
+
+static void su_start_worker(const smb_ut_suite *suite, su_worker *w)
+{
+  w->out = tmpfile();
+  if (!w->out) {
+    perror("su_run_parallel: tmpfile");
+    exit(1);
+  }
+  w->start = su_now();
+  w->done = false;
+  fflush(NULL); // or buffered output would be printed by both processes
+  w->pid = fork();
+  if (w->pid < 0) {
+    perror("su_run_parallel: fork");
+    exit(1);
+  }
+  if (w->pid == 0) {
+    // Line buffered, so output before a crash isn't lost.  (glibc ignores the
+    // mode if stdout already has a buffer and none is given.)
+    static char line[BUFSIZ];
+    dup2(fileno(w->out), STDOUT_FILENO);
+    dup2(fileno(w->out), STDERR_FILENO);
+    setvbuf(stdout, line, _IOLBF, sizeof(line));
+    suite->run();
+    exit(0);
+  }
+}
+
+/**
+   @brief Print a finished suite's output and result.  Returns 1 if it failed.
+ */
+static int su_report_worker(const smb_ut_suite *suite, su_worker *w)
+{
+  char buf[4096];
+  size_t n;
+  int failed = 1;
+
+  rewind(w->out);
+  while ((n = fread(buf, 1, sizeof(buf), w->out)) > 0) {
+    fwrite(buf, 1, n, stdout);
+  }
+  fclose(w->out);
+
+  if (WIFEXITED(w->status) && WEXITSTATUS(w->status) == 0) {
+    failed = 0;
+    printf("## SUITE \"%s\" passed in %.3f s\n\n", suite->name, w->elapsed);
+  } else if (WIFSIGNALED(w->status)) {
+    printf("## SUITE \"%s\" crashed: %s\n\n", suite->name,
+           strsignal(WTERMSIG(w->status)));
+  } else {
+    printf("## SUITE \"%s\" failed with status %d\n\n", suite->name,
+           WEXITSTATUS(w->status));
+  }
+  return failed;
+}
+
+int su_run_parallel(const smb_ut_suite *suites, int num_suites, int jobs)
+{
+  su_worker *workers;
+  double start = su_now();
+  int started = 0, running = 0, reported = 0, failed = 0, status, i;
+  pid_t pid;
+
+  if (jobs <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cpus > 0 ? (int) cpus : 1;
+  }
+  if (jobs == 1) {
+    for (i = 0; i < num_suites; i++) {
+      suites[i].run();
+    }
+    return 0;
+  }
+
+  workers = smb_new(su_worker, num_suites > 0 ? num_suites : 1);
+  while (reported < num_suites) {
+    while (running < jobs && started < num_suites) {
+      su_start_worker(&suites[started], &workers[started]);
+      started++;
+      running++;
+    }
+
+    pid = wait(&status);
+    if (pid < 0) {
+      perror("su_run_parallel: wait");
+      exit(1);
+    }
+    for (i = reported; i < started; i++) {
+      if (workers[i].pid == pid && !workers[i].done) {
+        workers[i].status = status;
+        workers[i].elapsed = su_now() - workers[i].start;
+        workers[i].done = true;
+        running--;
+        break;
+      }
+    }
+
+    // Output is printed in suite order, as soon as the suites before are done.
+    while (reported < started && workers[reported].done) {
+      failed += su_report_worker(&suites[reported], &workers[reported]);
+      reported++;
+    }
+    fflush(stdout);
+  }
+  smb_free(workers);
+
+  printf("## %d suites, %d failed, in %.3f s with %d jobs\n", num_suites,
+         failed, su_now() - start, jobs);
+  return failed;
+}
+
+/*******************************************************************************
+
+                                  Benchmarks
+
+*******************************************************************************/
+
+/**
+   @brief The most iterations per sample, in case a benchmark does nothing.
+ */
+#define SU_BENCH_MAX_ITERATIONS (LONG_MAX / 4)
+
+/**
+   @brief Allocations made while a benchmark's allocations are counted.
+ */
+static long su_allocs;
+
+static void *su_count_alloc(void *ctx, size_t size)
+{
+  (void)ctx; // unused
+  su_allocs++;
+  return malloc(size);
+}
+
+static void *su_count_realloc(void *ctx, void *ptr, size_t old_size,
+                              size_t new_size)
+{
+  (void)ctx; // unused
+  (void)old_size; // unused
+  su_allocs++;
+  return realloc(ptr, new_size);
+}
+
+static void su_count_free(void *ctx, void *ptr, size_t size)
+{
+  (void)ctx; // unused
+  (void)size; // unused
+  free(ptr);
+}
+
+static const smb_allocator su_counting_allocator = {
+  su_count_alloc, su_count_realloc, su_count_free, NULL
+};
+
+static double su_time(smb_ut_bench *bench, long iterations)
+{
+  double start = su_now();
+  bench->run(bench->arg, iterations);
+  return su_now() - start;
+}
+
+static int su_compare_double(const void *left, const void *right)
+{
+  double l = *(const double*)left, r = *(const double*)right;
+  return (l > r) - (l < r);
+}
+
+smb_ut_bench *su_create_bench(char *description,
+                              void (*run)(void *arg, long iterations),
+                              void *arg)
+{
+  smb_ut_bench *bench = smb_new(smb_ut_bench, 1);
+  strncpy(bench->description, description, SMB_UNIT_DESCRIPTION_SIZE - 1);
+  bench->description[SMB_UNIT_DESCRIPTION_SIZE - 1] = 0;
+  bench->run = run;
+  bench->arg = arg;
+  bench->samples = SMB_UNIT_BENCH_SAMPLES;
+  bench->sample_seconds = SMB_UNIT_BENCH_SAMPLE_SECONDS;
+  bench->count_allocs = true;
+  return bench;
+}
+
+void su_add_bench(smb_ut_group *group, smb_ut_bench *bench)
+{
+  if (group->num_benches < SMB_UNIT_TESTS_PER_GROUP) {
+    group->benches[group->num_benches++] = bench;
+  }
+}
+
+void su_run_bench(smb_ut_bench *bench, smb_ut_bench_result *result)
+{
+  double start = su_now(), elapsed;
+  double *times = smb_new(double, bench->samples > 0 ? bench->samples : 1);
+  long iterations = 1;
+  int i;
+
+  // Calibrate, scaling by the last sample's time once it's long enough to be
+  // worth trusting, and then warm up.
+  while ((elapsed = su_time(bench, iterations)) < bench->sample_seconds &&
+         iterations < SU_BENCH_MAX_ITERATIONS) {
+    if (elapsed < bench->sample_seconds / 10) {
+      iterations *= 2;
+    } else {
+      iterations = (long)(iterations * 1.2 * bench->sample_seconds / elapsed);
+    }
+  }
+  while (su_now() - start < SMB_UNIT_BENCH_WARMUP_SECONDS) {
+    su_time(bench, iterations);
+  }
+
+  for (i = 0; i < bench->samples; i++) {
+    times[i] = su_time(bench, iterations) * 1e9 / iterations;
+  }
+  qsort(times, bench->samples, sizeof(double), su_compare_double);
+
+  result->iterations = iterations;
+  result->samples = bench->samples;
+  if (bench->samples > 0) {
+    result->median_ns = times[bench->samples / 2];
+    result->p99_ns = times[(bench->samples * 99 + 99) / 100 - 1];
+    result->min_ns = times[0];
+  } else {
+    result->median_ns = result->p99_ns = result->min_ns = 0;
+  }
+
+  result->allocs = -1;
+  if (bench->count_allocs && smb_get_allocator() == &smb_malloc_allocator) {
+    su_allocs = 0;
+    smb_set_allocator(&su_counting_allocator);
+    bench->run(bench->arg, iterations);
+    smb_set_allocator(NULL);
+    result->allocs = (double)su_allocs / iterations;
+  }
+  smb_free(times);
+}
+
+void su_run_benches(smb_ut_group *group)
+{
+  smb_ut_bench_result result;
+  printf("## BENCH \"%s\" running...\n", group->description);
+  for (int i = 0; i < group->num_benches; i++) {
+    su_run_bench(group->benches[i], &result);
+    printf("BENCH \"%s\": median %.1f ns, p99 %.1f ns, min %.1f ns",
+           group->benches[i]->description, result.median_ns, result.p99_ns,
+           result.min_ns);
+    if (result.allocs >= 0) {
+      printf(", %.2f allocs", result.allocs);
+    }
+    printf(" (%d x %ld)\n", result.samples, result.iterations);
+  }
+  printf("## BENCH \"%s\" done.\n\n", group->description);
+}
+
+void su_delete_bench(smb_ut_bench *bench)
+{
+  smb_free(bench);
+}
+
+/**
+   @brief Where su_bench_keep() stores its pointer.
+ */
+const void *volatile su_bench_sink;
+
+void su_bench_keep(const void *p)
+{
+  // The value has to be in memory for a call the compiler can't see into, and
+  // storing to a volatile keeps the call from being dropped.
+  su_bench_sink = p;
+}
@@ -0,0 +1,305 @@
+/***************************************************************************//**
+
+  @file         sort.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Sorting arrays of DATA (declared in "libstephen/base.h").
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  data_sort() is a bottom-up merge sort.  Runs of SORT_RUN items are first
+  sorted by insertion, and then merged pairwise back and forth between the
+  array and a buffer of the same size.  It's stable, which lets ll_sort() use
+  it, and it does every pass over memory in order.
+
+  data_sort_parallel() sorts one chunk per thread, and then merges chunks in
+  pairs, once more with a thread per pair, until one is left.
+
+*******************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libstephen/base.h"
+
+/**
+   @brief The length of the runs sorted by insertion before merging.
+ */
+#define SORT_RUN 32
+
+/**
+   @brief The least number of items worth giving each thread.
+ */
+#define SORT_PARALLEL_MIN 4096
+
+/*******************************************************************************
+
+                               Private Functions
+
+*******************************************************************************/
+
+static void insertion_sort(DATA *items, int n, DATA_COMPARE cmp)
+{
+  int i, j;
+  for (i = 1; i < n; i++) {
+    DATA d = items[i];
+    for (j = i; j > 0 && cmp(items[j-1], d) > 0; j--) {
+      items[j] = items[j-1];
+    }
+    items[j] = d;
+  }
+}
+
+/**
+   @brief Merge src[lo, mid) and src[mid, hi) into dst[lo, hi).  Ties are taken
+   from the left, to keep the merge stable.
+ */
+static void merge(const DATA *src, DATA *dst, int lo, int mid, int hi,
+                  DATA_COMPARE cmp)
+{
+  int i = lo, j = mid, k = lo;
+
+  // If the halves are already in order, there's nothing to compare.
+  if (mid == hi || mid == lo || cmp(src[mid-1], src[mid]) <= 0) {
+    memcpy(dst + lo, src + lo, (hi - lo) * sizeof(DATA));
+    return;
+  }
+
+  while (i < mid && j < hi) {
+    dst[k++] = cmp(src[j], src[i]) < 0 ? src[j++] : src[i++];
+  }
+  memcpy(dst + k, src + i, (mid - i) * sizeof(DATA));
+  k += mid - i;
+  memcpy(dst + k, src + j, (hi - j) * sizeof(DATA));
+}
+
+/**
+   @brief Merge sort items, using buf (of the same length) as scratch space.
+ */
+static void merge_sort(DATA *items, DATA *buf, int n, DATA_COMPARE cmp)
+{
+  DATA *src = items, *dst = buf, *tmp;
+  int width, lo;
+
+  for (lo = 0; lo < n; lo += SORT_RUN) {
+    insertion_sort(items + lo, n - lo < SORT_RUN ? n - lo : SORT_RUN, cmp);
+  }
+
+  for (width = SORT_RUN; width < n; width *= 2) {
+    for (lo = 0; lo < n; lo += 2 * width) {
+      int mid = lo + width < n ? lo + width : n;
+      int hi = lo + 2 * width < n ? lo + 2 * width : n;
+      merge(src, dst, lo, mid, hi, cmp);
+    }
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != items) {
+    memcpy(items, src, n * sizeof(DATA));
+  }
+}
+
+/**
+   @brief One thread's share of a parallel sort: either sorting a chunk, or
+   merging two neighbouring ones.
+ */
+typedef struct sort_job {
+  DATA *src, *dst;
+  int lo, mid, hi;
+  DATA_COMPARE cmp;
+} sort_job;
+
+static void *sort_chunk(void *arg)
+{
+  sort_job *job = arg;
+  merge_sort(job->src + job->lo, job->dst + job->lo, job->hi - job->lo,
+             job->cmp);
+  return NULL;
+}
+
+static void *merge_chunks(void *arg)
+{
+  sort_job *job = arg;
+  merge(job->src, job->dst, job->lo, job->mid, job->hi, job->cmp);
+  return NULL;
+}
+
+/**
+   @brief Run every job on its own thread, and wait for them all.  A job whose
+   thread can't be started is run on this one.
+ */
+static void run_jobs(sort_job *jobs, pthread_t *threads, int njobs,
+                     void *(*work)(void*))
+{
+  int i;
+  bool *started = smb_new(bool, njobs);
+  for (i = 1; i < njobs; i++) {
+    started[i] = pthread_create(&threads[i], NULL, work, &jobs[i]) == 0;
+    if (!started[i]) {
+      work(&jobs[i]);
+    }
+  }
+  work(&jobs[0]);
+  for (i = 1; i < njobs; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+  smb_free(started);
+}
+
+/**
+   @brief Map a DATA's bits to an unsigned key which sorts the same way as
+   data_llint.
+ */
+static uint64_t llint_key(DATA d)
+{
+  return (uint64_t)d.data_llint ^ ((uint64_t)1 << 63);
+}
+
+/**
+   @brief Map a DATA's bits to an unsigned key which sorts the same way as
+   data_dbl.  Negative numbers have all their bits flipped, so that the larger
+   magnitudes come first, and positive ones just have the sign bit set.
+ */
+static uint64_t dbl_key(DATA d)
+{
+  uint64_t bits;
+  memcpy(&bits, &d.data_dbl, sizeof(bits));
+  return bits >> 63 ? ~bits : bits | ((uint64_t)1 << 63);
+}
+
+/**
+   @brief Least significant digit radix sort, a byte at a time.  Every byte's
+   counts are taken in one pass at the start, and bytes which are the same in
+   every key are skipped.
+ */
+static void radix_sort(DATA *items, int n, uint64_t (*key)(DATA))
+{
+  size_t counts[8][256];
+  DATA *buf, *src = items, *dst, *tmp;
+  int i, byte;
+
+  if (n < 2) {
+    return;
+  }
+
+  memset(counts, 0, sizeof(counts));
+  for (i = 0; i < n; i++) {
+    uint64_t k = key(items[i]);
+    for (byte = 0; byte < 8; byte++) {
+      counts[byte][(k >> (8 * byte)) & 0xff]++;
+    }
+  }
+
+  buf = dst = smb_new(DATA, n);
+  for (byte = 0; byte < 8; byte++) {
+    size_t offset = 0, c;
+    int digit, shift = 8 * byte;
+    if (counts[byte][(key(items[0]) >> shift) & 0xff] == (size_t)n) {
+      continue;
+    }
+    for (digit = 0; digit < 256; digit++) {
+      c = counts[byte][digit];
+      counts[byte][digit] = offset;
+      offset += c;
+    }
+    for (i = 0; i < n; i++) {
+      dst[counts[byte][(key(src[i]) >> shift) & 0xff]++] = src[i];
+    }
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != items) {
+    memcpy(items, src, n * sizeof(DATA));
+  }
+  smb_free(buf);
+}
+
+/*******************************************************************************
+
+                           Public Interface Functions
+
+*******************************************************************************/
+
+void data_sort(DATA *items, int n, DATA_COMPARE cmp)
+{
+  if (n <= SORT_RUN) {
+    insertion_sort(items, n, cmp);
+    return;
+  }
+  DATA *buf = smb_new(DATA, n);
+  merge_sort(items, buf, n, cmp);
+  smb_free(buf);
+}
+
+void data_sort_parallel(DATA *items, int n, DATA_COMPARE cmp, int nthreads)
+{
+  int i, nchunks;
+
+  if (nthreads > n / SORT_PARALLEL_MIN) {
+    nthreads = n / SORT_PARALLEL_MIN;
+  }
+  if (nthreads <= 1) {
+    data_sort(items, n, cmp);
+    return;
+  }
+
+  DATA *buf = smb_new(DATA, n), *src = items, *dst = buf, *tmp;
+  int *bounds = smb_new(int, nthreads + 1);
+  sort_job *jobs = smb_new(sort_job, nthreads);
+  pthread_t *threads = smb_new(pthread_t, nthreads);
+
+  // Sort each chunk in place.
+  for (i = 0; i <= nthreads; i++) {
+    bounds[i] = (int) ((long long) n * i / nthreads);
+  }
+  for (i = 0; i < nthreads; i++) {
+    jobs[i] = (sort_job){items, buf, bounds[i], 0, bounds[i+1], cmp};
+  }
+  run_jobs(jobs, threads, nthreads, sort_chunk);
+
+  // Merge neighbouring chunks until there's one.  An odd chunk out is merged
+  // with nothing, which just copies it across.
+  for (nchunks = nthreads; nchunks > 1; nchunks = (nchunks + 1) / 2) {
+    int njobs = (nchunks + 1) / 2;
+    for (i = 0; i < njobs; i++) {
+      int hi = 2 * i + 2 <= nchunks ? 2 * i + 2 : nchunks;
+      jobs[i] = (sort_job){src, dst, bounds[2*i], bounds[2*i+1], bounds[hi],
+                           cmp};
+      bounds[i] = bounds[2*i];
+    }
+    bounds[njobs] = n;
+    run_jobs(jobs, threads, njobs, merge_chunks);
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != items) {
+    memcpy(items, src, n * sizeof(DATA));
+  }
+  smb_free(threads);
+  smb_free(jobs);
+  smb_free(bounds);
+  smb_free(buf);
+}
+
+void data_sort_llint(DATA *items, int n)
+{
+  radix_sort(items, n, llint_key);
+}
+
+void data_sort_dbl(DATA *items, int n)
+{
+  radix_sort(items, n, dbl_key);
+}
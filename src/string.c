@@ -13,11 +13,23 @@
 
 *******************************************************************************/
 
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wchar.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "libstephen/ll.h"
 #include "libstephen/cb.h"
+#include "libstephen/str.h"
+
+/**
+   @brief How much a file view reads at a time, when it can't map the file.
+ */
+#define FV_READ_SIZE 65536
 
 char *read_file(FILE *f)
 {
@@ -136,3 +148,180 @@ smb_ll *split_linesw(wchar_t *source)
   }
   return list;
 }
+
+/**
+   @brief Fill in a file view by reading the rest of a file into a buffer.
+ */
+static void fv_read(smb_file_view *view, FILE *f, smb_status *status)
+{
+  size_t capacity = FV_READ_SIZE, length = 0, n;
+  char *buf = smb_new(char, capacity);
+
+  while ((n = fread(buf + length, 1, capacity - length, f)) > 0) {
+    length += n;
+    if (length == capacity) {
+      capacity *= 2;
+      buf = smb_renew(char, buf, capacity);
+    }
+  }
+  if (ferror(f)) {
+    smb_free(buf);
+    *status = SMB_IO_ERROR;
+    return;
+  }
+  view->data = buf;
+  view->length = length;
+  view->map = NULL;
+  view->map_length = 0;
+}
+
+void fv_open(smb_file_view *view, FILE *f, smb_status *status)
+{
+  *status = SMB_SUCCESS;
+  struct stat st;
+  off_t offset = ftello(f);
+  int fd = fileno(f);
+
+  // Only a regular file with something in it (many files in /proc claim to be
+  // empty) can be mapped.  Its position is wherever the stream is, even if the
+  // stream has read ahead.
+  if (offset < 0 || fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+      st.st_size == 0 || offset > st.st_size) {
+    fv_read(view, f, status);
+    return;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    fv_read(view, f, status);
+    return;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  view->map = map;
+  view->map_length = st.st_size;
+  view->data = (const char *)map + offset;
+  view->length = st.st_size - offset;
+}
+
+void fv_close(smb_file_view *view)
+{
+  if (view->map) {
+    munmap(view->map, view->map_length);
+  } else {
+    smb_free((char *)view->data);
+  }
+  view->data = NULL;
+  view->length = 0;
+}
+
+smb_line_iter line_iter(const char *data, size_t length)
+{
+  return (smb_line_iter){.next=data, .end=data + length};
+}
+
+bool line_next(smb_line_iter *it, smb_span *line)
+{
+  if (it->next >= it->end) {
+    return false;
+  }
+  const char *newline = memchr(it->next, '\n', it->end - it->next);
+  line->str = it->next;
+  if (newline) {
+    line->length = newline - it->next;
+    it->next = newline + 1;
+  } else {
+    line->length = it->end - it->next;
+    it->next = it->end;
+  }
+  return true;
+}
+
+void lr_init(smb_line_reader *lr, FILE *f, size_t capacity)
+{
+  lr->file = f;
+  lr->capacity = capacity > 0 ? capacity : 1;
+  lr->buf = smb_new(char, lr->capacity);
+  lr->start = lr->scanned = lr->end = 0;
+  lr->eof = false;
+}
+
+void lr_destroy(smb_line_reader *lr)
+{
+  smb_free(lr->buf);
+}
+
+/**
+   @brief Make room after the partial line at the start of the buffer, and read
+   up to the end of the next line into it.
+
+   Reading goes through the stream's own buffer, so it picks up where other
+   stdio reads left off.  It stops at a newline, because fread() would wait
+   for the whole buffer, and a line from a pipe or terminal should come back
+   as soon as it arrives.
+ */
+static void lr_fill(smb_line_reader *lr, smb_status *status)
+{
+  size_t length = lr->end - lr->start;
+  if (length > 0) {
+    memmove(lr->buf, lr->buf + lr->start, length);
+  }
+  lr->start = 0;
+  lr->end = length;
+  if (lr->end == lr->capacity) {
+    lr->capacity *= 2;
+    lr->buf = smb_renew(char, lr->buf, lr->capacity);
+  }
+
+  flockfile(lr->file);
+  while (lr->end < lr->capacity) {
+    int c = getc_unlocked(lr->file);
+    if (c == EOF) {
+      if (ferror(lr->file) && errno == EINTR) {
+        clearerr(lr->file);
+        continue;
+      }
+      if (ferror(lr->file)) {
+        *status = SMB_IO_ERROR;
+      }
+      lr->eof = true;
+      break;
+    }
+    lr->buf[lr->end++] = c;
+    if (c == '\n') {
+      break;
+    }
+  }
+  funlockfile(lr->file);
+}
+
+bool lr_next(smb_line_reader *lr, smb_span *line, smb_status *status)
+{
+  *status = SMB_SUCCESS;
+  while (true) {
+    char *from = lr->buf + lr->start + lr->scanned;
+    char *newline = memchr(from, '\n', lr->end - lr->start - lr->scanned);
+    if (newline) {
+      line->str = lr->buf + lr->start;
+      line->length = newline - line->str;
+      lr->start += line->length + 1;
+      lr->scanned = 0;
+      return true;
+    }
+    lr->scanned = lr->end - lr->start;
+
+    if (lr->eof) {
+      if (lr->start == lr->end) {
+        return false;
+      }
+      line->str = lr->buf + lr->start;
+      line->length = lr->end - lr->start;
+      lr->start = lr->end;
+      lr->scanned = 0;
+      return true;
+    }
+    lr_fill(lr, status);
+    if (*status != SMB_SUCCESS) {
+      return false;
+    }
+  }
+}
@@ -23,18 +23,67 @@
 #include "libstephen/base.h"  /* SMB_* */
 
 
+static void *malloc_alloc(void *ctx, size_t size)
+{
+  (void)ctx; // unused
+  return malloc(size);
+}
+
+static void *malloc_realloc(void *ctx, void *ptr, size_t old_size,
+                            size_t new_size)
+{
+  (void)ctx; // unused
+  (void)old_size; // unused
+  return realloc(ptr, new_size);
+}
+
+static void malloc_free(void *ctx, void *ptr, size_t size)
+{
+  (void)ctx; // unused
+  (void)size; // unused
+  free(ptr);
+}
+
+const smb_allocator smb_malloc_allocator = {
+  malloc_alloc, malloc_realloc, malloc_free, NULL
+};
+
 /**
-   @brief Utility function for macro smb_new().  Wrapper over malloc().
+   @brief The allocator behind smb_new() and friends.
+ */
+static const smb_allocator *smb_allocator_default = &smb_malloc_allocator;
+
+void smb_set_allocator(const smb_allocator *allocator)
+{
+  smb_allocator_default = allocator ? allocator : &smb_malloc_allocator;
+}
+
+const smb_allocator *smb_get_allocator(void)
+{
+  return smb_allocator_default;
+}
+
+/**
+   @brief Utility function for macro smb_alloc().
 
    Allocate a certain amount of memory.  If allocation fails, EXIT with an error
-   message.
+   message.  Allocating from malloc() doesn't go through its function table.
 
+   @param allocator The allocator, or NULL for the default.
    @param amt The number of bytes to allocate.
    @returns The pointer to the allocated memory (guaranteed).
  */
-void *smb___new(size_t amt)
+void *smb___alloc(const smb_allocator *allocator, size_t amt)
 {
-  void *result = malloc(amt);
+  void *result;
+  if (!allocator) {
+    allocator = smb_allocator_default;
+  }
+  if (allocator == &smb_malloc_allocator) {
+    result = malloc(amt);
+  } else {
+    result = allocator->alloc(allocator->ctx, amt);
+  }
   if (!result) {
     fprintf(stderr, "smb_new: allocation error\n");
     exit(1);
@@ -43,17 +92,29 @@ void *smb___new(size_t amt)
 }
 
 /**
-   @brief Utility function for macro smb_renew().  Wrapper over realloc().
+   @brief Utility function for macro smb_realloc().
 
-   Reallocate a certain amount of memory.
+   Reallocate a certain amount of memory.  If allocation fails, EXIT with an
+   error message.
 
+   @param allocator The allocator, or NULL for the default.
    @param ptr The memory to reallocate.
+   @param oldsize The size of the memory now.
    @param newsize The new size of the memory.
    @returns The pointer to the new block.
  */
-void *smb___renew(void *ptr, size_t newsize)
+void *smb___realloc(const smb_allocator *allocator, void *ptr,
+                    size_t oldsize, size_t newsize)
 {
-  void *result = realloc(ptr, newsize);
+  void *result;
+  if (!allocator) {
+    allocator = smb_allocator_default;
+  }
+  if (allocator == &smb_malloc_allocator) {
+    result = realloc(ptr, newsize);
+  } else {
+    result = allocator->realloc(allocator->ctx, ptr, oldsize, newsize);
+  }
   if (!result) {
     fprintf(stderr, "smb_renew: allocation error\n");
     exit(1);
@@ -62,7 +123,60 @@ void *smb___renew(void *ptr, size_t newsize)
 }
 
 /**
-   @brief Utility function for macro smb_free().  Wrapper over free().
+   @brief Utility function for macro smb_dealloc().
+
+   @param allocator The allocator, or NULL for the default.
+   @param ptr Memory to free.
+   @param size The size of the memory.
+ */
+void smb___dealloc(const smb_allocator *allocator, void *ptr, size_t size)
+{
+  if (!ptr) {
+    return;
+  }
+  if (!allocator) {
+    allocator = smb_allocator_default;
+  }
+  if (allocator == &smb_malloc_allocator) {
+    free(ptr);
+  } else {
+    allocator->free(allocator->ctx, ptr, size);
+  }
+}
+
+/**
+   @brief Utility function for macro smb_new().  Allocates from the default
+   allocator, which wraps malloc() unless smb_set_allocator() changed it.
+
+   Allocate a certain amount of memory.  If allocation fails, EXIT with an error
+   message.
+
+   @param amt The number of bytes to allocate.
+   @returns The pointer to the allocated memory (guaranteed).
+ */
+void *smb___new(size_t amt)
+{
+  return smb___alloc(NULL, amt);
+}
+
+/**
+   @brief Utility function for macro smb_renew().  Reallocates with the default
+   allocator.
+
+   Reallocate a certain amount of memory.
+
+   @param ptr The memory to reallocate.
+   @param newsize The new size of the memory.
+   @returns The pointer to the new block.
+ */
+void *smb___renew(void *ptr, size_t newsize)
+{
+  return smb___realloc(NULL, ptr, 0, newsize);
+}
+
+/**
+   @brief Utility function for macro smb_free().  Frees with the default
+   allocator.
 
    Free a pointer.
 
@@ -70,7 +184,7 @@ void *smb___renew(void *ptr, size_t newsize)
  */
 void smb___free(void *ptr)
 {
-  free(ptr);
+  smb___dealloc(NULL, ptr, 0);
 }
 
 wchar_t *smb_read_linew(FILE *file, smb_status *status)
@@ -0,0 +1,293 @@
+/***************************************************************************//**
+
+  @file         alloctest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for pluggable allocators.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  The counting allocator checks that containers give back every block with the
+  size it was allocated at.
+
+*******************************************************************************/
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libstephen/al.h"
+#include "libstephen/cb.h"
+#include "libstephen/ht.h"
+#include "libstephen/hta.h"
+#include "libstephen/ll.h"
+#include "libstephen/log.h"
+#include "libstephen/rb.h"
+#include "libstephen/ut.h"
+#include "tests.h"
+
+typedef struct {
+  long blocks;
+  long bytes;
+  long calls;
+} counts;
+
+static void *count_alloc(void *ctx, size_t size)
+{
+  counts *c = ctx;
+  c->blocks++;
+  c->bytes += size;
+  c->calls++;
+  return malloc(size);
+}
+
+static void *count_realloc(void *ctx, void *ptr, size_t old_size,
+                           size_t new_size)
+{
+  counts *c = ctx;
+  c->blocks += ptr ? 0 : 1;
+  c->bytes += (long)new_size - (long)old_size;
+  c->calls++;
+  return realloc(ptr, new_size);
+}
+
+static void count_free(void *ctx, void *ptr, size_t size)
+{
+  counts *c = ctx;
+  c->blocks--;
+  c->bytes -= size;
+  c->calls++;
+  free(ptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TESTS
+
+static int test_containers(void)
+{
+  counts c = {0, 0, 0};
+  smb_allocator counting = {count_alloc, count_realloc, count_free, &c};
+  smb_status status = SMB_SUCCESS;
+  smb_al al;
+  smb_ll ll;
+  smb_ht ht;
+  cbuf cb;
+  smb_rb rb;
+  DATA d;
+  int i;
+
+  al_init_alloc(&al, &counting);
+  ll_init_alloc(&ll, &counting);
+  ht_init_alloc(&ht, ht_string_hash, data_compare_string, &counting);
+  cb_init_alloc(&cb, 4, &counting);
+  rb_init_alloc(&rb, sizeof(int), 2, &counting);
+  for (i = 0; i < 1000; i++) {
+    d.data_llint = i;
+    al_append(&al, d);
+    ll_append(&ll, d);
+    cb_append(&cb, 'a');
+    rb_push_back(&rb, &i);
+  }
+  for (i = 0; i < 100; i++) {
+    d.data_ptr = i % 2 ? "odd" : "even";
+    ht_insert(&ht, d, d);
+  }
+  for (i = 0; i < 500; i++) {
+    ll_pop_back(&ll, &status);
+  }
+  al_shrink_to_fit(&al);
+  cb_trim(&cb);
+  TEST_ASSERT(c.blocks == 4 + ll.length);
+  TEST_ASSERT(c.bytes > 0);
+
+  al_destroy(&al);
+  ll_destroy(&ll);
+  ht_destroy(&ht);
+  cb_destroy(&cb);
+  rb_destroy(&rb);
+  TA_INT_EQ(c.blocks, 0);
+  TA_INT_EQ(c.bytes, 0);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  return 0;
+}
+
+static int test_steal(void)
+{
+  counts c = {0, 0, 0};
+  smb_allocator counting = {count_alloc, count_realloc, count_free, &c};
+  cbuf cb;
+  char *str;
+
+  // A stolen string is always on the heap, whatever the cbuf used.
+  cb_init_alloc(&cb, 4, &counting);
+  cb_concat(&cb, "hello, world");
+  str = cb_steal(&cb);
+  TA_STR_EQ(str, "hello, world");
+  TA_INT_EQ(c.blocks, 0);
+  smb_free(str);
+  return 0;
+}
+
+/*
+  An allocator which puts a header in front of every block, so that memory
+  given to free() directly, or memory from malloc() given back to it, breaks.
+  The logger frees from its own thread, so the count is atomic.
+ */
+#define HEADER_MAGIC 0x5AFEB10Cu
+
+typedef struct {
+  unsigned int magic;
+  size_t size;
+} header;
+
+static atomic_long header_blocks;
+
+static void *header_alloc(void *ctx, size_t size)
+{
+  (void)ctx;
+  header *h = malloc(sizeof(header) + size);
+  h->magic = HEADER_MAGIC;
+  h->size = size;
+  atomic_fetch_add(&header_blocks, 1);
+  return h + 1;
+}
+
+static void *header_realloc(void *ctx, void *ptr, size_t old_size,
+                            size_t new_size)
+{
+  (void)old_size;
+  if (!ptr) {
+    return header_alloc(ctx, new_size);
+  }
+  header *h = (header *)ptr - 1;
+  if (h->magic != HEADER_MAGIC) {
+    abort();
+  }
+  h = realloc(h, sizeof(header) + new_size);
+  h->size = new_size;
+  return h + 1;
+}
+
+static void header_free(void *ctx, void *ptr, size_t size)
+{
+  (void)ctx;
+  (void)size;
+  header *h = (header *)ptr - 1;
+  if (h->magic != HEADER_MAGIC) {
+    abort();
+  }
+  h->magic = 0;
+  atomic_fetch_sub(&header_blocks, 1);
+  free(h);
+}
+
+static unsigned int header_int_hash(void *key)
+{
+  return * (unsigned int*) key;
+}
+
+static int test_header(void)
+{
+  smb_allocator prefixed = {header_alloc, header_realloc, header_free, NULL};
+  smb_status status = SMB_SUCCESS;
+  FILE *f = tmpfile();
+  cbuf cb;
+  char *str;
+  int i, value;
+
+  atomic_store(&header_blocks, 0);
+  smb_set_allocator(&prefixed);
+
+  // A hash table grows and is freed.
+  smb_hta *table = hta_create(header_int_hash, hta_int_comp, sizeof(int),
+                              sizeof(int));
+  for (i = 0; i < 1000; i++) {
+    value = -i;
+    hta_insert(table, &i, &value);
+  }
+  hta_delete(table);
+
+  // A stolen string is freed from the default allocator.
+  cb_init(&cb, 4);
+  cb_concat(&cb, "hello, world");
+  str = cb_steal(&cb);
+  smb_free(str);
+
+  // The asynchronous writer frees the messages queued for it.
+  smb_logger *logger = sl_create();
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_INFO, .dst=f}, &status);
+  sl_start_async(logger, (smb_logasync){.capacity=4, .policy=SL_ASYNC_BLOCK,
+                                        .flush_bytes=256, .flush_ms=1},
+                 &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  for (i = 0; i < 20; i++) {
+    LINFO(logger, "message %d", i);
+  }
+  sl_delete(logger);
+
+  smb_set_allocator(NULL);
+  TA_INT_EQ(atomic_load(&header_blocks), 0);
+
+  rewind(f);
+  // Messages hold a source path of any length, so count newlines, not reads.
+  i = 0;
+  for (int c; (c = fgetc(f)) != EOF;) {
+    i += c == '\n';
+  }
+  TA_INT_EQ(i, 20);
+  fclose(f);
+  return 0;
+}
+
+static int test_default(void)
+{
+  counts c = {0, 0, 0};
+  smb_allocator counting = {count_alloc, count_realloc, count_free, &c};
+  const smb_allocator *set;
+  smb_al *list;
+  DATA d = {.data_llint = 1};
+  int i;
+
+  TEST_ASSERT(smb_get_allocator() == &smb_malloc_allocator);
+  smb_set_allocator(&counting);
+  set = smb_get_allocator();
+  list = al_create();
+  for (i = 0; i < 100; i++) {
+    al_append(list, d);
+  }
+  al_delete(list);
+  smb_set_allocator(NULL);
+
+  TEST_ASSERT(set == &counting);
+  TA_INT_EQ(c.blocks, 0);
+  TEST_ASSERT(c.calls > 4);
+  TEST_ASSERT(smb_get_allocator() == &smb_malloc_allocator);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST LOADER AND RUNNER
+
+void alloc_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/alloctest.c");
+
+  smb_ut_test *containers = su_create_test("containers", test_containers);
+  su_add_test(group, containers);
+
+  smb_ut_test *steal = su_create_test("steal", test_steal);
+  su_add_test(group, steal);
+
+  smb_ut_test *default_ = su_create_test("default", test_default);
+  su_add_test(group, default_);
+
+  smb_ut_test *header = su_create_test("header", test_header);
+  su_add_test(group, header);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
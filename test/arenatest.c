@@ -0,0 +1,165 @@
+/***************************************************************************//**
+
+  @file         arenatest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the arena allocator.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libstephen/al.h"
+#include "libstephen/arena.h"
+#include "libstephen/ht.h"
+#include "libstephen/ut.h"
+#include "tests.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// TESTS
+
+static int test_alloc(void)
+{
+  smb_arena a;
+  smb_arena_stats stats;
+  char *prev = NULL, *p;
+  int i;
+
+  arena_init(&a);
+  arena_stats(&a, &stats);
+  TA_INT_EQ(stats.blocks, 0);
+
+  // Allocations are aligned and don't overlap, across many blocks.
+  for (i = 1; i < 2000; i++) {
+    p = arena_alloc(&a, i % 100 + 1);
+    TA_INT_EQ((uintptr_t)p % SMB_ARENA_ALIGN, 0);
+    memset(p, i, i % 100 + 1);
+    if (prev) {
+      TA_INT_EQ(prev[0], (char)(i - 1));
+    }
+    prev = p;
+  }
+  arena_stats(&a, &stats);
+  TEST_ASSERT(stats.blocks > 1);
+  TEST_ASSERT(stats.used >= 2000 * 50);
+  TEST_ASSERT(stats.reserved >= stats.used);
+
+  // Larger alignments, and an allocation bigger than any block.
+  p = arena_alloc_aligned(&a, 10, 4096);
+  TA_INT_EQ((uintptr_t)p % 4096, 0);
+  p = arena_alloc(&a, 3 * SMB_ARENA_MAX_BLOCK);
+  memset(p, 0, 3 * SMB_ARENA_MAX_BLOCK);
+
+  arena_destroy(&a);
+  arena_stats(&a, &stats);
+  TA_INT_EQ(stats.blocks, 0);
+  return 0;
+}
+
+static int test_save_restore(void)
+{
+  smb_arena *a = arena_create();
+  smb_arena_stats stats;
+  smb_arena_mark mark;
+  int *first, *p, blocks, i;
+
+  first = arena_new(a, int, 10);
+  mark = arena_save(a);
+  p = arena_new(a, int, 10);
+  arena_restore(a, mark);
+  TEST_ASSERT(arena_new(a, int, 10) == p);
+
+  // Blocks freed by a restore or reset are reused.
+  mark = arena_save(a);
+  for (i = 0; i < 1000; i++) {
+    arena_new(a, int, 100);
+  }
+  arena_stats(a, &stats);
+  blocks = stats.blocks;
+  arena_restore(a, mark);
+  for (i = 0; i < 1000; i++) {
+    arena_new(a, int, 100);
+  }
+  arena_stats(a, &stats);
+  TA_INT_EQ(stats.blocks, blocks);
+  TEST_ASSERT(stats.peak >= 400000);
+
+  arena_reset(a);
+  arena_stats(a, &stats);
+  TEST_ASSERT(stats.used == 0);
+  TA_INT_EQ(stats.blocks, blocks);
+  TEST_ASSERT(arena_new(a, int, 10) == first);
+
+  arena_delete(a);
+  return 0;
+}
+
+static int test_allocator(void)
+{
+  smb_arena a;
+  smb_arena_stats stats;
+  smb_al list;
+  smb_ht table;
+  smb_status status = SMB_SUCCESS;
+  DATA d;
+  DATA *data;
+  int i;
+
+  arena_init(&a);
+
+  // A container growing alone at the end of the arena grows in place.
+  al_init_alloc(&list, arena_allocator(&a));
+  data = list.data;
+  for (i = 0; i < 200; i++) {
+    d.data_llint = i;
+    al_append(&list, d);
+  }
+  TEST_ASSERT(list.data == data);
+  for (i = 0; i < 200; i++) {
+    TEST_ASSERT(al_get(&list, i, &status).data_llint == i);
+  }
+
+  // Nothing needs to be destroyed.
+  ht_init_alloc(&table, ht_string_hash, data_compare_string,
+                arena_allocator(&a));
+  for (i = 0; i < 200; i++) {
+    d.data_llint = i;
+    al_append(&list, d);
+    d.data_ptr = "key";
+    ht_insert(&table, d, d);
+  }
+  TEST_ASSERT(ht_contains(&table, d));
+  arena_stats(&a, &stats);
+  TEST_ASSERT(stats.used > 400 * sizeof(DATA));
+
+  arena_destroy(&a);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST LOADER AND RUNNER
+
+void arena_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/arenatest.c");
+
+  smb_ut_test *alloc = su_create_test("alloc", test_alloc);
+  su_add_test(group, alloc);
+
+  smb_ut_test *save_restore = su_create_test("save_restore",
+                                             test_save_restore);
+  su_add_test(group, save_restore);
+
+  smb_ut_test *allocator = su_create_test("allocator", test_allocator);
+  su_add_test(group, allocator);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
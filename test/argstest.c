@@ -14,8 +14,10 @@
 *******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 
 #include "libstephen/ad.h"
 #include "libstephen/ll.h"
@@ -255,6 +257,112 @@ int ad_test_bare_strings(void)
   return 0;
 }
 
+/**
+   @brief Test many long flags and bare strings, including repeats.
+ */
+int ad_test_many(void)
+{
+  smb_ad ad;
+  char *args[3000];
+  char names[1000][16];
+  int i;
+
+  for (i = 0; i < 1000; i++) {
+    sprintf(names[i], "--flag%d", i);
+    args[3 * i] = names[i];
+    args[3 * i + 1] = names[i] + 2; // the parameter is the flag's own name
+    args[3 * i + 2] = names[i] + 6; // and a bare string of the number
+  }
+  args[2999] = names[0];  // a repeat, without a parameter
+
+  arg_data_init(&ad);
+  process_args(&ad, 3000, args);
+  for (i = 0; i < 1000; i++) {
+    TA_INT_EQ(check_long_flag(&ad, names[i] + 2), i + 1);
+    TA_STR_EQ(get_long_flag_parameter(&ad, names[i] + 2), names[i] + 2);
+  }
+  TA_INT_EQ(ll_length(ad.long_flags), 1001);
+  TA_INT_EQ(check_bare_string(&ad, "998"), 999);
+  TEST_ASSERT(!check_bare_string(&ad, "999"));
+  TEST_ASSERT(!check_long_flag(&ad, "flag1000"));
+  TEST_ASSERT(get_long_flag_parameter(&ad, "flag1000") == NULL);
+  arg_data_destroy(&ad);
+  return 0;
+}
+
+/**
+   @brief Write lines to a new temporary file, and return its name.
+ */
+static char *write_response_file(char *path, const char *contents)
+{
+  int fd = mkstemp(path);
+  FILE *f = fdopen(fd, "w");
+  fputs(contents, f);
+  fclose(f);
+  return path;
+}
+
+/**
+   @brief Test arguments read from response files.
+ */
+int ad_test_response_files(void)
+{
+  smb_ad ad;
+  char inner[] = "/tmp/argstest_inner_XXXXXX";
+  char outer[] = "/tmp/argstest_outer_XXXXXX";
+  char self[] = "/tmp/argstest_self_XXXXXX";
+  char contents[256], outer_arg[64], self_arg[64];
+  char *args[5];
+
+  write_response_file(inner, "-b\nparam b\n\nbare three\r\n");
+  sprintf(contents, "--outfile\nout file.txt\n@%s\n", inner);
+  write_response_file(outer, contents);
+  // A file which names itself stops at AD_MAX_RESPONSE_DEPTH.
+  write_response_file(self, "");
+  sprintf(self_arg, "@%s", self);
+  sprintf(contents, "%s\n--self\n", self_arg);
+  FILE *f = fopen(self, "w");
+  fputs(contents, f);
+  fclose(f);
+
+  sprintf(outer_arg, "@%s", outer);
+  args[0] = "-a";
+  args[1] = outer_arg;
+  args[2] = "@/no/such/file";
+  args[3] = self_arg;
+  args[4] = "--last";
+
+  // Response files are off by default.
+  arg_data_init(&ad);
+  process_args(&ad, 5, args);
+  TA_STR_EQ(get_flag_parameter(&ad, 'a'), outer_arg);
+  TA_INT_EQ(check_bare_string(&ad, "@/no/such/file"), 1);
+  TA_INT_EQ(check_bare_string(&ad, self_arg), 2);
+  TEST_ASSERT(!check_flag(&ad, 'b'));
+  TEST_ASSERT(ll_length(ad.long_flags) == 1);
+  arg_data_destroy(&ad);
+
+  arg_data_init(&ad);
+  ad.response_files = true;
+  process_args(&ad, 5, args);
+  TEST_ASSERT(check_flag(&ad, 'a'));
+  TEST_ASSERT(get_flag_parameter(&ad, 'a') == NULL);
+  TA_STR_EQ(get_long_flag_parameter(&ad, "outfile"), "out file.txt");
+  TEST_ASSERT(check_flag(&ad, 'b'));
+  TA_STR_EQ(get_flag_parameter(&ad, 'b'), "param b");
+  TA_INT_EQ(check_bare_string(&ad, "bare three"), 1);
+  TA_INT_EQ(check_bare_string(&ad, "@/no/such/file"), 2);
+  TEST_ASSERT(check_long_flag(&ad, "self"));
+  TEST_ASSERT(check_long_flag(&ad, "last"));
+  TEST_ASSERT(ll_length(ad.long_flags) == 2 + AD_MAX_RESPONSE_DEPTH);
+  arg_data_destroy(&ad);
+
+  unlink(inner);
+  unlink(outer);
+  unlink(self);
+  return 0;
+}
+
 void args_test(void)
 {
   smb_ut_group *group = su_create_test_group("test/argstest.c");
@@ -285,6 +393,13 @@ void args_test(void)
                                              &ad_test_bare_strings);
   su_add_test(group, bare_strings);
 
+  smb_ut_test *many = su_create_test("many", &ad_test_many);
+  su_add_test(group, many);
+
+  smb_ut_test *response_files = su_create_test("response_files",
+                                               &ad_test_response_files);
+  su_add_test(group, response_files);
+
   su_run_group(group);
   su_delete_group(group);
 }
@@ -13,6 +13,8 @@
 
 *******************************************************************************/
 
+#include <string.h>
+
 #include "libstephen/al.h"
 #include "libstephen/ut.h"
 #include "tests.h"
@@ -46,6 +48,207 @@ int al_test_create_empty()
   return 0;
 }
 
+int al_test_bulk()
+{
+  DATA items[100];
+  smb_status status = SMB_SUCCESS;
+  int i;
+
+  for (i = 0; i < 100; i++) {
+    items[i] = LLINT(i);
+  }
+
+  smb_al *list = al_create();
+  al_append_many(list, items, 100);
+  TA_INT_EQ(al_length(list), 100);
+
+  // Insert 0..9 in the middle, at the front, and past the end.
+  al_insert_many(list, 50, items, 10);
+  al_insert_many(list, -5, items, 10);
+  al_insert_many(list, 1000, items, 10);
+  TA_INT_EQ(al_length(list), 130);
+  for (i = 0; i < 130; i++) {
+    long long int expected;
+    if (i < 10) {
+      expected = i;
+    } else if (i < 60) {
+      expected = i - 10;
+    } else if (i < 70) {
+      expected = i - 60;
+    } else if (i < 120) {
+      expected = i - 20;
+    } else {
+      expected = i - 120;
+    }
+    TA_LLINT_EQ(al_get(list, i, &status).data_llint, expected);
+  }
+
+  al_delete(list);
+  return 0;
+}
+
+int al_test_capacity()
+{
+  int i;
+  smb_al *list = al_create();
+
+  al_reserve(list, 1000);
+  TA_INT_GE(list->allocated, 1000);
+  int allocated = list->allocated;
+  for (i = 0; i < 1000; i++) {
+    al_append(list, LLINT(i));
+  }
+  TA_INT_EQ(list->allocated, allocated);
+
+  al_shrink_to_fit(list);
+  TA_INT_EQ(list->allocated, 1000);
+
+  // Growing by a factor, the space doubles when it's full.
+  al_append(list, LLINT(1000));
+  TA_INT_EQ(list->allocated, 2000);
+
+  // A factor of 1 only adds a fixed block.
+  al_shrink_to_fit(list);
+  al_set_growth(list, 1);
+  al_append(list, LLINT(1001));
+  TA_INT_LT(list->allocated, 1100);
+
+  al_delete(list);
+  return 0;
+}
+
+/**
+   @brief Compare only the thousands, so that items with the same thousands
+   are left in the order they were in, by a stable sort.
+ */
+static int compare_thousands(DATA d1, DATA d2)
+{
+  return data_compare_int(LLINT(d1.data_llint / 1000),
+                          LLINT(d2.data_llint / 1000));
+}
+
+/**
+   @brief Fill a list with n items, with pseudo-random thousands and their
+   original index below that.
+ */
+static smb_al *shuffled(int n)
+{
+  smb_al *list = al_create();
+  unsigned int x = 12345;
+  int i;
+  for (i = 0; i < n; i++) {
+    x = x * 1103515245 + 12345;
+    al_append(list, LLINT((long long)(x >> 16) % 100 * 1000 + i));
+  }
+  return list;
+}
+
+/**
+   @brief Check a list is sorted by thousands, and ties are in index order.
+ */
+static int check_stable(smb_al *list)
+{
+  int i;
+  for (i = 1; i < al_length(list); i++) {
+    long long prev = list->data[i-1].data_llint, curr = list->data[i].data_llint;
+    TA_LLINT_LE(prev / 1000, curr / 1000);
+    if (prev / 1000 == curr / 1000) {
+      TA_LLINT_LT(prev % 1000, curr % 1000);
+    }
+  }
+  return 0;
+}
+
+int al_test_for_each()
+{
+  smb_al *list = al_create();
+  DATA d;
+  int i, count = 0;
+
+  AL_FOR_EACH(list, i, d) {
+    count++;
+  }
+  TA_INT_EQ(count, 0);
+
+  for (i = 0; i < 50; i++) {
+    al_append(list, LLINT(i * 3));
+  }
+  AL_FOR_EACH(list, i, d) {
+    TA_LLINT_EQ(d.data_llint, i * 3);
+    count++;
+  }
+  TA_INT_EQ(count, 50);
+  al_delete(list);
+  return 0;
+}
+
+int al_test_sort()
+{
+  int sizes[] = {0, 1, 10, 33, 999};
+  unsigned int i;
+  for (i = 0; i < sizeof(sizes)/sizeof(int); i++) {
+    smb_al *list = shuffled(sizes[i]);
+    al_sort(list, compare_thousands);
+    TA_INT_EQ(al_length(list), sizes[i]);
+    TA_INT_EQ(check_stable(list), 0);
+    al_delete(list);
+  }
+  return 0;
+}
+
+int al_test_sort_parallel()
+{
+  smb_al *list = shuffled(999);
+  int i;
+
+  // Enough items for five threads to get a share.
+  for (i = 0; i < 50000; i++) {
+    al_append(list, LLINT((long long)(i * 7919 % 100) * 1000 + i % 1000));
+  }
+  al_sort_parallel(list, data_compare_int, 5);
+  TA_INT_EQ(al_length(list), 50999);
+  for (i = 1; i < al_length(list); i++) {
+    TA_LLINT_LE(list->data[i-1].data_llint, list->data[i].data_llint);
+  }
+  al_delete(list);
+
+  list = shuffled(999);
+  al_sort_parallel(list, compare_thousands, 3);
+  TA_INT_EQ(check_stable(list), 0);
+  al_delete(list);
+  return 0;
+}
+
+int al_test_sort_radix()
+{
+  long long ints[] = {5, -1, 0, 1LL << 40, -(1LL << 40), 3, -1};
+  long long sorted_ints[] = {-(1LL << 40), -1, -1, 0, 3, 5, 1LL << 40};
+  double dbls[] = {2.5, -0.0, -3.0, 0.0, 1e300, -1e-300, 1.0};
+  double sorted_dbls[] = {-3.0, -1e-300, -0.0, 0.0, 1.0, 2.5, 1e300};
+  unsigned int i;
+
+  smb_al *list = al_create();
+  for (i = 0; i < sizeof(ints)/sizeof(ints[0]); i++) {
+    al_append(list, LLINT(ints[i]));
+  }
+  al_sort_llint(list);
+  for (i = 0; i < sizeof(ints)/sizeof(ints[0]); i++) {
+    TA_LLINT_EQ(list->data[i].data_llint, sorted_ints[i]);
+  }
+  al_delete(list);
+
+  list = al_create();
+  for (i = 0; i < sizeof(dbls)/sizeof(dbls[0]); i++) {
+    al_append(list, DBL(dbls[i]));
+  }
+  al_sort_dbl(list);
+  for (i = 0; i < sizeof(dbls)/sizeof(dbls[0]); i++) {
+    TA_INT_EQ(memcmp(&list->data[i].data_dbl, &sorted_dbls[i], sizeof(double)),
+              0);
+  }
+  al_delete(list);
+  return 0;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // TEST LOADER AND RUNNER
@@ -60,6 +263,25 @@ void array_list_test()
   smb_ut_test *create_empty = su_create_test("create_empty", al_test_create_empty);
   su_add_test(group, create_empty);
 
+  smb_ut_test *bulk = su_create_test("bulk", al_test_bulk);
+  su_add_test(group, bulk);
+
+  smb_ut_test *capacity = su_create_test("capacity", al_test_capacity);
+  su_add_test(group, capacity);
+
+  smb_ut_test *for_each = su_create_test("for_each", al_test_for_each);
+  su_add_test(group, for_each);
+
+  smb_ut_test *sort = su_create_test("sort", al_test_sort);
+  su_add_test(group, sort);
+
+  smb_ut_test *sort_parallel = su_create_test("sort_parallel",
+                                              al_test_sort_parallel);
+  su_add_test(group, sort_parallel);
+
+  smb_ut_test *sort_radix = su_create_test("sort_radix", al_test_sort_radix);
+  su_add_test(group, sort_radix);
+
   su_run_group(group);
   su_delete_group(group);
 }
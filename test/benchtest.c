@@ -0,0 +1,94 @@
+/***************************************************************************//**
+
+  @file         benchtest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the smbunit benchmark runner.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include "libstephen/base.h"
+#include "libstephen/ut.h"
+#include "tests.h"
+
+static void bench_count(void *arg, long n)
+{
+  long *total = arg;
+  for (long i = 0; i < n; i++) {
+    (*total)++;
+  }
+  su_bench_keep(total);
+}
+
+static void bench_alloc(void *arg, long n)
+{
+  (void) arg; // unused
+  for (long i = 0; i < n; i++) {
+    int *p = smb_new(int, 1);
+    su_bench_keep(p);
+    smb_free(p);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TESTS
+
+static int test_run(void)
+{
+  long total = 0;
+  smb_ut_bench *bench = su_create_bench("count", bench_count, &total);
+  smb_ut_bench_result result;
+
+  bench->samples = 5;
+  bench->sample_seconds = 0.0001;
+  su_run_bench(bench, &result);
+  TA_INT_EQ(result.samples, 5);
+  TEST_ASSERT(result.iterations > 0);
+  TEST_ASSERT(total >= 5 * result.iterations);
+  TEST_ASSERT(result.min_ns <= result.median_ns);
+  TEST_ASSERT(result.median_ns <= result.p99_ns);
+  TEST_ASSERT(result.allocs == 0);
+
+  bench->count_allocs = false;
+  su_run_bench(bench, &result);
+  TEST_ASSERT(result.allocs == -1);
+  su_delete_bench(bench);
+  return 0;
+}
+
+static int test_allocs(void)
+{
+  smb_ut_bench *bench = su_create_bench("alloc", bench_alloc, NULL);
+  smb_ut_bench_result result;
+
+  bench->samples = 3;
+  bench->sample_seconds = 0.0001;
+  su_run_bench(bench, &result);
+  TEST_ASSERT(result.allocs == 1);
+  TEST_ASSERT(smb_get_allocator() == &smb_malloc_allocator);
+  su_delete_bench(bench);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST LOADER AND RUNNER
+
+void bench_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/benchtest.c");
+
+  smb_ut_test *run = su_create_test("run", test_run);
+  su_add_test(group, run);
+
+  smb_ut_test *allocs = su_create_test("allocs", test_allocs);
+  su_add_test(group, allocs);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -0,0 +1,303 @@
+/***************************************************************************//**
+
+  @file         binlogtest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for binary logging.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+#include "libstephen/binlog.h"
+#include "libstephen/ut.h"
+
+#define BINLOG_THREADS 4
+#define BINLOG_MESSAGES 1000
+
+/*
+  Decode a stream, and return the message part of its nth line (after "LEVEL:
+  "), in buf.
+ */
+static char *decoded_line(FILE *in, int n, char *buf, int size)
+{
+  smb_status status = SMB_SUCCESS;
+  FILE *out = tmpfile();
+  char *msg = NULL;
+
+  fflush(in);
+  rewind(in);
+  bl_decode(in, out, &status);
+  rewind(out);
+  while (n-- >= 0 && fgets(buf, size, out)) {
+    msg = buf;
+  }
+  fclose(out);
+  if (status != SMB_SUCCESS || n >= 0 || !msg) {
+    return NULL;
+  }
+  msg = strstr(msg, ": ");          // after file:line
+  msg = msg ? strstr(msg + 2, ": ") : NULL; // after (function) LEVEL
+  if (msg) {
+    msg[strcspn(msg, "\n")] = '\0';
+    msg += 2;
+  }
+  return msg;
+}
+
+static int test_conversions(void)
+{
+  FILE *f = tmpfile();
+  smb_binlog *bl = bl_create(f, LEVEL_NOTSET);
+  char buf[512], expected[512];
+  const char *msg;
+  int i = 0;
+
+  BLOG(bl, LEVEL_INFO, "plain text, 100%% literal");
+  BLOG(bl, LEVEL_INFO, "%d %5i %-3d| %+d %hhd %hd", -12, 34, 5, 6, 300, 70000);
+  BLOG(bl, LEVEL_INFO, "%u %x %#X %o %lu %llu %zu", 1u, 255u, 255u, 8u,
+       123456789ul, 18446744073709551615ull, (size_t)42);
+  BLOG(bl, LEVEL_INFO, "%f %.2f %10.3e %g %Lf", 1.5, 3.14159, 12345.678, 0.0001,
+       (long double)2.25);
+  BLOG(bl, LEVEL_INFO, "[%s] [%.3s] [%8s] [%-8s] [%*.*s] [%ls]", "str",
+       "truncate", "right", "left", 6, 2, "star", L"wide");
+  BLOG(bl, LEVEL_INFO, "%c%c%c %lc %*d", 'a', 'b', 'c', L'z', 5, 7);
+  BLOG(bl, LEVEL_INFO, "%p %s", (void *)(uintptr_t)0x1234, (char *)NULL);
+
+  bl_delete(bl);
+  msg = decoded_line(f, i++, buf, sizeof(buf));
+  TA_STR_EQ(msg, "plain text, 100% literal");
+  msg = decoded_line(f, i++, buf, sizeof(buf));
+  snprintf(expected, sizeof(expected), "%d %5i %-3d| %+d %hhd %hd", -12, 34, 5,
+           6, 300, 70000);
+  TA_STR_EQ(msg, expected);
+  msg = decoded_line(f, i++, buf, sizeof(buf));
+  TA_STR_EQ(msg, "1 ff 0XFF 10 123456789 18446744073709551615 42");
+  msg = decoded_line(f, i++, buf, sizeof(buf));
+  snprintf(expected, sizeof(expected), "%f %.2f %10.3e %g %f", 1.5, 3.14159,
+           12345.678, 0.0001, 2.25);
+  TA_STR_EQ(msg, expected);
+  msg = decoded_line(f, i++, buf, sizeof(buf));
+  TA_STR_EQ(msg, "[str] [tru] [   right] [left    ] [    st] [wide]");
+  msg = decoded_line(f, i++, buf, sizeof(buf));
+  TA_STR_EQ(msg, "abc z     7");
+  msg = decoded_line(f, i++, buf, sizeof(buf));
+  snprintf(expected, sizeof(expected), "%p (null)", (void *)(uintptr_t)0x1234);
+  TA_STR_EQ(msg, expected);
+
+  fclose(f);
+  return 0;
+}
+
+static int test_sites(void)
+{
+  FILE *f = tmpfile();
+  smb_binlog *bl = bl_create(f, LEVEL_WARNING);
+  smb_status status = SMB_SUCCESS;
+  char buf[512];
+  int i, lines = 0;
+
+  for (i = 0; i < 3; i++) {
+    BLOG(bl, LEVEL_ERROR, "message %d", i);
+    BLOG(bl, LEVEL_INFO, "filtered %d", i);
+  }
+  bl_delete(bl);
+
+  // The site is described once, and gives every message its file and line.
+  FILE *out = tmpfile();
+  rewind(f);
+  bl_decode(f, out, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  rewind(out);
+  while (fgets(buf, sizeof(buf), out)) {
+    TEST_ASSERT(strstr(buf, "test/binlogtest.c:") != NULL);
+    TEST_ASSERT(strstr(buf, "(test_sites) ERROR: message ") != NULL);
+    lines++;
+  }
+  TA_INT_EQ(lines, 3);
+  fclose(out);
+  fclose(f);
+  return 0;
+}
+
+static int test_malformed(void)
+{
+  FILE *f = tmpfile(), *out = tmpfile();
+  smb_binlog *bl = bl_create(f, LEVEL_NOTSET);
+  smb_status status = SMB_SUCCESS;
+  char buf[4096];
+  size_t size;
+
+  BLOG(bl, LEVEL_INFO, "%s %s", "one", "two");
+  BLOG(bl, LEVEL_INFO, "%s %s", "three", "four");
+  bl_delete(bl);
+
+  // A stream cut off in its last record decodes up to the cut.
+  rewind(f);
+  size = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  f = tmpfile();
+  fwrite(buf, 1, size - 3, f);
+  rewind(f);
+  bl_decode(f, out, &status);
+  TA_INT_EQ(status, SMB_IO_ERROR);
+  rewind(out);
+  TEST_ASSERT(fgets(buf, sizeof(buf), out) && strstr(buf, "one two"));
+  TEST_ASSERT(!fgets(buf, sizeof(buf), out));
+  fclose(f);
+
+  // So does something which isn't a stream at all.
+  f = tmpfile();
+  fputs("not a binary log\n", f);
+  rewind(f);
+  status = SMB_SUCCESS;
+  bl_decode(f, out, &status);
+  TA_INT_EQ(status, SMB_IO_ERROR);
+  fclose(f);
+
+  // A huge '*' width is rejected rather than padded out, whether it was logged
+  // or came from corrupting a small one.
+  for (int corrupt = 0; corrupt < 2; corrupt++) {
+    int width = corrupt ? 12345 : 2147483600;
+    int64_t stored = width, huge = 0x7FFFFFF0;
+    f = tmpfile();
+    bl = bl_create(f, LEVEL_NOTSET);
+    BLOG(bl, LEVEL_INFO, "%s%*d", "s", width, 1);
+    bl_delete(bl);
+    rewind(f);
+    size = fread(buf, 1, sizeof(buf), f);
+    if (corrupt) {
+      size_t at = 0;
+      while (at + sizeof(stored) <= size &&
+             memcmp(buf + at, &stored, sizeof(stored)) != 0) {
+        at++;
+      }
+      TEST_ASSERT(at + sizeof(stored) <= size);
+      memcpy(buf + at, &huge, sizeof(huge));
+    }
+    fclose(f);
+    f = tmpfile();
+    fwrite(buf, 1, size, f);
+    rewind(f);
+    status = SMB_SUCCESS;
+    bl_decode(f, out, &status);
+    TA_INT_EQ(status, SMB_IO_ERROR);
+    fclose(f);
+  }
+
+  // So is a huge width in the format string.
+  f = tmpfile();
+  bl = bl_create(f, LEVEL_NOTSET);
+  BLOG(bl, LEVEL_INFO, "%2147483600d", 1);
+  bl_delete(bl);
+  rewind(f);
+  status = SMB_SUCCESS;
+  bl_decode(f, out, &status);
+  TA_INT_EQ(status, SMB_IO_ERROR);
+  fclose(f);
+
+  // A huge site id is rejected rather than grown into.
+  uint32_t header[2] = {1, 0x01020304u}, id = 0x80000001u;
+  unsigned char type = 1;
+  f = tmpfile();
+  fwrite("SMBL", 1, 4, f);
+  fwrite(header, sizeof(header), 1, f);
+  fwrite(&type, 1, 1, f);
+  fwrite(&id, sizeof(id), 1, f);
+  rewind(f);
+  status = SMB_SUCCESS;
+  bl_decode(f, out, &status);
+  TA_INT_EQ(status, SMB_IO_ERROR);
+  fclose(f);
+
+  // As is a string longer than the stream.
+  int32_t line = 1;
+  uint32_t length = 0xFFFFFFF0u;
+  id = 1;
+  f = tmpfile();
+  fwrite("SMBL", 1, 4, f);
+  fwrite(header, sizeof(header), 1, f);
+  fwrite(&type, 1, 1, f);
+  fwrite(&id, sizeof(id), 1, f);
+  fwrite(&line, sizeof(line), 1, f);
+  fwrite(&length, sizeof(length), 1, f);
+  fputs("short", f);
+  rewind(f);
+  status = SMB_SUCCESS;
+  bl_decode(f, out, &status);
+  TA_INT_EQ(status, SMB_IO_ERROR);
+
+  fclose(f);
+  fclose(out);
+  return 0;
+}
+
+static void *log_messages(void *arg)
+{
+  smb_binlog *bl = arg;
+  for (int i = 0; i < BINLOG_MESSAGES; i++) {
+    BLOG(bl, LEVEL_INFO, "message %d of %s", i, "thread");
+  }
+  return NULL;
+}
+
+static int test_threads(void)
+{
+  FILE *f = tmpfile(), *out = tmpfile();
+  smb_binlog *bl = bl_create(f, LEVEL_NOTSET);
+  smb_status status = SMB_SUCCESS;
+  pthread_t threads[BINLOG_THREADS];
+  char buf[512];
+  int i, lines = 0;
+
+  for (i = 0; i < BINLOG_THREADS; i++) {
+    pthread_create(&threads[i], NULL, log_messages, bl);
+  }
+  for (i = 0; i < BINLOG_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  bl_delete(bl);
+
+  rewind(f);
+  bl_decode(f, out, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  rewind(out);
+  while (fgets(buf, sizeof(buf), out)) {
+    TEST_ASSERT(strstr(buf, "INFO: message ") && strstr(buf, " of thread\n"));
+    lines++;
+  }
+  TA_INT_EQ(lines, BINLOG_THREADS * BINLOG_MESSAGES);
+  fclose(out);
+  fclose(f);
+  return 0;
+}
+
+void binlog_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/binlogtest.c");
+
+  smb_ut_test *conversions = su_create_test("conversions", test_conversions);
+  su_add_test(group, conversions);
+
+  smb_ut_test *sites = su_create_test("sites", test_sites);
+  su_add_test(group, sites);
+
+  smb_ut_test *malformed = su_create_test("malformed", test_malformed);
+  su_add_test(group, malformed);
+
+  smb_ut_test *threads = su_create_test("threads", test_threads);
+  su_add_test(group, threads);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
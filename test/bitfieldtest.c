@@ -13,6 +13,8 @@
 
 *******************************************************************************/
 
+#include <string.h>
+
 #include "libstephen/bf.h"
 #include "libstephen/ut.h"
 #include "tests.h"
@@ -139,6 +141,115 @@ int bf_test_flip()
   return 0;
 }
 
+#define bulk_bools 1003
+
+/*
+  Fill a bitfield with a pattern from a simple linear congruential generator.
+ */
+static void bf_fill(unsigned char *field, int num_bools, unsigned int seed)
+{
+  int i;
+  for (i = 0; i < SMB_BITFIELD_SIZE(num_bools); i++) {
+    seed = seed * 1103515245 + 12345;
+    field[i] = seed >> 16;
+  }
+}
+
+int bf_test_set_operations()
+{
+  // One byte in, so that none of the operands are aligned.
+  unsigned char a[SMB_BITFIELD_SIZE(bulk_bools) + 1];
+  unsigned char b[SMB_BITFIELD_SIZE(bulk_bools) + 1];
+  unsigned char dst[SMB_BITFIELD_SIZE(bulk_bools) + 1];
+  int i;
+
+  bf_fill(a + 1, bulk_bools, 1);
+  bf_fill(b + 1, bulk_bools, 2);
+
+  bf_and(dst + 1, a + 1, b + 1, bulk_bools);
+  for (i = 0; i < bulk_bools; i++) {
+    TA_INT_EQ(!!bf_check(dst + 1, i), bf_check(a + 1, i) && bf_check(b + 1, i));
+  }
+  bf_or(dst + 1, a + 1, b + 1, bulk_bools);
+  for (i = 0; i < bulk_bools; i++) {
+    TA_INT_EQ(!!bf_check(dst + 1, i), bf_check(a + 1, i) || bf_check(b + 1, i));
+  }
+  bf_xor(dst + 1, a + 1, b + 1, bulk_bools);
+  for (i = 0; i < bulk_bools; i++) {
+    TA_INT_EQ(!!bf_check(dst + 1, i), !bf_check(a + 1, i) != !bf_check(b + 1, i));
+  }
+  bf_andnot(dst + 1, a + 1, b + 1, bulk_bools);
+  for (i = 0; i < bulk_bools; i++) {
+    TA_INT_EQ(!!bf_check(dst + 1, i), bf_check(a + 1, i) && !bf_check(b + 1, i));
+  }
+
+  // The destination may be an operand.
+  memcpy(dst, a, sizeof(a));
+  bf_or(dst + 1, dst + 1, b + 1, bulk_bools);
+  for (i = 0; i < bulk_bools; i++) {
+    TA_INT_EQ(!!bf_check(dst + 1, i), bf_check(a + 1, i) || bf_check(b + 1, i));
+  }
+  bf_andnot(dst + 1, dst + 1, b + 1, bulk_bools);
+  for (i = 0; i < bulk_bools; i++) {
+    TA_INT_EQ(!!bf_check(dst + 1, i), bf_check(a + 1, i) && !bf_check(b + 1, i));
+  }
+  return 0;
+}
+
+int bf_test_count()
+{
+  unsigned char field[SMB_BITFIELD_SIZE(bulk_bools)];
+  int i, n, expected;
+
+  bf_fill(field, bulk_bools, 3);
+  for (n = 0; n <= bulk_bools; n += 37) {
+    expected = 0;
+    for (i = 0; i < n; i++) {
+      expected += !!bf_check(field, i);
+    }
+    TA_INT_EQ(bf_count(field, n), expected);
+  }
+  memset(field, 0xff, sizeof(field));
+  TA_INT_EQ(bf_count(field, bulk_bools), bulk_bools);
+  return 0;
+}
+
+int bf_test_next()
+{
+  unsigned char field[SMB_BITFIELD_SIZE(bulk_bools)];
+  int i, next;
+
+  // Sparse, so that whole words are skipped.
+  bf_init(field, bulk_bools);
+  bf_set(field, 5);
+  bf_set(field, 64);
+  bf_set(field, 700);
+  bf_set(field, bulk_bools - 1);
+  TA_INT_EQ(bf_next_set(field, bulk_bools, 0), 5);
+  TA_INT_EQ(bf_next_set(field, bulk_bools, 5), 5);
+  TA_INT_EQ(bf_next_set(field, bulk_bools, 6), 64);
+  TA_INT_EQ(bf_next_set(field, bulk_bools, 65), 700);
+  TA_INT_EQ(bf_next_set(field, bulk_bools, 701), bulk_bools - 1);
+  TA_INT_EQ(bf_next_set(field, bulk_bools - 1, 701), -1);
+  TA_INT_EQ(bf_next_set(field, bulk_bools, bulk_bools), -1);
+
+  // Against bf_check() on a dense pattern.
+  bf_fill(field, bulk_bools, 4);
+  for (i = 0; i < bulk_bools; i++) {
+    for (next = i; next < bulk_bools && !bf_check(field, next); next++) {}
+    TA_INT_EQ(bf_next_set(field, bulk_bools, i), next < bulk_bools ? next : -1);
+    for (next = i; next < bulk_bools && bf_check(field, next); next++) {}
+    TA_INT_EQ(bf_next_clear(field, bulk_bools, i), next < bulk_bools ? next : -1);
+  }
+
+  // Bits past the end are never found, set or clear.
+  memset(field, 0xff, sizeof(field));
+  TA_INT_EQ(bf_next_clear(field, bulk_bools, 0), -1);
+  field[sizeof(field) - 1] = 0;
+  TA_INT_EQ(bf_next_clear(field, bulk_bools, 0), (bulk_bools - 1) / 8 * 8);
+  return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // TEST LOADER AND RUNNER
 
@@ -163,6 +274,15 @@ void bit_field_test() {
   smb_ut_test *flip = su_create_test("flip", bf_test_flip);
   su_add_test(group, flip);
 
+  smb_ut_test *set_operations = su_create_test("set_operations", bf_test_set_operations);
+  su_add_test(group, set_operations);
+
+  smb_ut_test *count = su_create_test("count", bf_test_count);
+  su_add_test(group, count);
+
+  smb_ut_test *next = su_create_test("next", bf_test_next);
+  su_add_test(group, next);
+
   su_run_group(group);
   su_delete_group(group);
 }
@@ -0,0 +1,140 @@
+/***************************************************************************//**
+
+  @file         bloomtest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the Bloom filter.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <stdint.h>
+
+#include "libstephen/bloom.h"
+#include "libstephen/ut.h"
+#include "tests.h"
+
+#define test_keys 10000
+#define test_misses 100000
+
+/**
+   @brief The identity, which the filter's mixing has to make up for.
+ */
+static unsigned int int_hash(DATA d)
+{
+  return (unsigned int) d.data_llint;
+}
+
+/**
+   @brief Fill a filter with keys 0 through test_keys - 1, check that they're
+   all there, and return how many of as many keys again were false positives.
+ */
+static int false_positives(smb_bloom *filter)
+{
+  DATA d;
+  int i, found = 0;
+  for (i = 0; i < test_keys; i++) {
+    d.data_llint = i;
+    bloom_add(filter, d);
+  }
+  for (i = 0; i < test_keys; i++) {
+    d.data_llint = i;
+    if (!bloom_check(filter, d)) {
+      return -1;
+    }
+  }
+  for (i = test_keys; i < test_keys + test_misses; i++) {
+    d.data_llint = i;
+    found += bloom_check(filter, d);
+  }
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TESTS
+
+static int test_sizing(void)
+{
+  smb_bloom filter;
+
+  // 1% takes about 9.6 bits per key and 7 hashes.
+  bloom_init(&filter, test_keys, 0.01, int_hash, false);
+  TA_INT_EQ(filter.k, 7);
+  TEST_ASSERT(filter.num_bits >= 95000 && filter.num_bits <= 96000);
+  bloom_destroy(&filter);
+
+  bloom_init(&filter, test_keys, 0.001, int_hash, true);
+  TA_INT_EQ(filter.k, 10);
+  TA_INT_EQ(filter.num_bits % (BLOOM_BLOCK * 8), 0);
+  TA_INT_EQ((uintptr_t)filter.bits % BLOOM_BLOCK, 0);
+  bloom_destroy(&filter);
+
+  // Rates out of range are clamped.
+  bloom_init(&filter, 0, 0, int_hash, false);
+  TEST_ASSERT(filter.k == BLOOM_MAX_K && filter.num_bits > 0);
+  bloom_destroy(&filter);
+  bloom_init(&filter, 10, 2, int_hash, false);
+  TA_INT_EQ(filter.k, 1);
+  bloom_destroy(&filter);
+  return 0;
+}
+
+static int test_standard(void)
+{
+  smb_bloom *filter = bloom_create(test_keys, 0.01, int_hash, false);
+  int found = false_positives(filter);
+  TEST_ASSERT(found >= 0);
+  TEST_ASSERT(found < test_misses * 0.01 * 1.5);
+  bloom_delete(filter);
+  return 0;
+}
+
+static int test_blocked(void)
+{
+  smb_bloom *filter = bloom_create(test_keys, 0.01, int_hash, true);
+  int found = false_positives(filter);
+  TEST_ASSERT(found >= 0);
+  TEST_ASSERT(found < test_misses * 0.01 * 2.5);
+  bloom_delete(filter);
+  return 0;
+}
+
+static int test_hash_clear(void)
+{
+  smb_bloom filter;
+  bloom_init(&filter, 100, 0.01, NULL, true);
+  bloom_add_hash(&filter, 0x0123456789abcdefull);
+  TEST_ASSERT(bloom_check_hash(&filter, 0x0123456789abcdefull));
+  bloom_clear(&filter);
+  TEST_ASSERT(!bloom_check_hash(&filter, 0x0123456789abcdefull));
+  bloom_destroy(&filter);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST LOADER AND RUNNER
+
+void bloom_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/bloomtest.c");
+
+  smb_ut_test *sizing = su_create_test("sizing", test_sizing);
+  su_add_test(group, sizing);
+
+  smb_ut_test *standard = su_create_test("standard", test_standard);
+  su_add_test(group, standard);
+
+  smb_ut_test *blocked = su_create_test("blocked", test_blocked);
+  su_add_test(group, blocked);
+
+  smb_ut_test *hash_clear = su_create_test("hash_clear", test_hash_clear);
+  su_add_test(group, hash_clear);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
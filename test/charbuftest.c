@@ -13,9 +13,13 @@
 
 *******************************************************************************/
 
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 
+#include "libstephen/base.h"
 #include "libstephen/cb.h"
 #include "libstephen/ut.h"
 
@@ -249,6 +253,191 @@ int test_wcbuf_clear(void)
   return 0;
 }
 
+/**
+   @brief Test that a local buffer is used until it overflows, and then moved.
+ */
+int test_cbuf_local(void)
+{
+  char local[8];
+  cbuf cb;
+  cb_init_local(&cb, local, sizeof(local));
+  cb_concat(&cb, "abc");
+  TA_PTR_EQ(cb.buf, local);
+  cb_concat(&cb, "defgh");
+  TEST_ASSERT(cb.buf != local);
+  TA_STR_EQ(cb.buf, "abcdefgh");
+  TA_INT_EQ(cb.length, 8);
+  cb_destroy(&cb);
+  return 0;
+}
+
+/**
+   @brief Test that a wide local buffer is used until it overflows.
+ */
+int test_wcbuf_local(void)
+{
+  wchar_t local[8];
+  wcbuf wcb;
+  wcb_init_local(&wcb, local, 8);
+  wcb_concat(&wcb, L"abc");
+  TA_PTR_EQ(wcb.buf, local);
+  wcb_concat(&wcb, L"defgh");
+  TEST_ASSERT(wcb.buf != local);
+  TA_WSTR_EQ(wcb.buf, L"abcdefgh");
+  wcb_destroy(&wcb);
+  return 0;
+}
+
+/**
+   @brief Test appending a counted string, and reserving room.
+ */
+int test_cbuf_append_n(void)
+{
+  cbuf *c = cb_create(4);
+  cb_append_n(c, "abcdef", 3);
+  TA_STR_EQ(c->buf, "abc");
+  TA_INT_EQ(c->length, 3);
+  cb_reserve(c, 20);
+  TEST_ASSERT(c->capacity >= 24);
+  cb_append_n(c, "de\0f", 4);
+  TA_INT_EQ(c->length, 7);
+  TEST_ASSERT(memcmp(c->buf, "abcde\0f", 8) == 0);
+  cb_delete(c);
+  return 0;
+}
+
+/**
+   @brief Test appending a counted wide string, and reserving room.
+ */
+int test_wcbuf_append_n(void)
+{
+  wcbuf *wc = wcb_create(4);
+  wcb_append_n(wc, L"abcdef", 3);
+  TA_WSTR_EQ(wc->buf, L"abc");
+  wcb_reserve(wc, 20);
+  TEST_ASSERT(wc->capacity >= 24);
+  wcb_append_n(wc, L"def", 3);
+  TA_WSTR_EQ(wc->buf, L"abcdef");
+  wcb_delete(wc);
+  return 0;
+}
+
+/**
+   @brief Test taking the string out of heap and local buffers.
+ */
+int test_cbuf_steal(void)
+{
+  char local[16], *str;
+  cbuf cb;
+
+  cb_init(&cb, 16);
+  cb_concat(&cb, "heap");
+  char *buf = cb.buf;
+  str = cb_steal(&cb);
+  TA_PTR_EQ(str, buf);
+  TA_STR_EQ(str, "heap");
+  smb_free(str);
+
+  cb_init_local(&cb, local, sizeof(local));
+  cb_concat(&cb, "local");
+  str = cb_steal(&cb);
+  TEST_ASSERT(str != local);
+  TA_STR_EQ(str, "local");
+  smb_free(str);
+  return 0;
+}
+
+/**
+   @brief Test taking the string out of a wide buffer.
+ */
+int test_wcbuf_steal(void)
+{
+  wchar_t local[16], *str;
+  wcbuf wcb;
+  wcb_init_local(&wcb, local, 16);
+  wcb_concat(&wcb, L"local");
+  str = wcb_steal(&wcb);
+  TEST_ASSERT(str != local);
+  TA_WSTR_EQ(str, L"local");
+  smb_free(str);
+  return 0;
+}
+
+/**
+   @brief Test printf when the output fits, and when it must grow the buffer.
+ */
+int test_cbuf_printf_length(void)
+{
+  cbuf *cb = cb_create(16);
+  cb_printf(cb, "%d", 12);
+  TA_INT_EQ(cb->length, 2);
+  TA_INT_EQ(cb->capacity, 16);
+  cb_printf(cb, "-%s-", "a string too long to fit");
+  TA_STR_EQ(cb->buf, "12-a string too long to fit-");
+  TA_INT_EQ(cb->length, 28);
+  cb_append(cb, '!');
+  TA_STR_EQ(cb->buf, "12-a string too long to fit-!");
+  cb_delete(cb);
+  return 0;
+}
+
+/**
+   @brief Test wide printf when the output fits, and when it doesn't.
+ */
+int test_wcbuf_printf_length(void)
+{
+  wcbuf *wcb = wcb_create(16);
+  wcb_printf(wcb, L"%d", 12);
+  TA_INT_EQ(wcb->length, 2);
+  wcb_printf(wcb, L"-%s-", "a string too long to fit");
+  TA_WSTR_EQ(wcb->buf, L"12-a string too long to fit-");
+  TA_INT_EQ(wcb->length, 28);
+  wcb_delete(wcb);
+  return 0;
+}
+
+/**
+   @brief Test appending integers.
+ */
+int test_cbuf_append_int(void)
+{
+  cbuf *cb = cb_create(4);
+  cb_append_int(cb, 0);
+  cb_append(cb, ' ');
+  cb_append_int(cb, -42);
+  cb_append(cb, ' ');
+  cb_append_int(cb, LLONG_MIN);
+  cb_append(cb, ' ');
+  cb_append_uint(cb, ULLONG_MAX);
+  TA_STR_EQ(cb->buf, "0 -42 -9223372036854775808 18446744073709551615");
+  cb_delete(cb);
+  return 0;
+}
+
+/**
+   @brief Test that appending doubles matches printf.
+ */
+int test_cbuf_append_dbl(void)
+{
+  static const double values[] = {
+    0.0, -0.0, 1.0, -1.5, 0.125, 3.14159265, 123456.789, -0.0004, 1e17, 1e300,
+    0.999999, 2.5, 0.05, 0.15, 0.45, 1.005, 2.675, 0.0125, 1234.5675
+  };
+  char expected[512];
+  int i, precision;
+  cbuf *cb = cb_create(8);
+  for (i = 0; i < (int)(sizeof(values) / sizeof(values[0])); i++) {
+    for (precision = 0; precision <= CB_DBL_PRECISION + 1; precision++) {
+      cb_clear(cb);
+      cb_append_dbl(cb, values[i], precision);
+      snprintf(expected, sizeof(expected), "%.*f", precision, values[i]);
+      TA_STR_EQ(cb->buf, expected);
+    }
+  }
+  cb_delete(cb);
+  return 0;
+}
+
 void charbuf_test(void)
 {
   smb_ut_group *group = su_create_test_group("test/charbuftest.c");
@@ -301,6 +490,36 @@ void charbuf_test(void)
   smb_ut_test *wcbuf_clear = su_create_test("wcbuf_clear", test_wcbuf_clear);
   su_add_test(group, wcbuf_clear);
 
+  smb_ut_test *cbuf_local = su_create_test("cbuf_local", test_cbuf_local);
+  su_add_test(group, cbuf_local);
+
+  smb_ut_test *wcbuf_local = su_create_test("wcbuf_local", test_wcbuf_local);
+  su_add_test(group, wcbuf_local);
+
+  smb_ut_test *cbuf_append_n = su_create_test("cbuf_append_n", test_cbuf_append_n);
+  su_add_test(group, cbuf_append_n);
+
+  smb_ut_test *wcbuf_append_n = su_create_test("wcbuf_append_n", test_wcbuf_append_n);
+  su_add_test(group, wcbuf_append_n);
+
+  smb_ut_test *cbuf_steal = su_create_test("cbuf_steal", test_cbuf_steal);
+  su_add_test(group, cbuf_steal);
+
+  smb_ut_test *wcbuf_steal = su_create_test("wcbuf_steal", test_wcbuf_steal);
+  su_add_test(group, wcbuf_steal);
+
+  smb_ut_test *cbuf_printf_length = su_create_test("cbuf_printf_length", test_cbuf_printf_length);
+  su_add_test(group, cbuf_printf_length);
+
+  smb_ut_test *wcbuf_printf_length = su_create_test("wcbuf_printf_length", test_wcbuf_printf_length);
+  su_add_test(group, wcbuf_printf_length);
+
+  smb_ut_test *cbuf_append_int = su_create_test("cbuf_append_int", test_cbuf_append_int);
+  su_add_test(group, cbuf_append_int);
+
+  smb_ut_test *cbuf_append_dbl = su_create_test("cbuf_append_dbl", test_cbuf_append_dbl);
+  su_add_test(group, cbuf_append_dbl);
+
   su_run_group(group);
   su_delete_group(group);
 }
@@ -14,6 +14,7 @@
 *******************************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 
 #include "tests.h"
 #include "libstephen/ut.h"
@@ -312,6 +313,224 @@ int ht_test_iterator(void)
   return 0;
 }
 
+unsigned int ht_test_compares = 0;
+
+int ht_test_counting_compare(DATA d1, DATA d2)
+{
+  ht_test_compares++;
+  return data_compare_int(d1, d2);
+}
+
+/**
+   Keys whose stored hashes don't match aren't compared.  The hashes are mixed,
+   and mixing is one to one, so different integers never have the same hash.
+ */
+int ht_test_stored_hash(void)
+{
+  smb_status status = SMB_SUCCESS;
+  long long int i;
+  smb_ht *table = ht_create(ht_test_linear_hash, ht_test_counting_compare);
+
+  for (i = 0; i < 1000; i++) {
+    ht_insert(table, LLINT(i), LLINT(-i));
+  }
+  TA_INT_EQ(table->allocated & (table->allocated - 1), 0);
+
+  ht_test_compares = 0;
+  for (i = 0; i < 1000; i++) {
+    TA_LLINT_EQ(ht_get(table, LLINT(i), &status).data_llint, -i);
+    TA_INT_EQ(status, SMB_SUCCESS);
+  }
+  TA_INT_EQ(ht_test_compares, 1000);
+
+  ht_test_compares = 0;
+  for (i = 1000; i < 2000; i++) {
+    TEST_ASSERT(!ht_contains(table, LLINT(i)));
+  }
+  TA_INT_EQ(ht_test_compares, 0);
+
+  ht_delete(table);
+  return 0;
+}
+
+/**
+   Removing items leaves gravestones, but once they fill the table it is
+   rebuilt at the same size instead of growing forever.
+ */
+int ht_test_churn(void)
+{
+  smb_status status = SMB_SUCCESS;
+  long long int i;
+  unsigned int allocated = 0;
+  smb_ht *table = ht_create(ht_test_linear_hash, &data_compare_int);
+
+  for (i = 0; i < 100000; i++) {
+    ht_insert(table, LLINT(i), LLINT(-i));
+    if (i >= 10) {
+      ht_remove(table, LLINT(i - 10), &status);
+      TA_INT_EQ(status, SMB_SUCCESS);
+    }
+    TEST_ASSERT(table->length + table->graves <=
+                1 + table->allocated * HASH_TABLE_MAX_LOAD_FACTOR);
+    if (i == 1000) {
+      allocated = table->allocated;
+    }
+  }
+  TA_INT_EQ(table->length, 10);
+  TA_INT_EQ(table->allocated, allocated);
+  TA_INT_LE(table->allocated, 2 * HASH_TABLE_INITIAL_SIZE);
+  for (i = 0; i < 100000; i++) {
+    TA_INT_EQ(ht_contains(table, LLINT(i)), i >= 100000 - 10);
+  }
+
+  ht_delete(table);
+  return 0;
+}
+
+int ht_test_reserve(void)
+{
+  long long int i;
+  smb_ht *table = ht_create(ht_test_linear_hash, &data_compare_int);
+
+  ht_reserve(table, 1000);
+  unsigned int allocated = table->allocated;
+  TEST_ASSERT(1000 <= allocated * HASH_TABLE_MAX_LOAD_FACTOR);
+  for (i = 0; i < 1000; i++) {
+    ht_insert(table, LLINT(i), LLINT(-i));
+  }
+  TA_INT_EQ(table->allocated, allocated);
+
+  // Reserving less than the table already holds does nothing.
+  ht_reserve(table, 10);
+  TA_INT_EQ(table->allocated, allocated);
+
+  ht_delete(table);
+  return 0;
+}
+
+int ht_test_insert_many(void)
+{
+  smb_status status = SMB_SUCCESS;
+  long long int i;
+  DATA keys[10000], values[10000];
+  smb_ht *table = ht_create(ht_test_linear_hash, &data_compare_int);
+
+  ht_insert(table, LLINT(5), LLINT(0));
+  for (i = 0; i < 10000; i++) {
+    keys[i] = LLINT(i);
+    values[i] = LLINT(-i);
+  }
+  ht_insert_many(table, keys, values, 10000);
+  TA_INT_EQ(table->length, 10000);
+  for (i = 0; i < 10000; i++) {
+    TA_LLINT_EQ(ht_get(table, LLINT(i), &status).data_llint, -i);
+    TA_INT_EQ(status, SMB_SUCCESS);
+  }
+
+  ht_delete(table);
+  return 0;
+}
+
+int ht_test_hash_bytes(void)
+{
+  char buf[] = "abcdefghijklmnopqrstuvwxyz";
+  char with_nul[] = {'a', '\0', 'b'};
+  unsigned int hashes[27];
+  int i, j;
+
+  TA_INT_EQ(ht_string_hash(PTR(buf)), ht_hash_bytes(buf, strlen(buf)));
+  TA_INT_EQ(ht_string_hash(PTR(NULL)), 0);
+  TEST_ASSERT(ht_hash_bytes(with_nul, 3) != ht_hash_bytes(with_nul, 1));
+
+  // Every prefix, covering each way the tail of a key is read, hashes
+  // differently.
+  for (i = 0; i <= 26; i++) {
+    hashes[i] = ht_hash_bytes(buf, i);
+    for (j = 0; j < i; j++) {
+      TEST_ASSERT(hashes[i] != hashes[j]);
+    }
+  }
+  return 0;
+}
+
+/**
+   With every key hashed to the same slot, the i'th key inserted is found after
+   looking at i slots.
+ */
+int ht_test_stats(void)
+{
+  smb_status status = SMB_SUCCESS;
+  long long int i;
+  smb_ht_stats stats;
+  smb_ht *table = ht_create(ht_test_constant_hash, &data_compare_int);
+
+  ht_stats(table, &stats);
+  TA_INT_EQ(stats.length, 0);
+  TA_INT_EQ(stats.max_probe, 0);
+  TEST_ASSERT(stats.mean_probe == 0);
+
+  for (i = 0; i < 10; i++) {
+    ht_insert(table, LLINT(i), LLINT(-i));
+  }
+  ht_remove(table, LLINT(9), &status);
+  ht_remove(table, LLINT(8), &status);
+  ht_stats(table, &stats);
+  TA_INT_EQ(stats.length, 8);
+  TA_INT_EQ(stats.allocated, HASH_TABLE_INITIAL_SIZE);
+  TA_INT_EQ(stats.graves, 2);
+  TA_INT_EQ(stats.max_probe, 8);
+  TEST_ASSERT(stats.mean_probe == 4.5);
+  TA_SIZE_EQ(stats.bytes, HASH_TABLE_INITIAL_SIZE * sizeof(smb_ht_bckt));
+
+  ht_delete(table);
+  return 0;
+}
+
+/**
+   Batches of keys from the iterator, and the for-each loop, each see every key
+   once.
+ */
+int ht_test_iteration(void)
+{
+  smb_status status = SMB_SUCCESS;
+  bool seen[100] = {false};
+  DATA batch[16], k, v;
+  unsigned int index;
+  int i, n, total = 0;
+  smb_ht *table = ht_create(ht_test_constant_hash, &data_compare_int);
+
+  for (i = 0; i < 100; i++) {
+    ht_insert(table, LLINT(i), LLINT(-i));
+  }
+  ht_remove(table, LLINT(50), &status);
+
+  smb_iter it = ht_get_iter(table);
+  do {
+    n = iter_next_n(&it, batch, 16);
+    for (i = 0; i < n; i++) {
+      TA_INT_EQ(seen[batch[i].data_llint], false);
+      seen[batch[i].data_llint] = true;
+    }
+    total += n;
+  } while (n == 16);
+  TA_INT_EQ(total, 99);
+  TA_INT_EQ(it.has_next(&it), false);
+  it.destroy(&it);
+
+  total = 0;
+  HT_FOR_EACH(table, index, k, v) {
+    TA_LLINT_EQ(v.data_llint, -k.data_llint);
+    TA_INT_EQ(seen[k.data_llint], true);
+    seen[k.data_llint] = false;
+    total++;
+  }
+  TA_INT_EQ(total, 99);
+  TA_INT_EQ(seen[50], false);
+
+  ht_delete(table);
+  return 0;
+}
+
 void hash_table_test()
 {
   smb_ut_group *group = su_create_test_group("test/hashtabletest.c");
@@ -337,6 +556,27 @@ void hash_table_test()
   smb_ut_test *test_iterator = su_create_test("test_iterator", ht_test_iterator);
   su_add_test(group, test_iterator);
 
+  smb_ut_test *stored_hash = su_create_test("stored_hash", ht_test_stored_hash);
+  su_add_test(group, stored_hash);
+
+  smb_ut_test *churn = su_create_test("churn", ht_test_churn);
+  su_add_test(group, churn);
+
+  smb_ut_test *reserve = su_create_test("reserve", ht_test_reserve);
+  su_add_test(group, reserve);
+
+  smb_ut_test *insert_many = su_create_test("insert_many", ht_test_insert_many);
+  su_add_test(group, insert_many);
+
+  smb_ut_test *hash_bytes = su_create_test("hash_bytes", ht_test_hash_bytes);
+  su_add_test(group, hash_bytes);
+
+  smb_ut_test *stats = su_create_test("stats", ht_test_stats);
+  su_add_test(group, stats);
+
+  smb_ut_test *iteration = su_create_test("iteration", ht_test_iteration);
+  su_add_test(group, iteration);
+
   su_run_group(group);
   su_delete_group(group);
 }
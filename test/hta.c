@@ -255,6 +255,51 @@ int hta_test_duplicate()
   return 0;
 }
 
+int hta_test_reserve(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int key, value;
+  smb_hta *table = hta_create(hta_test_linear_hash, &hta_int_comp, sizeof(int), sizeof(int));
+
+  hta_reserve(table, 1000);
+  unsigned int allocated = table->allocated;
+  for (key = 0; key < 1000; key++) {
+    value = -key;
+    hta_insert(table, &key, &value);
+  }
+  TA_INT_EQ(table->allocated, allocated);
+  for (key = 0; key < 1000; key++) {
+    TA_INT_EQ(*(int*)hta_get(table, &key, &status), -key);
+    TA_INT_EQ(status, SMB_SUCCESS);
+  }
+
+  hta_delete(table);
+  return 0;
+}
+
+int hta_test_stats(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int key, value = 0;
+  smb_ht_stats stats;
+  smb_hta *table = hta_create(hta_test_constant_hash, &hta_int_comp, sizeof(int), sizeof(int));
+
+  for (key = 0; key < 10; key++) {
+    hta_insert(table, &key, &value);
+  }
+  key = 9;
+  hta_remove(table, &key, &status);
+  hta_stats(table, &stats);
+  TA_INT_EQ(stats.length, 9);
+  TA_INT_EQ(stats.graves, 1);
+  TA_INT_EQ(stats.max_probe, 9);
+  TEST_ASSERT(stats.mean_probe == 5);
+  TA_SIZE_EQ(stats.bytes, HASH_TABLE_INITIAL_SIZE * (HTA_KEY_OFFSET + 2 * sizeof(int)));
+
+  hta_delete(table);
+  return 0;
+}
+
 void hta_test()
 {
   smb_ut_group *group = su_create_test_group("test/hta.c");
@@ -277,6 +322,12 @@ void hta_test()
   smb_ut_test *duplicate = su_create_test("duplicate", hta_test_duplicate);
   su_add_test(group, duplicate);
 
+  smb_ut_test *reserve = su_create_test("reserve", hta_test_reserve);
+  su_add_test(group, reserve);
+
+  smb_ut_test *stats = su_create_test("stats", hta_test_stats);
+  su_add_test(group, stats);
+
   su_run_group(group);
   su_delete_group(group);
 }
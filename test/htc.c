@@ -0,0 +1,189 @@
+/***************************************************************************//**
+
+  @file         htc.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        A test of the HTC.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "tests.h"
+#include "libstephen/ut.h"
+#include "libstephen/htc.h"
+
+#define HTC_THREADS 4
+#define HTC_KEYS 10000
+
+static unsigned int htc_test_linear_hash(void *key)
+{
+  return * (unsigned int*) key;
+}
+
+static int htc_test_basic(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int key = 1, value = 2, out = 0;
+  smb_htc *table = htc_create(3, htc_test_linear_hash, &hta_int_comp,
+                              sizeof(int), sizeof(int));
+  TA_INT_EQ(table->nshards, 4);
+
+  htc_insert(table, &key, &value);
+  TEST_ASSERT(htc_contains(table, &key));
+  htc_get(table, &key, &out, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  TA_INT_EQ(out, 2);
+  TA_INT_EQ(htc_length(table), 1);
+
+  htc_remove(table, &key, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  htc_get(table, &key, &out, &status);
+  TA_INT_EQ(status, SMB_NOT_FOUND_ERROR);
+  htc_remove(table, &key, &status);
+  TA_INT_EQ(status, SMB_NOT_FOUND_ERROR);
+
+  // A single shard works too.
+  htc_delete(table);
+  table = htc_create(1, htc_test_linear_hash, &hta_int_comp,
+                     sizeof(int), sizeof(int));
+  htc_insert(table, &key, &value);
+  TEST_ASSERT(htc_contains(table, &key));
+  htc_delete(table);
+  return 0;
+}
+
+struct htc_worker {
+  smb_htc *table;
+  int id;
+  int errors;
+};
+
+/*
+  Insert this thread's keys, reading back the ones inserted so far, and then
+  remove the odd ones.
+ */
+static void *htc_worker(void *arg)
+{
+  struct htc_worker *w = arg;
+  smb_status status = SMB_SUCCESS;
+  int key, value;
+
+  for (int i = 0; i < HTC_KEYS; i++) {
+    key = i * HTC_THREADS + w->id;
+    value = -key;
+    htc_insert(w->table, &key, &value);
+    key = (i / 2) * HTC_THREADS + w->id;
+    htc_get(w->table, &key, &value, &status);
+    if (status != SMB_SUCCESS || value != -key) {
+      w->errors++;
+    }
+  }
+  for (int i = 1; i < HTC_KEYS; i += 2) {
+    key = i * HTC_THREADS + w->id;
+    htc_remove(w->table, &key, &status);
+    if (status != SMB_SUCCESS) {
+      w->errors++;
+    }
+  }
+  return NULL;
+}
+
+static int htc_test_threads(void)
+{
+  smb_status status = SMB_SUCCESS;
+  struct htc_worker workers[HTC_THREADS];
+  pthread_t threads[HTC_THREADS];
+  int key, value;
+  smb_htc *table = htc_create(16, htc_test_linear_hash, &hta_int_comp,
+                              sizeof(int), sizeof(int));
+
+  for (int i = 0; i < HTC_THREADS; i++) {
+    workers[i].table = table;
+    workers[i].id = i;
+    workers[i].errors = 0;
+    pthread_create(&threads[i], NULL, htc_worker, &workers[i]);
+  }
+  for (int i = 0; i < HTC_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    TA_INT_EQ(workers[i].errors, 0);
+  }
+
+  TA_INT_EQ(htc_length(table), HTC_THREADS * HTC_KEYS / 2);
+  for (key = 0; key < HTC_THREADS * HTC_KEYS; key++) {
+    htc_get(table, &key, &value, &status);
+    if ((key / HTC_THREADS) % 2 == 0) {
+      TA_INT_EQ(status, SMB_SUCCESS);
+      TA_INT_EQ(value, -key);
+    } else {
+      TA_INT_EQ(status, SMB_NOT_FOUND_ERROR);
+    }
+  }
+
+  // The keys are spread over the shards.
+  for (unsigned int i = 0; i < table->nshards; i++) {
+    TA_INT_GT(table->shards[i].table.length, 0);
+  }
+
+  htc_delete(table);
+  return 0;
+}
+
+/*
+  Insert and remove many more keys than the table holds while only a few are
+  live, so that gravestones have to be cleared for probes to terminate.
+ */
+static int htc_test_churn(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int key, value, live = 8;
+  smb_htc *table = htc_create(2, htc_test_linear_hash, &hta_int_comp,
+                              sizeof(int), sizeof(int));
+
+  for (key = 0; key < 100000; key++) {
+    value = -key;
+    htc_insert(table, &key, &value);
+    if (key >= live) {
+      int old = key - live;
+      htc_remove(table, &old, &status);
+      TA_INT_EQ(status, SMB_SUCCESS);
+    }
+  }
+  TA_INT_EQ(htc_length(table), live);
+  for (unsigned int i = 0; i < table->nshards; i++) {
+    TA_INT_LT(table->shards[i].table.allocated, 1024);
+  }
+  key = 100000 - 1;
+  htc_get(table, &key, &value, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  TA_INT_EQ(value, -key);
+  key = 0;
+  TEST_ASSERT(!htc_contains(table, &key));
+
+  htc_delete(table);
+  return 0;
+}
+
+void htc_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/htc.c");
+
+  smb_ut_test *basic = su_create_test("basic", htc_test_basic);
+  su_add_test(group, basic);
+
+  smb_ut_test *threads = su_create_test("threads", htc_test_threads);
+  su_add_test(group, threads);
+
+  smb_ut_test *churn = su_create_test("churn", htc_test_churn);
+  su_add_test(group, churn);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -0,0 +1,235 @@
+/***************************************************************************//**
+
+  @file         hts.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        A test of the HTS.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <stdio.h>
+
+#include "tests.h"
+#include "libstephen/ut.h"
+#include "libstephen/ht.h"
+#include "libstephen/hts.h"
+
+#define TEST_PAIRS 5
+
+static char *hts_test_keys[] = {
+  "first key",
+  "second key",
+  "third key",
+  "fourth key",
+  "fifth key"
+};
+
+static char *hts_test_values[] = {
+  "first value",
+  "second value",
+  "third value",
+  "fourth value",
+  "fifth value"
+};
+
+static unsigned int hts_test_constant_hash(void *key)
+{
+  (void) key; // unused
+  return 4;
+}
+
+static unsigned int hts_test_linear_hash(void *key)
+{
+  return * (unsigned int*) key;
+}
+
+static int hts_test_insert(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int i;
+  char **rv;
+  smb_hts *table = hts_create(&hta_string_hash, &hta_string_comp,
+                              sizeof(char*), sizeof(char*));
+
+  for (i = 0; i < TEST_PAIRS; i++) {
+    hts_insert(table, &hts_test_keys[i], &hts_test_values[i]);
+  }
+
+  for (i = 0; i < TEST_PAIRS; i++) {
+    TEST_ASSERT(hts_contains(table, &hts_test_keys[i]));
+    rv = (char**)hts_get(table, &hts_test_keys[i], &status);
+    TA_INT_EQ(status, SMB_SUCCESS);
+    TA_PTR_EQ(hts_test_values[i], *rv);
+  }
+  TA_INT_EQ(table->length, TEST_PAIRS);
+
+  hts_delete(table);
+  return 0;
+}
+
+static int hts_test_remove(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int i;
+  smb_hts *table = hts_create(&hta_string_hash, &hta_string_comp,
+                              sizeof(char*), sizeof(char*));
+
+  for (i = 0; i < TEST_PAIRS; i++) {
+    hts_insert(table, &hts_test_keys[i], &hts_test_values[i]);
+  }
+  for (i = 0; i < TEST_PAIRS; i++) {
+    hts_remove(table, &hts_test_keys[i], &status);
+    TA_INT_EQ(status, SMB_SUCCESS);
+    TEST_ASSERT(!hts_contains(table, &hts_test_keys[i]));
+    TA_INT_EQ(table->length, TEST_PAIRS - i - 1);
+  }
+
+  hts_remove(table, &hts_test_keys[0], &status);
+  TA_INT_EQ(status, SMB_NOT_FOUND_ERROR);
+  hts_get(table, &hts_test_keys[0], &status);
+  TA_INT_EQ(status, SMB_NOT_FOUND_ERROR);
+
+  hts_delete(table);
+  return 0;
+}
+
+/**
+   Every key has the same hash, so they all share control bytes and a probe
+   sequence, and have to be told apart by comparing them.
+ */
+static int hts_test_collisions(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int key, value, *rv;
+  smb_hts *table = hts_create(hts_test_constant_hash, &hta_int_comp,
+                              sizeof(int), sizeof(int));
+
+  for (key = 0; key < 100; key++) {
+    value = -key;
+    hts_insert(table, &key, &value);
+  }
+  for (key = 0; key < 100; key += 2) {
+    hts_remove(table, &key, &status);
+    TA_INT_EQ(status, SMB_SUCCESS);
+  }
+  for (key = 0; key < 100; key++) {
+    rv = hts_get(table, &key, &status);
+    if (key % 2 == 0) {
+      TA_INT_EQ(status, SMB_NOT_FOUND_ERROR);
+    } else {
+      TA_INT_EQ(status, SMB_SUCCESS);
+      TA_INT_EQ(*rv, -key);
+    }
+  }
+
+  hts_delete(table);
+  return 0;
+}
+
+static int hts_test_resize(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int key, value, *rv;
+  smb_hts *table = hts_create(hts_test_linear_hash, &hta_int_comp,
+                              sizeof(int), sizeof(int));
+
+  for (key = 0; key < 10000; key++) {
+    value = -key;
+    hts_insert(table, &key, &value);
+  }
+  TA_INT_EQ(table->length, 10000);
+  TA_INT_EQ(table->allocated & (table->allocated - 1), 0);
+  TEST_ASSERT(table->allocated >= 10000 + 10000 / 7);
+
+  for (key = 0; key < 10000; key++) {
+    rv = hts_get(table, &key, &status);
+    TA_INT_EQ(status, SMB_SUCCESS);
+    TA_INT_EQ(*rv, -key);
+  }
+  key = 10000;
+  TEST_ASSERT(!hts_contains(table, &key));
+
+  hts_delete(table);
+  return 0;
+}
+
+/**
+   Inserting and removing forever doesn't grow the table, since rehashing drops
+   the deleted slots.
+ */
+static int hts_test_churn(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int key, value = 0;
+  smb_hts *table = hts_create(hts_test_linear_hash, &hta_int_comp,
+                              sizeof(int), sizeof(int));
+
+  for (key = 0; key < 100000; key++) {
+    hts_insert(table, &key, &value);
+    if (key >= 10) {
+      int old = key - 10;
+      hts_remove(table, &old, &status);
+      TA_INT_EQ(status, SMB_SUCCESS);
+    }
+  }
+  TA_INT_EQ(table->length, 10);
+  TA_INT_EQ(table->allocated, HASH_TABLE_INITIAL_SIZE);
+  for (key = 100000 - 10; key < 100000; key++) {
+    TEST_ASSERT(hts_contains(table, &key));
+  }
+
+  hts_delete(table);
+  return 0;
+}
+
+static int hts_test_duplicate(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int i;
+  char **rv;
+  smb_hts *table = hts_create(&hta_string_hash, &hta_string_comp,
+                              sizeof(char*), sizeof(char*));
+
+  for (i = 0; i < TEST_PAIRS; i++) {
+    hts_insert(table, &hts_test_keys[0], &hts_test_values[i]);
+  }
+  TA_INT_EQ(table->length, 1);
+  rv = (char**)hts_get(table, &hts_test_keys[0], &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  TA_PTR_EQ(*rv, hts_test_values[TEST_PAIRS - 1]);
+
+  hts_delete(table);
+  return 0;
+}
+
+void hts_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/hts.c");
+
+  smb_ut_test *insert = su_create_test("insert", hts_test_insert);
+  su_add_test(group, insert);
+
+  smb_ut_test *remove = su_create_test("remove", hts_test_remove);
+  su_add_test(group, remove);
+
+  smb_ut_test *collisions = su_create_test("collisions", hts_test_collisions);
+  su_add_test(group, collisions);
+
+  smb_ut_test *resize = su_create_test("resize", hts_test_resize);
+  su_add_test(group, resize);
+
+  smb_ut_test *churn = su_create_test("churn", hts_test_churn);
+  su_add_test(group, churn);
+
+  smb_ut_test *duplicate = su_create_test("duplicate", hts_test_duplicate);
+  su_add_test(group, duplicate);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -121,6 +121,37 @@ int iter_test_values()
   return 0;
 }
 
+/**
+   @brief Tests that iter_next_n returns the same values in batches, both with
+   the iterator's own next_n and without it.
+ */
+int iter_test_next_n()
+{
+  DATA batch[7];
+  int pass, i, n, total;
+
+  for (pass = 0; pass < 2; pass++) {
+    smb_iter it = get_iter(100);
+    if (pass == 1) {
+      it.next_n = NULL;
+    }
+    total = 0;
+    do {
+      n = iter_next_n(&it, batch, 7);
+      for (i = 0; i < n; i++) {
+        TA_LLINT_EQ(batch[i].data_llint, (long long)100 * (total + i));
+      }
+      total += n;
+    } while (n == 7);
+    TA_INT_EQ(total, 100);
+    TA_INT_EQ(it.index, 100);
+    TA_INT_EQ(it.has_next(&it), false);
+    TA_INT_EQ(iter_next_n(&it, batch, 7), 0);
+    it.destroy(&it);
+    cleanup();
+  }
+  return 0;
+}
 
 /*******************************************************************************
 
@@ -211,6 +242,9 @@ void run_tests(char *desc)
   smb_ut_test *values = su_create_test("values", iter_test_values);
   su_add_test(group, values);
 
+  smb_ut_test *next_n = su_create_test("next_n", iter_test_next_n);
+  su_add_test(group, next_n);
+
   su_run_group(group);
   su_delete_group(group);
 }
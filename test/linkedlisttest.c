@@ -14,6 +14,7 @@
 *******************************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 
 #include "tests.h"
 #include "libstephen/ll.h"
@@ -75,6 +76,169 @@ int ll_test_sort_empty()
   return 0;
 }
 
+int ll_test_pool()
+{
+  smb_ll_pool *pool = ll_pool_create();
+  smb_ll *a = ll_create_pooled(pool);
+  smb_ll b;
+  smb_status status = SMB_SUCCESS;
+  int i;
+
+  ll_init_pooled(&b, pool);
+  for (i = 0; i < SMB_LL_POOL_SLAB + 10; i++) {
+    ll_append(a, LLINT(i));
+    ll_prepend(&b, LLINT(-i));
+  }
+  TA_INT_EQ(ll_length(a), SMB_LL_POOL_SLAB + 10);
+  TA_LLINT_EQ(ll_get(a, 100, &status).data_llint, 100);
+  TA_LLINT_EQ(ll_get(&b, 0, &status).data_llint, -SMB_LL_POOL_SLAB - 9);
+
+  // A removed node is the next one handed out, to either list.
+  smb_ll_node *tail = a->tail;
+  ll_pop_back(a, &status);
+  ll_append(&b, LLINT(1000));
+  TA_PTR_EQ(b.tail, tail);
+  TA_LLINT_EQ(ll_peek_back(&b, &status).data_llint, 1000);
+
+  ll_delete(a);
+  ll_destroy(&b);
+  ll_pool_delete(pool);
+  return 0;
+}
+
+int ll_test_indexed()
+{
+  smb_ll *list = ll_create();
+  smb_status status = SMB_SUCCESS;
+  long long int reference[300];
+  int length = 0, i, j;
+  unsigned int x = 1;
+
+  // Mix indexed operations at pseudo-random places, checking against an array,
+  // so that the list's cursor is left all over the place.
+  for (i = 0; i < 2000; i++) {
+    x = x * 1103515245 + 12345;
+    int index = length ? (x >> 16) % length : 0;
+    switch ((x >> 8) % 4) {
+    case 0:
+    case 1:
+      if (length < 300) {
+        ll_insert(list, index, LLINT(i));
+        memmove(reference + index + 1, reference + index,
+                (length - index) * sizeof(long long int));
+        reference[index] = i;
+        length++;
+      }
+      break;
+    case 2:
+      if (length > 0) {
+        ll_remove(list, index, &status);
+        TA_INT_EQ(status, SMB_SUCCESS);
+        memmove(reference + index, reference + index + 1,
+                (length - index - 1) * sizeof(long long int));
+        length--;
+      }
+      break;
+    case 3:
+      if (length > 0) {
+        ll_set(list, index, LLINT(-i), &status);
+        reference[index] = -i;
+      }
+      break;
+    }
+    if (i % 100 == 0) {
+      ll_prepend(list, LLINT(i));
+      ll_pop_front(list, &status);
+    }
+  }
+
+  TA_INT_EQ(ll_length(list), length);
+  for (j = 0; j < length; j++) {
+    TA_LLINT_EQ(ll_get(list, j, &status).data_llint, reference[j]);
+  }
+  for (j = length - 1; j >= 0; j--) {
+    TA_LLINT_EQ(ll_get(list, j, &status).data_llint, reference[j]);
+  }
+  ll_get(list, length, &status);
+  TA_INT_EQ(status, SMB_INDEX_ERROR);
+  ll_delete(list);
+  return 0;
+}
+
+int ll_test_for_each()
+{
+  smb_ll *list = ll_create();
+  smb_ll_node *node;
+  DATA d;
+  int i, count = 0;
+
+  LL_FOR_EACH(list, node, d) {
+    count++;
+  }
+  TA_INT_EQ(count, 0);
+
+  for (i = 0; i < 50; i++) {
+    ll_append(list, LLINT(i * 3));
+  }
+  LL_FOR_EACH(list, node, d) {
+    TA_LLINT_EQ(d.data_llint, count * 3);
+    node->data = LLINT(-d.data_llint);
+    count++;
+  }
+  TA_INT_EQ(count, 50);
+  TA_LLINT_EQ(list->tail->data.data_llint, -49 * 3);
+  ll_delete(list);
+  return 0;
+}
+
+int ll_test_cursor()
+{
+  smb_ll *list = ll_create();
+  smb_status status = SMB_SUCCESS;
+  int i;
+  for (i = 0; i < 10; i++) {
+    ll_append(list, LLINT(i));
+  }
+
+  // Remove the odd numbers, and put a negative copy before each even one.
+  smb_ll_cursor c = ll_cursor(list);
+  while (ll_cursor_valid(&c)) {
+    long long int value = ll_cursor_get(&c).data_llint;
+    if (value % 2) {
+      TA_LLINT_EQ(ll_cursor_remove(&c).data_llint, value);
+    } else {
+      ll_cursor_insert(&c, LLINT(-value));
+      TA_LLINT_EQ(ll_cursor_get(&c).data_llint, value);
+      ll_cursor_next(&c);
+    }
+  }
+  TA_INT_EQ(c.index, 10);
+  ll_cursor_insert(&c, LLINT(100));
+
+  long long int expected[] = {0, 0, -2, 2, -4, 4, -6, 6, -8, 8, 100};
+  TA_INT_EQ(ll_length(list), 11);
+  for (i = 0; i < 11; i++) {
+    TA_LLINT_EQ(ll_get(list, i, &status).data_llint, expected[i]);
+  }
+
+  // Walk back from past the end.
+  ll_cursor_seek(&c, 11, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  ll_cursor_prev(&c, &status);
+  TA_LLINT_EQ(ll_cursor_get(&c).data_llint, 100);
+  ll_cursor_seek(&c, 3, &status);
+  ll_cursor_set(&c, LLINT(20));
+  TA_LLINT_EQ(ll_get(list, 3, &status).data_llint, 20);
+  ll_cursor_seek(&c, 0, &status);
+  ll_cursor_prev(&c, &status);
+  TA_INT_EQ(status, SMB_INDEX_ERROR);
+  ll_cursor_seek(&c, 12, &status);
+  TA_INT_EQ(status, SMB_INDEX_ERROR);
+
+  ll_delete(list);
+  return 0;
+}
+
 static bool is_even(DATA d) {
   return d.data_llint % 2 == 0;
 }
@@ -248,6 +412,18 @@ void linked_list_test()
   smb_ut_test *sort_empty = su_create_test("sort_empty", ll_test_sort_empty);
   su_add_test(group, sort_empty);
 
+  smb_ut_test *pool = su_create_test("pool", ll_test_pool);
+  su_add_test(group, pool);
+
+  smb_ut_test *indexed = su_create_test("indexed", ll_test_indexed);
+  su_add_test(group, indexed);
+
+  smb_ut_test *for_each = su_create_test("for_each", ll_test_for_each);
+  su_add_test(group, for_each);
+
+  smb_ut_test *cursor = su_create_test("cursor", ll_test_cursor);
+  su_add_test(group, cursor);
+
   smb_ut_test *filter_empty = su_create_test("filter_empty", ll_test_filter_empty);
   su_add_test(group, filter_empty);
 
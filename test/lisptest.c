@@ -0,0 +1,802 @@
+/***************************************************************************//**
+
+  @file         lisptest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the lisp interpreter and bytecode VM.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "libstephen/lisp.h"
+
+static lisp_value *run(lisp_runtime *rt, lisp_scope *scope, const char *code)
+{
+  return lisp_eval(rt, scope, lisp_parse(rt, (char*)code));
+}
+
+static int run_int(lisp_runtime *rt, lisp_scope *scope, const char *code)
+{
+  lisp_value *v = run(rt, scope, code);
+  return v->type == type_integer ? ((lisp_integer*)v)->x : -1;
+}
+
+static lisp_lambda *lookup_lambda(lisp_runtime *rt, lisp_scope *scope,
+                                  const char *name)
+{
+  lisp_symbol *s = lisp_symbol_new(rt, (char*)name);
+  return (lisp_lambda*) lisp_scope_lookup(rt, scope, s);
+}
+
+static int test_arithmetic(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  run(&rt, scope, "(define f (lambda (x y) (- (* x 3) y)))");
+  TA_INT_EQ(run_int(&rt, scope, "(f 5 4)"), 11);
+  TA_INT_EQ(run_int(&rt, scope, "(f (f 1 1) 2)"), 4);
+  TA_PTR_NE(lookup_lambda(&rt, scope, "f")->bytecode, NULL);
+  TA_INT_EQ(run_int(&rt, scope, "((lambda (x) (car (cdr x))) '(1 2 3))"), 2);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_if(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  run(&rt, scope, "(define max (lambda (a b) (if (> a b) a b)))");
+  TA_INT_EQ(run_int(&rt, scope, "(max 3 7)"), 7);
+  TA_INT_EQ(run_int(&rt, scope, "(max 9 2)"), 9);
+  run(&rt, scope, "(define len (lambda (l) (if (null? l) 0 (+ 1 (len (cdr l))))))");
+  TA_INT_EQ(run_int(&rt, scope, "(len '(1 2 3 4))"), 4);
+  TA_PTR_NE(lookup_lambda(&rt, scope, "len")->bytecode, NULL);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_recursion(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  run(&rt, scope, "(define fact (lambda (n) (if (<= n 1) 1 (* n (fact (- n 1))))))");
+  TA_INT_EQ(run_int(&rt, scope, "(fact 10)"), 3628800);
+
+  // Calls between compiled lambdas don't use the C stack.
+  run(&rt, scope, "(define down (lambda (n) (if (= n 0) 0 (+ 1 (down (- n 1))))))");
+  TA_INT_EQ(run_int(&rt, scope, "(down 100000)"), 100000);
+  TA_SIZE_EQ(rt.nframes, 0);
+  TA_SIZE_EQ(rt.nstack, 0);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_tail_calls(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  // Compiled: the frame is reused, so only one is ever needed.
+  run(&rt, scope, "(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 2)))))");
+  TA_INT_EQ(run_int(&rt, scope, "(loop 100000 0)"), 200000);
+  TA_SIZE_EQ(rt.framealloc, 16);
+  TA_SIZE_EQ(rt.nframes, 0);
+  TA_SIZE_EQ(rt.nstack, 0);
+
+  // Mutual recursion, and a tail call with the wrong number of arguments.
+  run(&rt, scope, "(define even (lambda (n) (if (= n 0) 1 (odd (- n 1)))))");
+  run(&rt, scope, "(define odd (lambda (n) (if (= n 0) 0 (even (- n 1)))))");
+  TA_INT_EQ(run_int(&rt, scope, "(even 50001)"), 0);
+  run(&rt, scope, "(define wrong (lambda (n) (loop n)))");
+  TA_PTR_EQ(run(&rt, scope, "(wrong 1)")->type, type_error);
+  TA_SIZE_EQ(rt.nframes, 0);
+
+  // Interpreted: eval can't be compiled, so this loop runs in the evaluator.
+  run(&rt, scope, "(define iloop (lambda (n acc) (if (= n 0) acc (iloop (- n 1) (eval (+ acc 1))))))");
+  TA_INT_EQ(run_int(&rt, scope, "(iloop 20000 0)"), 20000);
+  TEST_ASSERT(lookup_lambda(&rt, scope, "iloop")->interpret);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_interpreted(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  // A body with a define in it is left to the interpreter.
+  run(&rt, scope, "(define z 0)");
+  run(&rt, scope, "(define setter (lambda (n) (define z n)))");
+  TA_INT_EQ(run_int(&rt, scope, "(setter 3)"), 3);
+  TA_INT_EQ(run_int(&rt, scope, "z"), 3);
+  TA_PTR_EQ(lookup_lambda(&rt, scope, "setter")->bytecode, NULL);
+  TEST_ASSERT(lookup_lambda(&rt, scope, "setter")->interpret);
+
+  // But it can still be called from compiled code.
+  run(&rt, scope, "(define twice (lambda (f x) (f (f x))))");
+  TA_INT_EQ(run_int(&rt, scope, "(twice setter 7)"), 7);
+  TA_PTR_NE(lookup_lambda(&rt, scope, "twice")->bytecode, NULL);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_closures(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  run(&rt, scope, "(define adder (lambda (n) (lambda (x) (+ x n))))");
+  TA_INT_EQ(run_int(&rt, scope, "((adder 3) 4)"), 7);
+  TA_PTR_NE(lookup_lambda(&rt, scope, "adder")->bytecode, NULL);
+
+  // Two levels up, with a shadowed name in between.
+  run(&rt, scope, "(define f (lambda (a b) (lambda (b) (lambda (c) (- a (* b c))))))");
+  TA_INT_EQ(run_int(&rt, scope, "(((f 100 0) 2) 3)"), 94);
+
+  // Closures keep their arguments alive through a collection.
+  run(&rt, scope, "(define add5 (adder 5))");
+  lisp_mark(&rt, (lisp_value*)scope);
+  lisp_sweep(&rt);
+  TA_INT_EQ(run_int(&rt, scope, "(add5 10)"), 15);
+  run(&rt, scope, "(define twice (lambda (f x) (f (f x))))");
+  TA_INT_EQ(run_int(&rt, scope, "(twice add5 1)"), 11);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_globals(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  run(&rt, scope, "(define k 2)");
+  run(&rt, scope, "(define g (lambda (x) (* x k)))");
+  TA_INT_EQ(run_int(&rt, scope, "(g 5)"), 10);
+  run(&rt, scope, "(define k 3)");
+  TA_INT_EQ(run_int(&rt, scope, "(g 5)"), 15);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_global_cache(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  // Lookups which fail aren't cached, so a later definition is seen.
+  run(&rt, scope, "(define g (lambda (x) (h x)))");
+  TA_PTR_EQ(run(&rt, scope, "(g 1)")->type, type_error);
+  run(&rt, scope, "(define h (lambda (x) (+ x 1)))");
+  TA_INT_EQ(run_int(&rt, scope, "(g 1)"), 2);
+
+  // Rebinding a builtin, or binding its name in an inner scope, is seen too.
+  run(&rt, scope, "(define + -)");
+  TA_INT_EQ(run_int(&rt, scope, "(g 1)"), 0);
+  lisp_scope *inner = (lisp_scope*)lisp_new(&rt, type_scope);
+  inner->up = scope;
+  run(&rt, inner, "(define f (lambda (x) (* x 2)))");
+  TA_INT_EQ(run_int(&rt, inner, "(f 3)"), 6);
+  lisp_scope_bind(inner, lisp_symbol_new(&rt, "*"),
+                  lisp_scope_lookup(&rt, scope, lisp_symbol_new(&rt, "-")));
+  TA_INT_EQ(run_int(&rt, inner, "(f 3)"), 1);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static lisp_value *native_pick(lisp_runtime *rt, int argc, lisp_value **argv)
+{
+  int i = ((lisp_integer*)argv[0])->x;
+  if (i < 1 || i >= argc) {
+    return (lisp_value*) lisp_error_new(rt, "index out of range");
+  }
+  return argv[i];
+}
+
+static int test_natives(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+  lisp_scope_add_native(&rt, scope, "pick", native_pick, "d*...");
+  lisp_builtin *pick = (lisp_builtin*)
+    lisp_scope_lookup(&rt, scope, lisp_symbol_new(&rt, "pick"));
+  TA_INT_EQ(pick->nargs, 1);
+  TEST_ASSERT(pick->variadic);
+  TA_PTR_EQ(pick->types[0], type_integer);
+  TA_PTR_EQ(pick->rest, NULL);
+
+  // From the interpreter, from bytecode, and through map.
+  TA_INT_EQ(run_int(&rt, scope, "(pick 2 10 20 30)"), 20);
+  run(&rt, scope, "(define f (lambda (i) (pick i 'a 5 'b)))");
+  TA_INT_EQ(run_int(&rt, scope, "(f 2)"), 5);
+  TA_INT_EQ(run_int(&rt, scope, "(car (cdr (map pick '(1 2) '(4 5) '(6 7))))"),
+            7);
+
+  // Signatures are checked before the builtin is called.
+  lisp_value *v = run(&rt, scope, "(pick)");
+  TA_PTR_EQ(v->type, type_error);
+  TA_STR_EQ(((lisp_error*)v)->message, "wrong number of arguments to pick");
+  v = run(&rt, scope, "(f 'x)");
+  TA_PTR_EQ(v->type, type_error);
+  TA_STR_EQ(((lisp_error*)v)->message, "argument 1 of pick must be integer");
+  v = run(&rt, scope, "(< 1 2 3)");
+  TA_STR_EQ(((lisp_error*)v)->message, "wrong number of arguments to <");
+  v = run(&rt, scope, "(+ 1 '(2))");
+  TA_STR_EQ(((lisp_error*)v)->message, "argument 2 of + must be integer");
+  TA_INT_EQ(run_int(&rt, scope, "(+)"), 0);
+  TA_INT_EQ(run_int(&rt, scope, "(- 4)"), -4);
+  TA_PTR_EQ(run(&rt, scope, "(-)")->type, type_error);
+  TA_SIZE_EQ(rt.nstack, 0);
+
+  // Natives are still functions when cloned, not special forms.
+  lisp_scope *copy = lisp_scope_clone(&rt, scope);
+  TA_INT_EQ(run_int(&rt, copy, "(f 2)"), 5);
+  TEST_ASSERT(!lisp_special_form_p((lisp_value*)pick));
+  TEST_ASSERT(lisp_special_form_p(
+    lisp_scope_lookup(&rt, scope, lisp_symbol_new(&rt, "if"))));
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_interning(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  lisp_symbol *a = lisp_symbol_new(&rt, "abc");
+  TA_PTR_EQ(lisp_symbol_new(&rt, "abc"), a);
+  TA_PTR_NE(lisp_symbol_new(&rt, "abd"), a);
+  lisp_list *l = (lisp_list*) lisp_parse(&rt, "(abc abc)");
+  TA_PTR_EQ(l->left, (lisp_value*)a);
+  TA_PTR_EQ(((lisp_list*)l->right)->left, (lisp_value*)a);
+  TA_PTR_EQ(lisp_parse(&rt, "car"), (lisp_value*)lisp_symbol_new(&rt, "car"));
+
+  // Collected symbols leave the table, and their names can be reused.
+  lisp_mark(&rt, (lisp_value*)scope);
+  lisp_sweep(&rt);
+  TEST_ASSERT(!ht_contains(&rt.symbols, PTR("abc")));
+  TEST_ASSERT(ht_contains(&rt.symbols, PTR("car")));
+  a = lisp_symbol_new(&rt, "abc");
+  TEST_ASSERT(strcmp(a->sym, "abc") == 0);
+  TA_PTR_EQ(lisp_symbol_new(&rt, "abc"), a);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static size_t count_objects(lisp_runtime *rt)
+{
+  size_t n = 0;
+  for (lisp_value *v = rt->head; v; v = v->next) {
+    n++;
+  }
+  return n;
+}
+
+static int test_generations(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+  lisp_mark(&rt, (lisp_value*)scope);
+  lisp_sweep(&rt);
+  size_t base = count_objects(&rt);
+  TA_SIZE_EQ(rt.nold + 1, base); // all but nil
+  TA_PTR_EQ(rt.young, rt.tail);
+
+  // Garbage made since the last collection goes in a minor one.
+  run(&rt, scope, "(+ 1 2 3)");
+  TA_SIZE_GT(count_objects(&rt), base);
+  lisp_mark_young(&rt, (lisp_value*)scope);
+  lisp_sweep_young(&rt);
+  TA_SIZE_EQ(count_objects(&rt), base);
+
+  // Young values bound in an old scope survive it, and become old.
+  run(&rt, scope, "(define l '(1 2 3))");
+  lisp_mark_young(&rt, (lisp_value*)scope);
+  lisp_sweep_young(&rt);
+  lisp_list *l = (lisp_list*) run(&rt, scope, "l");
+  TA_INT_EQ(lisp_list_length(l), 3);
+  TA_INT_EQ(((lisp_integer*)l->left)->x, 1);
+  TA_CHAR_EQ(l->left->gen, GC_OLD);
+  size_t withl = count_objects(&rt);
+  TA_SIZE_GT(withl, base);
+
+  // Old garbage stays until a major collection.
+  run(&rt, scope, "(define l 0)");
+  lisp_mark_young(&rt, (lisp_value*)scope);
+  lisp_sweep_young(&rt);
+  TA_SIZE_GE(count_objects(&rt), withl);
+  lisp_mark(&rt, (lisp_value*)scope);
+  lisp_sweep(&rt);
+  TA_SIZE_LT(count_objects(&rt), withl);
+  TA_INT_EQ(run_int(&rt, scope, "l"), 0);
+
+  // lisp_collect() does a major collection once the old generation doubles.
+  rt.majorat = rt.nold;
+  run(&rt, scope, "(define l '(4 5))");
+  lisp_collect(&rt, (lisp_value*)scope);
+  TEST_ASSERT(rt.majorat > rt.nold);
+  lisp_collect(&rt, (lisp_value*)scope);
+  l = (lisp_list*) run(&rt, scope, "l");
+  TA_INT_EQ(lisp_list_length(l), 2);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_pools(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+
+  // Objects of a size class come out of the same slab, one after another.
+  char *a = lisp_alloc(&rt, 20);
+  char *b = lisp_alloc(&rt, 32);
+  TA_PTR_EQ(b, a + 32);
+  TA_PTR_EQ(rt.pools[0].slabs, NULL);
+
+  // Freed ones are handed out again, zeroed.
+  memset(a, 'x', 20);
+  lisp_release(&rt, a, 20);
+  TA_PTR_EQ(lisp_alloc(&rt, 17), a);
+  TA_CHAR_EQ(a[0], 0);
+  TA_CHAR_EQ(a[16], 0);
+
+  // Big ones come from malloc.
+  char *big = lisp_alloc(&rt, LISP_POOL_GRAIN * LISP_POOL_CLASSES + 1);
+  TA_CHAR_EQ(big[0], 0);
+  lisp_release(&rt, big, LISP_POOL_GRAIN * LISP_POOL_CLASSES + 1);
+
+  // Swept objects go back to their pools.
+  lisp_value *v = lisp_new(&rt, type_integer);
+  lisp_sweep(&rt);
+  TA_PTR_EQ(lisp_new(&rt, type_integer), v);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_smallints(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  lisp_integer *five = lisp_integer_new(&rt, 5);
+  TA_INT_EQ(five->x, 5);
+  TA_PTR_EQ(lisp_integer_new(&rt, 5), five);
+  TA_PTR_EQ(run(&rt, scope, "(+ 2 3)"), (lisp_value*)five);
+  TA_PTR_EQ(run(&rt, scope, "5"), (lisp_value*)five);
+  TA_PTR_EQ(run(&rt, scope, "(< 1 2)"), (lisp_value*)lisp_integer_new(&rt, 1));
+  TA_PTR_NE(lisp_integer_new(&rt, 100000), lisp_integer_new(&rt, 100000));
+  TA_INT_EQ(lisp_integer_new(&rt, LISP_SMALLINT_MIN - 1)->x,
+            LISP_SMALLINT_MIN - 1);
+
+  // Small integers aren't in the object list, and outlive collections.
+  size_t before = count_objects(&rt);
+  lisp_integer_new(&rt, 7);
+  TA_SIZE_EQ(count_objects(&rt), before);
+  lisp_mark(&rt, (lisp_value*)scope);
+  lisp_sweep(&rt);
+  lisp_mark(&rt, (lisp_value*)scope);
+  lisp_sweep(&rt);
+  TA_INT_EQ(five->x, 5);
+  TA_INT_EQ(run_int(&rt, scope, "(* 5 (- 3 1))"), 10);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_safepoints(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  // Collect at every call, so that anything left unrooted is freed in use.
+  rt.collectat = 0;
+  run(&rt, scope, "(define fact (lambda (n) (if (= n 0) 1 (* n (fact (- n 1))))))");
+  TA_INT_EQ(run_int(&rt, scope, "(fact 10)"), 3628800);
+  run(&rt, scope, "(define ifact (lambda (n) (if (= n 0) 1 (* n (ifact (eval (- n 1)))))))");
+  TA_INT_EQ(run_int(&rt, scope, "(ifact 10)"), 3628800);
+  TA_INT_EQ(run_int(&rt, scope, "(+ (ifact 7) (ifact 7))"), 10080);
+  run(&rt, scope, "(define adder (lambda (n) (lambda (x) (+ x n))))");
+  TA_INT_EQ(run_int(&rt, scope, "((adder 5000) 10)"), 5010);
+  TA_INT_EQ(run_int(&rt, scope, "(car (cdr (map (lambda (x) (* x 1000)) (quote (1 2 3)))))"), 2000);
+  TA_INT_EQ(run_int(&rt, scope, "(reduce (lambda (a b) (+ a (fact b))) (quote (1 2 3 4)))"), 33);
+  TA_SIZE_EQ(rt.nroots, 0);
+
+  // A long loop doesn't keep its garbage until it's done.
+  rt.collectat = 1000;
+  run(&rt, scope, "(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 2)))))");
+  TA_INT_EQ(run_int(&rt, scope, "(loop 100000 0)"), 200000);
+  TA_SIZE_LT(count_objects(&rt), 5000);
+  TA_SIZE_EQ(rt.nroots, 0);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_containers(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  run(&rt, scope, "(define v (vector 1 2 3))");
+  TA_INT_EQ(run_int(&rt, scope, "(vector-ref v 1)"), 2);
+  TA_INT_EQ(run_int(&rt, scope, "(vector-length (vector-push! v 4))"), 4);
+  TA_PTR_EQ(run(&rt, scope, "(vector-ref v 4)")->type, type_error);
+  TA_PTR_EQ(run(&rt, scope, "(vector-set! v -1 0)")->type, type_error);
+
+  run(&rt, scope, "(define m (hashmap \"a\" 1 'b 2 3 4))");
+  TA_INT_EQ(run_int(&rt, scope, "(hashmap-get m \"a\")"), 1);
+  TA_INT_EQ(run_int(&rt, scope, "(hashmap-get m 'b)"), 2);
+  TA_INT_EQ(run_int(&rt, scope, "(hashmap-get m 3)"), 4);
+  run(&rt, scope, "(hashmap-set! m \"a\" 10)");
+  TA_INT_EQ(run_int(&rt, scope, "(hashmap-get m \"a\")"), 10);
+  TA_INT_EQ(run_int(&rt, scope, "(hashmap-length m)"), 3);
+  run(&rt, scope, "(hashmap-remove! m 'b)");
+  TA_INT_EQ(run_int(&rt, scope, "(hashmap-has? m 'b)"), 0);
+  TA_PTR_EQ(run(&rt, scope, "(hashmap-get m 'b)")->type, type_error);
+  TA_PTR_EQ(run(&rt, scope, "(hashmap 1)")->type, type_error);
+
+  // Young values stored in old containers survive a minor collection.
+  lisp_collect(&rt, (lisp_value*)scope);
+  run(&rt, scope, "(vector-set! v 0 (+ 5000 1))");
+  run(&rt, scope, "(hashmap-set! m (+ 5000 2) (+ 5000 3))");
+  lisp_collect(&rt, (lisp_value*)scope);
+  TA_INT_EQ(run_int(&rt, scope, "(vector-ref v 0)"), 5001);
+  TA_INT_EQ(run_int(&rt, scope, "(hashmap-get m 5002)"), 5003);
+  lisp_mark(&rt, (lisp_value*)scope);
+  lisp_sweep(&rt);
+  TA_INT_EQ(run_int(&rt, scope, "(vector-ref v 0)"), 5001);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_map_reduce(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+
+  TA_INT_EQ(run_int(&rt, scope, "(car (cdr (map + '(1 2 3) '(10 20))))"), 22);
+  TA_INT_EQ(run_int(&rt, scope, "(null? (cdr (cdr (map + '(1 2 3) '(10 20)))))"), 1);
+  TA_INT_EQ(run_int(&rt, scope, "(null? (map car '()))"), 1);
+  TA_INT_EQ(run_int(&rt, scope, "(reduce + 5 '(1 2 3))"), 11);
+  TA_PTR_EQ(run(&rt, scope, "(car (map if '(1)))")->type, type_error);
+  TA_PTR_EQ(run(&rt, scope, "(map car)")->type, type_error);
+
+  // Map and reduce are plain functions now, so lambdas using them compile.
+  run(&rt, scope, "(define sum (lambda (l) (reduce (lambda (a b) (+ a b)) 0 l)))");
+  TA_INT_EQ(run_int(&rt, scope, "(sum (map (lambda (x) (* x x)) '(1 2 3)))"), 14);
+  TEST_ASSERT(lookup_lambda(&rt, scope, "sum")->bytecode != NULL);
+
+  // Mapping a compiled lambda only makes the list of results.
+  rt.collectat = (size_t)-1;
+  run(&rt, scope, "(define range (lambda (n acc) (if (= n 0) acc (range (- n 1) (cons n acc)))))");
+  run(&rt, scope, "(define big (range 1000 '()))");
+  run(&rt, scope, "(define id (lambda (x) x))");
+  run(&rt, scope, "(map id '(1))");
+  size_t before = count_objects(&rt);
+  run(&rt, scope, "(map id big)");
+  TA_SIZE_LT(count_objects(&rt) - before, 1100);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static void feed(lisp_reader *reader, const char *text)
+{
+  lisp_reader_feed(reader, text, strlen(text));
+}
+
+static int test_reader(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+  lisp_reader reader;
+  lisp_value *v;
+
+  // Forms split across chunks are read once they are complete.
+  lisp_reader_init(&reader, NULL);
+  feed(&reader, "(define x");
+  TEST_ASSERT(lisp_read(&rt, &reader) == NULL);
+  feed(&reader, " 5) (+ x");
+  v = lisp_read(&rt, &reader);
+  TEST_ASSERT(v != NULL);
+  lisp_eval(&rt, scope, v);
+  TEST_ASSERT(lisp_read(&rt, &reader) == NULL);
+  feed(&reader, " 1) \"a)\\\"b\" 'c 42");
+  v = lisp_eval(&rt, scope, lisp_read(&rt, &reader));
+  TA_INT_EQ(((lisp_integer*)v)->x, 6);
+  v = lisp_read(&rt, &reader);
+  TA_PTR_EQ(v->type, type_string);
+  TA_STR_EQ(((lisp_string*)v)->s, "a)\"b");
+  v = lisp_eval(&rt, scope, lisp_read(&rt, &reader));
+  TA_PTR_EQ(v, (lisp_value*)lisp_symbol_new(&rt, "c"));
+  // The last atom might continue in the next chunk.
+  TEST_ASSERT(lisp_read(&rt, &reader) == NULL);
+  lisp_reader_end(&reader);
+  v = lisp_read(&rt, &reader);
+  TA_INT_EQ(((lisp_integer*)v)->x, 42);
+  TEST_ASSERT(lisp_read(&rt, &reader) == NULL);
+  lisp_reader_destroy(&reader);
+
+  // Files are read in chunks, so forms can be longer than one.
+  FILE *f = tmpfile();
+  fprintf(f, "(define sum (lambda (l) (reduce + 0 l)))\n(sum '(");
+  for (int i = 1; i <= 2000; i++) {
+    fprintf(f, " %d", i);
+  }
+  fprintf(f, "))\n(sum '(1 2");
+  rewind(f);
+  lisp_reader_init(&reader, f);
+  lisp_eval(&rt, scope, lisp_read(&rt, &reader));
+  v = lisp_eval(&rt, scope, lisp_read(&rt, &reader));
+  TA_INT_EQ(((lisp_integer*)v)->x, 2001000);
+  TA_PTR_EQ(lisp_read(&rt, &reader)->type, type_error);
+  TEST_ASSERT(lisp_read(&rt, &reader) == NULL);
+  lisp_reader_destroy(&reader);
+  fclose(f);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+struct clone_worker {
+  lisp_scope *from;
+  int fib, item, cycle;
+  bool own_closure;
+};
+
+static void *clone_worker(void *arg)
+{
+  struct clone_worker *w = arg;
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = lisp_scope_clone(&rt, w->from);
+  w->fib = run_int(&rt, scope, "(fib 15)");
+  w->item = run_int(&rt, scope, "(vector-ref v 1)");
+  w->cycle = run_int(&rt, scope, "(vector-ref (vector-ref v 3) 0)");
+  w->own_closure = lookup_lambda(&rt, scope, "fib")->closure == scope;
+  lisp_destroy(&rt);
+  return NULL;
+}
+
+static int test_clone(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+  run(&rt, scope, "(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))");
+  run(&rt, scope, "(define v (vector 1 2000 3))");
+  run(&rt, scope, "(vector-push! v v)");
+
+  // Each thread has its own runtime, made from a copy of the same scope.
+  struct clone_worker workers[4];
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++) {
+    workers[i].from = scope;
+    pthread_create(&threads[i], NULL, clone_worker, &workers[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+    TA_INT_EQ(workers[i].fib, 610);
+    TA_INT_EQ(workers[i].item, 2000);
+    TA_INT_EQ(workers[i].cycle, 1);
+    TEST_ASSERT(workers[i].own_closure);
+  }
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static lisp_profile_entry *profiled(lisp_runtime *rt, lisp_value *callable)
+{
+  smb_status status = SMB_SUCCESS;
+  DATA key = callable->type == type_builtin ?
+    PTR(((lisp_builtin*)callable)->name) : PTR(((lisp_lambda*)callable)->code);
+  lisp_profile_entry *e = ht_get(&rt->profile->calls, key, &status).data_ptr;
+  return status == SMB_SUCCESS ? e : NULL;
+}
+
+static int test_profile(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+  run(&rt, scope, "(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))");
+  run(&rt, scope, "(define setter (lambda (n) (define z n)))");
+  TA_PTR_EQ(rt.profile, NULL);
+
+  lisp_profile_start(&rt);
+  TA_INT_EQ(run_int(&rt, scope, "(fib 10)"), 55);
+  TA_INT_EQ(run_int(&rt, scope, "(setter 3)"), 3);
+  TA_INT_EQ(run_int(&rt, scope, "((lambda (x) (* x 2)) 4)"), 8);
+
+  lisp_profile_entry *fib = profiled(&rt, (lisp_value*)lookup_lambda(&rt, scope, "fib"));
+  TA_PTR_NE(fib, NULL);
+  TA_SIZE_EQ(fib->calls, 177);
+  TA_INT_EQ(fib->active, 0);
+  lisp_value *plus = run(&rt, scope, "+");
+  TA_SIZE_EQ(profiled(&rt, plus)->calls, 88);
+  lisp_profile_entry *setter = profiled(&rt, (lisp_value*)lookup_lambda(&rt, scope, "setter"));
+  TA_SIZE_EQ(setter->calls, 1);
+  TA_INT_EQ(setter->active, 0);
+  smb_status status = SMB_SUCCESS;
+  TEST_ASSERT(ht_get(&rt.profile->allocs, PTR(type_list), &status).data_llint > 0);
+
+  // The anonymous lambda's code outlives it, for the report.
+  size_t minor = rt.profile->minor;
+  lisp_collect(&rt, (lisp_value*)scope);
+  lisp_collect(&rt, (lisp_value*)scope);
+  TA_SIZE_EQ(rt.profile->minor, minor + 2);
+  TA_SIZE_EQ(rt.profile->major, 0);
+  TA_SIZE_EQ(rt.profile->lastsurvivors, 0);
+  TEST_ASSERT(rt.profile->survivors > 0);
+
+  FILE *f = tmpfile();
+  lisp_profile_report(&rt, f);
+  char report[4096];
+  rewind(f);
+  report[fread(report, 1, sizeof(report) - 1, f)] = '\0';
+  fclose(f);
+  TEST_ASSERT(strstr(report, "(lambda (n ) (if") != NULL);
+  TEST_ASSERT(strstr(report, "(lambda (x ) (* x 2 ))") != NULL);
+  TEST_ASSERT(strstr(report, "minor, 0 major") != NULL);
+
+  lisp_profile_stop(&rt);
+  TA_PTR_EQ(rt.profile, NULL);
+  lisp_destroy(&rt);
+  return 0;
+}
+
+static int test_errors(void)
+{
+  lisp_runtime rt;
+  lisp_init(&rt);
+  lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
+  lisp_scope_populate_builtins(&rt, scope);
+  lisp_value *v;
+
+  run(&rt, scope, "(define h (lambda (x y) (+ x y)))");
+  v = run(&rt, scope, "(h 1)");
+  TA_PTR_EQ(v->type, type_error);
+  TEST_ASSERT(strcmp(((lisp_error*)v)->message, "not enough arguments") == 0);
+  v = run(&rt, scope, "(h 1 2 3)");
+  TA_PTR_EQ(v->type, type_error);
+  TEST_ASSERT(strcmp(((lisp_error*)v)->message, "too many arguments") == 0);
+
+  run(&rt, scope, "(define bad (lambda (x) (h x)))");
+  v = run(&rt, scope, "(bad 1)");
+  TA_PTR_EQ(v->type, type_error);
+  run(&rt, scope, "(define notfn (lambda (x) (x 1)))");
+  v = run(&rt, scope, "(notfn 1)");
+  TA_PTR_EQ(v->type, type_error);
+  TA_SIZE_EQ(rt.nframes, 0);
+  TA_SIZE_EQ(rt.nstack, 0);
+
+  lisp_destroy(&rt);
+  return 0;
+}
+
+void lisp_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/lisptest.c");
+
+  smb_ut_test *arithmetic = su_create_test("arithmetic", test_arithmetic);
+  su_add_test(group, arithmetic);
+
+  smb_ut_test *if_ = su_create_test("if", test_if);
+  su_add_test(group, if_);
+
+  smb_ut_test *recursion = su_create_test("recursion", test_recursion);
+  su_add_test(group, recursion);
+
+  smb_ut_test *tail_calls = su_create_test("tail_calls", test_tail_calls);
+  su_add_test(group, tail_calls);
+
+  smb_ut_test *interpreted = su_create_test("interpreted", test_interpreted);
+  su_add_test(group, interpreted);
+
+  smb_ut_test *closures = su_create_test("closures", test_closures);
+  su_add_test(group, closures);
+
+  smb_ut_test *globals = su_create_test("globals", test_globals);
+  su_add_test(group, globals);
+
+  smb_ut_test *global_cache = su_create_test("global_cache", test_global_cache);
+  su_add_test(group, global_cache);
+
+  smb_ut_test *natives = su_create_test("natives", test_natives);
+  su_add_test(group, natives);
+
+  smb_ut_test *interning = su_create_test("interning", test_interning);
+  su_add_test(group, interning);
+
+  smb_ut_test *generations = su_create_test("generations", test_generations);
+  su_add_test(group, generations);
+
+  smb_ut_test *pools = su_create_test("pools", test_pools);
+  su_add_test(group, pools);
+
+  smb_ut_test *smallints = su_create_test("smallints", test_smallints);
+  su_add_test(group, smallints);
+
+  smb_ut_test *safepoints = su_create_test("safepoints", test_safepoints);
+  su_add_test(group, safepoints);
+
+  smb_ut_test *containers = su_create_test("containers", test_containers);
+  su_add_test(group, containers);
+
+  smb_ut_test *map_reduce = su_create_test("map_reduce", test_map_reduce);
+  su_add_test(group, map_reduce);
+
+  smb_ut_test *reader = su_create_test("reader", test_reader);
+  su_add_test(group, reader);
+
+  smb_ut_test *clone = su_create_test("clone", test_clone);
+  su_add_test(group, clone);
+
+  smb_ut_test *profile = su_create_test("profile", test_profile);
+  su_add_test(group, profile);
+
+  smb_ut_test *errors = su_create_test("errors", test_errors);
+  su_add_test(group, errors);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -13,7 +13,9 @@
 
 *******************************************************************************/
 
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "libstephen/log.h"
 #include "libstephen/ut.h"
@@ -86,6 +88,207 @@ int test_too_many_levels(void)
   return 0;
 }
 
+/*
+  Count the lines in a file, and check that each looks like a log message.
+ */
+static int count_lines(FILE *f)
+{
+  char line[256];
+  int count = 0;
+  rewind(f);
+  while (fgets(line, sizeof(line), f)) {
+    if (!strstr(line, "INFO: message")) {
+      return -1;
+    }
+    count++;
+  }
+  return count;
+}
+
+#define ASYNC_THREADS 4
+#define ASYNC_MESSAGES 500
+
+static void *log_messages(void *arg)
+{
+  smb_logger *logger = arg;
+  for (int i = 0; i < ASYNC_MESSAGES; i++) {
+    LINFO(logger, "message %d", i);
+  }
+  return NULL;
+}
+
+int test_async(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_logger *logger = sl_create();
+  pthread_t threads[ASYNC_THREADS];
+  FILE *info = tmpfile(), *error = tmpfile();
+  int i;
+
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_INFO, .dst=info}, &status);
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_ERROR, .dst=error}, &status);
+  sl_start_async(logger, (smb_logasync){.capacity=16, .policy=SL_ASYNC_BLOCK,
+                                        .flush_bytes=4096, .flush_ms=5},
+                 &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+
+  LINFO(logger, "message before threads");
+  sl_flush(logger);
+  TA_INT_EQ(count_lines(info), 1);
+  fseek(info, 0, SEEK_END);
+
+  for (i = 0; i < ASYNC_THREADS; i++) {
+    pthread_create(&threads[i], NULL, log_messages, logger);
+  }
+  for (i = 0; i < ASYNC_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  sl_flush(logger);
+  TA_INT_EQ(count_lines(info), 1 + ASYNC_THREADS * ASYNC_MESSAGES);
+  TA_INT_EQ(count_lines(error), 0);
+  TA_INT_EQ(sl_dropped(logger), 0);
+
+  // Stopping writes out whatever is left.
+  fseek(info, 0, SEEK_END);
+  LINFO(logger, "message after threads");
+  sl_delete(logger);
+  TA_INT_EQ(count_lines(info), 2 + ASYNC_THREADS * ASYNC_MESSAGES);
+
+  fclose(info);
+  fclose(error);
+  return 0;
+}
+
+int test_async_drop(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_logger *logger = sl_create();
+  FILE *info = tmpfile();
+  int i;
+
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_INFO, .dst=info}, &status);
+  sl_start_async(logger, (smb_logasync){.capacity=2, .policy=SL_ASYNC_DROP,
+                                        .flush_bytes=1 << 20, .flush_ms=1000},
+                 &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  for (i = 0; i < ASYNC_MESSAGES; i++) {
+    LINFO(logger, "message %d", i);
+  }
+  sl_flush(logger);
+  TEST_ASSERT(sl_dropped(logger) > 0);
+  TA_INT_EQ(count_lines(info) + sl_dropped(logger), ASYNC_MESSAGES);
+  sl_delete(logger);
+  fclose(info);
+  return 0;
+}
+
+static int evaluated;
+
+static int count_evaluation(void)
+{
+  return evaluated++;
+}
+
+int test_enabled(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_logger *logger = sl_create();
+  FILE *f = tmpfile();
+
+  TEST_ASSERT(!sl_enabled(logger, LEVEL_CRITICAL));
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_WARNING, .dst=f}, &status);
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_ERROR, .dst=f}, &status);
+  TEST_ASSERT(!sl_enabled(logger, LEVEL_INFO));
+  TEST_ASSERT(sl_enabled(logger, LEVEL_WARNING));
+
+  // Arguments of skipped messages aren't evaluated.
+  evaluated = 0;
+  LINFO(logger, "message %d", count_evaluation());
+  TA_INT_EQ(evaluated, 0);
+  LWARNING(logger, "message %d", count_evaluation());
+  TA_INT_EQ(evaluated, 1);
+
+  sl_set_level(logger, LEVEL_DEBUG);
+  TEST_ASSERT(sl_enabled(logger, LEVEL_DEBUG));
+  sl_clear_handlers(logger);
+  TEST_ASSERT(!sl_enabled(logger, LEVEL_CRITICAL));
+
+  sl_delete(logger);
+  fclose(f);
+  return 0;
+}
+
+/*
+  LOG() uses SMB_LOG_MIN_LEVEL where it's expanded, so it can be raised here.
+ */
+#undef SMB_LOG_MIN_LEVEL
+#define SMB_LOG_MIN_LEVEL LEVEL_INFO
+
+int test_compiled_out(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_logger *logger = sl_create();
+  FILE *f = tmpfile();
+
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_NOTSET, .dst=f}, &status);
+  evaluated = 0;
+  LDEBUG(logger, "message %d", count_evaluation());
+  TA_INT_EQ(evaluated, 0);
+  LINFO(logger, "message %d", count_evaluation());
+  TA_INT_EQ(evaluated, 1);
+  TA_INT_EQ(count_lines(f), 1);
+
+  sl_delete(logger);
+  fclose(f);
+  return 0;
+}
+
+#undef SMB_LOG_MIN_LEVEL
+#define SMB_LOG_MIN_LEVEL LEVEL_NOTSET
+
+static void *log_unnamed_level(void *arg)
+{
+  smb_logger *logger = arg;
+  for (int i = 0; i < ASYNC_MESSAGES; i++) {
+    LOG(logger, LEVEL_INFO + 1 + i % 8, "message %d", i);
+  }
+  return NULL;
+}
+
+int test_concurrent(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_logger *logger = sl_create();
+  pthread_t threads[ASYNC_THREADS];
+  FILE *f = tmpfile();
+  char line[256];
+  int i, count = 0;
+
+  sl_add_handler(logger, (smb_loghandler){.level=LEVEL_INFO, .dst=f}, &status);
+  for (i = 0; i < ASYNC_THREADS; i++) {
+    pthread_create(&threads[i], NULL, log_unnamed_level, logger);
+  }
+  for (i = 0; i < ASYNC_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // Every line is whole, with the level that thread gave it.
+  rewind(f);
+  while (fgets(line, sizeof(line), f)) {
+    int level, n;
+    char *msg = strstr(line, "(log_unnamed_level) ");
+    TEST_ASSERT(msg != NULL);
+    TA_INT_EQ(sscanf(msg, "(log_unnamed_level) %d: message %d", &level, &n), 2);
+    TA_INT_EQ(level, LEVEL_INFO + 1 + n % 8);
+    count++;
+  }
+  TA_INT_EQ(count, ASYNC_THREADS * ASYNC_MESSAGES);
+
+  sl_delete(logger);
+  fclose(f);
+  return 0;
+}
+
 void log_test(void)
 {
   smb_ut_group *group = su_create_test_group("test/logtest.c");
@@ -99,6 +302,21 @@ void log_test(void)
   smb_ut_test *too_many_levels = su_create_test("too_many_levels", test_too_many_levels);
   su_add_test(group, too_many_levels);
 
+  smb_ut_test *async = su_create_test("async", test_async);
+  su_add_test(group, async);
+
+  smb_ut_test *async_drop = su_create_test("async_drop", test_async_drop);
+  su_add_test(group, async_drop);
+
+  smb_ut_test *enabled = su_create_test("enabled", test_enabled);
+  su_add_test(group, enabled);
+
+  smb_ut_test *compiled_out = su_create_test("compiled_out", test_compiled_out);
+  su_add_test(group, compiled_out);
+
+  smb_ut_test *concurrent = su_create_test("concurrent", test_concurrent);
+  su_add_test(group, concurrent);
+
   printf("ALERT: Some logging tests are manual!\n");
   su_run_group(group);
   su_delete_group(group);
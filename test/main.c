@@ -14,34 +14,61 @@
 *******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "libstephen/base.h"
 #include "libstephen/log.h"
+#include "libstephen/ut.h"
 #include "tests.h"
 
 /**
-   Main test function
+   The test suites, in the order they run.
+ */
+static const smb_ut_suite suites[] = {
+  {"linked_list", linked_list_test},
+  {"array_list", array_list_test},
+  {"hash_table", hash_table_test},
+  {"hta", hta_test},
+  {"hts", hts_test},
+  {"htc", htc_test},
+  {"bit_field", bit_field_test},
+  {"iter", iter_test},
+  {"list", list_test},
+  {"args", args_test},
+  {"charbuf", charbuf_test},
+  {"string", string_test},
+  {"parse", parse_test},
+  {"lex", lex_test},
+  {"codegen", codegen_test},
+  {"pike", pike_test},
+  {"cache", cache_test},
+  {"log", log_test},
+  {"binlog", binlog_test},
+  {"roar", roar_test},
+  {"bloom", bloom_test},
+  {"alloc", alloc_test},
+  {"arena", arena_test},
+  {"bench", bench_test},
+  {"ringbuf", ringbuf_test},
+  {"lisp", lisp_test},
+};
+
+/**
+   Main test function.  "-j N" runs the suites in N worker processes (0 for one
+   per CPU).  By default they're run one after another in this process.
  */
 int main(int argc, char ** argv)
 {
-  (void) argc; // unused
-  (void) argv; // unused
+  int jobs = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+    } else if (strncmp(argv[i], "-j", 2) == 0) {
+      jobs = atoi(argv[i] + 2);
+    }
+  }
   sl_set_level(NULL, LEVEL_INFO);
-  linked_list_test();
-  array_list_test();
-  hash_table_test();
-  hta_test();
-  bit_field_test();
-  iter_test();
-  list_test();
-  args_test();
-  charbuf_test();
-  string_test();
-  parse_test();
-  lex_test();
-  codegen_test();
-  pike_test();
-  log_test();
-  ringbuf_test();
+  return su_run_parallel(suites, sizeof(suites) / sizeof(suites[0]), jobs) != 0;
   // return args_test_main(argc, argv);
 }
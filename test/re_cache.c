@@ -0,0 +1,115 @@
+/***************************************************************************//**
+
+  @file         re_cache.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Regex cache tests.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <stdio.h>
+
+#include "libstephen/ut.h"
+#include "tests.h"
+
+#include "libstephen/re.h"
+#include "libstephen/re_internals.h"
+
+static int test_hit(void)
+{
+  RegexCache *c = recachenew(1024 * 1024);
+  char pattern[] = "(a|b)+c";
+
+  const Regex *first = recacheget(c, pattern);
+  TA_INT_EQ(reexec(*first, "abac", NULL), 4);
+
+  // Asking again gives the same regex, even from a different string.
+  char copy[sizeof(pattern)];
+  snprintf(copy, sizeof(copy), "%s", pattern);
+  const Regex *second = recacheget(c, copy);
+  TA_PTR_EQ(second, first);
+  const Regex *other = recacheget(c, "x");
+  TA_PTR_NE(other, first);
+
+  recacherelease(c, other);
+  recacherelease(c, first);
+  recacherelease(c, second);
+  recachefree(c);
+  return 0;
+}
+
+static int test_evict(void)
+{
+  // The budget has room for about one small regex.
+  RegexCache *c = recachenew(1);
+  const Regex *a = recacheget(c, "a");
+  const Regex *b = recacheget(c, "b");
+
+  // Neither can be evicted while it is in use.
+  TA_INT_EQ(reexec(*a, "a", NULL), 1);
+  TA_INT_EQ(reexec(*b, "b", NULL), 1);
+  TA_SIZE_GT(recacheused(c), 1);
+
+  // Released regexes are evicted, least recently used first.
+  recacherelease(c, a);
+  recacherelease(c, b);
+  TA_SIZE_EQ(recacheused(c), 0);
+
+  recachefree(c);
+  return 0;
+}
+
+static int test_lru(void)
+{
+  RegexCache *c = recachenew(1024 * 1024);
+  const Regex *a = recacheget(c, "a+");
+  recacherelease(c, a);
+  size_t one = recacheused(c);
+  const Regex *b = recacheget(c, "b+");
+  recacherelease(c, b);
+  size_t two = recacheused(c);
+  recachefree(c);
+
+  // With room for two, using "a+" again makes "b+" the one to evict.
+  c = recachenew(two);
+  a = recacheget(c, "a+");
+  recacherelease(c, a);
+  b = recacheget(c, "b+");
+  recacherelease(c, b);
+  a = recacheget(c, "a+");
+  recacherelease(c, a);
+  const Regex *d = recacheget(c, "d+");
+  recacherelease(c, d);
+  TA_SIZE_LE(recacheused(c), two);
+  TA_SIZE_GE(recacheused(c), one);
+
+  // "a+" is still cached, so it comes back without being compiled again.
+  TA_PTR_EQ(recacheget(c, "a+"), a);
+  recacherelease(c, a);
+
+  recachefree(c);
+  return 0;
+}
+
+void cache_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/re_cache.c");
+
+  smb_ut_test *hit = su_create_test("hit", test_hit);
+  su_add_test(group, hit);
+
+  smb_ut_test *evict = su_create_test("evict", test_evict);
+  su_add_test(group, evict);
+
+  smb_ut_test *lru = su_create_test("lru", test_lru);
+  su_add_test(group, lru);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
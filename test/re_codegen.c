@@ -13,6 +13,7 @@
 
 *******************************************************************************/
 
+#include <stdint.h>
 #include <string.h>
 
 #include "libstephen/ut.h"
@@ -298,6 +299,104 @@ static int test_join_complex(void)
   return 0;
 }
 
+static int test_optimize_jumps(void)
+{
+  // Unoptimized, the first alternative ends with a jump to a jump.
+  Regex r = recomp("a*|b*");
+
+  TA_SIZE_EQ(r.n, 8);
+  TA_INT_EQ(r.i[0].code, Split);
+  TA_PTR_EQ(r.i[0].x, r.i + 1);
+  TA_PTR_EQ(r.i[0].y, r.i + 4);
+  TA_INT_EQ(r.i[1].code, Split);
+  TA_PTR_EQ(r.i[1].x, r.i + 2);
+  TA_PTR_EQ(r.i[1].y, r.i + 7);
+  TA_INT_EQ(r.i[2].code, Char);
+  TA_INT_EQ(r.i[3].code, Jump);
+  TA_PTR_EQ(r.i[3].x, r.i + 1);
+  TA_INT_EQ(r.i[4].code, Split);
+  TA_PTR_EQ(r.i[4].x, r.i + 5);
+  TA_PTR_EQ(r.i[4].y, r.i + 7);
+  TA_INT_EQ(r.i[5].code, Char);
+  TA_INT_EQ(r.i[6].code, Jump);
+  TA_PTR_EQ(r.i[6].x, r.i + 4);
+  TA_INT_EQ(r.i[7].code, Match);
+
+  refree(r);
+  return 0;
+}
+
+static int test_optimize_class(void)
+{
+  Regex r = recomp("[y][^y]");
+
+  TA_SIZE_EQ(r.n, 3);
+  TA_INT_EQ(r.i[0].code, Char);
+  TA_CHAR_EQ(r.i[0].c, 'y');
+  TA_INT_EQ(r.i[1].code, NRange);
+  TA_INT_EQ(r.i[2].code, Match);
+
+  refree(r);
+  return 0;
+}
+
+static int test_optimize_same(void)
+{
+  const char *patterns[] = {
+    "a*|b*", "(a|b|c)*d", "((a|b)|c)d", "(a*)*b", "x*[y]", "(a+?)(a*)"
+  };
+  const char *inputs[] = {"aaa", "bb", "abcd", "cd", "aab", "b", "xxy", ""};
+
+  // Optimized programs give the same matches and captures as unoptimized ones.
+  for (size_t i = 0; i < nelem(patterns); i++) {
+    PTree *tree = reparse(patterns[i]);
+    Regex plain = codegen(tree);
+    Regex opt = recomp(patterns[i]);
+    size_t nsave = renumsaves(plain);
+    TA_SIZE_LE(opt.n, plain.n);
+    TA_SIZE_EQ(renumsaves(opt), nsave);
+    for (size_t j = 0; j < nelem(inputs); j++) {
+      size_t *a, *b;
+      TA_INT_EQ(reexec(opt, inputs[j], &b), reexec(plain, inputs[j], &a));
+      if (a) {
+        TEST_ASSERT(memcmp(a, b, nsave * sizeof(size_t)) == 0);
+      }
+      free(a);
+      free(b);
+    }
+    refree(plain);
+    refree(opt);
+    free_tree(tree);
+  }
+  return 0;
+}
+
+static int test_arena(void)
+{
+  Arena a;
+  arenainit(&a);
+
+  // Allocations are zeroed and aligned, and keep working past the first block.
+  for (size_t i = 1; i < 200; i++) {
+    unsigned char *p = arenaalloc(&a, i * 3);
+    TA_SIZE_EQ((uintptr_t)p % _Alignof(max_align_t), 0);
+    for (size_t j = 0; j < i * 3; j++) {
+      TA_INT_EQ(p[j], 0);
+    }
+    memset(p, 0xff, i * 3);
+  }
+  TA_PTR_NE(a.blocks, NULL);
+
+  // So do allocations larger than a whole block.
+  char *big = arenaalloc(&a, 1024 * 1024);
+  TA_CHAR_EQ(big[1024 * 1024 - 1], 0);
+
+  arenafree(&a);
+  TA_PTR_EQ(a.blocks, NULL);
+  arenafree(&a);
+  return 0;
+}
+
 void codegen_test(void)
 {
   smb_ut_group *group = su_create_test_group("test/codegen.c");
@@ -344,6 +443,18 @@ void codegen_test(void)
   smb_ut_test *join_complex = su_create_test("join_complex", test_join_complex);
   su_add_test(group, join_complex);
 
+  smb_ut_test *optimize_jumps = su_create_test("optimize_jumps", test_optimize_jumps);
+  su_add_test(group, optimize_jumps);
+
+  smb_ut_test *optimize_class = su_create_test("optimize_class", test_optimize_class);
+  su_add_test(group, optimize_class);
+
+  smb_ut_test *optimize_same = su_create_test("optimize_same", test_optimize_same);
+  su_add_test(group, optimize_same);
+
+  smb_ut_test *arena = su_create_test("arena", test_arena);
+  su_add_test(group, arena);
+
   su_run_group(group);
   su_delete_group(group);
 }
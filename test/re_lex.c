@@ -27,6 +27,7 @@ static int test_lex_escapes(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   TA_INT_EQ(l.tok.sym, CharSym);
@@ -79,6 +80,7 @@ static int test_lex_tokens(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   TA_INT_EQ(l.tok.sym, LParen);
@@ -125,6 +127,7 @@ static int test_lex_buffer(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   TA_INT_EQ(l.tok.sym, CharSym);
@@ -180,6 +183,7 @@ static int test_lex_escapes_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   TA_INT_EQ(l.tok.sym, CharSym);
@@ -232,6 +236,7 @@ static int test_lex_tokens_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   TA_INT_EQ(l.tok.sym, LParen);
@@ -278,6 +283,7 @@ static int test_lex_buffer_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   TA_INT_EQ(l.tok.sym, CharSym);
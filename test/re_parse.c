@@ -42,6 +42,7 @@ static int test_TERM_CharSym_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -65,6 +66,7 @@ static int test_TERM_Minus_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -88,6 +90,7 @@ static int test_TERM_Caret_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -111,6 +114,7 @@ static int test_TERM_Dot_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -134,6 +138,7 @@ static int test_TERM_Special_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -157,6 +162,7 @@ static int test_TERM_Subexpr_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -179,6 +185,7 @@ static int test_TERM_Class_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -202,6 +209,7 @@ static int test_TERM_NClass_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -225,6 +233,7 @@ static int test_EXPR_Term_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -248,6 +257,7 @@ static int test_EXPR_Plus_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -272,6 +282,7 @@ static int test_EXPR_PlusQuestion_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -297,6 +308,7 @@ static int test_EXPR_Star_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -321,6 +333,7 @@ static int test_EXPR_StarQuestion_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -346,6 +359,7 @@ static int test_EXPR_Question_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -370,6 +384,7 @@ static int test_EXPR_QuestionQuestion_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -395,6 +410,7 @@ static int test_SUB_Normal_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = SUB(&l);
@@ -417,6 +433,7 @@ static int test_SUB_Concat_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = SUB(&l);
@@ -443,6 +460,7 @@ static int test_REGEX_Normal_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = REGEX(&l);
@@ -466,6 +484,7 @@ static int test_REGEX_Alternate_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = REGEX(&l);
@@ -493,6 +512,7 @@ static int test_CLASS_range_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = CLASS(&l);
@@ -518,6 +538,7 @@ static int test_CLASS_range_range_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = CLASS(&l);
@@ -551,6 +572,7 @@ static int test_CLASS_single_wide(void)
     l.input.str = NULL;
     l.index = 0;
     l.nbuf = 0;
+  l.arena = NULL;
 
     nextsym(&l);
     PTree *tree = CLASS(&l);
@@ -575,6 +597,7 @@ static int test_CLASS_single_hyphen_wide(void)
   l.input.str = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = CLASS(&l);
@@ -634,6 +657,7 @@ static int test_TERM_CharSym(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -657,6 +681,7 @@ static int test_TERM_Minus(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -680,6 +705,7 @@ static int test_TERM_Caret(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -703,6 +729,7 @@ static int test_TERM_Dot(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -726,6 +753,7 @@ static int test_TERM_Special(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -749,6 +777,7 @@ static int test_TERM_Subexpr(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -771,6 +800,7 @@ static int test_TERM_Class(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -794,6 +824,7 @@ static int test_TERM_NClass(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = TERM(&l);
@@ -817,6 +848,7 @@ static int test_EXPR_Term(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -840,6 +872,7 @@ static int test_EXPR_Plus(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -864,6 +897,7 @@ static int test_EXPR_PlusQuestion(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -889,6 +923,7 @@ static int test_EXPR_Star(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -913,6 +948,7 @@ static int test_EXPR_StarQuestion(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -938,6 +974,7 @@ static int test_EXPR_Question(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -962,6 +999,7 @@ static int test_EXPR_QuestionQuestion(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = EXPR(&l);
@@ -987,6 +1025,7 @@ static int test_SUB_Normal(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = SUB(&l);
@@ -1009,6 +1048,7 @@ static int test_SUB_Concat(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = SUB(&l);
@@ -1035,6 +1075,7 @@ static int test_REGEX_Normal(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = REGEX(&l);
@@ -1058,6 +1099,7 @@ static int test_REGEX_Alternate(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = REGEX(&l);
@@ -1085,6 +1127,7 @@ static int test_CLASS_range(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = CLASS(&l);
@@ -1110,6 +1153,7 @@ static int test_CLASS_range_range(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = CLASS(&l);
@@ -1143,6 +1187,7 @@ static int test_CLASS_single(void)
     l.input.wstr = NULL;
     l.index = 0;
     l.nbuf = 0;
+  l.arena = NULL;
 
     nextsym(&l);
     PTree *tree = CLASS(&l);
@@ -1167,6 +1212,7 @@ static int test_CLASS_single_hyphen(void)
   l.input.wstr = NULL;
   l.index = 0;
   l.nbuf = 0;
+  l.arena = NULL;
 
   nextsym(&l);
   PTree *tree = CLASS(&l);
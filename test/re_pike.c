@@ -13,6 +13,9 @@
 
 *******************************************************************************/
 
+#include <pthread.h>
+#include <stdint.h>
+
 #include "libstephen/ut.h"
 #include "tests.h"
 
@@ -81,6 +84,34 @@ static int test_nrange(void)
   return 0;
 }
 
+static int test_range_table(void)
+{
+  Regex r = recomp("[a-zA-Z0-9_.-]+");
+  TA_INT_EQ(reexec(r, "user.name-42_x@host", NULL), 14);
+  TA_INT_EQ(reexec(r, "@host", NULL), -1);
+  refree(r);
+
+  // Overlapping and out of order ranges are merged.
+  r = recomp("[x-zc-ea-dy]+");
+  TA_INT_EQ(reexec(r, "abcdexyzf", NULL), 8);
+  refree(r);
+
+  r = recomp("[^ \t]+");
+  TA_INT_EQ(reexec(r, "word ", NULL), 4);
+  TA_INT_EQ(reexec(r, "\t", NULL), -1);
+  refree(r);
+
+  // Bytes above 127 are matched by the range table, not the bitmap.
+  r = recomp("[\xc3\xa9]+");
+  TA_INT_EQ(reexec(r, "\xc3\xa9\xc3\xa9!", NULL), 4);
+  TA_INT_EQ(reexec(r, "e", NULL), -1);
+  refree(r);
+  r = recomp("[^a]");
+  TA_INT_EQ(reexec(r, "\xc3", NULL), 1);
+  refree(r);
+  return 0;
+}
+
 static int test_split_jump(void)
 {
   Regex r = recomp("a*");
@@ -244,6 +275,22 @@ static int test_nrange_wide(void)
   return 0;
 }
 
+static int test_range_table_wide(void)
+{
+  // Wide characters outside of the bitmap are found by binary search.
+  Regex r = recompw(L"[\u03b1-\u03c9a-z]+");
+  TA_INT_EQ(reexecw(r, L"\u03bb\u03b1x\u03c9!", NULL), 4);
+  TA_INT_EQ(reexecw(r, L"\u0391", NULL), -1);
+  refree(r);
+
+  r = recompw(L"[^\u03b1-\u03c9]");
+  TA_INT_EQ(reexecw(r, L"\u03bb", NULL), -1);
+  TA_INT_EQ(reexecw(r, L"\u4e2d", NULL), 1);
+  TA_INT_EQ(reexecw(r, L"\u00e9", NULL), 1);
+  refree(r);
+  return 0;
+}
+
 static int test_split_jump_wide(void)
 {
   Regex r = recompw(L"a*");
@@ -345,6 +392,793 @@ static int test_save_discard_stash_wide(void)
   return 0;
 }
 
+/*
+  The DFA is used whenever captures are not requested, so most of the tests
+  above already exercise it.  This one checks it against the Pike VM (which is
+  used when captures are requested) on patterns where thread priority matters.
+ */
+static int test_dfa_matches_pike(void)
+{
+  const char *patterns[] = {
+    "a|ab", "ab|a", "a*?", "(a|b)*c", "a*a*", "[a-c]+d?", "(ab)+|a(b)*",
+    "\\w+\\s*\\d*", "a.*b", "x?y?z?",
+  };
+  const char *inputs[] = {
+    "", "a", "ab", "abc", "aaab", "ababab", "cab", "abcd", "foo  42",
+    "a__b", "xyz", "zyx", "ababababc",
+  };
+  for (size_t i = 0; i < nelem(patterns); i++) {
+    Regex r = recomp(patterns[i]);
+    for (size_t j = 0; j < nelem(inputs); j++) {
+      size_t *capture = NULL;
+      ssize_t pike = reexec(r, inputs[j], &capture);
+      free(capture);
+      TA_INT_EQ(reexec(r, inputs[j], NULL), pike);
+    }
+    refree(r);
+  }
+  return 0;
+}
+
+/*
+  Capture lists are shared between threads and copied on write.  This pattern
+  has lots of threads sharing lists, and Saves on several paths, so it checks
+  that a shared list is never modified in place.
+ */
+static int test_save_shared(void)
+{
+  size_t *capture;
+  Regex r = recomp("((a|b)*)(c|(b)c)");
+
+  TA_INT_EQ(renumsaves(r), 8);
+  TA_INT_EQ(reexec(r, "abababbc", &capture), 8);
+  TA_SIZE_EQ(capture[0], 0);
+  TA_SIZE_EQ(capture[1], 7);
+  TA_SIZE_EQ(capture[2], 6);
+  TA_SIZE_EQ(capture[3], 7);
+  TA_SIZE_EQ(capture[4], 7);
+  TA_SIZE_EQ(capture[5], 8);
+  TA_SIZE_EQ(capture[6], 0);
+  TA_SIZE_EQ(capture[7], 0);
+  free(capture);
+
+  TA_INT_EQ(reexec(r, "abd", &capture), -1);
+  TA_PTR_EQ(capture, NULL);
+
+  refree(r);
+  return 0;
+}
+
+static int test_dfa_budget(void)
+{
+  Regex r = recomp("(a|b)*c");
+
+  // With no room for any state, every execution falls back to the Pike VM.
+  redfafree(r.dfa);
+  r.dfa = redfanew(r, 0);
+  TA_INT_EQ(reexec(r, "ababc", NULL), 5);
+  TA_INT_EQ(redfaexec(r.dfa, r, "ababc"), DFA_GAVEUP);
+
+  // With room for only a couple of states, the cache fills up and is flushed.
+  redfafree(r.dfa);
+  r.dfa = redfanew(r, 4 * 1024);
+  TA_INT_EQ(reexec(r, "ababababababc", NULL), 13);
+  TA_INT_EQ(reexec(r, "abd", NULL), -1);
+
+  refree(r);
+  return 0;
+}
+
+static int test_context_reuse(void)
+{
+  size_t *capture;
+  Regex r = recomp("(a*)(b)?c");
+  RegexContext *ctx = recontext(r);
+
+  TA_INT_EQ(reexecctx(ctx, "aabc", &capture), 4);
+  TA_SIZE_EQ(capture[1], 2);
+  TA_SIZE_EQ(capture[2], 2);
+  TA_SIZE_EQ(capture[3], 3);
+  free(capture);
+
+  // Captures which aren't reached must not leak from the previous execution.
+  TA_INT_EQ(reexecctx(ctx, "ac", &capture), 2);
+  TA_SIZE_EQ(capture[0], 0);
+  TA_SIZE_EQ(capture[1], 1);
+  TA_SIZE_EQ(capture[2], 0);
+  TA_SIZE_EQ(capture[3], 0);
+  free(capture);
+
+  TA_INT_EQ(reexecctx(ctx, "aab", NULL), -1);
+  TA_INT_EQ(reexecctx(ctx, "aabc", NULL), 4);
+  TA_INT_EQ(reexecwctx(ctx, L"abc", NULL), 3);
+  TA_INT_EQ(reexecwctx(ctx, L"abc", &capture), 3);
+  TA_SIZE_EQ(capture[1], 1);
+  free(capture);
+
+  recontextfree(ctx);
+  refree(r);
+  return 0;
+}
+
+static int test_search(void)
+{
+  size_t start, *capture;
+  Regex r = recomp("b+");
+
+  TA_INT_EQ(research(r, "aaabbbcc", &start, NULL), 3);
+  TA_SIZE_EQ(start, 3);
+  TA_INT_EQ(research(r, "bcb", &start, NULL), 1);
+  TA_SIZE_EQ(start, 0);
+  TA_INT_EQ(research(r, "aaa", &start, NULL), -1);
+  TA_INT_EQ(research(r, "", &start, NULL), -1);
+  refree(r);
+
+  // Leftmost match wins, even if a later one finishes first.
+  r = recomp("abc|b");
+  TA_INT_EQ(research(r, "xabc", &start, NULL), 3);
+  TA_SIZE_EQ(start, 1);
+  TA_INT_EQ(research(r, "xabd", &start, NULL), 1);
+  TA_SIZE_EQ(start, 2);
+  refree(r);
+
+  // Empty matches are found at the start, or at the end of the input.
+  r = recomp("a*");
+  TA_INT_EQ(research(r, "bbb", &start, NULL), 0);
+  TA_SIZE_EQ(start, 0);
+  refree(r);
+
+  // Captures are relative to the whole input.
+  r = recomp("(\\d+)-(\\d+)");
+  TA_INT_EQ(research(r, "tel: 555-1234.", &start, &capture), 8);
+  TA_SIZE_EQ(start, 5);
+  TA_SIZE_EQ(capture[0], 5);
+  TA_SIZE_EQ(capture[1], 8);
+  TA_SIZE_EQ(capture[2], 9);
+  TA_SIZE_EQ(capture[3], 13);
+  free(capture);
+  TA_INT_EQ(research(r, "no numbers", &start, &capture), -1);
+  TA_PTR_EQ(capture, NULL);
+  refree(r);
+
+  r = recomp("x");
+  TA_INT_EQ(research(r, "", NULL, NULL), -1);
+  refree(r);
+  return 0;
+}
+
+static int test_search_prefix(void)
+{
+  size_t start, *capture;
+  // Every match begins with "foo", so the search skips between occurrences.
+  Regex r = recomp("(foo)+(ba[rz])");
+  RegexContext *ctx = recontext(r);
+
+  TA_INT_EQ(researchctx(ctx, "fofoo foobaz", &start, &capture), 6);
+  TA_SIZE_EQ(start, 6);
+  TA_SIZE_EQ(capture[2], 9);
+  TA_SIZE_EQ(capture[3], 12);
+  free(capture);
+  TA_INT_EQ(researchctx(ctx, "foofoofoobar!", &start, NULL), 12);
+  TA_SIZE_EQ(start, 0);
+  TA_INT_EQ(researchctx(ctx, "foo bar foobax", &start, NULL), -1);
+  TA_INT_EQ(researchwctx(ctx, L"xxfoobarxx", &start, NULL), 6);
+  TA_SIZE_EQ(start, 2);
+  TA_INT_EQ(researchw(r, L"foba", &start, NULL), -1);
+
+  recontextfree(ctx);
+  refree(r);
+  return 0;
+}
+
+/**
+   @brief Feed a string to a stream in chunks of the given size.
+ */
+static void feedchunks(RegexContext *ctx, const char *input, size_t size)
+{
+  size_t len = strlen(input);
+  for (size_t i = 0; i < len; i += size) {
+    size_t n = (len - i < size) ? len - i : size;
+    if (!restreamfeed(ctx, input + i, n)) {
+      break;
+    }
+  }
+}
+
+static int test_stream(void)
+{
+  size_t start, *capture;
+  Regex r = recomp("(a+)(b+)");
+  RegexContext *ctx = recontext(r);
+
+  // Every chunk size gives the same result as matching the whole string.
+  for (size_t size = 1; size <= 8; size++) {
+    restreamstart(ctx, false, true);
+    feedchunks(ctx, "aaabbbc", size);
+    TA_INT_EQ(restreamfinish(ctx, &start, &capture), 6);
+    TA_SIZE_EQ(start, 0);
+    TA_SIZE_EQ(capture[0], 0);
+    TA_SIZE_EQ(capture[1], 3);
+    TA_SIZE_EQ(capture[2], 3);
+    TA_SIZE_EQ(capture[3], 6);
+    free(capture);
+
+    restreamstart(ctx, true, true);
+    feedchunks(ctx, "xxxabbbxab", size);
+    TA_INT_EQ(restreamfinish(ctx, &start, &capture), 4);
+    TA_SIZE_EQ(start, 3);
+    TA_SIZE_EQ(capture[2], 4);
+    TA_SIZE_EQ(capture[3], 7);
+    free(capture);
+  }
+
+  // The result is decided as soon as no thread is left.
+  restreamstart(ctx, false, false);
+  TEST_ASSERT(restreamfeed(ctx, "aa", 2));
+  TEST_ASSERT(restreamfeed(ctx, "ab", 2));
+  TEST_ASSERT(!restreamfeed(ctx, "bc", 2));
+  TA_INT_EQ(restreamfinish(ctx, NULL, &capture), 5);
+  TA_PTR_EQ(capture, NULL);
+
+  // A match may still be growing when the stream ends.
+  restreamstart(ctx, true, false);
+  TEST_ASSERT(restreamfeed(ctx, "zab", 3));
+  TA_INT_EQ(restreamfinish(ctx, &start, NULL), 2);
+  TA_SIZE_EQ(start, 1);
+
+  // Abandoning a stream and starting another is fine.
+  restreamstart(ctx, true, true);
+  restreamfeed(ctx, "aab", 3);
+  restreamstart(ctx, false, false);
+  TA_INT_EQ(restreamfinish(ctx, NULL, NULL), -1);
+
+  recontextfree(ctx);
+  refree(r);
+  return 0;
+}
+
+static int test_stream_prefix(void)
+{
+  size_t start;
+  // The literal prefix is split across chunks.
+  Regex r = recomp("foo(bar|baz)");
+  RegexContext *ctx = recontext(r);
+
+  restreamstart(ctx, true, false);
+  TEST_ASSERT(restreamfeed(ctx, "fo fo", 5));
+  TEST_ASSERT(restreamfeed(ctx, "ob", 2));
+  TEST_ASSERT(restreamfeed(ctx, "", 0));
+  TEST_ASSERT(!restreamfeed(ctx, "az and more", 11));
+  TA_INT_EQ(restreamfinish(ctx, &start, NULL), 6);
+  TA_SIZE_EQ(start, 3);
+
+  // A NUL ends the input, even when the match would come after it.
+  restreamstart(ctx, true, false);
+  TEST_ASSERT(!restreamfeed(ctx, "xx\0foobar", 9));
+  TA_INT_EQ(restreamfinish(ctx, NULL, NULL), -1);
+  TA_INT_EQ(research(r, "xx\0foobar", NULL, NULL), -1);
+
+  restreamstart(ctx, true, false);
+  TEST_ASSERT(restreamfeedw(ctx, L"xxxfoob", 7));
+  TEST_ASSERT(!restreamfeedw(ctx, L"ar!", 3));
+  TA_INT_EQ(restreamfinish(ctx, &start, NULL), 6);
+  TA_SIZE_EQ(start, 3);
+
+  restreamstart(ctx, true, false);
+  TEST_ASSERT(restreamfeed(ctx, "no match", 8));
+  TA_INT_EQ(restreamfinish(ctx, &start, NULL), -1);
+
+  recontextfree(ctx);
+  refree(r);
+  return 0;
+}
+
+static int test_stream_file(void)
+{
+  size_t start, *capture;
+  Regex r = recomp("needle(\\d+)");
+  RegexContext *ctx = recontext(r);
+  FILE *f = tmpfile();
+
+  // Put the match across the boundary of the first read.
+  for (int i = 0; i < 4093; i++) {
+    fputc('x', f);
+  }
+  fputs("needle42 and more hay", f);
+
+  rewind(f);
+  TA_INT_EQ(restreamfile(ctx, f, true, &start, &capture), 8);
+  TA_SIZE_EQ(start, 4093);
+  TA_SIZE_EQ(capture[0], 4099);
+  TA_SIZE_EQ(capture[1], 4101);
+  free(capture);
+
+  rewind(f);
+  TA_INT_EQ(restreamfile(ctx, f, false, NULL, NULL), -1);
+
+  fclose(f);
+  recontextfree(ctx);
+  refree(r);
+  return 0;
+}
+
+static int test_set(void)
+{
+  const char *patterns[] = {"abc", "a+", "b", "(ab)*c", "a.c", "[a-c]+d"};
+  const char *inputs[] = {"abc", "aaa", "b", "ababc", "c", "abcd", "", "x"};
+  size_t npatterns = nelem(patterns);
+  Regex single[nelem(patterns)];
+  bool matched[nelem(patterns)];
+  RegexSet *set = recompset(patterns, npatterns);
+
+  for (size_t i = 0; i < npatterns; i++) {
+    single[i] = recomp(patterns[i]);
+  }
+
+  // Every pattern in the set matches exactly when it would alone.
+  for (size_t j = 0; j < nelem(inputs); j++) {
+    size_t count = 0;
+    for (size_t i = 0; i < npatterns; i++) {
+      if (reexec(single[i], inputs[j], NULL) != -1) {
+        count++;
+      }
+    }
+    TA_SIZE_EQ(reexecset(set, inputs[j], matched), count);
+    for (size_t i = 0; i < npatterns; i++) {
+      TA_INT_EQ(matched[i], reexec(single[i], inputs[j], NULL) != -1);
+    }
+  }
+
+  TA_SIZE_EQ(reexecset(set, "abcd", matched), 5);
+  TEST_ASSERT(!matched[2]);
+
+  for (size_t i = 0; i < npatterns; i++) {
+    refree(single[i]);
+  }
+  refreeset(set);
+  return 0;
+}
+
+static int test_set_wide(void)
+{
+  const wchar_t *patterns[] = {L"λ+", L"x"};
+  bool matched[2];
+  RegexSet *set = recompsetw(patterns, 2);
+
+  TA_SIZE_EQ(reexecsetw(set, L"λλ", matched), 1);
+  TEST_ASSERT(matched[0] && !matched[1]);
+  TA_SIZE_EQ(reexecsetw(set, L"x", matched), 1);
+  TEST_ASSERT(!matched[0] && matched[1]);
+
+  // A set of one pattern is just that pattern.
+  refreeset(set);
+  set = recompset((const char *[]){"a*"}, 1);
+  TA_SIZE_EQ(reexecset(set, "", matched), 1);
+  TEST_ASSERT(matched[0]);
+
+  refreeset(set);
+  return 0;
+}
+
+static int test_binary(void)
+{
+  const char *patterns[] = {"(a|b)*c", "[^ \t]+x?", "\\d+\\.\\w*", "λ[α-ω]"};
+  const char *inputs[] = {"ababc", "hello there", "12.5ab", "λβ", "", "c"};
+  size_t len, used;
+
+  for (size_t i = 0; i < nelem(patterns); i++) {
+    Regex r = recomp(patterns[i]);
+    void *buf = rebinwrite(r, &len);
+    TA_SIZE_EQ(len % 8, 0);
+    Regex copy = rebinread(buf, len, &used);
+    TA_PTR_NE(copy.i, NULL);
+    TA_SIZE_EQ(used, len);
+    TA_SIZE_EQ(copy.n, r.n);
+    for (size_t j = 0; j < nelem(inputs); j++) {
+      size_t *a, *b;
+      TA_INT_EQ(reexec(copy, inputs[j], &b), reexec(r, inputs[j], &a));
+      if (a) {
+        TEST_ASSERT(memcmp(a, b, renumsaves(r) * sizeof(size_t)) == 0);
+      }
+      free(a);
+      free(b);
+    }
+    free(buf);
+    refree(copy);
+    refree(r);
+  }
+
+  Regex wide = recompw(L"[α-ω]+");
+  void *buf = rebinwrite(wide, &len);
+  Regex copy = rebinread(buf, len, NULL);
+  TA_INT_EQ(reexecw(copy, L"λμx", NULL), 2);
+  free(buf);
+  refree(copy);
+  refree(wide);
+  return 0;
+}
+
+static int test_binary_bundle(void)
+{
+  size_t len, used;
+  FILE *f = tmpfile();
+  Regex a = recomp("a+"), b = recomp("[0-9]b");
+
+  // Programs written one after another read back one after another.
+  rebinfwrite(a, f);
+  rebinfwrite(b, f);
+  len = ftell(f);
+  rewind(f);
+  unsigned char *bundle = calloc(len, 1);
+  TA_SIZE_EQ(fread(bundle, 1, len, f), len);
+
+  Regex first = rebinread(bundle, len, &used);
+  Regex second = rebinread(bundle + used, len - used, &used);
+  TA_INT_EQ(reexec(first, "aaa", NULL), 3);
+  TA_INT_EQ(reexec(second, "7b", NULL), 2);
+  TA_INT_EQ(reexec(second, "aaa", NULL), -1);
+
+  free(bundle);
+  fclose(f);
+  refree(first);
+  refree(second);
+  refree(a);
+  refree(b);
+  return 0;
+}
+
+static int test_binary_invalid(void)
+{
+  size_t len;
+  Regex r = recomp("(ab)*[xy]");
+  unsigned char *buf = rebinwrite(r, &len);
+
+  // Every truncation is rejected.
+  for (size_t i = 0; i < len - 8; i++) {
+    TA_PTR_EQ(rebinread(buf, i, NULL).i, NULL);
+  }
+
+  // So is a bad magic number.
+  buf[0] ^= 0xFF;
+  TA_PTR_EQ(rebinread(buf, len, NULL).i, NULL);
+  buf[0] ^= 0xFF;
+
+  // And a jump target outside of the program (the first instruction is a
+  // split, whose x field is the second word of its record).
+  size_t header = 24, target = header + 16;
+  uint64_t bad = 1000;
+  memcpy(buf + target, &bad, sizeof(bad));
+  TA_PTR_EQ(rebinread(buf, len, NULL).i, NULL);
+
+  free(buf);
+  refree(r);
+  return 0;
+}
+
+static int test_binary_crafted(void)
+{
+  size_t len, header = 24, record = 32;
+  Regex r = recomp("(a)b");
+  unsigned char *buf = rebinwrite(r, &len);
+  size_t save = 0;
+  while (r.i[save].code != Save) {
+    save++;
+  }
+
+  // The unmodified program loads.
+  Regex ok = rebinread(buf, len, NULL);
+  TA_INT_EQ(ok.n, r.n);
+  refree(ok);
+
+  // A save slot far beyond the program is rejected (s is the third field).
+  uint64_t slot = (uint64_t) 1 << 40, old;
+  memcpy(&old, buf + header + save * record + 8, sizeof(old));
+  memcpy(buf + header + save * record + 8, &slot, sizeof(slot));
+  Regex bad = rebinread(buf, len, NULL);
+  TA_PTR_EQ(bad.i, NULL);
+  TA_INT_EQ(bad.n, 0);
+  memcpy(buf + header + save * record + 8, &old, sizeof(old));
+
+  // So is a final instruction which would fall off the end.
+  uint32_t code = Char;
+  memcpy(buf + header + (r.n - 1) * record, &code, sizeof(code));
+  bad = rebinread(buf, len, NULL);
+  TA_PTR_EQ(bad.i, NULL);
+  TA_INT_EQ(bad.n, 0);
+  free(buf);
+  refree(r);
+
+  // Even when it's a character class, which mustn't be leaked.
+  r = recomp("[xy]");
+  buf = rebinwrite(r, &len);
+  size_t range = 0;
+  while (r.i[range].code != Range) {
+    range++;
+  }
+  memcpy(buf + header + (r.n - 1) * record, buf + header + range * record,
+         record);
+  bad = rebinread(buf, len, NULL);
+  TA_PTR_EQ(bad.i, NULL);
+  TA_INT_EQ(bad.n, 0);
+
+  free(buf);
+  refree(r);
+  return 0;
+}
+
+static int test_backtrack(void)
+{
+  const char *patterns[] = {
+    "[0-9]+\\.[0-9]+", "(a*)*b", "(a|ab)(c|bcd)(d*)", "(a+?)(a*)", "((a)|b)+",
+    "(x*)(x*)y", ".*(\\w+)"
+  };
+  const char *inputs[] = {
+    "3.14", "12.", "aaab", "abcd", "aaa", "abab", "xxxy", "x", "", "hi there"
+  };
+
+  // The backtracker gives the same matches and captures as the Pike VM.
+  for (size_t i = 0; i < nelem(patterns); i++) {
+    Regex r = recomp(patterns[i]);
+    RegexContext *ctx = recontext(r);
+    size_t nsave = renumsaves(r);
+    for (size_t j = 0; j < nelem(inputs); j++) {
+      size_t *a, *b;
+      TA_INT_EQ(rebacktrack(r, inputs[j], &b), reexecctx(ctx, inputs[j], &a));
+      if (a) {
+        TEST_ASSERT(memcmp(a, b, nsave * sizeof(size_t)) == 0);
+      }
+      free(a);
+      free(b);
+      TA_INT_EQ(rebacktrack(r, inputs[j], NULL), reexecctx(ctx, inputs[j], NULL));
+    }
+    recontextfree(ctx);
+    refree(r);
+  }
+  return 0;
+}
+
+static int test_backtrack_budget(void)
+{
+  size_t len = BT_BUDGET * 8, *capture;
+  char *input = calloc(len + 1, sizeof(char));
+  memset(input, 'a', len);
+  Regex r = recomp("(a*)");
+
+  // Too big for the backtracker, but reexec() falls back to the Pike VM.
+  TA_INT_EQ(rebacktrack(r, input, NULL), BT_GAVEUP);
+  TA_INT_EQ(reexec(r, input, &capture), len);
+  TA_SIZE_EQ(capture[1], len);
+  free(capture);
+
+  free(input);
+  refree(r);
+  return 0;
+}
+
+#define NWORKERS 4
+
+struct worker {
+  Regex r;
+  int failures;
+};
+
+static void *context_worker(void *arg)
+{
+  struct worker *w = arg;
+  RegexContext *ctx = recontext(w->r);
+  for (int i = 0; i < 2000; i++) {
+    size_t *capture;
+    if (reexecctx(ctx, "abababc", &capture) != 7 || capture[1] != 6) {
+      w->failures++;
+    }
+    free(capture);
+    if (reexecctx(ctx, "ababx", NULL) != -1) {
+      w->failures++;
+    }
+  }
+  recontextfree(ctx);
+  return NULL;
+}
+
+static int test_context_threads(void)
+{
+  pthread_t threads[NWORKERS];
+  struct worker workers[NWORKERS];
+  Regex r = recomp("((a|b)*)c");
+
+  for (int i = 0; i < NWORKERS; i++) {
+    workers[i] = (struct worker){.r=r, .failures=0};
+    pthread_create(&threads[i], NULL, context_worker, &workers[i]);
+  }
+  for (int i = 0; i < NWORKERS; i++) {
+    pthread_join(threads[i], NULL);
+    TA_INT_EQ(workers[i].failures, 0);
+  }
+
+  refree(r);
+  return 0;
+}
+
+#define NOPTIONAL 5000
+
+struct deep {
+  Regex r;
+  ssize_t plain, captured;
+};
+
+static void *deep_worker(void *arg)
+{
+  struct deep *d = arg;
+  RegexContext *ctx = recontext(d->r);
+  size_t *capture;
+  d->plain = reexecctx(ctx, "aab", NULL);
+  d->captured = reexecctx(ctx, "aab", &capture);
+  free(capture);
+  recontextfree(ctx);
+  return NULL;
+}
+
+static int test_deep_closure(void)
+{
+  // A chain of thousands of Splits, all followed from the start of input.
+  char *pattern = calloc(2 * NOPTIONAL + 2, sizeof(char));
+  for (size_t i = 0; i < NOPTIONAL; i++) {
+    pattern[2*i] = 'a';
+    pattern[2*i + 1] = '?';
+  }
+  pattern[2 * NOPTIONAL] = 'b';
+  struct deep d = {.r=recomp(pattern), .plain=0, .captured=0};
+
+  // The closure doesn't recurse, so a small stack is plenty.
+  pthread_t worker;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, 128 * 1024);
+  pthread_create(&worker, &attr, deep_worker, &d);
+  pthread_join(worker, NULL);
+  pthread_attr_destroy(&attr);
+
+  TA_INT_EQ(d.plain, 3);
+  TA_INT_EQ(d.captured, 3);
+  free(pattern);
+  refree(d.r);
+  return 0;
+}
+
+static int test_grep(void)
+{
+  Regex r = recomp("b+");
+  const char buf[] = "abc\nxyz\n\nbbb\nb";
+  size_t n;
+
+  // More threads than lines is fine, and so is no trailing newline.
+  for (size_t t = 0; t <= 8; t++) {
+    RegexMatch *m = regrep(r, buf, sizeof(buf) - 1, t, &n);
+    TA_SIZE_EQ(n, 3);
+    TA_SIZE_EQ(m[0].line, 0);
+    TA_SIZE_EQ(m[0].start, 1);
+    TA_SIZE_EQ(m[0].length, 1);
+    TA_SIZE_EQ(m[1].line, 3);
+    TA_SIZE_EQ(m[1].start, 9);
+    TA_SIZE_EQ(m[1].length, 3);
+    TA_SIZE_EQ(m[2].line, 4);
+    TA_SIZE_EQ(m[2].start, 13);
+    TA_SIZE_EQ(m[2].length, 1);
+    free(m);
+  }
+
+  RegexMatch *m = regrep(r, buf, 0, 4, &n);
+  TA_SIZE_EQ(n, 0);
+  free(m);
+
+  // A NUL ends the line it's in, as far as matching goes.
+  const char nul[] = "xx\0bb\nbb";
+  m = regrep(r, nul, sizeof(nul) - 1, 1, &n);
+  TA_SIZE_EQ(n, 1);
+  TA_SIZE_EQ(m[0].line, 1);
+  TA_SIZE_EQ(m[0].start, 6);
+  free(m);
+  refree(r);
+  return 0;
+}
+
+static int test_grep_threads(void)
+{
+  Regex r = recomp("(\\d+)-(\\d+)");
+  size_t len = 0, n, expected = 0;
+  char *buf = calloc(1000 * 16, sizeof(char));
+
+  for (int i = 0; i < 1000; i++) {
+    if (i % 7 == 0) {
+      len += sprintf(buf + len, "x %d-%d\n", i, i + 1);
+      expected++;
+    } else {
+      len += sprintf(buf + len, "line %d\n", i);
+    }
+  }
+
+  for (size_t t = 1; t <= 16; t *= 2) {
+    RegexMatch *m = regrep(r, buf, len, t, &n);
+    TA_SIZE_EQ(n, expected);
+    for (size_t k = 0; k < n; k++) {
+      TA_SIZE_EQ(m[k].line, 7 * k);
+      TA_CHAR_EQ(buf[m[k].start - 1], ' ');
+      TA_CHAR_EQ(buf[m[k].start + m[k].length], '\n');
+    }
+    free(m);
+  }
+
+  free(buf);
+  refree(r);
+  return 0;
+}
+
+static int test_into(void)
+{
+  Regex r = recomp("(\\w+)=(\\d+)");
+  RegexContext *ctx = recontext(r);
+  size_t saved[4], start;
+
+  TA_INT_EQ(reexecinto(ctx, "width=640", saved, 4), 9);
+  TA_SIZE_EQ(saved[0], 0);
+  TA_SIZE_EQ(saved[1], 5);
+  TA_SIZE_EQ(saved[2], 6);
+  TA_SIZE_EQ(saved[3], 9);
+
+  // Only the indices that fit are written, and nothing is written on failure.
+  saved[2] = saved[3] = 42;
+  TA_INT_EQ(reexecinto(ctx, "height=480", saved, 2), 10);
+  TA_SIZE_EQ(saved[1], 6);
+  TA_SIZE_EQ(saved[2], 42);
+  TA_INT_EQ(reexecinto(ctx, "=480", saved, 4), -1);
+  TA_SIZE_EQ(saved[0], 0);
+  TA_INT_EQ(reexecinto(ctx, "x=1", NULL, 0), 3);
+
+  TA_INT_EQ(researchinto(ctx, "set depth=24;", &start, saved, 4), 8);
+  TA_SIZE_EQ(start, 4);
+  TA_SIZE_EQ(saved[0], 4);
+  TA_SIZE_EQ(saved[3], 12);
+
+  TA_INT_EQ(reexecwinto(ctx, L"n=1", saved, 4), 3);
+  TA_SIZE_EQ(saved[2], 2);
+  TA_INT_EQ(researchwinto(ctx, L"; n=12", &start, saved, 4), 4);
+  TA_SIZE_EQ(start, 2);
+  TA_SIZE_EQ(saved[3], 6);
+
+  recontextfree(ctx);
+  refree(r);
+  return 0;
+}
+
+static int test_span(void)
+{
+  Regex r = recomp("(\\w+)=(\\d*)");
+  RegexContext *ctx = recontext(r);
+  size_t saved[4];
+  Span spans[2];
+  WSpan wspans[2];
+  const char *input = "key=";
+  const wchar_t *winput = L"wide=7";
+
+  TA_INT_EQ(reexecinto(ctx, input, saved, 4), 4);
+  recapspan(input, saved, 4, spans);
+  TA_PTR_EQ(spans[0].str, input);
+  TA_SIZE_EQ(spans[0].len, 3);
+  TA_PTR_EQ(spans[1].str, input + 4);
+  TA_SIZE_EQ(spans[1].len, 0);
+
+  TA_INT_EQ(reexecwinto(ctx, winput, saved, 4), 6);
+  recapwspan(winput, saved, 4, wspans);
+  TA_PTR_EQ(wspans[0].str, winput);
+  TA_SIZE_EQ(wspans[0].len, 4);
+  TA_PTR_EQ(wspans[1].str, winput + 5);
+  TA_SIZE_EQ(wspans[1].len, 1);
+
+  recontextfree(ctx);
+  refree(r);
+  return 0;
+}
+
 void pike_test(void)
 {
   smb_ut_group *group = su_create_test_group("test/re_pike.c");
@@ -361,6 +1195,9 @@ void pike_test(void)
   smb_ut_test *nrange = su_create_test("nrange", test_nrange);
   su_add_test(group, nrange);
 
+  smb_ut_test *range_table = su_create_test("range_table", test_range_table);
+  su_add_test(group, range_table);
+
   smb_ut_test *split_jump = su_create_test("split_jump", test_split_jump);
   su_add_test(group, split_jump);
 
@@ -388,6 +1225,9 @@ void pike_test(void)
   smb_ut_test *nrange_wide = su_create_test("nrange_wide", test_nrange_wide);
   su_add_test(group, nrange_wide);
 
+  smb_ut_test *range_table_wide = su_create_test("range_table_wide", test_range_table_wide);
+  su_add_test(group, range_table_wide);
+
   smb_ut_test *split_jump_wide = su_create_test("split_jump_wide", test_split_jump_wide);
   su_add_test(group, split_jump_wide);
 
@@ -403,6 +1243,74 @@ void pike_test(void)
   smb_ut_test *save_discard_stash_wide = su_create_test("save_discard_stash_wide", test_save_discard_stash_wide);
   su_add_test(group, save_discard_stash_wide);
 
+  smb_ut_test *save_shared = su_create_test("save_shared", test_save_shared);
+  su_add_test(group, save_shared);
+
+  smb_ut_test *dfa_matches_pike = su_create_test("dfa_matches_pike", test_dfa_matches_pike);
+  su_add_test(group, dfa_matches_pike);
+
+  smb_ut_test *dfa_budget = su_create_test("dfa_budget", test_dfa_budget);
+  su_add_test(group, dfa_budget);
+
+  smb_ut_test *context_reuse = su_create_test("context_reuse", test_context_reuse);
+  su_add_test(group, context_reuse);
+
+  smb_ut_test *search = su_create_test("search", test_search);
+  su_add_test(group, search);
+
+  smb_ut_test *search_prefix = su_create_test("search_prefix", test_search_prefix);
+  su_add_test(group, search_prefix);
+
+  smb_ut_test *context_threads = su_create_test("context_threads", test_context_threads);
+  su_add_test(group, context_threads);
+
+  smb_ut_test *deep_closure = su_create_test("deep_closure", test_deep_closure);
+  su_add_test(group, deep_closure);
+
+  smb_ut_test *stream = su_create_test("stream", test_stream);
+  su_add_test(group, stream);
+
+  smb_ut_test *stream_prefix = su_create_test("stream_prefix", test_stream_prefix);
+  su_add_test(group, stream_prefix);
+
+  smb_ut_test *stream_file = su_create_test("stream_file", test_stream_file);
+  su_add_test(group, stream_file);
+
+  smb_ut_test *set = su_create_test("set", test_set);
+  su_add_test(group, set);
+
+  smb_ut_test *set_wide = su_create_test("set_wide", test_set_wide);
+  su_add_test(group, set_wide);
+
+  smb_ut_test *binary = su_create_test("binary", test_binary);
+  su_add_test(group, binary);
+
+  smb_ut_test *binary_bundle = su_create_test("binary_bundle", test_binary_bundle);
+  su_add_test(group, binary_bundle);
+
+  smb_ut_test *binary_invalid = su_create_test("binary_invalid", test_binary_invalid);
+  su_add_test(group, binary_invalid);
+  smb_ut_test *binary_crafted = su_create_test("binary_crafted", test_binary_crafted);
+  su_add_test(group, binary_crafted);
+
+  smb_ut_test *backtrack = su_create_test("backtrack", test_backtrack);
+  su_add_test(group, backtrack);
+
+  smb_ut_test *backtrack_budget = su_create_test("backtrack_budget", test_backtrack_budget);
+  su_add_test(group, backtrack_budget);
+
+  smb_ut_test *grep = su_create_test("grep", test_grep);
+  su_add_test(group, grep);
+
+  smb_ut_test *grep_threads = su_create_test("grep_threads", test_grep_threads);
+  su_add_test(group, grep_threads);
+
+  smb_ut_test *into = su_create_test("into", test_into);
+  su_add_test(group, into);
+
+  smb_ut_test *span = su_create_test("span", test_span);
+  su_add_test(group, span);
+
   su_run_group(group);
   su_delete_group(group);
 }
@@ -12,6 +12,8 @@
                 Revised BSD License.  See LICENSE.txt for details.
 
 *******************************************************************************/
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 
 #include "libstephen/ut.h"
@@ -189,6 +191,275 @@ int test_pop_back(void)
   return 0;
 }
 
+int test_bulk(void)
+{
+  smb_rb rb;
+  int values[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, out[10], i;
+  rb_init(&rb, sizeof(int), 4);
+
+  // Wrap the items around the end, then grow with them wrapped.
+  rb_push_back_n(&rb, values, 3);
+  TA_INT_EQ(rb_pop_front_n(&rb, out, 2), 2);
+  rb_push_back_n(&rb, values + 3, 3);
+  TA_INT_EQ(rb.start, 2);
+  TA_INT_EQ(rb.count, 4);
+  rb_push_back_n(&rb, values + 6, 4);
+  TA_INT_EQ(rb.nalloc, 8);
+  TA_INT_EQ(rb_pop_front_n(&rb, out, 10), 8);
+  for (i = 0; i < 8; i++) {
+    TA_INT_EQ(out[i], i + 2);
+  }
+  TA_INT_EQ(rb_pop_front_n(&rb, out, 10), 0);
+  rb_destroy(&rb);
+  return 0;
+}
+
+int test_spans(void)
+{
+  smb_rb rb;
+  int *span, n, i, v;
+  rb_init(&rb, sizeof(int), 8);
+
+  // Fill the buffer in place, and empty it again.
+  span = rb_writable_span(&rb, 5, &n);
+  TA_INT_EQ(n, 8);
+  for (i = 0; i < 5; i++) {
+    span[i] = i;
+  }
+  rb_commit(&rb, 5);
+  span = rb_readable_span(&rb, &n);
+  TA_INT_EQ(n, 5);
+  TA_INT_EQ(span[4], 4);
+  rb_consume(&rb, 3);
+
+  // Now the free space wraps: three after the items, and three before them.
+  span = rb_writable_span(&rb, 6, &n);
+  TA_INT_EQ(n, 3);
+  for (i = 0; i < 3; i++) {
+    span[i] = 5 + i;
+  }
+  rb_commit(&rb, 3);
+  span = rb_writable_span(&rb, 3, &n);
+  TA_INT_EQ(n, 3);
+  for (i = 0; i < 3; i++) {
+    span[i] = 8 + i;
+  }
+  rb_commit(&rb, 3);
+  TA_INT_EQ(rb.count, 8);
+  TA_INT_EQ(rb.nalloc, 8);
+
+  // The items wrap too, so they're read in two spans.
+  span = rb_readable_span(&rb, &n);
+  TA_INT_EQ(n, 5);
+  TA_INT_EQ(span[0], 3);
+  rb_consume(&rb, 5);
+  span = rb_readable_span(&rb, &n);
+  TA_INT_EQ(n, 3);
+  TA_INT_EQ(span[2], 10);
+
+  // Asking for more room than is left grows the buffer.
+  span = rb_writable_span(&rb, 10, &n);
+  TA_INT_GE(n, 10);
+  span[0] = 11;
+  rb_commit(&rb, 1);
+  for (i = 8; i < 12; i++) {
+    rb_pop_front(&rb, &v);
+    TA_INT_EQ(v, i);
+  }
+  TA_INT_EQ(rb.count, 0);
+  rb_destroy(&rb);
+  return 0;
+}
+
+int test_spsc(void)
+{
+  smb_rb_spsc rb;
+  int values[8] = {0, 1, 2, 3, 4, 5, 6, 7}, out[8], v = 100, i;
+  rb_spsc_init(&rb, sizeof(int), 5);
+  TA_SIZE_EQ(rb.mask, 7);
+
+  TA_INT_EQ(rb_spsc_pop(&rb, &v), false);
+  TA_INT_EQ(v, 100);
+  TA_SIZE_EQ(rb_spsc_push_n(&rb, values, 6), 6);
+  TA_SIZE_EQ(rb_spsc_pop_n(&rb, out, 4), 4);
+  for (i = 0; i < 4; i++) {
+    TA_INT_EQ(out[i], i);
+  }
+
+  // Only six of these fit, and they wrap around the end.
+  TA_SIZE_EQ(rb_spsc_push_n(&rb, values, 8), 6);
+  TA_INT_EQ(rb_spsc_push(&rb, &v), false);
+  TA_SIZE_EQ(rb_spsc_count(&rb), 8);
+  TA_SIZE_EQ(rb_spsc_pop_n(&rb, out, 8), 8);
+  TA_INT_EQ(out[0], 4);
+  TA_INT_EQ(out[1], 5);
+  for (i = 2; i < 8; i++) {
+    TA_INT_EQ(out[i], i - 2);
+  }
+  TA_INT_EQ(rb_spsc_push(&rb, &v), true);
+  TA_INT_EQ(rb_spsc_pop(&rb, &i), true);
+  TA_INT_EQ(i, 100);
+  rb_spsc_destroy(&rb);
+  return 0;
+}
+
+#define SPSC_ITEMS 100000
+
+static void *spsc_producer(void *arg)
+{
+  smb_rb_spsc *rb = arg;
+  int batch[37], i = 0, n, sent;
+  while (i < SPSC_ITEMS) {
+    // Alternate single pushes with uneven batches.
+    if (i % 2) {
+      if (rb_spsc_push(rb, &i)) {
+        i++;
+      } else {
+        sched_yield();
+      }
+      continue;
+    }
+    for (n = 0; n < 37 && i + n < SPSC_ITEMS; n++) {
+      batch[n] = i + n;
+    }
+    sent = 0;
+    while (sent < n) {
+      size_t pushed = rb_spsc_push_n(rb, batch + sent, n - sent);
+      if (pushed == 0) {
+        // Let the consumer run when the buffer is full, as on one CPU.
+        sched_yield();
+      }
+      sent += pushed;
+    }
+    i += n;
+  }
+  return NULL;
+}
+
+int test_spsc_threads(void)
+{
+  smb_rb_spsc rb;
+  pthread_t producer;
+  int batch[50], expected = 0, wrong = 0, n, i;
+
+  // Keep taking items after a wrong one, so the producer can finish.
+  rb_spsc_init(&rb, sizeof(int), 256);
+  pthread_create(&producer, NULL, spsc_producer, &rb);
+  while (expected < SPSC_ITEMS) {
+    n = rb_spsc_pop_n(&rb, batch, 50);
+    if (n == 0) {
+      sched_yield();
+    }
+    for (i = 0; i < n; i++) {
+      wrong += batch[i] != expected;
+      expected++;
+    }
+  }
+  pthread_join(producer, NULL);
+  TA_INT_EQ(wrong, 0);
+  TA_SIZE_EQ(rb_spsc_count(&rb), 0);
+  rb_spsc_destroy(&rb);
+  return 0;
+}
+
+int test_mpmc(void)
+{
+  smb_rb_mpmc rb;
+  int v, i;
+  rb_mpmc_init(&rb, sizeof(int), 3);
+  TA_SIZE_EQ(rb.mask, 3);
+
+  TA_INT_EQ(rb_mpmc_try_pop(&rb, &v), false);
+  for (i = 0; i < 4; i++) {
+    TA_INT_EQ(rb_mpmc_try_push(&rb, &i), true);
+  }
+  TA_INT_EQ(rb_mpmc_try_push(&rb, &i), false);
+
+  // Go around a few laps.
+  for (i = 4; i < 20; i++) {
+    rb_mpmc_pop(&rb, &v);
+    TA_INT_EQ(v, i - 4);
+    rb_mpmc_push(&rb, &i);
+  }
+  for (i = 16; i < 20; i++) {
+    TA_INT_EQ(rb_mpmc_try_pop(&rb, &v), true);
+    TA_INT_EQ(v, i);
+  }
+  TA_INT_EQ(rb_mpmc_try_pop(&rb, &v), false);
+  rb_mpmc_destroy(&rb);
+  return 0;
+}
+
+#define MPMC_THREADS 4
+#define MPMC_ITEMS 50000
+
+typedef struct {
+  smb_rb_mpmc *rb;
+  int id;
+  long long sum;
+  int last[MPMC_THREADS];
+  int wrong;
+} mpmc_worker;
+
+static void *mpmc_producer(void *arg)
+{
+  mpmc_worker *w = arg;
+  for (int i = 0; i < MPMC_ITEMS; i++) {
+    int v = i * MPMC_THREADS + w->id;
+    rb_mpmc_push(w->rb, &v);
+  }
+  return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+  mpmc_worker *w = arg;
+  for (int i = 0; i < MPMC_THREADS; i++) {
+    w->last[i] = -1;
+  }
+  for (int i = 0; i < MPMC_ITEMS; i++) {
+    int v;
+    rb_mpmc_pop(w->rb, &v);
+    w->sum += v;
+    // Each producer's items come out in the order it pushed them.
+    if (v / MPMC_THREADS <= w->last[v % MPMC_THREADS]) {
+      w->wrong++;
+    }
+    w->last[v % MPMC_THREADS] = v / MPMC_THREADS;
+  }
+  return NULL;
+}
+
+int test_mpmc_threads(void)
+{
+  smb_rb_mpmc rb;
+  pthread_t threads[2 * MPMC_THREADS];
+  mpmc_worker workers[2 * MPMC_THREADS] = {{0}};
+  long long sum = 0, n = (long long)MPMC_ITEMS * MPMC_THREADS;
+  int i, wrong = 0;
+
+  rb_mpmc_init(&rb, sizeof(int), 64);
+  for (i = 0; i < 2 * MPMC_THREADS; i++) {
+    workers[i].rb = &rb;
+    workers[i].id = i % MPMC_THREADS;
+    pthread_create(&threads[i], NULL,
+                   i < MPMC_THREADS ? mpmc_producer : mpmc_consumer,
+                   &workers[i]);
+  }
+  for (i = 0; i < 2 * MPMC_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    sum += workers[i].sum;
+    wrong += workers[i].wrong;
+  }
+
+  // Every item was popped exactly once.
+  TA_LLINT_EQ(sum, n * (n - 1) / 2);
+  TA_INT_EQ(wrong, 0);
+  TA_INT_EQ(rb_mpmc_try_pop(&rb, &i), false);
+  rb_mpmc_destroy(&rb);
+  return 0;
+}
+
 void ringbuf_test(void)
 {
   smb_ut_group *group = su_create_test_group("test/ringbuftest.c");
@@ -205,6 +476,24 @@ void ringbuf_test(void)
   smb_ut_test *pop_back = su_create_test("pop_back", test_pop_back);
   su_add_test(group, pop_back);
 
+  smb_ut_test *bulk = su_create_test("bulk", test_bulk);
+  su_add_test(group, bulk);
+
+  smb_ut_test *spans = su_create_test("spans", test_spans);
+  su_add_test(group, spans);
+
+  smb_ut_test *spsc = su_create_test("spsc", test_spsc);
+  su_add_test(group, spsc);
+
+  smb_ut_test *spsc_threads = su_create_test("spsc_threads", test_spsc_threads);
+  su_add_test(group, spsc_threads);
+
+  smb_ut_test *mpmc = su_create_test("mpmc", test_mpmc);
+  su_add_test(group, mpmc);
+
+  smb_ut_test *mpmc_threads = su_create_test("mpmc_threads", test_mpmc_threads);
+  su_add_test(group, mpmc_threads);
+
   su_run_group(group);
   su_delete_group(group);
 }
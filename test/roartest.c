@@ -0,0 +1,315 @@
+/***************************************************************************//**
+
+  @file         roartest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the compressed bitmap.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+  Most tests keep a plain bitfield of the same values alongside, and compare
+  the two.
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libstephen/bf.h"
+#include "libstephen/roar.h"
+#include "libstephen/ut.h"
+#include "tests.h"
+
+/**
+   @brief The values the tests use are below this.
+ */
+#define test_range (4 * ROAR_CHUNK)
+
+static int check_same(const smb_roar *r, unsigned char *ref)
+{
+  uint64_t length = 0;
+  int i;
+  for (i = 0; i < test_range; i++) {
+    TA_INT_EQ(roar_contains(r, i), bf_check(ref, i) != 0);
+    length += bf_check(ref, i) != 0;
+  }
+  TEST_ASSERT(roar_length(r) == length);
+  return 0;
+}
+
+/**
+   @brief Fill a bitmap and its reference with a mix of containers: a sparse
+   chunk, a dense one, one of long runs, and an empty one.
+ */
+static void fill(smb_roar *r, unsigned char *ref, unsigned int seed)
+{
+  int i;
+  srand(seed);
+  for (i = 0; i < 1000; i++) {
+    int v = rand() % ROAR_CHUNK;
+    roar_add(r, v);
+    bf_set(ref, v);
+  }
+  for (i = 0; i < 20000; i++) {
+    int v = ROAR_CHUNK + rand() % ROAR_CHUNK;
+    roar_add(r, v);
+    bf_set(ref, v);
+  }
+  for (i = 3 * ROAR_CHUNK + seed * 10; i < test_range; i++) {
+    if (i % 1000 < 500) {
+      roar_add(r, i);
+      bf_set(ref, i);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TESTS
+
+static int test_add_remove(void)
+{
+  smb_roar *r = roar_create();
+  unsigned char *ref = bf_create(test_range);
+  int i;
+
+  TEST_ASSERT(roar_length(r) == 0);
+  TEST_ASSERT(!roar_contains(r, 12345));
+
+  // Grow one chunk past an array, into a bitset, and back down again.
+  for (i = 0; i < 2 * ROAR_ARRAY_MAX; i++) {
+    roar_add(r, 3 * i);
+    bf_set(ref, 3 * i);
+  }
+  roar_add(r, 3);
+  TA_INT_EQ(r->length, 1);
+  TA_INT_EQ(r->containers[0].type, ROAR_BITSET);
+  if (check_same(r, ref)) return 1;
+
+  for (i = 0; i < 2 * ROAR_ARRAY_MAX; i += 2) {
+    roar_remove(r, 3 * i);
+    bf_clear(ref, 3 * i);
+  }
+  roar_remove(r, 1);
+  TA_INT_EQ(r->containers[0].type, ROAR_ARRAY);
+  if (check_same(r, ref)) return 1;
+
+  // Values far apart get their own containers, and emptied ones go.
+  roar_add(r, 0xffffffff);
+  TEST_ASSERT(roar_contains(r, 0xffffffff));
+  TA_INT_EQ(r->length, 2);
+  roar_remove(r, 0xffffffff);
+  TA_INT_EQ(r->length, 1);
+
+  roar_delete(r);
+  bf_delete(ref, test_range);
+  return 0;
+}
+
+static int test_or_and(void)
+{
+  smb_roar a, b, c;
+  unsigned char *ra = bf_create(test_range);
+  unsigned char *rb = bf_create(test_range);
+  unsigned char *rc = bf_create(test_range);
+
+  roar_init(&a);
+  roar_init(&b);
+  roar_init(&c);
+  fill(&a, ra, 1);
+  fill(&b, rb, 2);
+  roar_remove(&b, 3 * ROAR_CHUNK + 10);
+  bf_clear(rb, 3 * ROAR_CHUNK + 10);
+  for (int i = 2 * ROAR_CHUNK; i < 2 * ROAR_CHUNK + 100; i++) {
+    roar_add(&b, i);
+    bf_set(rb, i);
+  }
+
+  roar_or(&c, &a, &b);
+  bf_or(rc, ra, rb, test_range);
+  if (check_same(&c, rc)) return 1;
+
+  roar_and(&c, &a, &b);
+  bf_and(rc, ra, rb, test_range);
+  if (check_same(&c, rc)) return 1;
+
+  // Runs take part too, and dst may be an operand.
+  roar_optimize(&a);
+  roar_and(&a, &a, &b);
+  if (check_same(&a, rc)) return 1;
+  roar_or(&b, &b, &a);
+  if (check_same(&b, rb)) return 1;
+
+  roar_destroy(&a);
+  roar_destroy(&b);
+  roar_destroy(&c);
+  bf_delete(ra, test_range);
+  bf_delete(rb, test_range);
+  bf_delete(rc, test_range);
+  return 0;
+}
+
+static int test_optimize(void)
+{
+  smb_roar *r = roar_create();
+  unsigned char *ref = bf_create(test_range);
+  size_t before;
+  int i;
+
+  fill(r, ref, 3);
+  for (i = 2 * ROAR_CHUNK; i < 3 * ROAR_CHUNK; i++) {
+    roar_add(r, i);
+    bf_set(ref, i);
+  }
+  before = roar_memory(r);
+  roar_optimize(r);
+  TEST_ASSERT(roar_memory(r) < before);
+  TA_INT_EQ(r->containers[0].type, ROAR_ARRAY);
+  TA_INT_EQ(r->containers[1].type, ROAR_BITSET);
+  TA_INT_EQ(r->containers[2].type, ROAR_RUN);
+  TA_INT_EQ(r->containers[2].length, 1);
+  TA_INT_EQ(r->containers[3].type, ROAR_RUN);
+  if (check_same(r, ref)) return 1;
+
+  // Changing a run container turns it back.
+  roar_remove(r, 2 * ROAR_CHUNK + 7);
+  bf_clear(ref, 2 * ROAR_CHUNK + 7);
+  TA_INT_EQ(r->containers[2].type, ROAR_BITSET);
+  roar_add(r, 3 * ROAR_CHUNK + 999);
+  bf_set(ref, 3 * ROAR_CHUNK + 999);
+  TEST_ASSERT(r->containers[3].type != ROAR_RUN);
+  if (check_same(r, ref)) return 1;
+
+  roar_delete(r);
+  bf_delete(ref, test_range);
+  return 0;
+}
+
+static int test_serialize(void)
+{
+  smb_roar r, s;
+  unsigned char *ref = bf_create(test_range);
+  smb_status status = SMB_SUCCESS;
+  FILE *f = tmpfile();
+  long size;
+
+  roar_init(&r);
+  fill(&r, ref, 4);
+  roar_optimize(&r);
+  roar_write(&r, f, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  size = ftell(f);
+
+  rewind(f);
+  roar_read(&s, f, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  if (check_same(&s, ref)) return 1;
+  roar_destroy(&s);
+
+  // Cut short.
+  rewind(f);
+  TEST_ASSERT(ftruncate(fileno(f), size - 1) == 0);
+  roar_read(&s, f, &status);
+  TA_INT_EQ(status, SMB_IO_ERROR);
+  TA_INT_EQ(s.length, 0);
+  roar_destroy(&s);
+
+  // Values out of order.
+  rewind(f);
+  TEST_ASSERT(ftruncate(fileno(f), 0) == 0);
+  fwrite("\x01\x00\x00\x00" "\x00\x00" "\x00\x00" "\x02\x00\x00\x00"
+         "\x05\x00" "\x04\x00", 1, 16, f);
+  rewind(f);
+  status = SMB_SUCCESS;
+  roar_read(&s, f, &status);
+  TA_INT_EQ(status, SMB_IO_ERROR);
+  roar_destroy(&s);
+
+  fclose(f);
+  roar_destroy(&r);
+  bf_delete(ref, test_range);
+  return 0;
+}
+
+static int test_iter(void)
+{
+  smb_roar *r = roar_create();
+  unsigned char *ref = bf_create(test_range);
+  smb_status status = SMB_SUCCESS;
+  smb_iter it;
+  long long prev = -1, count = 0;
+
+  it = roar_get_iter(r);
+  TEST_ASSERT(!it.has_next(&it));
+
+  fill(r, ref, 5);
+  roar_optimize(r);
+  roar_add(r, 0xffffffff);
+  it = roar_get_iter(r);
+  while (it.has_next(&it)) {
+    long long v = it.next(&it, &status).data_llint;
+    TA_INT_EQ(status, SMB_SUCCESS);
+    TEST_ASSERT(v > prev);
+    TEST_ASSERT(v == 0xffffffff || bf_check(ref, v));
+    prev = v;
+    count++;
+  }
+  TEST_ASSERT(prev == 0xffffffff);
+  TEST_ASSERT((uint64_t)count == roar_length(r));
+  it.next(&it, &status);
+  TA_INT_EQ(status, SMB_STOP_ITERATION);
+
+  roar_delete(r);
+  bf_delete(ref, test_range);
+  return 0;
+}
+
+static int test_memory(void)
+{
+  smb_roar *r = roar_create();
+  int i;
+
+  // Scattered ids take about two bytes each, where a bitfield of their range
+  // would take 2MB.
+  for (i = 0; i < 100000; i++) {
+    roar_add(r, (uint32_t)i * 167);
+  }
+  roar_optimize(r);
+  TEST_ASSERT(roar_length(r) == 100000);
+  TEST_ASSERT(roar_memory(r) < 250000);
+
+  roar_delete(r);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST LOADER AND RUNNER
+
+void roar_test(void)
+{
+  smb_ut_group *group = su_create_test_group("test/roartest.c");
+
+  smb_ut_test *add_remove = su_create_test("add_remove", test_add_remove);
+  su_add_test(group, add_remove);
+
+  smb_ut_test *or_and = su_create_test("or_and", test_or_and);
+  su_add_test(group, or_and);
+
+  smb_ut_test *optimize = su_create_test("optimize", test_optimize);
+  su_add_test(group, optimize);
+
+  smb_ut_test *serialize = su_create_test("serialize", test_serialize);
+  su_add_test(group, serialize);
+
+  smb_ut_test *iter = su_create_test("iter", test_iter);
+  su_add_test(group, iter);
+
+  smb_ut_test *memory = su_create_test("memory", test_memory);
+  su_add_test(group, memory);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -17,6 +17,7 @@
 #include <wchar.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 
 #include "libstephen/ut.h"
 #include "libstephen/str.h"
@@ -160,6 +161,170 @@ int test_split_linesw_nonewline(void)
   return 0;
 }
 
+/**
+   @brief Check that a view's lines are "a", "", "bc" and "d".
+ */
+static int check_view_lines(smb_file_view *view)
+{
+  char *lines[] = {"a", "", "bc", "d"};
+  smb_line_iter it = line_iter(view->data, view->length);
+  smb_span line;
+  int i = 0;
+  while (line_next(&it, &line)) {
+    TA_SIZE_EQ(line.length, strlen(lines[i]));
+    TEST_ASSERT(strncmp(line.str, lines[i], line.length) == 0);
+    i++;
+  }
+  TA_INT_EQ(i, 4);
+  return 0;
+}
+
+int test_file_view(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_file_view view;
+  FILE *f = tmpfile();
+  fputs("skip\na\n\nbc\nd", f);
+  rewind(f);
+  free(read_line(f));
+
+  // A regular file is mapped, starting where the stream was.
+  fv_open(&view, f, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  TEST_ASSERT(view.map != NULL);
+  TA_SIZE_EQ(view.length, 7);
+  TA_INT_EQ(check_view_lines(&view), 0);
+  fv_close(&view);
+  fclose(f);
+  return 0;
+}
+
+int test_file_view_pipe(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_file_view view;
+  int fds[2];
+  TA_INT_EQ(pipe(fds), 0);
+  TA_INT_EQ(write(fds[1], "a\n\nbc\nd\n", 8), 8);
+  close(fds[1]);
+
+  // A pipe can't be mapped, so it's read instead.
+  FILE *f = fdopen(fds[0], "r");
+  fv_open(&view, f, &status);
+  TA_INT_EQ(status, SMB_SUCCESS);
+  TEST_ASSERT(view.map == NULL);
+  TA_SIZE_EQ(view.length, 8);
+  TA_INT_EQ(check_view_lines(&view), 0);
+  fv_close(&view);
+  fclose(f);
+  return 0;
+}
+
+int test_line_reader(void)
+{
+  char *lines[] = {"one", "", "a line longer than the buffer", "x", "last"};
+  smb_status status = SMB_SUCCESS;
+  smb_line_reader lr;
+  smb_span line;
+  FILE *f = tmpfile();
+  int i = 0;
+  fputs("one\n\na line longer than the buffer\nx\nlast", f);
+  rewind(f);
+
+  // A tiny buffer, so that lines span refills and make it grow.
+  lr_init(&lr, f, 4);
+  while (lr_next(&lr, &line, &status)) {
+    TA_SIZE_EQ(line.length, strlen(lines[i]));
+    TEST_ASSERT(strncmp(line.str, lines[i], line.length) == 0);
+    i++;
+  }
+  TA_INT_EQ(status, SMB_SUCCESS);
+  TA_INT_EQ(i, 5);
+  TEST_ASSERT(!lr_next(&lr, &line, &status));
+  lr_destroy(&lr);
+
+  fclose(f);
+
+  // A file ending in a newline has no empty last line.
+  f = tmpfile();
+  fputs("a\nb\n", f);
+  rewind(f);
+  lr_init(&lr, f, LR_DEFAULT_SIZE);
+  for (i = 0; lr_next(&lr, &line, &status); i++);
+  TA_INT_EQ(i, 2);
+  lr_destroy(&lr);
+  fclose(f);
+  return 0;
+}
+
+int test_line_reader_pipe(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_line_reader lr;
+  smb_span line;
+  int fds[2];
+  TA_INT_EQ(pipe(fds), 0);
+  FILE *f = fdopen(fds[0], "r");
+
+  // A line comes back while the pipe is still open, without waiting for the
+  // buffer to fill.
+  TA_INT_EQ(write(fds[1], "first\nsec", 9), 9);
+  lr_init(&lr, f, LR_DEFAULT_SIZE);
+  TEST_ASSERT(lr_next(&lr, &line, &status));
+  TA_SIZE_EQ(line.length, 5);
+  TEST_ASSERT(strncmp(line.str, "first", 5) == 0);
+
+  TA_INT_EQ(write(fds[1], "ond\n", 4), 4);
+  close(fds[1]);
+  TEST_ASSERT(lr_next(&lr, &line, &status));
+  TA_SIZE_EQ(line.length, 6);
+  TEST_ASSERT(strncmp(line.str, "second", 6) == 0);
+  TEST_ASSERT(!lr_next(&lr, &line, &status));
+  TA_INT_EQ(status, SMB_SUCCESS);
+
+  lr_destroy(&lr);
+  fclose(f);
+  return 0;
+}
+
+int test_line_reader_mixed(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_line_reader lr;
+  smb_span line;
+  char header[16];
+  int fds[2], i;
+
+  // The reader carries on after a header read with stdio, from a file and
+  // from a pipe.
+  for (int piped = 0; piped < 2; piped++) {
+    FILE *f;
+    if (piped) {
+      TA_INT_EQ(pipe(fds), 0);
+      TA_INT_EQ(write(fds[1], "header\n1\n2\n3\n4\n", 15), 15);
+      close(fds[1]);
+      f = fdopen(fds[0], "r");
+    } else {
+      f = tmpfile();
+      fputs("header\n1\n2\n3\n4\n", f);
+      rewind(f);
+    }
+    TEST_ASSERT(fgets(header, sizeof(header), f));
+    TA_STR_EQ(header, "header\n");
+
+    lr_init(&lr, f, 4);
+    for (i = 0; lr_next(&lr, &line, &status); i++) {
+      TA_SIZE_EQ(line.length, 1);
+      TA_CHAR_EQ(line.str[0], '1' + i);
+    }
+    TA_INT_EQ(status, SMB_SUCCESS);
+    TA_INT_EQ(i, 4);
+    lr_destroy(&lr);
+    fclose(f);
+  }
+  return 0;
+}
+
 void string_test(void)
 {
   smb_ut_group *group = su_create_test_group("test/stringtest.c");
@@ -190,6 +355,21 @@ void string_test(void)
   smb_ut_test *split_linesw_nonewline = su_create_test("split_linesw_nonewline", test_split_linesw_nonewline);
   su_add_test(group, split_linesw_nonewline);
 
+  smb_ut_test *file_view = su_create_test("file_view", test_file_view);
+  su_add_test(group, file_view);
+
+  smb_ut_test *file_view_pipe = su_create_test("file_view_pipe", test_file_view_pipe);
+  su_add_test(group, file_view_pipe);
+
+  smb_ut_test *line_reader = su_create_test("line_reader", test_line_reader);
+  su_add_test(group, line_reader);
+
+  smb_ut_test *line_reader_pipe = su_create_test("line_reader_pipe", test_line_reader_pipe);
+  su_add_test(group, line_reader_pipe);
+
+  smb_ut_test *line_reader_mixed = su_create_test("line_reader_mixed", test_line_reader_mixed);
+  su_add_test(group, line_reader_mixed);
+
   su_run_group(group);
   su_delete_group(group);
 }
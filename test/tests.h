@@ -33,6 +33,16 @@ void hash_table_test();
 */
 void hta_test();
 
+/**
+   Run the grouped hash table tests
+ */
+void hts_test(void);
+
+/**
+   Run the concurrent hash table tests
+ */
+void htc_test(void);
+
 /**
    Run the bit field tests
  */
@@ -63,6 +73,36 @@ void charbuf_test(void);
  */
 void log_test(void);
 
+/**
+   Run the binary log test.
+ */
+void binlog_test(void);
+
+/**
+   Run the compressed bitmap test.
+ */
+void roar_test(void);
+
+/**
+   Run the Bloom filter test.
+ */
+void bloom_test(void);
+
+/**
+   Run the allocator test.
+ */
+void alloc_test(void);
+
+/**
+   Run the arena test.
+ */
+void arena_test(void);
+
+/**
+   Run the benchmark runner test.
+ */
+void bench_test(void);
+
 /**
    Run the string test.
  */
@@ -75,8 +115,14 @@ void parse_test(void);
 void lex_test(void);
 void codegen_test(void);
 void pike_test(void);
+void cache_test(void);
 void ringbuf_test(void);
 
+/**
+   Run the lisp tests.
+ */
+void lisp_test(void);
+
 
 /**
    Output statistics of main function args.
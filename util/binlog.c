@@ -0,0 +1,46 @@
+/***************************************************************************//**
+
+  @file         binlog.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Utility for decoding binary logs into text.
+
+  @copyright    Copyright (c) 2026, Stephen Brennan.  Released under the
+                Revised BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libstephen/binlog.h"
+
+int main(int argc, char *argv[])
+{
+  smb_status status = SMB_SUCCESS;
+  FILE *in = stdin;
+  int i;
+
+  if (argc < 2) {
+    bl_decode(stdin, stdout, &status);
+    return status == SMB_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  for (i = 1; i < argc; i++) {
+    in = fopen(argv[i], "rb");
+    if (!in) {
+      perror(argv[i]);
+      return EXIT_FAILURE;
+    }
+    bl_decode(in, stdout, &status);
+    fclose(in);
+    if (status != SMB_SUCCESS) {
+      fprintf(stderr, "%s: malformed binary log\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
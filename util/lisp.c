@@ -1,5 +1,6 @@
 #include <editline/readline.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "libstephen/lisp.h"
 
@@ -10,6 +11,12 @@ int main(int argc, char **argv)
   lisp_scope *scope = (lisp_scope*)lisp_new(&rt, type_scope);
   lisp_scope_populate_builtins(&rt, scope);
 
+  // With --profile, a report is printed to stderr on exit.
+  bool profile = argc > 1 && strcmp(argv[1], "--profile") == 0;
+  if (profile) {
+    lisp_profile_start(&rt);
+  }
+
   while (true) {
     char *input = readline("> ");
     if (input == NULL) {
@@ -21,10 +28,12 @@ int main(int argc, char **argv)
     lisp_value *result = lisp_eval(&rt, scope, value);
     lisp_print(stdout, result);
     fprintf(stdout, "\n");
-    lisp_mark(&rt, (lisp_value*)scope);
-    lisp_sweep(&rt);
+    lisp_collect(&rt, (lisp_value*)scope);
   }
 
+  if (profile) {
+    lisp_profile_report(&rt, stderr);
+  }
   lisp_destroy(&rt);
   return 0;
 }
@@ -14,17 +14,53 @@
 *******************************************************************************/
 
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "libstephen/re.h"
 
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+   @brief Time reexec() on a string, and report how fast it went.
+ */
+static void bench(Regex code, const char *str)
+{
+  size_t runs = 0, *saves;
+  double start = now(), elapsed;
+  do {
+    reexec(code, str, &saves);
+    free(saves);
+    runs++;
+    elapsed = now() - start;
+  } while (elapsed < 0.25);
+
+  printf(";; \"%s\": %zu runs, %.1f ns/run, %.2f MB/s\n", str, runs,
+         elapsed / runs * 1e9, runs * strlen(str) / elapsed / 1e6);
+}
 
 int main(int argc, char **argv)
 {
+  const char *name = argv[0];
+  // With --bench, time each string instead of reporting its captures.
+  bool timing = argc > 1 && strcmp(argv[1], "--bench") == 0;
+  if (timing) {
+    argv++;
+    argc--;
+  }
+
   if (argc < 3) {
     fprintf(stderr, "too few arguments\n");
-    fprintf(stderr, "usage: %s REGEXP string1 [string2 [...]]\n", argv[0]);
+    fprintf(stderr, "usage: %s [--bench] REGEXP string1 [string2 [...]]\n",
+            name);
     exit(EXIT_FAILURE);
   }
 
@@ -48,6 +84,10 @@ int main(int argc, char **argv)
   printf(";; BEGIN TEST RUNS:\n");
 
   for (int i = 2; i < argc; i++) {
+    if (timing) {
+      bench(code, argv[i]);
+      continue;
+    }
     size_t *saves = NULL;
     ssize_t match = reexec(code, argv[i], &saves);
     if (match != -1) {